@@ -0,0 +1,128 @@
+/**
+ * Compares cat's kernel-side copy with the stream copy it replaced, into
+ * a file and into a pipe.
+ *
+ * Usage: cppshell_bench_cat [MIB]
+ *
+ * Writes a MIB MiB file (default 1024; 10240 outgrows the page cache of
+ * small machines) and copies it with `cat FILE` writing to a descriptor, and
+ * with `out << ifstream.rdbuf()`, as cat did before. A thread drains the
+ * pipe into a buffer. Where the filesystem shares extents, the copy into
+ * a file may take no time at all.
+ */
+
+#include "cppshell/builtins.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/fd_stream.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+void WriteData(const std::filesystem::path &path, size_t mib) {
+  std::vector<char> block(1024 * 1024);
+  uint32_t state = 1;
+  for (char &ch : block) {
+    state = state * 1103515245 + 12345;
+    ch = static_cast<char>(state >> 24);
+  }
+  std::ofstream f(path, std::ios::binary);
+  for (size_t i = 0; i < mib; ++i) {
+    block[i % block.size()] ^= 1;
+    f.write(block.data(), static_cast<std::streamsize>(block.size()));
+  }
+}
+
+/** Seconds copying `path` to `fd` takes, by cat or by the stream copy. */
+double Copy(const std::filesystem::path &path, int fd, bool kernel) {
+  const auto start = std::chrono::steady_clock::now();
+  {
+    cppshell::FdWriteBuffer buffer(fd, false);
+    std::ostream out(&buffer);
+    if (kernel) {
+      std::istringstream in;
+      std::ostringstream err;
+      const cppshell::Environment env;
+      cppshell::CommandStreams streams{in, out, err};
+      cppshell::CommandContext ctx{streams, env};
+      cppshell::CatCommand cat({path.string()});
+      static_cast<void>(cat.Execute(ctx));
+    } else {
+      std::ifstream in(path, std::ios::binary);
+      out << in.rdbuf();
+    }
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double ToFile(const std::filesystem::path &path,
+              const std::filesystem::path &target, bool kernel) {
+  const int fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  const double seconds = Copy(path, fd, kernel);
+  ::close(fd);
+  std::filesystem::remove(target);
+  return seconds;
+}
+
+double ToPipe(const std::filesystem::path &path, bool kernel) {
+  int fds[2];
+  if (::pipe(fds) != 0) {
+    return 0;
+  }
+  std::thread reader([fd = fds[0]] {
+    std::vector<char> buffer(1024 * 1024);
+    while (::read(fd, buffer.data(), buffer.size()) > 0) {
+    }
+  });
+  const double seconds = Copy(path, fds[1], kernel);
+  ::close(fds[1]);
+  reader.join();
+  ::close(fds[0]);
+  return seconds;
+}
+
+void Report(const std::string &name, double seconds, double bytes) {
+  std::cout << std::left << std::setw(16) << name << std::fixed
+            << std::setprecision(4) << seconds << " s  "
+            << std::setprecision(2) << bytes / seconds / 1e9 << " GB/s\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+  if (mib == 0) {
+    std::cerr << "usage: cppshell_bench_cat [MIB]\n";
+    return 2;
+  }
+  const auto dir =
+      std::filesystem::temp_directory_path() / "cppshell_bench_cat";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto path = dir / "data";
+  WriteData(path, mib);
+  const double bytes = static_cast<double>(mib) * 1024 * 1024;
+
+  std::cout << mib << " MiB\n";
+  Report("file, stream", ToFile(path, dir / "copy", false), bytes);
+  Report("file, cat", ToFile(path, dir / "copy", true), bytes);
+  Report("pipe, stream", ToPipe(path, false), bytes);
+  Report("pipe, cat", ToPipe(path, true), bytes);
+
+  std::filesystem::remove_all(dir);
+  return 0;
+}
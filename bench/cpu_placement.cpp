@@ -0,0 +1,121 @@
+/**
+ * Compares CPU placement policies (CPPSHELL_PLACEMENT) on a byte-heavy
+ * four-stage pipeline, with a thread and with a process per stage.
+ *
+ * Usage: cppshell_bench_placement [SIZE_MB [ITERATIONS]]
+ *
+ * Writes a SIZE_MB file (default 512) and streams it through the pipeline
+ * ITERATIONS times (default 3) per policy and mode, reporting the best
+ * throughput. The effect depends on the machine: with one CPU all policies
+ * are equal, across sockets "compact" should win clearly.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/cpu_placement.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/executor.hpp"
+#include "cppshell/parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/** Best seconds per run of `line` over `iterations` runs. */
+double Measure(const cppshell::Executor &executor, const std::string &line,
+               const std::string &mode, const std::string &policy,
+               int iterations) {
+  const cppshell::ParseResult parsed = cppshell::ParseLine(line);
+  if (!parsed.Ok() || !parsed.pipeline.has_value()) {
+    std::cerr << "cannot parse: " << line << '\n';
+    std::exit(2);
+  }
+  cppshell::Environment env;
+  env.Set("CPPSHELL_PIPELINE_MODE", mode);
+  env.Set("CPPSHELL_PLACEMENT", policy);
+
+  // Forked stages write to fd 1 directly; keep the report readable.
+  std::fflush(stdout);
+  const int savedStdout = dup(STDOUT_FILENO);
+  const int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  dup2(devNull, STDOUT_FILENO);
+
+  double best = 0;
+  for (int i = 0; i < iterations; ++i) {
+    std::istringstream in;
+    std::ostringstream out;
+    std::ostringstream err;
+    const auto start = std::chrono::steady_clock::now();
+    static_cast<void>(executor.RunPipeline(
+        *parsed.pipeline, env, cppshell::CommandStreams{in, out, err}));
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    best = i == 0 ? seconds : std::min(best, seconds);
+  }
+
+  std::fflush(stdout);
+  dup2(savedStdout, STDOUT_FILENO);
+  close(savedStdout);
+  close(devNull);
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long sizeMb = argc > 1 ? std::atol(argv[1]) : 512;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 3;
+  if (sizeMb <= 0 || iterations <= 0) {
+    std::cerr << "usage: cppshell_bench_placement [SIZE_MB [ITERATIONS]]\n";
+    return 2;
+  }
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "cppshell_bench_placement.txt";
+  {
+    std::ofstream f(file, std::ios::binary);
+    std::string block;
+    for (int i = 0; block.size() < 1024 * 1024; ++i) {
+      block += "line " + std::to_string(i) + " of the placement benchmark\n";
+    }
+    block.resize(1024 * 1024);
+    for (long i = 0; i < sizeMb; ++i) {
+      f.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+  }
+  const double gigabytes = static_cast<double>(sizeMb) / 1024.0;
+  const std::string line = "cat " + file.string() + " | cat | cat | cat";
+
+  const cppshell::CommandFactory factory;
+  const cppshell::Executor executor(factory);
+
+  std::cout << "pipeline: " << line << '\n'
+            << "cpus: " << cppshell::CurrentCpuTopology().cpus.size() << '\n';
+  std::cout << std::left << std::setw(9) << "mode" << std::setw(9)
+            << "policy" << "GB/s\n";
+  for (const std::string mode : {"threads", "fork"}) {
+    for (const std::string policy : {"os", "compact", "spread"}) {
+      const double seconds = Measure(executor, line, mode, policy, iterations);
+      std::cout << std::left << std::setw(9) << mode << std::setw(9) << policy
+                << std::fixed << std::setprecision(2) << gigabytes / seconds
+                << '\n';
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(file, ec);
+  return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Compares the transports between forked pipeline stages: shared-memory
+ * rings and vmsplice (CPPSHELL_FORK_TRANSPORT unset) against plain pipes.
+ *
+ * Usage: cppshell_bench_transport [SIZE_MB [ITERATIONS]]
+ *
+ * Writes a SIZE_MB file (default 1024) and streams it through each
+ * pipeline ITERATIONS times (default 3) per transport, reporting the best
+ * throughput. Stage output is discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/executor.hpp"
+#include "cppshell/parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/** Best seconds per run of `line` over `iterations` runs. */
+double Measure(const cppshell::Executor &executor, const std::string &line,
+               const std::string &transport, int iterations) {
+  const cppshell::ParseResult parsed = cppshell::ParseLine(line);
+  if (!parsed.Ok() || !parsed.pipeline.has_value()) {
+    std::cerr << "cannot parse: " << line << '\n';
+    std::exit(2);
+  }
+  cppshell::Environment env;
+  env.Set("CPPSHELL_PIPELINE_MODE", "fork");
+  env.Set("CPPSHELL_FORK_TRANSPORT", transport);
+
+  // Forked stages write to fd 1 directly; keep the report readable.
+  std::fflush(stdout);
+  const int savedStdout = dup(STDOUT_FILENO);
+  const int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  dup2(devNull, STDOUT_FILENO);
+
+  double best = 0;
+  for (int i = 0; i < iterations; ++i) {
+    std::istringstream in;
+    std::ostringstream out;
+    std::ostringstream err;
+    const auto start = std::chrono::steady_clock::now();
+    static_cast<void>(executor.RunPipeline(
+        *parsed.pipeline, env, cppshell::CommandStreams{in, out, err}));
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    best = i == 0 ? seconds : std::min(best, seconds);
+  }
+
+  std::fflush(stdout);
+  dup2(savedStdout, STDOUT_FILENO);
+  close(savedStdout);
+  close(devNull);
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const long sizeMb = argc > 1 ? std::atol(argv[1]) : 1024;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 3;
+  if (sizeMb <= 0 || iterations <= 0) {
+    std::cerr << "usage: cppshell_bench_transport [SIZE_MB [ITERATIONS]]\n";
+    return 2;
+  }
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "cppshell_bench_transport.txt";
+  {
+    std::ofstream f(file, std::ios::binary);
+    std::string block;
+    for (int i = 0; block.size() < 1024 * 1024; ++i) {
+      block += "line " + std::to_string(i) + " of the transport benchmark\n";
+    }
+    block.resize(1024 * 1024);
+    for (long i = 0; i < sizeMb; ++i) {
+      f.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+  }
+  const double gigabytes = static_cast<double>(sizeMb) / 1024.0;
+
+  const std::vector<std::string> pipelines = {
+      // Builtin to builtin: shared-memory rings. wc's counting tends to
+      // dominate the first; the second measures the transport itself.
+      "cat " + file.string() + " | cat | cat | wc",
+      "cat " + file.string() + " | cat | cat | cat",
+      // Builtin to external program: vmsplice.
+      "cat " + file.string() + " | cat | tail -c 1",
+  };
+  const std::vector<std::string> transports = {"shm", "pipe"};
+
+  const cppshell::CommandFactory factory;
+  const cppshell::Executor executor(factory);
+
+  std::cout << std::left << std::setw(11) << "transport" << std::setw(10)
+            << "GB/s" << "pipeline\n";
+  for (const std::string &line : pipelines) {
+    for (const std::string &transport : transports) {
+      const double seconds = Measure(executor, line, transport, iterations);
+      std::cout << std::left << std::setw(11) << transport << std::setw(10)
+                << std::fixed << std::setprecision(2) << gigabytes / seconds
+                << line << '\n';
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(file, ec);
+  return 0;
+}
@@ -0,0 +1,163 @@
+/**
+ * Shows what binary detection saves grep -r in a tree of mixed artifacts.
+ *
+ * Usage: cppshell_bench_grep_binary [FILES]
+ *
+ * Creates FILES (default 200) text files of 64 KiB of log lines and as
+ * many 1 MiB binary artifacts of random bytes, and runs grep -r over the
+ * tree with --binary-files=text (every binary searched to the end and its
+ * lines printed), with --binary-files=binary (stops at the first
+ * selected line of each binary) and with -I (binaries left unread
+ * after their first block). Then it compares the LooksBinary() scan of a
+ * 64 KiB block with looking for a NUL byte only.
+ */
+
+#include "cppshell/binary_detect.hpp"
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr size_t kTextBytes = 64 * 1024;
+constexpr size_t kBinaryBytes = 1024 * 1024;
+
+void MakeTree(const std::filesystem::path &root, size_t files) {
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "src");
+  std::filesystem::create_directories(root / "build");
+  std::mt19937 rng(1);
+  for (size_t i = 0; i < files; ++i) {
+    std::ofstream text(root / "src" / ("log" + std::to_string(i) + ".txt"));
+    for (size_t written = 0; written < kTextBytes;) {
+      const std::string line = "12:00:" + std::to_string(rng() % 60) +
+                               " request " + std::to_string(rng() % 100000) +
+                               " status=" + std::to_string(200 + rng() % 5) +
+                               "\n";
+      text << line;
+      written += line.size();
+    }
+    // Random bytes with a string table of log lines every 4 KiB.
+    std::string bytes(kBinaryBytes, '\0');
+    for (char &c : bytes) {
+      c = static_cast<char>(rng());
+    }
+    for (size_t at = 0; at + 64 < bytes.size(); at += 4096) {
+      const std::string entry = "\nrequest " + std::to_string(rng() % 100000) +
+                                " status=" + std::to_string(200 + rng() % 5) +
+                                "\n";
+      bytes.replace(at, entry.size(), entry);
+    }
+    std::ofstream(root / "build" / ("obj" + std::to_string(i) + ".o"),
+                  std::ios::binary)
+        << bytes;
+  }
+}
+
+/** Seconds grep with `args` takes; `output` gets the bytes it printed. */
+double Measure(std::vector<std::string> args, size_t &output) {
+  std::istringstream in;
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", "1");
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  cppshell::GrepCommand grep(std::move(args));
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(grep.Execute(ctx));
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  output = out.str().size();
+  return seconds;
+}
+
+template <typename F> double MiBPerSecond(const std::string &block, F &&scan) {
+  constexpr int kRounds = 2000;
+  bool any = false;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRounds; ++i) {
+    // A different end each round, so the scan is not hoisted.
+    const std::string_view data(block.data(), block.size() - i % 2);
+    any = scan(data) || any;
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  if (any) {
+    std::cerr << "unexpected binary block\n";
+  }
+  return static_cast<double>(block.size()) * kRounds / (1024 * 1024) /
+         seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t files = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+  if (files == 0) {
+    std::cerr << "usage: cppshell_bench_grep_binary [FILES]\n";
+    return 2;
+  }
+
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_bench_binary";
+  MakeTree(root, files);
+
+  std::cout << "tree: " << files << " text files of 64 KiB, " << files
+            << " binaries of 1 MiB\n"
+            << std::left << std::setw(28) << "grep -r" << std::setw(12)
+            << "seconds" << "output bytes\n";
+  for (const std::string mode :
+       {"--binary-files=text", "--binary-files=binary", "-I"}) {
+    size_t output = 0;
+    const double seconds =
+        Measure({"-r", mode, "status=20[34]", root.string()}, output);
+    std::cout << std::left << std::setw(28) << mode << std::setw(12)
+              << std::fixed << std::setprecision(4) << seconds << output
+              << std::endl;
+  }
+
+  std::string ascii;
+  while (ascii.size() < kTextBytes) {
+    ascii += "12:00:31 request 4242 status=200 from 10.0.0.1\n";
+  }
+  std::string cyrillic;
+  while (cyrillic.size() < kTextBytes) {
+    cyrillic += "\xD0\xB7\xD0\xB0\xD0\xBF\xD1\x80\xD0\xBE\xD1\x81 4242 "
+                "\xD1\x81\xD1\x82\xD0\xB0\xD1\x82\xD1\x83\xD1\x81=200\n";
+  }
+  const auto nul = [](std::string_view block) {
+    return block.find('\0') != std::string_view::npos;
+  };
+  const auto full = [](std::string_view block) {
+    return cppshell::LooksBinary(block);
+  };
+  std::cout << "\n"
+            << std::left << std::setw(28) << "64 KiB block" << std::setw(16)
+            << "NUL only MiB/s" << "LooksBinary MiB/s\n";
+  for (const auto &[name, block] :
+       {std::pair<std::string, const std::string &>{"ASCII", ascii},
+        std::pair<std::string, const std::string &>{"UTF-8 Cyrillic",
+                                                    cyrillic}}) {
+    std::cout << std::left << std::setw(28) << name << std::setw(16)
+              << std::setprecision(0) << MiBPerSecond(block, nul)
+              << MiBPerSecond(block, full) << std::endl;
+  }
+
+  std::filesystem::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * Compares grep's block scan with matching line by line.
+ *
+ * Usage: cppshell_bench_grep_block [SIZE_MB]
+ *
+ * Builds two in-memory corpora of SIZE_MB megabytes (default 256): a log
+ * with short lines and the same records joined into 1 MiB lines. Each is
+ * searched on one thread the way grep did before (LineSource splitting
+ * every 64 KiB chunk into lines, then GrepMatcher::MatchLines) and the way
+ * it does now (BlockReader handing out 64 KiB blocks of unsplit lines to
+ * GrepMatcher::MatchBlock). Only the number of selected lines is kept.
+ */
+
+#include "cppshell/grep_matcher.hpp"
+#include "cppshell/line_channel.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/** Log records, ending a line after every `perLine` bytes or so. */
+[[nodiscard]] std::string MakeCorpus(size_t bytes, size_t perLine) {
+  static const char *const kLevels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  std::string corpus;
+  corpus.reserve(bytes + 256);
+  size_t lineStart = 0;
+  for (unsigned i = 0; corpus.size() < bytes; ++i) {
+    corpus += "2026-10-19T12:" + std::to_string(i % 60) + " " +
+              kLevels[(i * 7) % 4] + " worker-" + std::to_string(i % 32) +
+              " request " + std::to_string(i) + " status=" +
+              std::to_string(200 + (i % 5) * 100);
+    if (corpus.size() - lineStart >= perLine) {
+      corpus += '\n';
+      lineStart = corpus.size();
+    } else {
+      corpus += ' ';
+    }
+  }
+  corpus += '\n';
+  return corpus;
+}
+
+/** Seconds to select lines chunk by chunk; counts them into `selected`. */
+double TimeLines(const std::string &corpus, const cppshell::GrepMatcher &m,
+                 size_t &selected) {
+  std::istringstream in(corpus);
+  const auto start = Clock::now();
+  cppshell::LineSource source(in);
+  std::vector<size_t> matches;
+  selected = 0;
+  while (const auto chunk = source.Next()) {
+    matches.clear();
+    m.MatchLines(*chunk, matches);
+    selected += matches.size();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Seconds to select lines block by block; counts them into `selected`. */
+double TimeBlocks(const std::string &corpus, const cppshell::GrepMatcher &m,
+                  size_t &selected) {
+  std::istringstream in(corpus);
+  const auto start = Clock::now();
+  cppshell::BlockReader reader(in, 64 * 1024, SIZE_MAX);
+  std::vector<cppshell::LineSpan> spans;
+  selected = 0;
+  while (true) {
+    const cppshell::BlockReader::Block block = reader.Next();
+    if (block.data == nullptr) {
+      break;
+    }
+    spans.clear();
+    m.MatchBlock(*block.data, spans);
+    selected += spans.size();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+  if (sizeMb == 0) {
+    std::cerr << "usage: cppshell_bench_grep_block [SIZE_MB]\n";
+    return 2;
+  }
+  const double megabytes = static_cast<double>(sizeMb);
+
+  std::cout << std::left << std::setw(12) << "corpus" << std::setw(18)
+            << "pattern" << std::setw(14) << "lines MiB/s" << std::setw(15)
+            << "blocks MiB/s"
+            << "speedup\n";
+  for (const size_t perLine : {size_t{0}, size_t{1024 * 1024}}) {
+    const std::string corpus = MakeCorpus(sizeMb * 1024 * 1024, perLine);
+    const char *name = perLine == 0 ? "short" : "1 MiB";
+    for (const char *pattern :
+         {"zebra", "ERROR", "request 77", "status=[45]0"}) {
+      const cppshell::GrepMatcher matcher(pattern, {});
+      size_t byLines = 0;
+      size_t byBlocks = 0;
+      const double lines = TimeLines(corpus, matcher, byLines);
+      const double blocks = TimeBlocks(corpus, matcher, byBlocks);
+      if (byLines != byBlocks) {
+        std::cerr << "selections differ for " << pattern << '\n';
+        return 1;
+      }
+      std::cout << std::left << std::setw(12) << name << std::setw(18)
+                << pattern << std::setw(14) << std::fixed
+                << std::setprecision(0) << megabytes / lines << std::setw(15)
+                << megabytes / blocks << std::setprecision(2)
+                << lines / blocks << "x" << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Compares grep -r with grep --index on a tree where few files match.
+ *
+ * Usage: cppshell_bench_grep_index [FILES] [THREADS]
+ *
+ * Writes FILES files (default 2000) of about 20 KiB of generated words
+ * under a temporary directory; one file in a hundred also holds a rare
+ * word. Times building the index, updating it after one file changes,
+ * and searching for the rare word (and for a word in every file) with a
+ * full recursive scan and through the index. Output is discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+#include "cppshell/trigram_index.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+/** Writes file `n`, changed an hour ago so that the index trusts it. */
+void WriteFile(const std::filesystem::path &path, size_t n) {
+  static const char *const kWords[] = {"alpha", "beta",  "gamma", "delta",
+                                       "omega", "sigma", "kappa", "theta"};
+  std::filesystem::create_directories(path.parent_path());
+  {
+    std::ofstream f(path, std::ios::binary);
+    uint64_t state = n * 2654435761u + 1;
+    for (size_t line = 0; line < 400; ++line) {
+      for (size_t word = 0; word < 6; ++word) {
+        state = state * 6364136223846793005u + 1442695040888963407u;
+        f << kWords[(state >> 33) % 8] << ((state >> 40) % 1000) << ' ';
+      }
+      if (n % 100 == 0 && line == 200) {
+        f << "needle";
+      }
+      f << '\n';
+    }
+  }
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now() -
+                std::chrono::hours(1));
+}
+
+/** Seconds `fn` takes. */
+template <typename F> double Time(F &&fn) {
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/** Seconds one grep with `args` takes. */
+double Measure(std::vector<std::string> args, const std::string &threads) {
+  std::istringstream in;
+  NullBuffer sink;
+  std::ostream out(&sink);
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", threads);
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  cppshell::GrepCommand grep(std::move(args));
+  return Time([&] { static_cast<void>(grep.Execute(ctx)); });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+  const std::string threads = argc > 2 ? argv[2] : "1";
+  if (count == 0) {
+    std::cerr << "usage: cppshell_bench_grep_index [FILES] [THREADS]\n";
+    return 2;
+  }
+
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_bench_grep_index";
+  std::filesystem::remove_all(root);
+  for (size_t n = 0; n < count; ++n) {
+    WriteFile(root / std::to_string(n % 32) / (std::to_string(n) + ".txt"), n);
+  }
+  const std::string dir = root.string();
+  const size_t workers = std::strtoull(threads.c_str(), nullptr, 10);
+
+  std::cout << count << " files, " << threads << " thread(s)\n"
+            << std::fixed << std::setprecision(4);
+  cppshell::IndexBuild built;
+  const auto build = [&] {
+    built = cppshell::TrigramIndex::Build(dir, workers);
+  };
+  const double full = Time(build);
+  std::cout << std::left << std::setw(28) << "index build" << full << " s ("
+            << built.read << " files read)\n";
+  WriteFile(root / "0" / "0.txt", 1);
+  const double update = Time(build);
+  std::cout << std::setw(28) << "index update, 1 changed" << update << " s ("
+            << built.read << " files read)\n";
+
+  for (const std::string pattern : {"needle", "alpha1"}) {
+    const double scan = Measure({"-r", "--exclude=.cppshell-grep-index",
+                                 pattern, dir},
+                                threads);
+    const double indexed = Measure({"--index", dir, pattern}, threads);
+    std::cout << std::setw(28) << ("grep -r " + pattern) << scan << " s\n"
+              << std::setw(28) << ("grep --index " + pattern) << indexed
+              << " s\n";
+  }
+
+  std::filesystem::remove_all(root);
+  return 0;
+}
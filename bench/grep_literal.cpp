@@ -0,0 +1,121 @@
+/**
+ * Compares grep's literal fast path with the std::regex path on a log.
+ *
+ * Usage: cppshell_bench_grep_literal [SIZE_MB]
+ *
+ * Writes a synthetic log of SIZE_MB megabytes (default 1024) and greps it
+ * on one thread with pairs of equivalent patterns: a literal one and the
+ * same string written with a character class, which forces std::regex.
+ * Matches are discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+void WriteLog(const std::filesystem::path &path, size_t bytes) {
+  static const char *const kLevels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  std::ofstream f(path, std::ios::binary);
+  std::string line;
+  size_t written = 0;
+  for (unsigned i = 0; written < bytes; ++i) {
+    line = "2026-10-19T12:" + std::to_string(i % 60) + ":" +
+           std::to_string(i % 59) + " " + kLevels[(i * 7) % 4] +
+           " worker-" + std::to_string(i % 32) + " request " +
+           std::to_string(i) + " finished in " + std::to_string(i % 997) +
+           "ms status=" + std::to_string(200 + (i % 5) * 100) + '\n';
+    f << line;
+    written += line.size();
+  }
+}
+
+/** Seconds one grep over `path` with `args` takes. */
+double Measure(const std::filesystem::path &path,
+               std::vector<std::string> args) {
+  std::istringstream in;
+  NullBuffer sink;
+  std::ostream out(&sink);
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", "1");
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  args.push_back(path.string());
+  cppshell::GrepCommand grep(std::move(args));
+
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(grep.Execute(ctx));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+  if (sizeMb == 0) {
+    std::cerr << "usage: cppshell_bench_grep_literal [SIZE_MB]\n";
+    return 2;
+  }
+
+  const auto path = std::filesystem::temp_directory_path() /
+                    "cppshell_bench_grep_literal.log";
+  WriteLog(path, sizeMb * 1024 * 1024);
+  const double megabytes =
+      static_cast<double>(std::filesystem::file_size(path)) / (1024 * 1024);
+
+  // Literal pattern, then the same search through std::regex.
+  const std::vector<std::pair<std::vector<std::string>,
+                              std::vector<std::string>>>
+      cases = {
+          {{"request 4242 "}, {"request 424[2] "}},
+          {{"-i", "fatal"}, {"-i", "fata[l]"}},
+          {{"-w", "ERROR"}, {"-w", "ERRO[R]"}},
+          {{"-F", "ms status=5"}, {"ms status=[5]"}},
+      };
+
+  std::cout << "log: " << std::fixed << std::setprecision(0) << megabytes
+            << " MiB, one thread\n"
+            << std::left << std::setw(26) << "pattern" << std::setw(14)
+            << "literal MiB/s" << std::setw(12) << "regex MiB/s"
+            << "speedup\n";
+  for (const auto &[literal, regex] : cases) {
+    std::string name;
+    for (const std::string &arg : literal) {
+      name += (name.empty() ? "" : " ") + arg;
+    }
+    const double fast = Measure(path, literal);
+    const double slow = Measure(path, regex);
+    std::cout << std::left << std::setw(26) << name << std::setw(14)
+              << std::setprecision(0) << megabytes / fast << std::setw(12)
+              << megabytes / slow << std::setprecision(1) << slow / fast
+              << "x\n";
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return 0;
+}
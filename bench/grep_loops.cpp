@@ -0,0 +1,114 @@
+/**
+ * Shows what grep costs per line on short lines, per option combination.
+ *
+ * Usage: cppshell_bench_grep_loops [MILLION_LINES] [THREADS]
+ *
+ * Writes MILLION_LINES million lines (default 16) of 8 to 24 bytes, a
+ * quarter of which hold "key", and greps them with THREADS workers
+ * (default 1) once per combination of the options the scanning loops are
+ * specialised on. Output is discarded; what is left is the loop over
+ * lines and the writing of the selected ones.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+void WriteLines(const std::filesystem::path &path, size_t lines) {
+  static const char *const kWords[] = {"key", "value", "Item", "node"};
+  std::ofstream f(path, std::ios::binary);
+  std::string line;
+  for (size_t i = 0; i < lines; ++i) {
+    line = std::string(kWords[(i * 7) % 4]) + "=" +
+           std::to_string(i % 100003) + std::string(i % 11, 'x') + '\n';
+    f << line;
+  }
+}
+
+/** Seconds one grep over `path` with `args` takes. */
+double Measure(const std::filesystem::path &path,
+               std::vector<std::string> args, const std::string &threads) {
+  std::istringstream in;
+  NullBuffer sink;
+  std::ostream out(&sink);
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", threads);
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  args.push_back(path.string());
+  cppshell::GrepCommand grep(std::move(args));
+
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(grep.Execute(ctx));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t million = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+  const std::string threads = argc > 2 ? argv[2] : "1";
+  if (million == 0) {
+    std::cerr << "usage: cppshell_bench_grep_loops [MILLION_LINES] "
+                 "[THREADS]\n";
+    return 2;
+  }
+
+  const auto path = std::filesystem::temp_directory_path() /
+                    "cppshell_bench_grep_loops.txt";
+  const size_t lines = million * 1000 * 1000;
+  WriteLines(path, lines);
+
+  const std::vector<std::vector<std::string>> cases = {
+      {"key"},          {"-n", "key"},     {"-v", "key"},
+      {"-vn", "key"},   {"-c", "key"},     {"-cv", "key"},
+      {"-i", "KEY"},    {"-w", "key"},     {"-in", "KEY"},
+      {"ke[y]"},        {"-n", "ke[y]"},   {"-v", "ke[y]"},
+      {"-c", "ke[y]"},  {"-C", "1", "key"}, {"-e", "key", "-e", "node"},
+  };
+
+  std::cout << lines << " lines, " << threads << " thread(s)\n"
+            << std::left << std::setw(24) << "options" << std::setw(12)
+            << "seconds"
+            << "ns/line\n";
+  for (const auto &args : cases) {
+    std::string name;
+    for (const std::string &arg : args) {
+      name += (name.empty() ? "" : " ") + arg;
+    }
+    const double seconds = Measure(path, args, threads);
+    std::cout << std::left << std::setw(24) << name << std::setw(12)
+              << std::fixed << std::setprecision(4) << seconds
+              << std::setprecision(2)
+              << seconds * 1e9 / static_cast<double>(lines) << std::endl;
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * Shows grep's early exits and counting modes on a large log.
+ *
+ * Usage: cppshell_bench_grep_modes [SIZE_MB] [THREADS]
+ *
+ * Writes a synthetic log of SIZE_MB megabytes (default 1024) and greps it
+ * with THREADS workers (default 1) once per output mode. ERROR occurs on
+ * every fourth line from the start, so -q, -l and -m stop within the first
+ * block, while printing and -c read the whole file. The -C runs show what
+ * keeping context costs, with matches and with none. Output is discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+void WriteLog(const std::filesystem::path &path, size_t bytes) {
+  static const char *const kLevels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  std::ofstream f(path, std::ios::binary);
+  std::string line;
+  size_t written = 0;
+  for (unsigned i = 0; written < bytes; ++i) {
+    line = "2026-10-19T12:" + std::to_string(i % 60) + ":" +
+           std::to_string(i % 59) + " " + kLevels[(i * 7) % 4] +
+           " worker-" + std::to_string(i % 32) + " request " +
+           std::to_string(i) + " finished in " + std::to_string(i % 997) +
+           "ms status=" + std::to_string(200 + (i % 5) * 100) + '\n';
+    f << line;
+    written += line.size();
+  }
+}
+
+/** Seconds one grep over `path` with `args` takes. */
+double Measure(const std::filesystem::path &path,
+               std::vector<std::string> args, const std::string &threads) {
+  std::istringstream in;
+  NullBuffer sink;
+  std::ostream out(&sink);
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", threads);
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  args.push_back(path.string());
+  cppshell::GrepCommand grep(std::move(args));
+
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(grep.Execute(ctx));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+  const std::string threads = argc > 2 ? argv[2] : "1";
+  if (sizeMb == 0) {
+    std::cerr << "usage: cppshell_bench_grep_modes [SIZE_MB] [THREADS]\n";
+    return 2;
+  }
+
+  const auto path = std::filesystem::temp_directory_path() /
+                    "cppshell_bench_grep_modes.log";
+  WriteLog(path, sizeMb * 1024 * 1024);
+  const double megabytes =
+      static_cast<double>(std::filesystem::file_size(path)) / (1024 * 1024);
+
+  const std::vector<std::vector<std::string>> cases = {
+      {"ERROR"},
+      {"-n", "ERROR"},
+      {"-v", "ERROR"},
+      {"-c", "ERROR"},
+      {"-q", "ERROR"},
+      {"-l", "ERROR"},
+      {"-m", "1", "ERROR"},
+      {"-m", "1000", "ERROR"},
+      {"-C", "3", "ERROR"},
+      {"-C", "3", "zebra"},
+  };
+
+  std::cout << "log: " << std::fixed << std::setprecision(0) << megabytes
+            << " MiB, " << threads << " thread(s)\n"
+            << std::left << std::setw(20) << "options" << std::setw(12)
+            << "seconds" << std::setw(12) << "MiB/s"
+            << "vs printing\n";
+  double printing = 0;
+  for (const auto &args : cases) {
+    std::string name;
+    for (const std::string &arg : args) {
+      name += (name.empty() ? "" : " ") + arg;
+    }
+    const double seconds = Measure(path, args, threads);
+    if (printing == 0) {
+      printing = seconds;
+    }
+    std::cout << std::left << std::setw(20) << name << std::setw(12)
+              << std::setprecision(4) << seconds << std::setw(12)
+              << std::setprecision(0) << megabytes / seconds
+              << std::setprecision(1) << printing / seconds << "x"
+              << std::endl;
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return 0;
+}
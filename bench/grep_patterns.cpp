@@ -0,0 +1,130 @@
+/**
+ * Shows how grep's throughput changes with the number of patterns.
+ *
+ * Usage: cppshell_bench_grep_patterns [SIZE_MB] [MAX_PATTERNS]
+ *
+ * Writes a synthetic log of SIZE_MB megabytes (default 256) whose lines
+ * name one of a million user identifiers, and counts (-c) the lines naming
+ * one of a block-list of 10, 100, ... up to MAX_PATTERNS (default 100000)
+ * identifiers, read with -f. Up to 1000 patterns the same list is also
+ * given as one regex alternation `id1|id2|...` for comparison.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr unsigned kUsers = 1000000;
+
+[[nodiscard]] std::string UserId(unsigned user) {
+  std::ostringstream id;
+  id << "u" << std::hex << std::setw(8) << std::setfill('0')
+     << user * 2654435761U;
+  return id.str();
+}
+
+void WriteLog(const std::filesystem::path &path, size_t bytes) {
+  std::mt19937 rng(1);
+  std::ofstream f(path, std::ios::binary);
+  std::string line;
+  size_t written = 0;
+  for (unsigned i = 0; written < bytes; ++i) {
+    line = "2026-10-19T12:" + std::to_string(i % 60) + " login user=" +
+           UserId(rng() % kUsers) + " from 10.0." + std::to_string(i % 256) +
+           "." + std::to_string(i % 199) + " status=ok\n";
+    f << line;
+    written += line.size();
+  }
+}
+
+/** Seconds one grep with `args` over `path` takes, and its output. */
+double Measure(const std::filesystem::path &path,
+               std::vector<std::string> args, std::string &output) {
+  std::istringstream in;
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", "1");
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  args.push_back(path.string());
+  cppshell::GrepCommand grep(std::move(args));
+
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(grep.Execute(ctx));
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  output = out.str().substr(0, out.str().find('\n'));
+  return seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+  const size_t maxPatterns =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+  if (sizeMb == 0 || maxPatterns == 0 || maxPatterns > kUsers) {
+    std::cerr << "usage: cppshell_bench_grep_patterns [SIZE_MB] "
+                 "[MAX_PATTERNS]\n";
+    return 2;
+  }
+
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto log = dir / "cppshell_bench_grep_patterns.log";
+  const auto list = dir / "cppshell_bench_grep_patterns.txt";
+  WriteLog(log, sizeMb * 1024 * 1024);
+  const double megabytes =
+      static_cast<double>(std::filesystem::file_size(log)) / (1024 * 1024);
+
+  std::cout << "log: " << std::fixed << std::setprecision(0) << megabytes
+            << " MiB\n"
+            << std::left << std::setw(10) << "patterns" << std::setw(14)
+            << "how" << std::setw(12) << "seconds" << std::setw(12)
+            << "MiB/s" << "lines\n";
+  std::mt19937 rng(2);
+  for (size_t count = 10; count <= maxPatterns; count *= 10) {
+    std::vector<std::string> ids;
+    std::string alternation;
+    {
+      std::ofstream f(list, std::ios::binary);
+      for (size_t i = 0; i < count; ++i) {
+        ids.push_back(UserId(rng() % kUsers));
+        f << ids.back() << '\n';
+        alternation += (i == 0 ? "" : "|") + ids.back();
+      }
+    }
+    const auto row = [&](const std::string &how,
+                         std::vector<std::string> args) {
+      std::string lines;
+      const double seconds = Measure(log, std::move(args), lines);
+      std::cout << std::left << std::setw(10) << count << std::setw(14)
+                << how << std::setw(12) << std::setprecision(4) << seconds
+                << std::setw(12) << std::setprecision(0)
+                << megabytes / seconds << lines << std::endl;
+    };
+    row("-f", {"-c", "-f", list.string()});
+    if (count <= 1000) {
+      row("alternation", {"-c", alternation});
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(log, ec);
+  std::filesystem::remove(list, ec);
+  return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Compares the RegexAutomaton behind grep with std::regex.
+ *
+ * Usage: cppshell_bench_grep_regex [SIZE_MB]
+ *
+ * First searches SIZE_MB megabytes (default 64) of synthetic log lines
+ * with typical grep patterns, one line at a time on one thread, and
+ * reports the throughput of both engines. Then times adversarial patterns
+ * on single lines of growing length, where std::regex backtracks
+ * exponentially; it is skipped once a run exceeds a second.
+ */
+
+#include "cppshell/regex_automaton.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]] std::vector<std::string> MakeLog(size_t bytes) {
+  static const char *const kLevels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  std::vector<std::string> lines;
+  size_t total = 0;
+  for (unsigned i = 0; total < bytes; ++i) {
+    lines.push_back("2026-10-19T12:" + std::to_string(i % 60) + ":" +
+                    std::to_string(i % 59) + " " + kLevels[(i * 7) % 4] +
+                    " worker-" + std::to_string(i % 32) + " request " +
+                    std::to_string(i) + " finished in " +
+                    std::to_string(i % 997) + "ms status=" +
+                    std::to_string(200 + (i % 5) * 100));
+    total += lines.back().size() + 1;
+  }
+  return lines;
+}
+
+[[nodiscard]] double Seconds(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** Seconds the automaton needs for `lines`; counts matches into `hits`. */
+double TimeAutomaton(const std::string &pattern,
+                     const std::vector<std::string> &lines, size_t &hits) {
+  const auto automaton = cppshell::RegexAutomaton::Compile(pattern, false);
+  if (automaton == nullptr) {
+    std::cerr << "not supported by the automaton: " << pattern << '\n';
+    std::exit(2);
+  }
+  auto searcher = automaton->Acquire();
+  hits = 0;
+  const auto start = Clock::now();
+  for (const std::string &line : lines) {
+    hits += searcher->Search(line) ? 1 : 0;
+  }
+  return Seconds(start);
+}
+
+double TimeStdRegex(const std::string &pattern,
+                    const std::vector<std::string> &lines, size_t &hits) {
+  const std::regex re(pattern, std::regex_constants::ECMAScript);
+  hits = 0;
+  const auto start = Clock::now();
+  for (const std::string &line : lines) {
+    hits += std::regex_search(line, re) ? 1 : 0;
+  }
+  return Seconds(start);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+  if (sizeMb == 0) {
+    std::cerr << "usage: cppshell_bench_grep_regex [SIZE_MB]\n";
+    return 2;
+  }
+
+  const std::vector<std::string> log = MakeLog(sizeMb * 1024 * 1024);
+  const double megabytes = static_cast<double>(sizeMb);
+  std::cout << "typical patterns, " << sizeMb << " MiB of log lines\n"
+            << std::left << std::setw(34) << "pattern" << std::setw(16)
+            << "automaton MiB/s" << std::setw(12) << "std MiB/s"
+            << "speedup\n";
+  for (const std::string pattern :
+       {"ERROR .* in 9[0-9]+ms", "status=[45]0[0-9]$", "worker-(1|2)[0-9] ",
+        "^2026-10-19T12:5\\d:", "\\brequest 4\\d{3}\\b"}) {
+    size_t automatonHits = 0;
+    size_t stdHits = 0;
+    const double fast = TimeAutomaton(pattern, log, automatonHits);
+    const double slow = TimeStdRegex(pattern, log, stdHits);
+    if (automatonHits != stdHits) {
+      std::cerr << "engines disagree on " << pattern << '\n';
+      return 1;
+    }
+    std::cout << std::left << std::setw(34) << pattern << std::setw(16)
+              << std::fixed << std::setprecision(0) << megabytes / fast
+              << std::setw(12) << megabytes / slow << std::setprecision(1)
+              << slow / fast << "x" << std::endl;
+  }
+
+  std::cout << "\nadversarial patterns, one line of n 'a's and a '!'\n"
+            << std::left << std::setw(16) << "pattern" << std::setw(10) << "n"
+            << std::setw(16) << "automaton s" << "std s\n";
+  for (const std::string pattern : {"(a+)+$", "(a|aa)*b", "(a*)*(a*)*c"}) {
+    bool stdTooSlow = false;
+    for (size_t n = 8; n <= 32; n += 4) {
+      const std::vector<std::string> line = {std::string(n, 'a') + "!"};
+      size_t hits = 0;
+      const double fast = TimeAutomaton(pattern, line, hits);
+      std::cout << std::left << std::setw(16) << pattern << std::setw(10) << n
+                << std::setw(16) << std::scientific << std::setprecision(2)
+                << fast;
+      if (stdTooSlow) {
+        std::cout << "skipped" << std::endl;
+        continue;
+      }
+      const double slow = TimeStdRegex(pattern, line, hits);
+      stdTooSlow = slow > 1;
+      std::cout << slow << std::endl;
+    }
+    // std::regex recurses per character and cannot take lines this long.
+    const size_t n = 1 << 20;
+    const std::vector<std::string> line = {std::string(n, 'a') + "!"};
+    size_t hits = 0;
+    const double fast = TimeAutomaton(pattern, line, hits);
+    std::cout << std::left << std::setw(16) << pattern << std::setw(10) << n
+              << std::setw(16) << fast << "skipped" << std::endl;
+  }
+  return 0;
+}
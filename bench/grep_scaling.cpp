@@ -0,0 +1,114 @@
+/**
+ * Measures how `grep` scales with worker threads on a large log.
+ *
+ * Usage: cppshell_bench_grep [SIZE_MB [MAX_THREADS [PATTERN]]]
+ *
+ * Writes a synthetic log of SIZE_MB megabytes (default 2048) to the temp
+ * directory, then greps it with CPPSHELL_THREADS = 1, 2, 4, ... up to
+ * MAX_THREADS (default: hardware concurrency). Matches are discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+void WriteLog(const std::filesystem::path &path, size_t bytes) {
+  static const char *const kLevels[] = {"INFO", "DEBUG", "WARN", "ERROR"};
+  std::ofstream f(path, std::ios::binary);
+  std::string line;
+  size_t written = 0;
+  for (unsigned i = 0; written < bytes; ++i) {
+    line = "2026-10-19T12:" + std::to_string(i % 60) + ":" +
+           std::to_string(i % 59) + " " + kLevels[(i * 7) % 4] +
+           " worker-" + std::to_string(i % 32) + " request " +
+           std::to_string(i) + " finished in " + std::to_string(i % 997) +
+           "ms status=" + std::to_string(200 + (i % 5) * 100) + '\n';
+    f << line;
+    written += line.size();
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t sizeMb = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2048;
+  const size_t maxThreads =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+               : std::max(1U, std::thread::hardware_concurrency());
+  const std::string pattern =
+      argc > 3 ? argv[3] : "ERROR .* in 9[0-9]+ms status=5";
+  if (sizeMb == 0 || maxThreads == 0) {
+    std::cerr << "usage: cppshell_bench_grep [SIZE_MB [MAX_THREADS "
+                 "[PATTERN]]]\n";
+    return 2;
+  }
+
+  const auto path =
+      std::filesystem::temp_directory_path() / "cppshell_bench_grep.log";
+  WriteLog(path, sizeMb * 1024 * 1024);
+  const double megabytes =
+      static_cast<double>(std::filesystem::file_size(path)) / (1024 * 1024);
+
+  std::cout << "log: " << std::fixed << std::setprecision(0) << megabytes
+            << " MiB, pattern: " << pattern << '\n'
+            << std::left << std::setw(10) << "threads" << std::setw(12)
+            << "seconds" << std::setw(12) << "MiB/s" << "speedup\n";
+
+  double baseline = 0;
+  for (size_t threads = 1;; threads *= 2) {
+    threads = std::min(threads, maxThreads);
+
+    std::istringstream in;
+    NullBuffer sink;
+    std::ostream out(&sink);
+    std::ostringstream err;
+    cppshell::Environment env;
+    env.Set("CPPSHELL_THREADS", std::to_string(threads));
+    cppshell::CommandStreams streams{in, out, err};
+    cppshell::CommandContext ctx{streams, env};
+    cppshell::GrepCommand grep({pattern, path.string()});
+
+    const auto start = std::chrono::steady_clock::now();
+    static_cast<void>(grep.Execute(ctx));
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    if (threads == 1) {
+      baseline = seconds;
+    }
+
+    std::cout << std::left << std::setw(10) << threads << std::setw(12)
+              << std::setprecision(2) << seconds << std::setw(12)
+              << std::setprecision(0) << megabytes / seconds
+              << std::setprecision(2) << baseline / seconds << "x\n";
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return 0;
+}
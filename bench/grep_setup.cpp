@@ -0,0 +1,72 @@
+/**
+ * Measures what one grep costs besides the search: parsing its options,
+ * compiling its patterns and setting up its input and output.
+ *
+ * Usage: cppshell_bench_grep_setup [RUNS]
+ *
+ * Runs grep RUNS times (default 20000) over the one-line input "Foo bar",
+ * as a shell loop would, with a literal and with a regular expression,
+ * first with the GrepMatcherCache and then with the cache turned off, and
+ * prints the mean time per run.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+#include "cppshell/grep_matcher.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Mean microseconds one grep with `args` over a one-line input takes. */
+double Measure(const std::vector<std::string> &args, size_t runs) {
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", "1");
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; ++i) {
+    std::istringstream in("Foo bar\n");
+    std::ostringstream out;
+    std::ostringstream err;
+    cppshell::CommandStreams streams{in, out, err};
+    cppshell::CommandContext ctx{streams, env};
+    cppshell::GrepCommand grep(args);
+    static_cast<void>(grep.Execute(ctx));
+  }
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         static_cast<double>(runs);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t runs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+  if (runs == 0) {
+    std::cerr << "usage: cppshell_bench_grep_setup [RUNS]\n";
+    return 2;
+  }
+
+  const std::vector<std::vector<std::string>> invocations = {
+      {"-i", "foo"}, {"-i", "f[o]+ (bar|baz)"}};
+  std::cout << std::left << std::setw(28) << "grep" << std::setw(14)
+            << "cache" << "us/run\n";
+  for (const bool cached : {true, false}) {
+    cppshell::GrepMatcherCache::Shared().SetCapacity(
+        cached ? cppshell::GrepMatcherCache::kCapacity : 0);
+    for (const auto &args : invocations) {
+      std::cout << std::left << std::setw(28)
+                << args[0] + " '" + args[1] + "'" << std::setw(14)
+                << (cached ? "on" : "off") << std::fixed
+                << std::setprecision(2) << Measure(args, runs) << std::endl;
+    }
+  }
+  return 0;
+}
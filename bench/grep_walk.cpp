@@ -0,0 +1,107 @@
+/**
+ * Compares the directory walk behind grep -r with a sequential one.
+ *
+ * Usage: cppshell_bench_grep_walk [FILES] [THREADS]
+ *
+ * Creates a tree of FILES empty files (default 1000000), 100 to a
+ * directory, three levels deep, and lists it with
+ * std::filesystem::recursive_directory_iterator, then with WalkTree on one
+ * thread and on THREADS threads (default: the hardware threads). The tree
+ * is kept between runs of the same size, so only the first run pays for
+ * creating it; later runs list it from a warm cache.
+ */
+
+#include "cppshell/file_walker.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr size_t kFilesPerDirectory = 100;
+constexpr size_t kFanOut = 100;
+
+/** Creates the tree unless the marker next to it says it is complete. */
+void MakeTree(const std::filesystem::path &root, size_t files) {
+  auto marker = root;
+  marker += ".complete";
+  if (std::filesystem::exists(marker)) {
+    return;
+  }
+  std::filesystem::remove_all(root);
+  for (size_t i = 0; i < files; ++i) {
+    const size_t directory = i / kFilesPerDirectory;
+    const auto parent = root / std::to_string(directory / (kFanOut * kFanOut)) /
+                        std::to_string(directory / kFanOut % kFanOut) /
+                        std::to_string(directory % kFanOut);
+    if (i % kFilesPerDirectory == 0) {
+      std::filesystem::create_directories(parent);
+    }
+    std::ofstream(parent / ("f" + std::to_string(i) + ".txt"));
+  }
+  std::ofstream{marker};
+}
+
+template <typename F> double Seconds(F &&walk, size_t &found) {
+  const auto start = std::chrono::steady_clock::now();
+  found = walk();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t files =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  const size_t threads =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+               : std::max(1U, std::thread::hardware_concurrency());
+  if (files == 0 || threads == 0) {
+    std::cerr << "usage: cppshell_bench_grep_walk [FILES] [THREADS]\n";
+    return 2;
+  }
+
+  const auto root = std::filesystem::temp_directory_path() /
+                    ("cppshell_bench_walk_" + std::to_string(files));
+  MakeTree(root, files);
+
+  size_t found = 0;
+  std::cout << "tree: " << files << " files\n"
+            << std::left << std::setw(32) << "walk" << std::setw(12)
+            << "seconds" << std::setw(12) << "files" << "vs sequential\n";
+  const double sequential = Seconds(
+      [&] {
+        size_t count = 0;
+        for (const auto &entry :
+             std::filesystem::recursive_directory_iterator(root)) {
+          count += entry.is_regular_file() ? 1 : 0;
+        }
+        return count;
+      },
+      found);
+  const auto row = [&](const std::string &name, double seconds) {
+    std::cout << std::left << std::setw(32) << name << std::setw(12)
+              << std::fixed << std::setprecision(4) << seconds
+              << std::setw(12) << found << std::setprecision(1)
+              << sequential / seconds << "x" << std::endl;
+  };
+  row("recursive_directory_iterator", sequential);
+
+  for (const size_t n : {size_t{1}, threads}) {
+    cppshell::WalkOptions options;
+    options.threads = n;
+    const double seconds = Seconds(
+        [&] { return cppshell::WalkTree(root.string(), options).files.size(); },
+        found);
+    row("WalkTree, " + std::to_string(n) + " thread(s)", seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * Compares the executor's pipeline modes on builtin-only pipelines.
+ *
+ * Usage: cppshell_bench_pipeline [ITERATIONS]
+ *
+ * Every pipeline runs ITERATIONS times (default 200) per mode; the output
+ * lists the mean wall time of one run. Stage output is discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/executor.hpp"
+#include "cppshell/parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Mean microseconds per run of `line` in `mode`. */
+double Measure(const cppshell::Executor &executor, const std::string &line,
+               const std::string &mode, int iterations) {
+  const cppshell::ParseResult parsed = cppshell::ParseLine(line);
+  if (!parsed.Ok() || !parsed.pipeline.has_value()) {
+    std::cerr << "cannot parse: " << line << '\n';
+    std::exit(2);
+  }
+  cppshell::Environment env;
+  env.Set("CPPSHELL_PIPELINE_MODE", mode);
+
+#ifndef _WIN32
+  // Forked stages write to fd 1 directly; keep the report readable.
+  std::fflush(stdout);
+  const int savedStdout = dup(STDOUT_FILENO);
+  const int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  dup2(devNull, STDOUT_FILENO);
+#endif
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    std::istringstream in;
+    std::ostringstream out;
+    std::ostringstream err;
+    static_cast<void>(executor.RunPipeline(
+        *parsed.pipeline, env, cppshell::CommandStreams{in, out, err}));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+#ifndef _WIN32
+  std::fflush(stdout);
+  dup2(savedStdout, STDOUT_FILENO);
+  close(savedStdout);
+  close(devNull);
+#endif
+
+  return std::chrono::duration<double, std::micro>(elapsed).count() /
+         iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+  if (iterations <= 0) {
+    std::cerr << "usage: cppshell_bench_pipeline [ITERATIONS]\n";
+    return 2;
+  }
+
+  const auto file =
+      std::filesystem::temp_directory_path() / "cppshell_bench_pipeline.txt";
+  {
+    std::ofstream f(file, std::ios::binary);
+    for (int i = 0; i < 20000; ++i) {
+      f << "line " << i << " of the benchmark input\n";
+    }
+  }
+
+  const std::vector<std::string> pipelines = {
+      "echo hello world | wc",
+      "echo hello world | cat | grep hello | wc",
+      "cat " + file.string() + " | grep 7 | wc",
+  };
+#ifdef _WIN32
+  const std::vector<std::string> modes = {"cooperative", "threads"};
+#else
+  const std::vector<std::string> modes = {"cooperative", "threads", "fork"};
+#endif
+
+  const cppshell::CommandFactory factory;
+  const cppshell::Executor executor(factory);
+
+  std::cout << std::left << std::setw(14) << "mode" << std::setw(14)
+            << "us/run" << "pipeline\n";
+  for (const std::string &line : pipelines) {
+    for (const std::string &mode : modes) {
+      const double us = Measure(executor, line, mode, iterations);
+      std::cout << std::left << std::setw(14) << mode << std::setw(14)
+                << std::fixed << std::setprecision(1) << us << line << '\n';
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::remove(file, ec);
+  return 0;
+}
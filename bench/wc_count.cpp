@@ -0,0 +1,151 @@
+/**
+ * Compares wc's counting loop with the byte-at-a-time loop it replaced
+ * and, where it is installed, with the system's wc.
+ *
+ * Usage: cppshell_bench_wc_count [MIB] [THREADS]
+ *
+ * Writes MIB MiB (default 256) of text, words of 1 to 12 letters with
+ * spaces, tabs and newlines between them, and counts it with each. The
+ * file is read once first, so all of them read it from the page cache.
+ * The builtin then counts it again with 2, 4, ... up to THREADS workers
+ * (default 4), splitting it into ranges, and with -lmw alone and with
+ * --validate-utf8, which checks the text in the same pass.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/wc_command.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void WriteText(const std::filesystem::path &path, size_t bytes) {
+  std::ofstream f(path, std::ios::binary);
+  std::string text;
+  uint32_t state = 1;
+  while (text.size() < bytes) {
+    state = state * 1103515245 + 12345;
+    text.append(1 + (state >> 16) % 12, static_cast<char>('a' + state % 26));
+    const unsigned gap = (state >> 28) % 16;
+    text.push_back(gap == 0 ? '\n' : gap == 1 ? '\t' : ' ');
+  }
+  text.resize(bytes);
+  f << text;
+}
+
+/** Seconds `fn` takes. */
+template <typename F> double Time(F &&fn) {
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/** The loop wc used before: std::isspace on each byte of a stream. */
+std::string CountBytewise(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  size_t lines = 0;
+  size_t words = 0;
+  size_t bytes = 0;
+  bool inWord = false;
+  for (std::istreambuf_iterator<char> it(in), end; it != end; ++it) {
+    const auto c = static_cast<unsigned char>(*it);
+    ++bytes;
+    lines += c == '\n' ? 1 : 0;
+    const bool space = std::isspace(c) != 0;
+    words += !space && !inWord ? 1 : 0;
+    inWord = !space;
+  }
+  return std::to_string(lines) + ' ' + std::to_string(words) + ' ' +
+         std::to_string(bytes) + '\n';
+}
+
+std::string CountBuiltin(const std::filesystem::path &path, size_t threads,
+                         std::vector<std::string> flags = {}) {
+  std::istringstream in;
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", std::to_string(threads));
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  flags.push_back(path.string());
+  cppshell::WcCommand wc(std::move(flags));
+  static_cast<void>(wc.Execute(ctx));
+  return out.str();
+}
+
+void Report(const std::string &name, double seconds, size_t bytes) {
+  std::cout << std::left << std::setw(16) << name << std::fixed
+            << std::setprecision(4) << seconds << " s  "
+            << std::setprecision(2)
+            << static_cast<double>(bytes) / seconds / 1e9 << " GB/s\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+  const size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+  if (mib == 0 || threads == 0) {
+    std::cerr << "usage: cppshell_bench_wc_count [MIB] [THREADS]\n";
+    return 2;
+  }
+  const auto path =
+      std::filesystem::temp_directory_path() / "cppshell_bench_wc_count.txt";
+  const size_t bytes = mib * 1024 * 1024;
+  WriteText(path, bytes);
+
+  std::string builtin;
+  std::string bytewise;
+  static_cast<void>(CountBuiltin(path, 1));
+  const double fast = Time([&] { builtin = CountBuiltin(path, 1); });
+  const double slow = Time([&] { bytewise = CountBytewise(path); });
+  std::cout << mib << " MiB: " << builtin;
+  Report("wc builtin", fast, bytes);
+  Report("bytewise", slow, bytes);
+  if (builtin != bytewise) {
+    std::cerr << "counts differ: " << bytewise;
+    return 1;
+  }
+#ifndef _WIN32
+  const std::string command = "wc " + path.string() + " > /dev/null 2>&1";
+  int status = 0;
+  const double system = Time([&] { status = std::system(command.c_str()); });
+  if (status == 0) {
+    Report("system wc", system, bytes);
+  }
+#endif
+  for (size_t n = 2; n <= threads; n *= 2) {
+    std::string split;
+    const double seconds = Time([&] { split = CountBuiltin(path, n); });
+    Report("wc " + std::to_string(n) + " threads", seconds, bytes);
+    if (split != builtin) {
+      std::cerr << "counts differ with " << n << " threads: " << split;
+      return 1;
+    }
+  }
+  const double chars =
+      Time([&] { static_cast<void>(CountBuiltin(path, 1, {"-lmw"})); });
+  Report("wc -lmw", chars, bytes);
+  const double validated = Time([&] {
+    static_cast<void>(CountBuiltin(path, 1, {"-lmw", "--validate-utf8"}));
+  });
+  Report("+ validation", validated, bytes);
+
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return 0;
+}
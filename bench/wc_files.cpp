@@ -0,0 +1,95 @@
+/**
+ * Shows what wc costs over many files, per counter selection.
+ *
+ * Usage: cppshell_bench_wc_files [FILES] [THREADS]
+ *
+ * Writes FILES log-like files (default 5000) of about 8 KiB and runs
+ * `wc -c`, `wc -l` and `wc` over all of them with one worker and with
+ * THREADS workers (default 4). Output is discarded.
+ */
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/wc_command.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Output buffer that drops everything written to it. */
+class NullBuffer final : public std::streambuf {
+protected:
+  int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    return n;
+  }
+};
+
+/** Seconds one wc with `args` takes. */
+double Measure(std::vector<std::string> args, const std::string &threads) {
+  std::istringstream in;
+  NullBuffer sink;
+  std::ostream out(&sink);
+  std::ostringstream err;
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", threads);
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  cppshell::WcCommand wc(std::move(args));
+  const auto start = std::chrono::steady_clock::now();
+  static_cast<void>(wc.Execute(ctx));
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+  const std::string threads = argc > 2 ? argv[2] : "4";
+  if (count == 0) {
+    std::cerr << "usage: cppshell_bench_wc_files [FILES] [THREADS]\n";
+    return 2;
+  }
+
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_bench_wc_files";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::vector<std::string> files;
+  for (size_t n = 0; n < count; ++n) {
+    files.push_back((root / (std::to_string(n) + ".log")).string());
+    std::ofstream f(files.back(), std::ios::binary);
+    for (size_t line = 0; line < 100; ++line) {
+      f << "2024-01-01T00:00:" << (line % 60) << " worker-" << n % 16
+        << " INFO request " << n * 100 + line << " served in "
+        << (n + line) % 997 << " ms\n";
+    }
+  }
+
+  std::cout << count << " files\n"
+            << std::left << std::setw(12) << "counts" << std::setw(14)
+            << "1 thread" << threads << " threads\n"
+            << std::fixed << std::setprecision(4);
+  for (const std::string flags : {"-c", "-l", "-lwc"}) {
+    std::vector<std::string> args = files;
+    args.insert(args.begin(), flags);
+    const double one = Measure(args, "1");
+    const double many = Measure(args, threads);
+    std::cout << std::setw(12) << ("wc " + flags) << std::setw(14) << one
+              << many << "\n";
+  }
+
+  std::filesystem::remove_all(root);
+  return 0;
+}
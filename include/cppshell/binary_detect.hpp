@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string_view>
+
+namespace cppshell {
+
+/**
+ * Returns true if a file starting with `data` is taken for binary: `data`
+ * holds a NUL byte or bytes that are not UTF-8 (overlong forms, surrogates
+ * and code points past U+10FFFF included). A sequence cut off by the end
+ * of `data` is not held against it.
+ *
+ * Windows of 64 bytes are checked for NUL and by Utf8Validator, so even
+ * text that is not ASCII is checked without a branch per character.
+ */
+[[nodiscard]] bool LooksBinary(std::string_view data);
+
+} // namespace cppshell
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Builtin: buffer.
+ *
+ * Copies its input to its output unchanged while decoupling the stages on
+ * either side: input is read as fast as the producer delivers it and kept
+ * in a SpillQueue, so the producer only waits once both the memory and the
+ * disk limit are reached.
+ */
+class BufferCommand final : public ICommand {
+public:
+  /** Constructs the command with its argv (excluding the command name). */
+  explicit BufferCommand(std::vector<std::string> args);
+
+  /** Reads input on a second thread while writing buffered data. */
+  [[nodiscard]] CommandResult Execute(CommandContext &context) override;
+
+  /** Reads and writes LineChannels when the executor provides them. */
+  [[nodiscard]] bool SupportsLineChannels() const override { return true; }
+
+  /**
+   * Between cooperative stages, alternates reading and writing on the
+   * pipeline's thread instead; otherwise runs Execute().
+   */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
+private:
+  std::vector<std::string> args_;
+};
+
+} // namespace cppshell
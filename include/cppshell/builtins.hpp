@@ -2,6 +2,7 @@
 
 #include "cppshell/command.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,13 @@ public:
   /** Prints args to stdout separated by spaces and ends with '\n'. */
   [[nodiscard]] CommandResult Execute(CommandContext &context) override;
 
+  /** Writes its line to a LineChannel when the executor provides one. */
+  [[nodiscard]] bool SupportsLineChannels() const override { return true; }
+
+  /** Coroutine body behind Execute(), also run by cooperative pipelines. */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
 private:
   std::vector<std::string> args_;
 };
@@ -42,21 +50,44 @@ public:
   /** Outputs file contents to stdout; if no args, copies stdin to stdout. */
   [[nodiscard]] CommandResult Execute(CommandContext &context) override;
 
+  /** Reads and writes LineChannels when the executor provides them. */
+  [[nodiscard]] bool SupportsLineChannels() const override { return true; }
+
+  /** Coroutine body behind Execute(), also run by cooperative pipelines. */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
 private:
   std::vector<std::string> args_;
 };
 
-/** Builtin: wc. */
-class WcCommand final : public ICommand {
+/**
+ * Fused `<command> | wc`, produced by the pipeline optimizer.
+ *
+ * Runs the wrapped command with its output counted instead of written, then
+ * prints `<lines> <words> <bytes>` exactly as the `wc` stage would have.
+ * Like that stage, it always succeeds; the wrapped command's errors still
+ * reach stderr.
+ */
+class CountOutputCommand final : public ICommand {
 public:
-  /** Constructs the command with its argv (excluding the command name). */
-  explicit WcCommand(std::vector<std::string> args);
+  /** Wraps `command`, whose output is to be counted. */
+  explicit CountOutputCommand(std::unique_ptr<ICommand> command);
 
-  /** Prints `<lines> <words> <bytes>` for a file; if no args, reads stdin. */
+  /** Runs the wrapped command and prints the counts of its output. */
   [[nodiscard]] CommandResult Execute(CommandContext &context) override;
 
+  /** Reads a LineChannel if the wrapped command does; writes the counts. */
+  [[nodiscard]] bool SupportsLineChannels() const override {
+    return command_->SupportsLineChannels();
+  }
+
+  /** Coroutine body behind Execute(), also run by cooperative pipelines. */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
 private:
-  std::vector<std::string> args_;
+  std::unique_ptr<ICommand> command_;
 };
 
 /** Builtin: exit. */
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cppshell/environment.hpp"
+#include "cppshell/parser.hpp"
 
 #include <istream>
 #include <memory>
@@ -10,6 +11,10 @@
 
 namespace cppshell {
 
+class CooperativeContext;
+class LineChannel;
+class StageTask;
+
 /** Execution streams for a command invocation. */
 struct CommandStreams {
   /** Command standard input stream. */
@@ -26,6 +31,14 @@ struct CommandContext {
   CommandStreams streams;
   /** Effective environment for this invocation. */
   const Environment &env;
+  /**
+   * Line channel replacing `streams.in` when the previous pipeline stage is
+   * a builtin that writes lines (see line_channel.hpp). Only set for
+   * commands whose SupportsLineChannels() returns true.
+   */
+  LineChannel *inChannel = nullptr;
+  /** Line channel replacing `streams.out`, under the same rules. */
+  LineChannel *outChannel = nullptr;
 };
 
 /** Result of executing a command. */
@@ -51,6 +64,25 @@ public:
 
   /** Executes the command using the provided context. */
   [[nodiscard]] virtual CommandResult Execute(CommandContext &context) = 0;
+
+  /**
+   * Returns true if the command honours CommandContext::inChannel and
+   * outChannel, so the executor may connect it to neighbouring builtins
+   * with LineChannels instead of byte pipes.
+   */
+  [[nodiscard]] virtual bool SupportsLineChannels() const { return false; }
+
+  /**
+   * Runs the command as a coroutine sharing one thread with the other
+   * stages of a builtin-only pipeline (see cooperative.hpp).
+   *
+   * The default adapts Execute(): since Execute() cannot yield, it first
+   * collects all of the input channel, runs Execute() on it and then
+   * publishes the whole output. Builtins that stream override this with
+   * their real body and implement Execute() through RunInline().
+   */
+  [[nodiscard]] virtual StageTask
+  ExecuteCooperative(CooperativeContext &context);
 };
 
 /** Factory for builtins and external commands. */
@@ -60,6 +92,16 @@ public:
   [[nodiscard]] std::unique_ptr<ICommand>
   Create(const std::string &name, const std::vector<std::string> &args,
          const Environment &envForCommand) const;
+
+  /**
+   * Creates the implementation of a parsed pipeline stage, honouring
+   * Command::countOutput.
+   */
+  [[nodiscard]] std::unique_ptr<ICommand>
+  Create(const Command &command, const Environment &envForCommand) const;
+
+  /** Returns true if `name` is implemented inside the shell. */
+  [[nodiscard]] bool IsBuiltin(const std::string &name) const;
 };
 
 } // namespace cppshell
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+#include "cppshell/line_channel.hpp"
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+
+namespace cppshell {
+
+/**
+ * Coroutine running one command, returned by ICommand::ExecuteCooperative.
+ *
+ * Starts suspended. The cooperative executor resumes it on the pipeline's
+ * thread; another StageTask may also `co_await` it, which runs it to
+ * completion and yields its CommandResult.
+ */
+class StageTask {
+public:
+  struct promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  /** Coroutine state: the result and the coroutine awaiting this one. */
+  struct promise_type {
+    CommandResult result;
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+
+    StageTask get_return_object() {
+      return StageTask(Handle::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    /** Hands control back to the awaiting coroutine, if any. */
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(Handle h) noexcept {
+        const std::coroutine_handle<> next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void return_value(CommandResult r) { result = r; }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  StageTask(StageTask &&other) noexcept;
+  StageTask &operator=(StageTask &&other) noexcept;
+  StageTask(const StageTask &) = delete;
+  StageTask &operator=(const StageTask &) = delete;
+
+  /** Destroys the coroutine frame. */
+  ~StageTask();
+
+  /** Handle to resume the coroutine with. */
+  [[nodiscard]] Handle GetHandle() const { return handle_; }
+
+  /** Returns true once the coroutine body has returned. */
+  [[nodiscard]] bool Done() const { return handle_.done(); }
+
+  /** The command's result; rethrows an exception that escaped the body. */
+  [[nodiscard]] CommandResult Result() const;
+
+  /** Awaiting a task runs it and resumes the awaiter when it returns. */
+  struct Awaiter {
+    Handle handle;
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+      handle.promise().continuation = awaiting;
+      return handle;
+    }
+    CommandResult await_resume() const;
+  };
+  Awaiter operator co_await() const & noexcept { return Awaiter{handle_}; }
+
+private:
+  explicit StageTask(Handle handle) : handle_(handle) {}
+
+  Handle handle_;
+};
+
+/** FIFO of suspended coroutines that are ready to continue. */
+class CooperativeScheduler {
+public:
+  /** Marks `handle` ready to be resumed. */
+  void Schedule(std::coroutine_handle<> handle) { ready_.push_back(handle); }
+
+  /** Next coroutine to resume, or a null handle if none is ready. */
+  [[nodiscard]] std::coroutine_handle<> Next();
+
+private:
+  std::deque<std::coroutine_handle<>> ready_;
+};
+
+/**
+ * LineChannel between two stages running as coroutines on the same thread.
+ *
+ * Push and Pop never block. Instead, a stage awaits
+ * CooperativeContext::InputReady() before popping and
+ * CooperativeContext::OutputSpace() after pushing; each suspends the stage
+ * until the other end has made progress. As one chunk at most is in flight
+ * and the consumer runs right after it is produced, the chunk is still in
+ * cache when it is read.
+ */
+class CooperativeLineChannel final : public LineChannel {
+public:
+  /** Creates a channel whose waiting stages are resumed via `scheduler`. */
+  explicit CooperativeLineChannel(CooperativeScheduler &scheduler);
+
+  bool Push(std::shared_ptr<const LineChunk> chunk) override;
+  [[nodiscard]] std::shared_ptr<const LineChunk> Pop() override;
+  void Close() override;
+  void CloseReader() override;
+
+  /** Returns true if Pop() would not have to wait. */
+  [[nodiscard]] bool Readable() const { return !chunks_.empty() || closed_; }
+
+  /** Returns true if the reader consumed everything pushed so far. */
+  [[nodiscard]] bool Writable() const {
+    return chunks_.empty() || readerClosed_;
+  }
+
+  /** Resumes `reader` once the channel becomes readable. */
+  void WaitReadable(std::coroutine_handle<> reader) { reader_ = reader; }
+
+  /** Resumes `writer` once the channel becomes writable. */
+  void WaitWritable(std::coroutine_handle<> writer) { writer_ = writer; }
+
+private:
+  void Wake(std::coroutine_handle<> &waiter);
+
+  CooperativeScheduler &scheduler_;
+  std::deque<std::shared_ptr<const LineChunk>> chunks_;
+  std::coroutine_handle<> reader_;
+  std::coroutine_handle<> writer_;
+  bool closed_ = false;
+  bool readerClosed_ = false;
+};
+
+/**
+ * What a command's coroutine body sees: its CommandContext plus the points
+ * at which it may yield to the other stages of its pipeline.
+ *
+ * Outside the cooperative executor the channels, if any, are blocking ones
+ * and both awaiters complete immediately, so the same body also implements
+ * Execute() (see RunInline).
+ */
+class CooperativeContext {
+public:
+  /** Waits for CommandContext::inChannel to become readable. */
+  struct InputAwaiter {
+    CooperativeLineChannel *channel;
+    bool await_ready() const {
+      return channel == nullptr || channel->Readable();
+    }
+    void await_suspend(std::coroutine_handle<> h) const {
+      channel->WaitReadable(h);
+    }
+    void await_resume() const noexcept {}
+  };
+
+  /** Waits for CommandContext::outChannel to drain. */
+  struct OutputAwaiter {
+    CooperativeLineChannel *channel;
+    bool await_ready() const {
+      return channel == nullptr || channel->Writable();
+    }
+    void await_suspend(std::coroutine_handle<> h) const {
+      channel->WaitWritable(h);
+    }
+    void await_resume() const noexcept {}
+  };
+
+  /** Wraps `context`; cooperative channels in it are detected. */
+  explicit CooperativeContext(CommandContext &context);
+
+  /** The wrapped context. */
+  [[nodiscard]] CommandContext &Context() const { return context_; }
+
+  /**
+   * Returns true if a neighbouring stage runs as a coroutine on this
+   * thread, so the body must not block waiting for it.
+   */
+  [[nodiscard]] bool Cooperative() const {
+    return in_ != nullptr || out_ != nullptr;
+  }
+
+  /** `co_await` before taking the next chunk from the input channel. */
+  [[nodiscard]] InputAwaiter InputReady() const { return InputAwaiter{in_}; }
+
+  /** `co_await` after publishing chunks to the output channel. */
+  [[nodiscard]] OutputAwaiter OutputSpace() const {
+    return OutputAwaiter{out_};
+  }
+
+private:
+  CommandContext &context_;
+  CooperativeLineChannel *in_ = nullptr;
+  CooperativeLineChannel *out_ = nullptr;
+};
+
+/**
+ * Runs `command`'s coroutine body to completion on the calling thread.
+ * Builtins written as coroutines implement Execute() with it.
+ */
+[[nodiscard]] CommandResult RunInline(ICommand &command,
+                                      CommandContext &context);
+
+} // namespace cppshell
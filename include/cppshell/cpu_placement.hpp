@@ -0,0 +1,92 @@
+#pragma once
+
+#include "cppshell/environment.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * How the stages of a pipeline are placed on CPUs, chosen per session with
+ * CPPSHELL_PLACEMENT.
+ */
+enum class PlacementPolicy {
+  /** No pinning; the scheduler decides (the default). */
+  kOs,
+  /**
+   * Adjacent stages on neighbouring physical cores that share an L2 or at
+   * least an L3 cache, so the data they pass stays in that cache.
+   */
+  kCompact,
+  /**
+   * Stages on cores as far apart as possible: alternating L3 domains
+   * (usually sockets), then L2 groups, so independent stages do not compete
+   * for the same cache.
+   */
+  kSpread,
+};
+
+/**
+ * Reads CPPSHELL_PLACEMENT from `env`: "compact" or "spread"; anything else
+ * means kOs.
+ */
+[[nodiscard]] PlacementPolicy PlacementFromEnv(const Environment &env);
+
+/** Where one logical CPU sits in the cache hierarchy. */
+struct CpuInfo {
+  int id = 0;
+  /** Lowest CPU id of the physical core (SMT siblings share it). */
+  int core = 0;
+  /** Position among the SMT siblings of the core, 0 for the first. */
+  int thread = 0;
+  /** Lowest CPU id sharing this CPU's L2 cache. */
+  int l2 = 0;
+  /** Lowest CPU id sharing this CPU's L3 cache (or package without one). */
+  int l3 = 0;
+};
+
+/** Logical CPUs available to the shell, in id order. */
+struct CpuTopology {
+  std::vector<CpuInfo> cpus;
+};
+
+/**
+ * Reads the topology of the CPUs in `allowed` from a sysfs tree laid out
+ * like /sys/devices/system/cpu. Missing files degrade gracefully: a CPU
+ * with no cache information counts as its own core and cache domain.
+ */
+[[nodiscard]] CpuTopology ReadCpuTopology(const std::filesystem::path &root,
+                                          const std::vector<int> &allowed);
+
+/**
+ * Topology of the CPUs the shell process may run on, read from sysfs on
+ * first use. Empty where that is not available (outside Linux).
+ */
+[[nodiscard]] const CpuTopology &CurrentCpuTopology();
+
+/**
+ * Returns the CPU to pin each of `stages` pipeline stages to under
+ * `policy`, or -1 for stages left to the scheduler. Stages wrap around
+ * when there are more of them than CPUs.
+ */
+[[nodiscard]] std::vector<int> PlanPlacement(const CpuTopology &topology,
+                                             PlacementPolicy policy,
+                                             size_t stages);
+
+/**
+ * Restricts the calling thread to `cpu`; processes it spawns afterwards
+ * inherit that. Does nothing for a negative `cpu`. Returns false if the
+ * system refused or does not support it.
+ */
+bool PinCurrentThread(int cpu);
+
+/**
+ * Gives the calling thread back the CPUs it had before the first
+ * PinCurrentThread() of this process. Worker pools call it so that a
+ * pinned stage's helpers are not all squeezed onto its one CPU.
+ */
+void UnpinCurrentThread();
+
+} // namespace cppshell
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/parser.hpp"
+
+namespace cppshell {
+
+/**
+ * Runs pipelines of two or more commands.
+ *
+ * Pipelines made only of builtins run inside the shell process. By default
+ * all stages are coroutines sharing the calling thread (see
+ * cooperative.hpp); with CPPSHELL_PIPELINE_MODE=threads each stage gets a
+ * thread instead, and adjacent builtins that support it exchange lines
+ * through a LineChannel while every other edge carries plain bytes through
+ * a Pipe. On POSIX systems, pipelines containing external programs (or any
+ * pipeline with CPPSHELL_PIPELINE_MODE=fork) fork one child per stage
+ * connected with OS pipes; on Windows they use threads. On Linux, forked
+ * builtins next to each other share a ring buffer instead of the pipe's
+ * data path (see shm_transport.hpp). Threads and forked stages are pinned
+ * to CPUs according to CPPSHELL_PLACEMENT (see cpu_placement.hpp).
+ */
+class Executor {
+public:
+  /** Creates an executor instantiating commands with `factory`. */
+  explicit Executor(const CommandFactory &factory);
+
+  /** Runs `pipeline` and returns the exit code of its last command. */
+  [[nodiscard]] int RunPipeline(const Pipeline &pipeline,
+                                const Environment &baseEnv,
+                                CommandStreams streams) const;
+
+private:
+  [[nodiscard]] int RunCooperative(const Pipeline &pipeline,
+                                   const Environment &baseEnv,
+                                   CommandStreams streams) const;
+  [[nodiscard]] int RunThreaded(const Pipeline &pipeline,
+                                const Environment &baseEnv,
+                                CommandStreams streams) const;
+#ifndef _WIN32
+  [[nodiscard]] int RunForked(const Pipeline &pipeline,
+                              const Environment &baseEnv) const;
+#endif
+
+  const CommandFactory &factory_;
+};
+
+} // namespace cppshell
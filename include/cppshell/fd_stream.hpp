@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Stream buffer reading directly from a POSIX file descriptor.
+ *
+ * Large reads bypass the internal buffer and go straight into the caller's
+ * memory. External commands can take the descriptor itself via Fd() as long
+ * as nothing has been buffered yet (see HasBufferedData()).
+ */
+class FdReadBuffer : public std::streambuf {
+public:
+  /** Wraps `fd`; when `ownsFd` is true the descriptor is closed on destroy. */
+  FdReadBuffer(int fd, bool ownsFd);
+  ~FdReadBuffer() override;
+
+  FdReadBuffer(const FdReadBuffer &) = delete;
+  FdReadBuffer &operator=(const FdReadBuffer &) = delete;
+
+  /** Underlying descriptor. */
+  [[nodiscard]] int Fd() const { return fd_; }
+
+  /** Returns true if bytes were read from the fd but not consumed yet. */
+  [[nodiscard]] bool HasBufferedData() const { return gptr() < egptr(); }
+
+protected:
+  int_type underflow() override;
+  std::streamsize xsgetn(char *s, std::streamsize n) override;
+  std::streamsize showmanyc() override;
+
+private:
+  static constexpr size_t kBufferSize = 64 * 1024;
+  int fd_;
+  bool ownsFd_;
+  std::vector<char> buffer_;
+};
+
+/**
+ * Stream buffer writing directly to a POSIX file descriptor.
+ *
+ * Small writes are coalesced in an internal buffer; writes larger than the
+ * buffer are issued with a single write(2) from the caller's memory.
+ */
+class FdWriteBuffer : public std::streambuf {
+public:
+  /** Wraps `fd`; when `ownsFd` is true the descriptor is closed on destroy. */
+  FdWriteBuffer(int fd, bool ownsFd);
+  ~FdWriteBuffer() override;
+
+  FdWriteBuffer(const FdWriteBuffer &) = delete;
+  FdWriteBuffer &operator=(const FdWriteBuffer &) = delete;
+
+  /** Underlying descriptor. Call pubsync() before handing it elsewhere. */
+  [[nodiscard]] int Fd() const { return fd_; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  [[nodiscard]] bool FlushBuffer();
+
+  static constexpr size_t kBufferSize = 64 * 1024;
+  int fd_;
+  bool ownsFd_;
+  std::vector<char> buffer_;
+};
+
+/** Writes all `size` bytes to `fd`, retrying on EINTR and short writes. */
+[[nodiscard]] bool WriteAll(int fd, const char *data, size_t size);
+
+/**
+ * Returns the descriptor `in` can be read from directly, or -1 if the stream
+ * has to be pumped. Redirected files qualify until someone buffers.
+ */
+[[nodiscard]] int DirectInputFd(std::istream &in);
+
+/**
+ * Same as DirectInputFd() for an output stream, where `standard` (std::cout
+ * or std::cerr) stands for `standardFd`. FdWriteBuffer and, on Linux,
+ * VmspliceWriteBuffer qualify; a RingWriteBuffer has no descriptor to
+ * write to. Flushes pending bytes first, so that bytes written to the
+ * descriptor follow them.
+ */
+[[nodiscard]] int DirectOutputFd(std::ostream &out, std::ostream &standard,
+                                 int standardFd);
+
+} // namespace cppshell
+
+#endif
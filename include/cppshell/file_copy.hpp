@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef _WIN32
+
+namespace cppshell {
+
+/**
+ * Whether `out` is the regular file `in` reads, with bytes left to read:
+ * copying would feed the input its own output, as `cat f >> f` does.
+ */
+[[nodiscard]] bool InputIsOutput(int in, int out);
+
+/**
+ * Copies everything `in` holds from its current offset to `out`, leaving
+ * both offsets unspecified. Returns false if reading or writing fails, and
+ * without copying anything if InputIsOutput().
+ *
+ * On Linux the bytes stay in the kernel where the pair allows it: a
+ * regular file goes to a regular file with copy_file_range (which may
+ * share extents on filesystems that reflink), to a pipe with splice and
+ * to anything else with sendfile; a pipe goes anywhere with splice.
+ * Between regular files, holes found with SEEK_DATA/SEEK_HOLE are skipped
+ * and stay holes. Whatever the kernel refuses, and every other system,
+ * is copied through a 1 MiB buffer.
+ */
+[[nodiscard]] bool CopyToFd(int in, int out);
+
+} // namespace cppshell
+
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Returns true if `name` matches the shell glob `pattern`: `*` matches any
+ * run of characters but '/', `**` also '/', `?` one character but '/',
+ * `[...]` a class (`[!...]` or `[^...]` negated, with ranges), and `\`
+ * quotes the next character. `**` before a '/' matches zero or more
+ * whole directories.
+ */
+[[nodiscard]] bool GlobMatch(std::string_view pattern, std::string_view name);
+
+/**
+ * Rules of one gitignore-style file. Blank lines and lines starting with
+ * '#' are skipped; `!` re-includes what an earlier rule ignored; a
+ * trailing '/' only matches directories; a pattern with another '/' is
+ * matched against the path relative to the file's directory, any other
+ * against the last path component. The last matching rule decides.
+ */
+class IgnoreRules {
+public:
+  /** What the rules say about a path. */
+  enum class Verdict { kNone, kIgnore, kKeep };
+
+  /** Parses the text of an ignore file. */
+  explicit IgnoreRules(std::string_view text);
+
+  /** Returns true if there are no rules. */
+  [[nodiscard]] bool Empty() const { return rules_.empty(); }
+
+  /** Judges `path`, relative to the directory of the ignore file. */
+  [[nodiscard]] Verdict Judge(std::string_view path, bool directory) const;
+
+private:
+  struct Rule {
+    std::string glob;
+    bool negate = false;
+    bool directoryOnly = false;
+    bool anchored = false;
+  };
+
+  std::vector<Rule> rules_;
+};
+
+/** Which files WalkTree yields. */
+struct WalkOptions {
+  /** -R: follow symbolic links below the root, not only the root. */
+  bool followLinks = false;
+  /** --include: only files whose name matches one of these globs. */
+  std::vector<std::string> include;
+  /** --exclude: skip files whose name matches one of these globs. */
+  std::vector<std::string> exclude;
+  /** --exclude-dir: skip directories whose name matches one of these. */
+  std::vector<std::string> excludeDir;
+  /** --ignore-file: gitignore-style files to read in every directory. */
+  std::vector<std::string> ignoreFiles;
+  /** Sort the files by path; otherwise they come in the order found. */
+  bool sorted = false;
+  /** Threads listing directories. */
+  size_t threads = 1;
+};
+
+/** The files under a directory, and the errors met on the way. */
+struct WalkResult {
+  std::vector<std::string> files;
+  /** Messages like "dir: Permission denied", without a program name. */
+  std::vector<std::string> errors;
+};
+
+/**
+ * Lists the regular files under the directory `root`, as `root` joined
+ * with their relative path (just the relative path if `root` is empty,
+ * which stands for the current directory).
+ *
+ * Directories are listed by `options.threads` workers, each with its own
+ * queue of directories: a worker takes the newest directory from its own
+ * queue and, when that is empty, steals the oldest from another's. On
+ * Linux directories are read with getdents64 relative to an openat
+ * descriptor; elsewhere through std::filesystem. Symbolic links are only
+ * followed under WalkOptions::followLinks, and then every directory is
+ * entered once.
+ */
+[[nodiscard]] WalkResult WalkTree(const std::string &root,
+                                  const WalkOptions &options);
+
+} // namespace cppshell
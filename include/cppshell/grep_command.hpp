@@ -16,6 +16,13 @@ public:
   /** Executes grep logic. */
   [[nodiscard]] CommandResult Execute(CommandContext &context) override;
 
+  /** Reads and writes LineChannels when the executor provides them. */
+  [[nodiscard]] bool SupportsLineChannels() const override { return true; }
+
+  /** Coroutine body behind Execute(), also run by cooperative pipelines. */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
 private:
   std::vector<std::string> args_;
 };
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "cppshell/line_channel.hpp"
+#include "cppshell/literal_search.hpp"
+#include "cppshell/multi_literal_search.hpp"
+#include "cppshell/regex_automaton.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cppshell {
+
+/** How grep interprets its pattern. */
+struct GrepPatternOptions {
+  /** -i: ignore case distinctions. */
+  bool ignoreCase = false;
+  /** -w: the match must be a whole word (a \b boundary on both sides). */
+  bool wordRegexp = false;
+  /** -F: the pattern is a fixed string, not a regular expression. */
+  bool fixedStrings = false;
+};
+
+/**
+ * Decides which lines grep selects: those in which any of its patterns
+ * matches.
+ *
+ * Patterns without regular expression metacharacters (and all patterns
+ * under -F) are literals. A single literal is searched with a
+ * LiteralSearcher across whole runs of lines at once, with -i folded by
+ * the searcher and -w checked at each hit; several go into one
+ * MultiLiteralSearcher. Other patterns are joined into one alternation on
+ * a RegexAutomaton, in time linear in the line, except those that need
+ * std::regex (ECMAScript) for backreferences or lookahead, which are tried
+ * one by one. All paths select the same lines.
+ *
+ * Matching is const and may run on several threads at once.
+ */
+class GrepMatcher {
+public:
+  /** Compiles `pattern`; check Ok() before use. */
+  GrepMatcher(const std::string &pattern, const GrepPatternOptions &options);
+
+  /**
+   * Compiles `patterns` (-e and -f), selecting the lines any of them
+   * matches; check Ok() before use. No patterns select no lines.
+   */
+  GrepMatcher(const std::vector<std::string> &patterns,
+              const GrepPatternOptions &options);
+
+  /** Returns true if the pattern compiled. */
+  [[nodiscard]] bool Ok() const { return error_.empty(); }
+
+  /** Why the pattern did not compile. */
+  [[nodiscard]] const std::string &Error() const { return error_; }
+
+  /** Returns true if the fast literal path is used. */
+  [[nodiscard]] bool Literal() const { return literal_.has_value(); }
+
+  /** Returns true if several literals share a MultiLiteralSearcher. */
+  [[nodiscard]] bool MultiLiteral() const { return literals_ != nullptr; }
+
+  /** Returns true if a pattern runs on the RegexAutomaton. */
+  [[nodiscard]] bool Automaton() const { return automaton_ != nullptr; }
+
+  /**
+   * Returns true if lines can be judged in pieces by a LineFeed, which
+   * holds unless a pattern needs std::regex or several literals are
+   * searched under -w.
+   */
+  [[nodiscard]] bool Streams() const {
+    return regexes_.empty() && !(literals_ != nullptr && wordRegexp_);
+  }
+
+  /** Appends the indices of the lines of `chunk` that match to `out`. */
+  void MatchLines(const LineChunk &chunk, std::vector<size_t> &out) const;
+
+  /**
+   * Appends the spans of the lines of `block` (whole lines, the last one
+   * maybe unterminated) that match to `out`. A literal pattern is searched
+   * across the block and line boundaries are only looked for around hits.
+   */
+  void MatchBlock(std::string_view block, std::vector<LineSpan> &out) const;
+
+  /**
+   * Judges one line that arrives in pieces, for lines too long to hold in
+   * memory. Requires Streams().
+   */
+  class LineFeed {
+  public:
+    explicit LineFeed(const GrepMatcher &matcher);
+    ~LineFeed();
+
+    LineFeed(const LineFeed &) = delete;
+    LineFeed &operator=(const LineFeed &) = delete;
+
+    /**
+     * Feeds the next piece of the line, without its terminator. Returns
+     * true once the line is known to match.
+     */
+    bool Feed(std::string_view piece);
+
+    /** Ends the line; returns true if it matches. */
+    [[nodiscard]] bool End();
+
+  private:
+    /** Checks the literal's hits in tail_; `atEnd` if the line ends. */
+    [[nodiscard]] bool LiteralHit(bool atEnd) const;
+
+    const GrepMatcher &matcher_;
+    std::unique_ptr<RegexAutomaton::Searcher> searcher_;
+    uint32_t literalsState_ = MultiLiteralSearcher::kStart;
+    // Literal patterns: the last bytes fed, enough to find a hit that
+    // crosses into the next piece and to check its -w boundaries.
+    std::string tail_;
+    // Bytes of the line that came before tail_.
+    size_t dropped_ = 0;
+    bool matched_ = false;
+  };
+
+private:
+  using BlockLoop = void (GrepMatcher::*)(std::string_view,
+                                          std::vector<LineSpan> &) const;
+  using LinesLoop = void (GrepMatcher::*)(const LineChunk &,
+                                          std::vector<size_t> &) const;
+
+  /** Compiles what is not a single literal. */
+  void Compile(const std::vector<std::string> &literals,
+               const std::vector<std::string> &others,
+               const GrepPatternOptions &options);
+
+  /** Picks the loops MatchBlock and MatchLines run for what compiled. */
+  void PickLoops();
+
+  /** Returns true if the literal occurs in `line` (as a word if kWord). */
+  template <bool kWord>
+  [[nodiscard]] bool LiteralInLine(std::string_view line, size_t from) const;
+
+  /**
+   * Returns true if any pattern but the single literal matches `line`,
+   * trying only the searchers the flags name. `searcher` comes from
+   * automaton_, if there is one.
+   */
+  template <bool kLiterals, bool kAutomaton, bool kRegexes>
+  [[nodiscard]] bool AnyInLine(std::string_view line,
+                               RegexAutomaton::Searcher *searcher) const;
+
+  /** MatchBlock for the single literal (kSingle) or several. */
+  template <bool kSingle, bool kWord>
+  void LiteralBlock(std::string_view block, std::vector<LineSpan> &out) const;
+
+  /** MatchLines for the single literal. */
+  template <bool kWord>
+  void LiteralLines(const LineChunk &chunk, std::vector<size_t> &out) const;
+
+  /** MatchBlock one line at a time, with AnyInLine. */
+  template <bool kLiterals, bool kAutomaton, bool kRegexes>
+  void BlockByLine(std::string_view block, std::vector<LineSpan> &out) const;
+
+  /** MatchLines one line at a time, with AnyInLine. */
+  template <bool kLiterals, bool kAutomaton, bool kRegexes>
+  void LinesByLine(const LineChunk &chunk, std::vector<size_t> &out) const;
+
+  bool wordRegexp_;
+  // Instantiations of the loops above for this matcher, so that they test
+  // no option and no searcher per line.
+  BlockLoop blockLoop_ = nullptr;
+  LinesLoop linesLoop_ = nullptr;
+  std::optional<LiteralSearcher> literal_;
+  std::unique_ptr<MultiLiteralSearcher> literals_;
+  std::unique_ptr<RegexAutomaton> automaton_;
+  std::vector<std::regex> regexes_;
+  std::string error_;
+};
+
+/**
+ * The GrepMatchers compiled last, shared by all greps of the process, so a
+ * grep run again and again (in a loop, say) with the same patterns
+ * compiles them once. Matchers are keyed by their patterns and
+ * GrepPatternOptions; the least recently used one is dropped when the
+ * cache is full. Sets of patterns longer than kMaxPatternBytes are
+ * compiled afresh each time rather than kept.
+ *
+ * Safe to use from several threads at once.
+ */
+class GrepMatcherCache {
+public:
+  /** Matchers kept by default. */
+  static constexpr size_t kCapacity = 64;
+
+  /** Longest set of patterns, in bytes, whose matcher is kept. */
+  static constexpr size_t kMaxPatternBytes = 64 * 1024;
+
+  /** Counters since the cache was made. */
+  struct Stats {
+    /** Lookups that found their matcher. */
+    size_t hits = 0;
+    /** Lookups that compiled it. */
+    size_t misses = 0;
+    /** Matchers dropped to make room. */
+    size_t evictions = 0;
+    /** Matchers kept now. */
+    size_t entries = 0;
+  };
+
+  /** The cache grep uses. */
+  [[nodiscard]] static GrepMatcherCache &Shared();
+
+  explicit GrepMatcherCache(size_t capacity = kCapacity);
+
+  GrepMatcherCache(const GrepMatcherCache &) = delete;
+  GrepMatcherCache &operator=(const GrepMatcherCache &) = delete;
+
+  /**
+   * Returns the matcher for `patterns` under `options`, compiling it on a
+   * miss. A matcher that did not compile is kept too, with its Error().
+   */
+  [[nodiscard]] std::shared_ptr<const GrepMatcher>
+  Get(const std::vector<std::string> &patterns,
+      const GrepPatternOptions &options);
+
+  /** The counters so far. */
+  [[nodiscard]] Stats Statistics() const;
+
+  /** Keeps at most `capacity` matchers from now on; 0 keeps none. */
+  void SetCapacity(size_t capacity);
+
+private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const GrepMatcher> matcher;
+  };
+
+  /** Drops the least recently used entries beyond capacity_. */
+  void Trim();
+
+  mutable std::mutex mutex_;
+  size_t capacity_;
+  Stats stats_;
+  // Most recently used first; index_ points into it by key.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+};
+
+} // namespace cppshell
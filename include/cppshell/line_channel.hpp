@@ -0,0 +1,235 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppshell {
+
+/** Location of one line inside LineChunk::data. */
+struct LineSpan {
+  /** Offset of the first byte. */
+  size_t offset = 0;
+  /** Length including the trailing '\n' (absent only on a final line). */
+  size_t size = 0;
+};
+
+/**
+ * A reference-counted block of complete lines.
+ *
+ * Chunks are immutable once published, so a stage can forward some of the
+ * lines it received by sharing `data` instead of copying the bytes.
+ */
+struct LineChunk {
+  /** Shared storage the spans point into. */
+  std::shared_ptr<const std::string> data;
+  /** Lines in stream order. */
+  std::vector<LineSpan> lines;
+
+  /** Returns line `i` including its '\n'. */
+  [[nodiscard]] std::string_view Line(size_t i) const {
+    return std::string_view(*data).substr(lines[i].offset, lines[i].size);
+  }
+};
+
+/**
+ * Queue of LineChunks between two builtins of one pipeline.
+ *
+ * Used by the executor instead of a byte Pipe when both ends support it
+ * (ICommand::SupportsLineChannels()), so lines are split once at the start
+ * of the pipeline rather than re-parsed at every hop.
+ */
+class LineChannel {
+public:
+  /** Virtual destructor for interface type. */
+  virtual ~LineChannel() = default;
+
+  /**
+   * Publishes a chunk. Returns false if the reader has gone away; the
+   * producer may stop early then.
+   */
+  virtual bool Push(std::shared_ptr<const LineChunk> chunk) = 0;
+
+  /** Next chunk, or nullptr once the writer closed and all were consumed. */
+  [[nodiscard]] virtual std::shared_ptr<const LineChunk> Pop() = 0;
+
+  /** Writer side: no more chunks will be pushed. */
+  virtual void Close() = 0;
+
+  /** Reader side: no more chunks will be popped; unblocks the writer. */
+  virtual void CloseReader() = 0;
+};
+
+/**
+ * LineChannel connecting stages that run on different threads. Push blocks
+ * while the channel is full and Pop while it is empty.
+ */
+class BlockingLineChannel final : public LineChannel {
+public:
+  /** Creates a channel holding at most `capacity` unread chunks. */
+  explicit BlockingLineChannel(size_t capacity = kDefaultCapacity);
+
+  bool Push(std::shared_ptr<const LineChunk> chunk) override;
+  [[nodiscard]] std::shared_ptr<const LineChunk> Pop() override;
+  void Close() override;
+  void CloseReader() override;
+
+private:
+  static constexpr size_t kDefaultCapacity = 8;
+
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::deque<std::shared_ptr<const LineChunk>> chunks_;
+  size_t capacity_;
+  bool closed_ = false;
+  bool readerClosed_ = false;
+};
+
+/**
+ * Reads a stream in large blocks of whole lines without splitting them.
+ *
+ * Each block ends at a line boundary; the partial line after the last '\n'
+ * is carried into the next block. A line that grows past `maxLine` bytes
+ * without a '\n' is handed out in pieces instead, so at most about
+ * `maxLine` bytes are buffered whatever the input.
+ */
+class BlockReader {
+public:
+  /** One read result. `data` is null at end of input. */
+  struct Block {
+    std::shared_ptr<const std::string> data;
+    /** `data` is a piece of a line longer than `maxLine`. */
+    bool longLine = false;
+    /** For a long line piece: the line ends in it (or the input did). */
+    bool lineEnds = false;
+  };
+
+  /**
+   * Reads `in` in blocks of about `blockSize` bytes. Before a read that may
+   * wait, `in.tie()` and `out` are flushed, as a sentry flushes the tie, so
+   * output is not held back while input is slow.
+   */
+  BlockReader(std::istream &in, size_t blockSize, size_t maxLine,
+              std::ostream *out = nullptr);
+
+  /** Next block, waiting for input only until it holds a whole line. */
+  [[nodiscard]] Block Next();
+
+  /** Whether Next() may wait for input: the stream has nothing ready. */
+  [[nodiscard]] bool MayWait() const;
+
+private:
+  [[nodiscard]] Block NextPiece(std::string data);
+  /** Appends what the stream has available, at most a block; 0 at EOF. */
+  [[nodiscard]] size_t Append(std::string &data);
+
+  std::istream *in_;
+  std::ostream *out_;
+  size_t blockSize_;
+  size_t maxLine_;
+  std::string carry_;
+  bool inLongLine_ = false;
+};
+
+/**
+ * Reads a command's input as LineChunks.
+ *
+ * Takes chunks from CommandContext::inChannel when present, otherwise reads
+ * `streams.in` in blocks and splits them into complete lines. Lets
+ * line-oriented builtins share one code path for both kinds of input.
+ */
+class LineSource {
+public:
+  /**
+   * Reads from the context's channel or input stream, flushing
+   * `streams.out` before waiting for the stream.
+   */
+  explicit LineSource(const CommandContext &context);
+
+  /** Reads from an arbitrary stream (e.g. a file argument). */
+  explicit LineSource(std::istream &in);
+
+  /** Next chunk of lines, or nullptr at end of input. */
+  [[nodiscard]] std::shared_ptr<const LineChunk> Next();
+
+private:
+  static constexpr size_t kBlockSize = 64 * 1024;
+
+  LineChannel *channel_ = nullptr;
+  std::unique_ptr<BlockReader> reader_;
+};
+
+/**
+ * Writes a command's output either to CommandContext::outChannel or to
+ * `streams.out`.
+ *
+ * Forwarded lines keep pointing into the source chunk's storage; lines
+ * produced by the command itself are batched into new chunks.
+ */
+class LineSink {
+public:
+  /** Writes to the context's channel or output stream. */
+  explicit LineSink(const CommandContext &context);
+
+  /** Flushes pending lines. */
+  ~LineSink();
+
+  LineSink(const LineSink &) = delete;
+  LineSink &operator=(const LineSink &) = delete;
+
+  /** Writes `text` followed by '\n'. */
+  void WriteLine(std::string_view text);
+
+  /** Writes a final line that has no '\n'; nothing may follow it. */
+  void WriteLastLine(std::string_view text);
+
+  /** Forwards line `i` of `chunk` unchanged. */
+  void Forward(const std::shared_ptr<const LineChunk> &chunk, size_t i);
+
+  /** Forwards lines [first, last) of `chunk` unchanged. */
+  void Forward(const std::shared_ptr<const LineChunk> &chunk, size_t first,
+               size_t last);
+
+  /** Forwards every line of `chunk` unchanged. */
+  void Forward(const std::shared_ptr<const LineChunk> &chunk);
+
+  /** Publishes everything written so far. */
+  void Flush();
+
+  /** Returns true once the downstream reader stopped reading. */
+  [[nodiscard]] bool Broken() const { return broken_; }
+
+private:
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  void FlushOwned();
+  void FlushForwarded();
+  void Publish(std::shared_ptr<const LineChunk> chunk);
+
+  LineChannel *channel_ = nullptr;
+  std::ostream *out_ = nullptr;
+  std::string owned_;
+  std::vector<LineSpan> ownedLines_;
+  std::shared_ptr<const LineChunk> forwardedFrom_;
+  std::vector<LineSpan> forwardedLines_;
+  bool broken_ = false;
+};
+
+/**
+ * Reads whatever `in` can deliver without waiting for a full block: at
+ * least one byte unless at EOF, at most `size`. Returns 0 at EOF.
+ */
+[[nodiscard]] size_t ReadAvailable(std::istream &in, char *buffer,
+                                   size_t size);
+
+} // namespace cppshell
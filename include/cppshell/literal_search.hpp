@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace cppshell {
+
+/**
+ * Finds occurrences of a fixed byte string, optionally ignoring ASCII case.
+ *
+ * Candidates are found 16 bytes at a time by comparing every position with
+ * the first and the last byte of the needle (SSE2 where available), and
+ * only those are compared in full. Case is folded by setting bit 0x20 of
+ * both sides, which is exact for letters; other bytes compare as they are.
+ */
+class LiteralSearcher {
+public:
+  /** Prepares a search for `needle`. */
+  LiteralSearcher(std::string needle, bool ignoreCase);
+
+  /**
+   * Returns the position of the first occurrence at or after `from` in
+   * `haystack`, or std::string_view::npos.
+   */
+  [[nodiscard]] size_t Find(std::string_view haystack, size_t from = 0) const;
+
+  /** The needle being searched for. */
+  [[nodiscard]] const std::string &Needle() const { return needle_; }
+
+private:
+  /** Find, compiled for one case mode so that no candidate tests it. */
+  template <bool kFold>
+  [[nodiscard]] size_t FindIn(std::string_view haystack, size_t from) const;
+
+  template <bool kFold> [[nodiscard]] bool EqualAt(const char *at) const;
+
+  std::string needle_;
+  bool ignoreCase_;
+  // First and last needle byte: a haystack byte matches when
+  // (byte | fold) == value.
+  unsigned char firstValue_ = 0;
+  unsigned char firstFold_ = 0;
+  unsigned char lastValue_ = 0;
+  unsigned char lastFold_ = 0;
+};
+
+} // namespace cppshell
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Finds occurrences of any of a set of fixed byte strings, optionally
+ * ignoring ASCII case, in one pass over the input (Aho-Corasick).
+ *
+ * Bytes are first mapped to classes: one per byte value that occurs in a
+ * needle (upper and lower case letters share one under `ignoreCase`) and
+ * class 0 for all others, which always leads back to the root. The trie
+ * is numbered breadth first; the states nearest the root, where a scan
+ * spends most of its time, get a full DFA row of kDenseEntries at most in
+ * total, and deeper states keep their children sorted by class and a
+ * failure link. Each input byte thus costs a table lookup in the common
+ * case, however many needles there are.
+ *
+ * Searching is const and may run on several threads at once.
+ */
+class MultiLiteralSearcher {
+public:
+  /** Most DFA table entries kept for the states nearest the root. */
+  static constexpr size_t kDenseEntries = 1 << 20;
+
+  /** The state a line fed in pieces starts in. */
+  static constexpr uint32_t kStart = 0;
+
+  /** Prepares a search for `needles`; duplicates are merged. */
+  MultiLiteralSearcher(const std::vector<std::string> &needles,
+                       bool ignoreCase);
+
+  /** Number of distinct needles. */
+  [[nodiscard]] size_t Size() const { return size_; }
+
+  /**
+   * Returns the position just past the occurrence that ends first at or
+   * after `from` in `haystack` (`from` itself for an empty needle), or
+   * std::string_view::npos.
+   */
+  [[nodiscard]] size_t FindEnd(std::string_view haystack,
+                               size_t from = 0) const;
+
+  /**
+   * Returns true if a needle occurs in `line`; under `word` only an
+   * occurrence with an ECMAScript \b on both sides counts, and an empty
+   * needle never does.
+   */
+  [[nodiscard]] bool Contains(std::string_view line, bool word) const;
+
+  /**
+   * Feeds the next piece of a line, moving `state` from kStart on. Returns
+   * true once a needle occurred in the pieces fed.
+   */
+  [[nodiscard]] bool Feed(uint32_t &state, std::string_view piece) const;
+
+private:
+  /** Marks a state reached in delta_ and Next() where a needle ends. */
+  static constexpr uint32_t kOutputBit = 1U << 31;
+
+  struct State {
+    /** The children are the next `children` states, sorted by label_. */
+    uint32_t firstChild = 0;
+    uint32_t fail = 0;
+    /**
+     * The nearest state on the failure chain (this one included) where a
+     * needle ends, 0 if there is none.
+     */
+    uint32_t output = 0;
+    uint16_t children = 0;
+  };
+
+  /**
+   * The state after `state` reads a byte of class `c` (not 0), with
+   * kOutputBit set if a needle ends there. `state` may carry the bit.
+   */
+  [[nodiscard]] uint32_t Next(uint32_t state, uint16_t c) const;
+
+  /** The child of `state` over class `c`, or 0 if it has none. */
+  [[nodiscard]] uint32_t Child(uint32_t state, uint16_t c) const;
+
+  std::array<uint16_t, 256> classOf_{};
+  size_t classes_ = 1;
+  size_t size_ = 0;
+  bool matchesEmpty_ = false;
+  // States [0, dense_) have a full row of classes_ entries in delta_.
+  uint32_t dense_ = 1;
+  std::vector<uint32_t> delta_;
+  std::vector<State> states_;
+  // The class of the byte leading to each state.
+  std::vector<uint16_t> label_;
+  // Length of the needle ending at a state, 0 if none does.
+  std::vector<uint32_t> length_;
+};
+
+} // namespace cppshell
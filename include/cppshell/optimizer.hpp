@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cppshell/parser.hpp"
+
+#include <string>
+
+namespace cppshell {
+
+/**
+ * Rewrites a parsed pipeline into a cheaper plan with the same output,
+ * errors and exit code.
+ *
+ * Applied until none matches:
+ * - `cat FILE | grep ...` and `cat FILE | wc` become `grep ... FILE` and
+ *   `wc FILE`, when FILE is a single existing regular file;
+ * - an argument-less `cat` in front of another stage is dropped, unless
+ *   that changes who reads the shell's input;
+ * - `grep ... | wc` becomes a single stage counting grep's output in place
+ *   (Command::countOutput).
+ *
+ * Stages with assignments or redirections that could observe a rewrite are
+ * left alone. The shell runs this between ParseLine and execution unless
+ * the variable CPPSHELL_OPTIMIZE is set to 0.
+ */
+[[nodiscard]] Pipeline OptimizePipeline(Pipeline pipeline);
+
+/**
+ * Formats a pipeline back into shell syntax, for the CPPSHELL_DUMP_PLAN
+ * debug output. Fused stages are shown in square brackets.
+ */
+[[nodiscard]] std::string FormatPipeline(const Pipeline &pipeline);
+
+} // namespace cppshell
@@ -8,6 +8,26 @@
 
 namespace cppshell {
 
+/** Which standard stream a redirection replaces and how its file is opened. */
+enum class RedirectionKind {
+  /** `< file`: stdin reads from the file. */
+  Input,
+  /** `> file`: stdout truncates and writes the file. */
+  Output,
+  /** `>> file`: stdout appends to the file. */
+  Append,
+  /** `2> file`: stderr truncates and writes the file. */
+  Error,
+};
+
+/** A single I/O redirection attached to a command. */
+struct Redirection {
+  /** Redirection operator. */
+  RedirectionKind kind = RedirectionKind::Output;
+  /** Target file path. */
+  std::string target;
+};
+
 struct Command {
   /** Environment assignments like NAME=value, appearing before the command. */
   std::unordered_map<std::string, std::string> assignments;
@@ -15,6 +35,14 @@ struct Command {
   std::string command;
   /** Command arguments, excluding the command name. */
   std::vector<std::string> args;
+  /** Redirections in the order they appear; later ones win. */
+  std::vector<Redirection> redirections;
+  /**
+   * Never set by the parser. The pipeline optimizer sets it when it fuses a
+   * following argument-less `wc` into this command: the command's output is
+   * counted in place and only the counts are written (see optimizer.hpp).
+   */
+  bool countOutput = false;
 };
 
 /** Parsed representation of a command pipeline. */
@@ -39,7 +67,9 @@ struct ParseResult {
  * This stage supports:
  * - tokenization with quotes;
  * - leading NAME=value assignments;
- * - a single command invocation.
+ * - commands separated by `|`;
+ * - redirections `< file`, `> file`, `>> file` and `2> file` anywhere after
+ *   the assignments of a command.
  */
 [[nodiscard]] ParseResult ParseLine(std::string_view input);
 
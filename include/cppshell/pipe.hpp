@@ -37,6 +37,12 @@ public:
     return toRead;
   }
 
+  // Bytes a Read would return without waiting
+  size_t Available() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return buffer_.size();
+  }
+
   void Close() {
     std::unique_lock<std::mutex> lock(mutex_);
     closed_ = true;
@@ -71,6 +77,10 @@ protected:
     return traits_type::to_int_type(*gptr());
   }
 
+  std::streamsize showmanyc() override {
+    return static_cast<std::streamsize>(pipe_.Available());
+  }
+
 private:
   static constexpr size_t kBufferSize = 1024;
   char buffer_[kBufferSize];
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+#include "cppshell/parser.hpp"
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Command streams with a command's redirections applied.
+ *
+ * Every target is opened exactly once, in order; streams that are not
+ * redirected are taken from the inherited ones. On POSIX systems the files
+ * are wrapped in fd-backed stream buffers (see FdReadBuffer/FdWriteBuffer),
+ * so builtins read and write the descriptor directly and ExternalCommand
+ * passes the descriptor itself to the child process.
+ */
+class RedirectedStreams {
+public:
+  /** Opens all redirection targets on top of `inherited`. */
+  RedirectedStreams(const std::vector<Redirection> &redirections,
+                    CommandStreams inherited);
+  ~RedirectedStreams();
+
+  RedirectedStreams(const RedirectedStreams &) = delete;
+  RedirectedStreams &operator=(const RedirectedStreams &) = delete;
+
+  /** Returns true if every target was opened. */
+  [[nodiscard]] bool Ok() const { return error_.empty(); }
+
+  /** Human-readable error for the first target that failed to open. */
+  [[nodiscard]] const std::string &Error() const { return error_; }
+
+  /** Streams to execute the command with. */
+  [[nodiscard]] CommandStreams Streams() const;
+
+private:
+  std::istream *in_;
+  std::ostream *out_;
+  std::ostream *err_;
+  std::vector<std::unique_ptr<std::streambuf>> buffers_;
+  std::unique_ptr<std::istream> ownedIn_;
+  std::unique_ptr<std::ostream> ownedOut_;
+  std::unique_ptr<std::ostream> ownedErr_;
+  std::string error_;
+};
+
+#ifndef _WIN32
+/**
+ * Applies redirections onto file descriptors 0/1/2 of the current process.
+ *
+ * Used in forked pipeline children, where commands run on std::cin/std::cout.
+ * Returns an error message, or an empty string on success.
+ */
+[[nodiscard]] std::string
+RedirectStandardFds(const std::vector<Redirection> &redirections);
+#endif
+
+} // namespace cppshell
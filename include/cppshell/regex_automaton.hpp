@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Regular expression search in time linear in the input.
+ *
+ * Understands the ECMAScript subset grep patterns use in practice: `.`,
+ * bracket expressions, \d \w \s and their negations, escapes, groups,
+ * alternation, all quantifiers (laziness does not change whether a line
+ * matches) and the assertions ^ $ \b \B. The pattern is compiled to an
+ * NFA (Thompson construction); searching walks a DFA whose states are
+ * built from it on demand and cached. The cache holds at most
+ * kMaxStates states and starts over when full, so memory stays bounded
+ * whatever the pattern.
+ *
+ * Backreferences, lookahead and other syntax outside the subset are not
+ * compiled; callers fall back to std::regex for those.
+ */
+class RegexAutomaton {
+  struct Nfa;
+
+public:
+  /** Most DFA states a Searcher keeps before discarding its cache. */
+  static constexpr size_t kMaxStates = 4096;
+
+  /**
+   * Searches lines with a private DFA cache. Use from one thread at a
+   * time; get one per thread from Acquire().
+   */
+  class Searcher {
+  public:
+    ~Searcher();
+
+    Searcher(const Searcher &) = delete;
+    Searcher &operator=(const Searcher &) = delete;
+
+    /**
+     * Returns true if the pattern matches somewhere in `line`, which is
+     * the whole subject: ^ and $ hold only at its ends.
+     */
+    [[nodiscard]] bool Search(std::string_view line);
+
+    /** Starts a line that arrives in pieces, for lines too long to hold. */
+    void Begin();
+
+    /**
+     * Feeds the next piece of the line started by Begin(). Returns true
+     * once the pattern is known to match; later pieces need not be fed.
+     */
+    [[nodiscard]] bool Feed(std::string_view piece);
+
+    /** Ends the line; returns true if the pattern matches it. */
+    [[nodiscard]] bool End();
+
+    /** Number of times the cache was full and started over. */
+    [[nodiscard]] size_t CacheResets() const;
+
+  private:
+    friend class RegexAutomaton;
+    struct Cache;
+    explicit Searcher(const Nfa &nfa);
+
+    std::unique_ptr<Cache> cache_;
+    // Position in the line being fed: a DFA state, or matched.
+    int state_ = 0;
+    bool matched_ = false;
+  };
+
+  /**
+   * Compiles `pattern`, or returns nullptr if it is invalid or uses syntax
+   * outside the supported subset. `ignoreCase` folds ASCII letters, like
+   * std::regex::icase in the "C" locale.
+   */
+  [[nodiscard]] static std::unique_ptr<RegexAutomaton>
+  Compile(std::string_view pattern, bool ignoreCase);
+
+  ~RegexAutomaton();
+
+  RegexAutomaton(const RegexAutomaton &) = delete;
+  RegexAutomaton &operator=(const RegexAutomaton &) = delete;
+
+  /** Hands out a Searcher, reusing one given back before if possible. */
+  [[nodiscard]] std::unique_ptr<Searcher> Acquire() const;
+
+  /** Takes back a Searcher so its cached states serve the next caller. */
+  void Release(std::unique_ptr<Searcher> searcher) const;
+
+private:
+  explicit RegexAutomaton(std::unique_ptr<Nfa> nfa);
+
+  std::unique_ptr<Nfa> nfa_;
+  mutable std::mutex mutex_;
+  mutable std::vector<std::unique_ptr<Searcher>> idle_;
+};
+
+} // namespace cppshell
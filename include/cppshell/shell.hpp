@@ -2,6 +2,7 @@
 
 #include "cppshell/command.hpp"
 #include "cppshell/environment.hpp"
+#include "cppshell/executor.hpp"
 
 #include <istream>
 #include <ostream>
@@ -29,6 +30,7 @@ public:
 private:
   Environment baseEnv_;
   CommandFactory factory_;
+  Executor executor_;
 };
 
 } // namespace cppshell
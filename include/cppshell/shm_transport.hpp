@@ -0,0 +1,190 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <streambuf>
+
+namespace cppshell {
+
+/**
+ * Single-producer, single-consumer byte ring in shared memory, connecting
+ * two forked builtin stages without a kernel pipe in between.
+ *
+ * The ring lives in a memfd mapped twice back to back, so any readable or
+ * writable region is contiguous even when it wraps around. It is created
+ * before forking and inherited by both children; the producer copies its
+ * output straight into the shared pages and the consumer reads it in place.
+ * A side waits on a futex only when the ring is full or empty.
+ *
+ * Both sides close their end explicitly. A peer that dies without doing so
+ * is detected through the pipe the executor still connects the two stages
+ * with: a waiting side periodically polls that descriptor for a hang-up.
+ */
+class SharedRing {
+public:
+  static constexpr size_t kDefaultCapacity = 1024 * 1024;
+
+  /**
+   * Maps a new ring of `capacity` bytes, rounded up to whole pages.
+   * Returns nullptr if memfd or the mappings are unavailable, in which case
+   * the caller falls back to a pipe.
+   */
+  [[nodiscard]] static std::unique_ptr<SharedRing>
+  Create(size_t capacity = kDefaultCapacity);
+
+  /** Unmaps the ring in this process only. */
+  ~SharedRing();
+
+  SharedRing(const SharedRing &) = delete;
+  SharedRing &operator=(const SharedRing &) = delete;
+
+  /** Ring size in bytes. */
+  [[nodiscard]] size_t Capacity() const { return capacity_; }
+
+  /**
+   * Producer: waits for free space and returns up to `maxBytes` of it. An
+   * empty span means the consumer has closed its end.
+   */
+  [[nodiscard]] std::span<char> WaitWritable(size_t maxBytes, int peerFd);
+
+  /** Producer: publishes the first `size` bytes of the writable region. */
+  void Commit(size_t size);
+
+  /** Producer: signals end of data. */
+  void CloseWriter();
+
+  /** Returns true once the consumer has closed its end. */
+  [[nodiscard]] bool ReaderClosed() const;
+
+  /**
+   * Consumer: waits for data and returns up to `maxBytes` of it. An empty
+   * span means end of data.
+   */
+  [[nodiscard]] std::span<const char> WaitReadable(size_t maxBytes,
+                                                   int peerFd);
+
+  /** Consumer: bytes published and not consumed yet. */
+  [[nodiscard]] size_t Readable() const;
+
+  /** Consumer: releases the first `size` bytes of the readable region. */
+  void Consume(size_t size);
+
+  /** Consumer: stops reading; further producer writes fail. */
+  void CloseReader();
+
+private:
+  struct Header;
+
+  SharedRing(Header *header, char *data, size_t capacity, size_t headerSize);
+
+  Header *header_;
+  char *data_;
+  size_t capacity_;
+  size_t headerSize_;
+};
+
+/**
+ * Input stream buffer over the consumer end of a SharedRing. The get area
+ * points into the shared pages, so reading takes no copy beyond the
+ * caller's own. Closes the consumer end when destroyed.
+ */
+class RingReadBuffer : public std::streambuf {
+public:
+  /** Reads from `ring`; `peerFd` is polled to notice a dead producer. */
+  RingReadBuffer(SharedRing &ring, int peerFd);
+  ~RingReadBuffer() override;
+
+  RingReadBuffer(const RingReadBuffer &) = delete;
+  RingReadBuffer &operator=(const RingReadBuffer &) = delete;
+
+protected:
+  int_type underflow() override;
+  std::streamsize showmanyc() override;
+
+private:
+  static constexpr size_t kRegionSize = 256 * 1024;
+  SharedRing &ring_;
+  int peerFd_;
+};
+
+/**
+ * Output stream buffer over the producer end of a SharedRing. The put area
+ * points into the shared pages and is published on overflow and sync().
+ *
+ * Like a write to a pipe without readers, writing after the consumer has
+ * gone raises SIGPIPE and, if that is ignored, fails. Closes the producer
+ * end when destroyed.
+ */
+class RingWriteBuffer : public std::streambuf {
+public:
+  /** Writes to `ring`; `peerFd` is polled to notice a dead consumer. */
+  RingWriteBuffer(SharedRing &ring, int peerFd);
+  ~RingWriteBuffer() override;
+
+  RingWriteBuffer(const RingWriteBuffer &) = delete;
+  RingWriteBuffer &operator=(const RingWriteBuffer &) = delete;
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  /** Publishes the put area and maps a new one; false if the reader left. */
+  [[nodiscard]] bool NextRegion();
+
+  // Published at least this often so the consumer can start early.
+  static constexpr size_t kRegionSize = 64 * 1024;
+  SharedRing &ring_;
+  int peerFd_;
+};
+
+/**
+ * Output stream buffer for a pipe read by an external program.
+ *
+ * Full buffers are gifted to the pipe with vmsplice(2) and SPLICE_F_GIFT:
+ * the pipe references the buffer's pages and the reader copies out of
+ * them directly, saving the copy into the kernel that write(2) makes. A
+ * gifted buffer is unmapped and never written again, and the next one is
+ * freshly mapped, because the pages may stay referenced for as long as
+ * the reader likes: it may grow the pipe with F_SETPIPE_SZ or pass the
+ * pages on with splice(2) or tee(2). Partial buffers (sync(), destruction)
+ * are written normally. Falls back to write(2) for good if the descriptor
+ * is not a pipe.
+ */
+class VmspliceWriteBuffer : public std::streambuf {
+public:
+  /** Writes to `fd`, which stays open. */
+  explicit VmspliceWriteBuffer(int fd);
+  ~VmspliceWriteBuffer() override;
+
+  VmspliceWriteBuffer(const VmspliceWriteBuffer &) = delete;
+  VmspliceWriteBuffer &operator=(const VmspliceWriteBuffer &) = delete;
+
+  /** Underlying descriptor. Call pubsync() before writing to it elsewhere. */
+  [[nodiscard]] int Fd() const { return fd_; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char *s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  [[nodiscard]] bool SpliceFull();
+  [[nodiscard]] bool WritePending();
+
+  // Pipe size requested, and the size of a buffer; the kernel may grant
+  // less.
+  static constexpr size_t kPipeSize = 1024 * 1024;
+  int fd_;
+  bool splice_ = false;
+  size_t size_ = 0;
+  char *buffer_ = nullptr;
+};
+
+} // namespace cppshell
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * FIFO of bytes kept in a bounded in-memory ring that overflows into an
+ * unlinked temporary file.
+ *
+ * The oldest bytes are in memory and the newest, once memory is full, on
+ * disk. While anything is on disk new bytes go there as well, so the order
+ * is preserved. The file is created on first use (with O_TMPFILE where the
+ * file system supports it, otherwise under a name that is unlinked right
+ * away) and truncated whenever it has been read back completely, so the
+ * disk limit applies to its size. Spilling is not available on Windows.
+ *
+ * Not thread-safe.
+ */
+class SpillQueue {
+public:
+  /** Holds at most `memoryLimit` bytes in memory and `diskLimit` on disk. */
+  SpillQueue(size_t memoryLimit, size_t diskLimit);
+
+  /** Closes, and thereby deletes, the spill file. */
+  ~SpillQueue();
+
+  SpillQueue(const SpillQueue &) = delete;
+  SpillQueue &operator=(const SpillQueue &) = delete;
+
+  /** Number of bytes Append() accepts right now. */
+  [[nodiscard]] size_t Room() const;
+
+  /**
+   * Appends as much of `data` as fits and returns the number of bytes
+   * taken. A short count with Error() set means the spill file could not
+   * be written.
+   */
+  [[nodiscard]] size_t Append(std::string_view data);
+
+  /**
+   * Moves up to `maxBytes` of the oldest bytes to the end of `out` and
+   * returns their number. Returns 0 with Error() set if the spill file
+   * could not be read.
+   */
+  size_t Take(std::string &out, size_t maxBytes);
+
+  /** Returns true if no bytes are queued. */
+  [[nodiscard]] bool Empty() const { return size_ == 0 && Spilled() == 0; }
+
+  /** Highest number of bytes held in memory so far. */
+  [[nodiscard]] size_t PeakMemory() const { return peakMemory_; }
+
+  /** Largest size of the spill file so far. */
+  [[nodiscard]] size_t PeakDisk() const { return peakDisk_; }
+
+  /** Description of the last I/O failure, empty if none. */
+  [[nodiscard]] const std::string &Error() const { return error_; }
+
+private:
+  [[nodiscard]] size_t Spilled() const { return diskEnd_ - diskRead_; }
+  void PushMemory(std::string_view data);
+  [[nodiscard]] bool OpenFile();
+  [[nodiscard]] bool WriteFile(std::string_view data);
+  [[nodiscard]] bool ReadFile(char *out, size_t size);
+
+  size_t memoryLimit_;
+  size_t diskLimit_;
+
+  // In-memory ring, grown on demand up to memoryLimit_.
+  std::vector<char> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+
+  // Spill file: bytes in [diskRead_, diskEnd_) are still queued.
+  int fd_ = -1;
+  size_t diskRead_ = 0;
+  size_t diskEnd_ = 0;
+
+  size_t peakMemory_ = 0;
+  size_t peakDisk_ = 0;
+  std::string error_;
+};
+
+} // namespace cppshell
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cppshell/environment.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Fixed set of worker threads running submitted tasks in FIFO order.
+ *
+ * Used by builtins that split their input into independent pieces. The
+ * destructor finishes the queued tasks and joins the workers.
+ */
+class ThreadPool {
+public:
+  /** Starts `workers` threads (at least one). */
+  explicit ThreadPool(size_t workers);
+
+  /** Runs the remaining tasks and joins the workers. */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /** Number of worker threads. */
+  [[nodiscard]] size_t Size() const { return workers_.size(); }
+
+  /**
+   * Queues `fn` and returns a future for its result. An exception thrown
+   * by `fn` is rethrown from the future's get().
+   */
+  template <typename F>
+  [[nodiscard]] std::future<std::invoke_result_t<F>> Submit(F fn) {
+    using Result = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+    std::future<Result> future = task->get_future();
+    Enqueue([task] { (*task)(); });
+    return future;
+  }
+
+private:
+  void Enqueue(std::function<void()> task);
+  void WorkerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable hasWork_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+};
+
+/**
+ * Number of threads a data-parallel builtin may use: CPPSHELL_THREADS from
+ * `env` if it is a positive number, otherwise the hardware concurrency.
+ */
+[[nodiscard]] size_t WorkerCount(const Environment &env);
+
+} // namespace cppshell
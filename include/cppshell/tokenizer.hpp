@@ -10,6 +10,11 @@ namespace cppshell {
 struct TokenizeResult {
   /** Token list, if tokenization succeeded. */
   std::vector<std::string> tokens;
+  /**
+   * Parallel to `tokens`: true for unquoted operators, so that a quoted `"|"`
+   * or `'>'` stays an ordinary word.
+   */
+  std::vector<bool> operators;
   /** Human-readable error; empty if successful. */
   std::string error;
 
@@ -24,7 +29,9 @@ struct TokenizeResult {
  * - Whitespace separates tokens.
  * - Single and double quotes both group text into a single token.
  * - Quotes are removed from the resulting token.
- * - No variable substitution and no pipes are handled here.
+ * - Unquoted `|`, `<`, `>`, `>>` and `2>` are emitted as separate operator
+ *   tokens.
+ * - No variable substitution is handled here.
  */
 [[nodiscard]] TokenizeResult Tokenize(std::string_view line);
 
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "cppshell/grep_matcher.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * The trigrams a line must hold for grep's patterns to match it: it
+ * matches only if, for one of the alternatives, it holds all of the
+ * alternative's trigrams.
+ *
+ * Trigrams are read off the runs of plain characters every match of a
+ * pattern contains. Each top-level `|` branch is an alternative. Groups,
+ * classes, escapes like `\d`, anchors and quantified characters end a run
+ * without adding to it. A branch with no run of three characters
+ * requires nothing, and then every line may match. Trigrams are
+ * ASCII-folded, as the index stores them, so one query serves -i too.
+ */
+class TrigramQuery {
+public:
+  TrigramQuery(const std::vector<std::string> &patterns,
+               const GrepPatternOptions &options);
+
+  /** Returns true if the query rules no line out. */
+  [[nodiscard]] bool All() const { return all_; }
+
+  /** Sorted trigrams of each alternative. */
+  [[nodiscard]] const std::vector<std::vector<uint32_t>> &
+  Alternatives() const {
+    return alternatives_;
+  }
+
+private:
+  std::vector<std::vector<uint32_t>> alternatives_;
+  bool all_ = false;
+};
+
+/** What TrigramIndex::Build did. */
+struct IndexBuild {
+  /** Set once the index file is written. */
+  bool written = false;
+  /** Files indexed. */
+  size_t files = 0;
+  /** Of those, the files read because they were new or had changed. */
+  size_t read = 0;
+  /** Messages like "dir: Permission denied", without a program name. */
+  std::vector<std::string> errors;
+};
+
+/**
+ * A persistent trigram index of the regular files under a directory, kept
+ * in kFileName there, for `grep --index`.
+ *
+ * For each file the index holds its path relative to the directory, its
+ * inode, size and modification time, and the set of ASCII-folded byte
+ * trigrams of its lines. Trigrams map to sorted posting lists of file
+ * numbers. The file is memory-mapped (read whole where mmap is missing)
+ * and used in place: opening it only hashes the paths.
+ *
+ * A file that is not in the index, or whose inode, size or modification
+ * time differ from the indexed ones, is always a candidate, so answers
+ * stay right as the tree changes. Build() again brings the index up to
+ * date, reading only the new and changed files.
+ */
+class TrigramIndex {
+public:
+  /** Name of the index file in the indexed directory. */
+  static constexpr std::string_view kFileName = ".cppshell-grep-index";
+
+  /**
+   * Indexes the files under `dir`, read with `threads` workers, reusing
+   * what the current index holds for files that did not change. The new
+   * index replaces the old one atomically.
+   */
+  [[nodiscard]] static IndexBuild Build(const std::string &dir,
+                                        size_t threads);
+
+  /**
+   * Opens the index of `dir`; returns nullptr and sets `error` if there is
+   * none or it cannot be used.
+   */
+  [[nodiscard]] static std::unique_ptr<TrigramIndex>
+  Open(const std::string &dir, std::string &error);
+
+  ~TrigramIndex();
+
+  TrigramIndex(const TrigramIndex &) = delete;
+  TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+  /** Number of files indexed. */
+  [[nodiscard]] size_t Files() const { return paths_.size(); }
+
+  /**
+   * Keeps those of `files`, paths under the index's directory as WalkTree
+   * lists them, that may hold a line `query` matches.
+   */
+  [[nodiscard]] std::vector<std::string>
+  Narrow(std::vector<std::string> files, const TrigramQuery &query) const;
+
+  /** The sorted trigrams of each indexed file, by file number. */
+  [[nodiscard]] std::vector<std::vector<uint32_t>> FileTrigrams() const;
+
+private:
+  struct Header;
+  struct FileEntry;
+  struct TrigramEntry;
+
+  /** Uses `size` bytes mapped at `data`, or `buffer` if `data` is null. */
+  TrigramIndex(std::string dir, std::string buffer, const char *data,
+               size_t size);
+
+  /** Checks the layout and hashes the paths; returns the error, if any. */
+  [[nodiscard]] std::string Load();
+
+  /**
+   * The posting list of `trigram`, empty if no file holds it; nullopt if
+   * the index is damaged there.
+   */
+  [[nodiscard]] std::optional<std::span<const uint32_t>>
+  Postings(uint32_t trigram) const;
+
+  std::string dir_;
+  // The file's bytes where it is read rather than mapped.
+  std::string buffer_;
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+  const Header *header_ = nullptr;
+  const FileEntry *files_ = nullptr;
+  const char *pathData_ = nullptr;
+  const TrigramEntry *trigrams_ = nullptr;
+  const uint32_t *postings_ = nullptr;
+  std::unordered_map<std::string_view, uint32_t> paths_;
+};
+
+} // namespace cppshell
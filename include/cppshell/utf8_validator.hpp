@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+namespace cppshell {
+
+/**
+ * Checks that bytes given in turn, as whole 64-byte windows or one at a
+ * time, are UTF-8: no stray continuation bytes, no sequence cut short by
+ * another byte, and no overlong forms, surrogates or code points past
+ * U+10FFFF. NUL is valid UTF-8.
+ *
+ * A window is classified into bit masks (with SSE2 where available) that
+ * are checked against each other, so text that is not ASCII costs no
+ * branch per character; an all-ASCII window costs one mask. Once a byte
+ * fails, the state is undefined until Reset().
+ */
+class Utf8Validator {
+public:
+  /**
+   * Checks the 64 bytes at `p`. Returns a mask, bit i for byte i, whose
+   * lowest set bit is the first byte at which decoding fails; 0 if none.
+   */
+  [[nodiscard]] uint64_t NextWindow(const char *p);
+
+  /** Checks one byte; returns false if decoding fails at it. */
+  [[nodiscard]] bool NextByte(unsigned char c);
+
+  /** Returns true if the bytes so far end inside a sequence. */
+  [[nodiscard]] bool Open() const { return need_ != 0; }
+
+  void Reset() { *this = Utf8Validator(); }
+
+private:
+  // Continuation bytes the open sequence still needs.
+  unsigned need_ = 0;
+  // The last byte, if it is a lead (E0, ED, F0, F4) that narrows the
+  // range of the byte after it; 0 otherwise.
+  unsigned char narrowLead_ = 0;
+};
+
+} // namespace cppshell
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cppshell {
+
+/**
+ * Builtin: wc.
+ *
+ * Prints the selected counts (-l, -w, -m, -c, -L; lines, words and bytes
+ * by default) of standard input or of each FILE. With several FILEs each
+ * line ends with the FILE's name and a `total` line follows. Files after
+ * the current one are counted ahead on a thread pool and printed in
+ * argument order.
+ */
+class WcCommand final : public ICommand {
+public:
+  /** Constructs the command with its argv (excluding the command name). */
+  explicit WcCommand(std::vector<std::string> args);
+
+  /** Prints the counts of each file, or of stdin if there is none. */
+  [[nodiscard]] CommandResult Execute(CommandContext &context) override;
+
+  /** Reads and writes LineChannels when the executor provides them. */
+  [[nodiscard]] bool SupportsLineChannels() const override { return true; }
+
+  /** Coroutine body behind Execute(), also run by cooperative pipelines. */
+  [[nodiscard]] StageTask
+  ExecuteCooperative(CooperativeContext &context) override;
+
+private:
+  std::vector<std::string> args_;
+};
+
+} // namespace cppshell
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "cppshell/utf8_validator.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace cppshell {
+
+/** What wc counts. */
+struct WcCounts {
+  size_t lines = 0;
+  size_t words = 0;
+  /** Characters: bytes other than UTF-8 continuation bytes. */
+  size_t chars = 0;
+  size_t bytes = 0;
+  /** Width of the widest line, as -L measures it. */
+  size_t maxLineLength = 0;
+  /**
+   * Offset of the first byte at which UTF-8 decoding fails, or the size
+   * if the input ends inside a character. Only looked for on request.
+   */
+  std::optional<size_t> invalidUtf8;
+};
+
+/** Which counts a WordCounter keeps; the others stay 0 (bytes never do). */
+struct WcFields {
+  bool lines = true;
+  bool words = true;
+  bool chars = false;
+  bool maxLineLength = false;
+  /** Whether to look for invalidUtf8. */
+  bool validateUtf8 = false;
+};
+
+/**
+ * Counts the newlines, words, characters and bytes of a stream given
+ * piece by piece; a word may span pieces. A word is a run of bytes that
+ * are not whitespace as the C locale's std::isspace has it (space, '\t',
+ * '\n', '\v', '\f', '\r').
+ *
+ * Pieces are classified 64 bytes at a time into whitespace, newline and
+ * continuation byte bit masks (with SSE2 where available). Word starts
+ * are the non-space bits after a space bit, so a window costs a few
+ * popcounts and no branch per byte. When only lines are asked for, only
+ * newlines are classified. The width of lines is measured byte by byte:
+ * a tab moves to the next multiple of 8, '\n', '\r' and '\f' start a new
+ * line, and every other printable character, ASCII or not, is 1 wide.
+ * UTF-8 is validated in the same windows, by Utf8Validator.
+ */
+class WordCounter {
+public:
+  explicit WordCounter(WcFields fields = {});
+
+  /** Counts `data`, which follows what was counted before. */
+  void Add(std::string_view data);
+
+  /**
+   * Adds what `next` counted, starting afresh, of the bytes that follow
+   * these, as if they had been added here: a word the boundary cuts is
+   * counted once. Line widths and UTF-8 cut between counters cannot be
+   * joined, so neither counter may keep maxLineLength or validate.
+   */
+  void Append(const WordCounter &next);
+
+  /** The counts of everything added so far. */
+  [[nodiscard]] WcCounts Counts() const;
+
+private:
+  void AddWindows(std::string_view data, size_t offset);
+  void ValidateBytes(std::string_view data, size_t offset);
+  void AddNewlines(std::string_view data);
+  void MeasureLines(std::string_view data);
+
+  WcFields fields_;
+  WcCounts counts_;
+  size_t continuation_ = 0;
+  bool inWord_ = false;
+  // Whether the first byte added is part of a word, for Append().
+  bool startsInWord_ = false;
+  // Width of the line so far, for -L.
+  size_t linePosition_ = 0;
+  Utf8Validator utf8_;
+};
+
+} // namespace cppshell
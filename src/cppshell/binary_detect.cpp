@@ -0,0 +1,61 @@
+#include "cppshell/binary_detect.hpp"
+
+#include "cppshell/utf8_validator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Bytes judged at once; bit i of a mask stands for byte i. */
+constexpr size_t kWindow = 64;
+
+#ifdef __SSE2__
+[[nodiscard]] uint64_t Nuls(const char *p) {
+  uint64_t mask = 0;
+  for (size_t k = 0; k < kWindow / 16; ++k) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * k));
+    mask |= static_cast<uint64_t>(static_cast<uint16_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()))))
+            << (16 * k);
+  }
+  return mask;
+}
+#else
+[[nodiscard]] uint64_t Nuls(const char *p) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kWindow; ++i) {
+    mask |= static_cast<uint64_t>(p[i] == 0) << i;
+  }
+  return mask;
+}
+#endif
+
+} // namespace
+
+bool LooksBinary(std::string_view data) {
+  Utf8Validator validator;
+  size_t i = 0;
+  for (; i + kWindow <= data.size(); i += kWindow) {
+    const char *p = data.data() + i;
+    if (Nuls(p) != 0 || validator.NextWindow(p) != 0) {
+      return true;
+    }
+  }
+  for (; i < data.size(); ++i) {
+    const auto c = static_cast<unsigned char>(data[i]);
+    if (c == 0 || !validator.NextByte(c)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace cppshell
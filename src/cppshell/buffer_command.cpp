@@ -0,0 +1,402 @@
+#include "cppshell/buffer_command.hpp"
+#include "CLI/CLI.hpp"
+#include "cppshell/cooperative.hpp"
+#include "cppshell/line_channel.hpp"
+#include "cppshell/spill_queue.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+namespace cppshell {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kDefaultMemoryLimit = 16 * 1024 * 1024;
+constexpr size_t kDefaultDiskLimit = 1024 * 1024 * 1024;
+
+/** Largest block handed downstream at once. */
+constexpr size_t kBlockSize = 64 * 1024;
+
+struct BufferOptions {
+  size_t memoryLimit = kDefaultMemoryLimit;
+  size_t diskLimit = kDefaultDiskLimit;
+  bool stats = false;
+};
+
+struct BufferStats {
+  size_t bytes = 0;
+  /** Time the producer could not hand over input because both were full. */
+  Clock::duration producerStalled{};
+  /** Time the consumer could have taken output but none was buffered. */
+  Clock::duration consumerIdle{};
+};
+
+/** Parses a byte count such as 4096, 64K, 16M or 1G (powers of 1024). */
+[[nodiscard]] std::optional<size_t> ParseSize(const std::string &text) {
+  if (text.empty() || std::isdigit(static_cast<unsigned char>(text[0])) == 0) {
+    return std::nullopt;
+  }
+  size_t end = 0;
+  unsigned long long value = 0;
+  try {
+    value = std::stoull(text, &end);
+  } catch (...) {
+    return std::nullopt;
+  }
+
+  int shift = 0;
+  const std::string suffix = text.substr(end);
+  if (suffix == "K" || suffix == "k") {
+    shift = 10;
+  } else if (suffix == "M" || suffix == "m") {
+    shift = 20;
+  } else if (suffix == "G" || suffix == "g") {
+    shift = 30;
+  } else if (!suffix.empty()) {
+    return std::nullopt;
+  }
+  if (value > (SIZE_MAX >> shift)) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(value) << shift;
+}
+
+/**
+ * Parses the command line into `options`. Returns the command's result if
+ * it must stop right away (help or a usage error).
+ */
+[[nodiscard]] std::optional<CommandResult>
+ParseOptions(const std::vector<std::string> &args, CommandContext &context,
+             BufferOptions &options) {
+  std::vector<std::string> argv;
+  argv.reserve(args.size() + 1);
+  argv.push_back("buffer");
+  argv.insert(argv.end(), args.begin(), args.end());
+  std::vector<char *> c_argv;
+  c_argv.reserve(argv.size());
+  std::transform(
+      argv.begin(), argv.end(), std::back_inserter(c_argv),
+      [](const std::string &s) { return const_cast<char *>(s.data()); });
+
+  CLI::App app{"buffer utility"};
+  std::string memory;
+  std::string disk;
+  app.add_option("-m,--memory", memory, "Memory limit");
+  app.add_option("-d,--disk", disk, "Spill file limit");
+  app.add_flag("--stats", options.stats, "Print usage statistics");
+
+  try {
+    app.parse(static_cast<int>(c_argv.size()), c_argv.data());
+  } catch (const CLI::ParseError &e) {
+    std::stringstream ss;
+    const int exitCode = app.exit(e, ss, ss);
+    if (e.get_name() == "CallForHelp") {
+      context.streams.out << ss.str();
+    } else {
+      context.streams.err << ss.str();
+    }
+    return CommandResult{exitCode};
+  }
+
+  for (const auto &[text, limit] :
+       {std::pair{&memory, &options.memoryLimit},
+        std::pair{&disk, &options.diskLimit}}) {
+    if (text->empty()) {
+      continue;
+    }
+    const std::optional<size_t> size = ParseSize(*text);
+    if (!size.has_value()) {
+      context.streams.err << "buffer: invalid size: " << *text << '\n';
+      return CommandResult{2};
+    }
+    *limit = *size;
+  }
+  if (options.memoryLimit == 0) {
+    context.streams.err << "buffer: memory limit must be positive\n";
+    return CommandResult{2};
+  }
+  return std::nullopt;
+}
+
+/**
+ * Calls `f` with each run of adjacent lines of `chunk` as one view. Stops
+ * and returns false as soon as `f` does.
+ */
+template <typename F> bool ForEachRun(const LineChunk &chunk, F f) {
+  const std::string_view data(*chunk.data);
+  size_t i = 0;
+  while (i < chunk.lines.size()) {
+    const size_t begin = chunk.lines[i].offset;
+    size_t end = begin + chunk.lines[i].size;
+    for (++i; i < chunk.lines.size() && chunk.lines[i].offset == end; ++i) {
+      end += chunk.lines[i].size;
+    }
+    if (!f(data.substr(begin, end - begin))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Writes buffered bytes downstream. A LineChannel carries whole lines, so
+ * there a trailing partial line waits for the rest of it.
+ */
+class Emitter {
+public:
+  explicit Emitter(CommandContext &context)
+      : context_(context), sink_(context) {}
+
+  void Write(std::string_view bytes) {
+    if (context_.outChannel == nullptr) {
+      context_.streams.out.write(bytes.data(),
+                                 static_cast<std::streamsize>(bytes.size()));
+      return;
+    }
+    size_t nl = bytes.find('\n');
+    if (!partial_.empty()) {
+      if (nl == std::string_view::npos) {
+        partial_.append(bytes);
+        return;
+      }
+      partial_.append(bytes.substr(0, nl));
+      sink_.WriteLine(partial_);
+      partial_.clear();
+      bytes.remove_prefix(nl + 1);
+      nl = bytes.find('\n');
+    }
+    while (nl != std::string_view::npos) {
+      sink_.WriteLine(bytes.substr(0, nl));
+      bytes.remove_prefix(nl + 1);
+      nl = bytes.find('\n');
+    }
+    partial_.assign(bytes);
+  }
+
+  /** Publishes everything written; at the end also a final partial line. */
+  void Flush(bool last) {
+    if (context_.outChannel == nullptr) {
+      context_.streams.out.flush();
+      return;
+    }
+    if (last && !partial_.empty()) {
+      sink_.WriteLastLine(partial_);
+      partial_.clear();
+    }
+    sink_.Flush();
+  }
+
+  /** Returns true once nothing more can be written. */
+  [[nodiscard]] bool Broken() const {
+    return context_.outChannel == nullptr ? !context_.streams.out
+                                          : sink_.Broken();
+  }
+
+private:
+  CommandContext &context_;
+  LineSink sink_;
+  std::string partial_;
+};
+
+/** Reports a spill failure or the --stats summary; returns the exit code. */
+int Finish(CommandContext &context, const BufferOptions &options,
+           const SpillQueue &queue, const BufferStats &stats) {
+  if (options.stats) {
+    const auto seconds = [](Clock::duration d) {
+      return std::chrono::duration<double>(d).count();
+    };
+    std::ostringstream line;
+    line << "buffer: " << stats.bytes << " bytes, peak memory "
+         << queue.PeakMemory() << ", peak disk " << queue.PeakDisk()
+         << std::fixed << std::setprecision(3) << ", producer stalled "
+         << seconds(stats.producerStalled) << " s, consumer idle "
+         << seconds(stats.consumerIdle) << " s\n";
+    context.streams.err << line.str();
+  }
+  if (!queue.Error().empty()) {
+    context.streams.err << "buffer: " << queue.Error() << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
+
+BufferCommand::BufferCommand(std::vector<std::string> args)
+    : args_(std::move(args)) {}
+
+CommandResult BufferCommand::Execute(CommandContext &context) {
+  BufferOptions options;
+  if (const auto done = ParseOptions(args_, context, options)) {
+    return *done;
+  }
+
+  SpillQueue queue(options.memoryLimit, options.diskLimit);
+  BufferStats stats;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool inputDone = false;
+  bool stop = false;
+
+  // Drains the input as fast as the producer delivers it.
+  std::thread reader([&] {
+    LineSource source(context);
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    auto append = [&](std::string_view run) {
+      lock.lock();
+      while (!run.empty() && !stop && queue.Error().empty()) {
+        if (queue.Room() == 0) {
+          const Clock::time_point start = Clock::now();
+          changed.wait(lock, [&] { return queue.Room() != 0 || stop; });
+          stats.producerStalled += Clock::now() - start;
+          continue;
+        }
+        const size_t n = queue.Append(run);
+        run.remove_prefix(n);
+        stats.bytes += n;
+        changed.notify_all();
+      }
+      const bool more = !stop && queue.Error().empty();
+      lock.unlock();
+      return more;
+    };
+    while (const auto chunk = source.Next()) {
+      if (!ForEachRun(*chunk, append)) {
+        break;
+      }
+    }
+    lock.lock();
+    inputDone = true;
+    changed.notify_all();
+  });
+
+  Emitter emitter(context);
+  std::string block;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (queue.Error().empty()) {
+    if (queue.Empty()) {
+      if (inputDone) {
+        break;
+      }
+      // Nothing buffered: let the consumer have everything so far.
+      lock.unlock();
+      emitter.Flush(false);
+      lock.lock();
+      const Clock::time_point start = Clock::now();
+      changed.wait(lock, [&] { return !queue.Empty() || inputDone; });
+      stats.consumerIdle += Clock::now() - start;
+      continue;
+    }
+
+    block.clear();
+    static_cast<void>(queue.Take(block, kBlockSize));
+    changed.notify_all();
+    lock.unlock();
+    emitter.Write(block);
+    const bool broken = emitter.Broken();
+    lock.lock();
+    if (broken) {
+      break;
+    }
+  }
+  const bool early = !inputDone;
+  stop = true;
+  changed.notify_all();
+  lock.unlock();
+
+  // Unblock a producer still pushing into a channel nobody will read.
+  if (early && context.inChannel != nullptr) {
+    context.inChannel->CloseReader();
+  }
+  reader.join();
+  emitter.Flush(true);
+  return {Finish(context, options, queue, stats)};
+}
+
+StageTask BufferCommand::ExecuteCooperative(CooperativeContext &cooperative) {
+  CommandContext &context = cooperative.Context();
+  if (!cooperative.Cooperative()) {
+    co_return Execute(context);
+  }
+
+  BufferOptions options;
+  if (const auto done = ParseOptions(args_, context, options)) {
+    co_return *done;
+  }
+
+  // The neighbours share this thread, so rather than blocking, take input
+  // and hand on output whenever the other side is ready (await_ready()
+  // tells without suspending) and only suspend when neither is.
+  SpillQueue queue(options.memoryLimit, options.diskLimit);
+  BufferStats stats;
+  LineSource source(context);
+  Emitter emitter(context);
+  std::string pending; // Input not yet accepted by the queue.
+  std::string block;
+  bool inputDone = false;
+
+  while (queue.Error().empty()) {
+    if (!queue.Empty() && cooperative.OutputSpace().await_ready()) {
+      block.clear();
+      static_cast<void>(queue.Take(block, kBlockSize));
+      emitter.Write(block);
+      emitter.Flush(false);
+      if (emitter.Broken()) {
+        break;
+      }
+      continue;
+    }
+    if (!pending.empty() && queue.Room() != 0) {
+      const size_t n = queue.Append(pending);
+      pending.erase(0, n);
+      stats.bytes += n;
+      continue;
+    }
+    if (pending.empty() && !inputDone &&
+        cooperative.InputReady().await_ready()) {
+      const auto chunk = source.Next();
+      if (chunk == nullptr) {
+        inputDone = true;
+      } else {
+        ForEachRun(*chunk, [&](std::string_view run) {
+          pending.append(run);
+          return true;
+        });
+      }
+      continue;
+    }
+    if (inputDone && pending.empty() && queue.Empty()) {
+      break;
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (pending.empty() && !inputDone) {
+      co_await cooperative.InputReady();
+      if (queue.Empty()) {
+        stats.consumerIdle += Clock::now() - start;
+      }
+    } else {
+      co_await cooperative.OutputSpace();
+      if (!pending.empty()) {
+        stats.producerStalled += Clock::now() - start;
+      }
+    }
+  }
+
+  emitter.Flush(true);
+  co_return {Finish(context, options, queue, stats)};
+}
+
+} // namespace cppshell
@@ -1,49 +1,181 @@
 #include "cppshell/builtins.hpp"
 
-#include <cctype>
+#include "cppshell/cooperative.hpp"
+#include "cppshell/fd_stream.hpp"
+#include "cppshell/file_copy.hpp"
+#include "cppshell/line_channel.hpp"
+#include "cppshell/word_count.hpp"
+
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
-#include <iterator>
+#include <iostream>
 #include <map>
 #include <sstream>
+#include <streambuf>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace cppshell {
 
 namespace {
 
-struct WcStats {
-  size_t lines = 0;
-  size_t words = 0;
-  size_t bytes = 0;
-};
+/** Bytes cat copies at once when it goes through streams. */
+constexpr size_t kCatBufferSize = 1024 * 1024;
+
+/**
+ * Copies `in` to `out` through a buffer. Unlike `out << in.rdbuf()`, an
+ * empty `in` does not set failbit on `out`, which would drop every later
+ * file.
+ */
+void CopyStream(std::istream &in, std::ostream &out) {
+  thread_local std::vector<char> buffer(kCatBufferSize);
+  std::streambuf *source = in.rdbuf();
+  while (true) {
+    const std::streamsize got = source->sgetn(
+        buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (got <= 0) {
+      break;
+    }
+    out.write(buffer.data(), got);
+  }
+}
 
-[[nodiscard]] WcStats CountStream(std::istream &in) {
-  WcStats s;
-  bool inWord = false;
-
-  std::istreambuf_iterator<char> it(in);
-  const std::istreambuf_iterator<char> end;
-  for (; it != end; ++it) {
-    unsigned char uch = static_cast<unsigned char>(*it);
-    ++s.bytes;
-    if (uch == '\n') {
-      ++s.lines;
+/** What became of a copy that cat tried to make between descriptors. */
+enum class DirectCopy { NotDescriptors, Copied, CannotOpen, InputIsOutput };
+
+/**
+ * Copies `in` to `out` with CopyToFd() if both are descriptors. Returns
+ * NotDescriptors, having copied nothing, if either is not. Standard input
+ * is left to the stream, which may have buffered it.
+ */
+[[nodiscard]] DirectCopy CopyDirect(std::istream &in, std::ostream &out) {
+#ifndef _WIN32
+  const int inFd = &in == &std::cin ? -1 : DirectInputFd(in);
+  const int outFd =
+      inFd < 0 ? -1 : DirectOutputFd(out, std::cout, STDOUT_FILENO);
+  if (outFd >= 0) {
+    if (InputIsOutput(inFd, outFd)) {
+      return DirectCopy::InputIsOutput;
     }
+    static_cast<void>(CopyToFd(inFd, outFd));
+    return DirectCopy::Copied;
+  }
+#endif
+  return DirectCopy::NotDescriptors;
+}
 
-    const bool ws = (std::isspace(uch) != 0);
-    if (ws) {
-      inWord = false;
-    } else {
-      if (!inWord) {
-        ++s.words;
-        inWord = true;
+/**
+ * Copies `file` to `out` with CopyToFd() if `out` is a descriptor.
+ * Returns NotDescriptors if it is not, so the file must be streamed.
+ */
+[[nodiscard]] DirectCopy CopyFileDirect(const std::string &file,
+                                        std::ostream &out) {
+#ifndef _WIN32
+  const int outFd = DirectOutputFd(out, std::cout, STDOUT_FILENO);
+  if (outFd < 0) {
+    return DirectCopy::NotDescriptors;
+  }
+  const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return DirectCopy::CannotOpen;
+  }
+  DirectCopy result = DirectCopy::InputIsOutput;
+  if (!InputIsOutput(fd, outFd)) {
+    // Write errors, such as a closed pipe, stop output as they did when
+    // the file was streamed: quietly.
+    static_cast<void>(CopyToFd(fd, outFd));
+    result = DirectCopy::Copied;
+  }
+  ::close(fd);
+  return result;
+#else
+  static_cast<void>(file);
+  static_cast<void>(out);
+  return DirectCopy::NotDescriptors;
+#endif
+}
+
+[[nodiscard]] std::string FormatStats(const WcCounts &s) {
+  return std::to_string(s.lines) + ' ' + std::to_string(s.words) + ' ' +
+         std::to_string(s.bytes);
+}
+
+/** Output buffer that keeps wc statistics instead of storing bytes. */
+class CountingBuffer final : public std::streambuf {
+public:
+  [[nodiscard]] WcCounts Stats() const { return counter_.Counts(); }
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      const char c = traits_type::to_char_type(ch);
+      counter_.Add(std::string_view(&c, 1));
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    counter_.Add(std::string_view(s, static_cast<size_t>(n)));
+    return n;
+  }
+
+private:
+  WordCounter counter_;
+};
+
+/**
+ * Forwards the lines of consecutive inputs to a LineSink as one stream: a
+ * last line without '\n' is joined with the first line of the next input,
+ * exactly as concatenating the bytes would.
+ */
+class ConcatenatingForwarder {
+public:
+  explicit ConcatenatingForwarder(LineSink &sink) : sink_(sink) {}
+
+  void Add(const std::shared_ptr<const LineChunk> &chunk) {
+    size_t first = 0;
+    size_t last = chunk->lines.size();
+    if (!partial_.empty() && last != 0) {
+      partial_.append(chunk->Line(0));
+      first = 1;
+      if (partial_.back() != '\n') {
+        return; // A single unterminated line: keep accumulating.
       }
+      partial_.pop_back();
+      sink_.WriteLine(partial_);
+      partial_.clear();
+    }
+
+    if (last > first && chunk->Line(last - 1).back() != '\n') {
+      partial_.assign(chunk->Line(last - 1));
+      --last;
+    }
+
+    if (first == 0 && last == chunk->lines.size()) {
+      sink_.Forward(chunk);
+      return;
+    }
+    for (size_t i = first; i < last; ++i) {
+      sink_.Forward(chunk, i);
     }
   }
 
-  return s;
-}
+  void Finish() {
+    if (!partial_.empty()) {
+      sink_.WriteLastLine(partial_);
+      partial_.clear();
+    }
+  }
+
+private:
+  LineSink &sink_;
+  std::string partial_;
+};
 
 } // namespace
 
@@ -51,16 +183,22 @@ EchoCommand::EchoCommand(std::vector<std::string> args)
     : args_(std::move(args)) {}
 
 CommandResult EchoCommand::Execute(CommandContext &context) {
+  return RunInline(*this, context);
+}
+
+StageTask EchoCommand::ExecuteCooperative(CooperativeContext &context) {
+  std::string line;
   for (size_t i = 0; i < args_.size(); ++i) {
     if (i != 0) {
-      context.streams.out << ' ';
+      line.push_back(' ');
     }
-    context.streams.out << args_[i];
+    line += args_[i];
   }
-  context.streams.out << '\n';
+  LineSink sink(context.Context());
+  sink.WriteLine(line);
   CommandResult r;
   r.exitCode = 0;
-  return r;
+  co_return r;
 }
 
 PwdCommand::PwdCommand(std::vector<std::string> args)
@@ -93,62 +231,118 @@ CatCommand::CatCommand(std::vector<std::string> args)
     : args_(std::move(args)) {}
 
 CommandResult CatCommand::Execute(CommandContext &context) {
+  return RunInline(*this, context);
+}
+
+StageTask CatCommand::ExecuteCooperative(CooperativeContext &cooperative) {
+  CommandContext &context = cooperative.Context();
   int exitCode = 0;
 
   if (args_.empty()) {
-    context.streams.out << context.streams.in.rdbuf();
+    if (context.inChannel == nullptr && context.outChannel == nullptr) {
+      switch (CopyDirect(context.streams.in, context.streams.out)) {
+      case DirectCopy::NotDescriptors:
+        CopyStream(context.streams.in, context.streams.out);
+        break;
+      case DirectCopy::InputIsOutput:
+        context.streams.err << "cat: -: input file is output file\n";
+        exitCode = 1;
+        break;
+      case DirectCopy::Copied:
+      case DirectCopy::CannotOpen:
+        break;
+      }
+    } else {
+      // Lines arrive already split: pass the chunks through untouched.
+      LineSource source(context);
+      LineSink sink(context);
+      while (true) {
+        co_await cooperative.InputReady();
+        const auto chunk = source.Next();
+        if (chunk == nullptr) {
+          break;
+        }
+        sink.Forward(chunk);
+        if (sink.Broken()) {
+          break;
+        }
+        co_await cooperative.OutputSpace();
+      }
+    }
     CommandResult r;
-    r.exitCode = 0;
-    return r;
+    r.exitCode = exitCode;
+    co_return r;
   }
 
+  LineSink sink(context);
+  ConcatenatingForwarder forwarder(sink);
   for (const auto &file : args_) {
+    if (context.outChannel == nullptr) {
+      const DirectCopy copy = CopyFileDirect(file, context.streams.out);
+      if (copy == DirectCopy::CannotOpen) {
+        context.streams.err << "cat: cannot open file: " << file << "\n";
+        exitCode = 1;
+      } else if (copy == DirectCopy::InputIsOutput) {
+        context.streams.err << "cat: " << file
+                            << ": input file is output file\n";
+        exitCode = 1;
+      }
+      if (copy != DirectCopy::NotDescriptors) {
+        continue;
+      }
+    }
     std::ifstream in(file, std::ios::binary);
     if (!in) {
       context.streams.err << "cat: cannot open file: " << file << "\n";
       exitCode = 1;
       continue;
     }
-    context.streams.out << in.rdbuf();
+    if (context.outChannel == nullptr) {
+      CopyStream(in, context.streams.out);
+      continue;
+    }
+    LineSource source(in);
+    while (const auto chunk = source.Next()) {
+      forwarder.Add(chunk);
+      sink.Flush();
+      if (sink.Broken()) {
+        break;
+      }
+      co_await cooperative.OutputSpace();
+    }
   }
+  forwarder.Finish();
 
   CommandResult r;
   r.exitCode = exitCode;
-  return r;
+  co_return r;
 }
 
-WcCommand::WcCommand(std::vector<std::string> args) : args_(std::move(args)) {}
-
-CommandResult WcCommand::Execute(CommandContext &context) {
-  if (args_.empty()) {
-    const WcStats s = CountStream(context.streams.in);
-    context.streams.out << s.lines << ' ' << s.words << ' ' << s.bytes << '\n';
-    CommandResult r;
-    r.exitCode = 0;
-    return r;
-  }
-
-  if (args_.size() != 1) {
-    context.streams.err << "wc: expected exactly one file argument\n";
-    CommandResult r;
-    r.exitCode = 2;
-    return r;
-  }
+CountOutputCommand::CountOutputCommand(std::unique_ptr<ICommand> command)
+    : command_(std::move(command)) {}
 
-  const std::string &file = args_.front();
-  std::ifstream in(file, std::ios::binary);
-  if (!in) {
-    context.streams.err << "wc: cannot open file: " << file << "\n";
-    CommandResult r;
-    r.exitCode = 1;
-    return r;
-  }
+CommandResult CountOutputCommand::Execute(CommandContext &context) {
+  return RunInline(*this, context);
+}
 
-  const WcStats s = CountStream(in);
-  context.streams.out << s.lines << ' ' << s.words << ' ' << s.bytes << '\n';
+StageTask
+CountOutputCommand::ExecuteCooperative(CooperativeContext &cooperative) {
+  CommandContext &context = cooperative.Context();
+  CountingBuffer counter;
+  std::ostream counted(&counter);
+  CommandContext inner{
+      CommandStreams{context.streams.in, counted, context.streams.err},
+      context.env};
+  inner.inChannel = context.inChannel;
+  CooperativeContext innerCooperative(inner);
+  // The exit status is that of the fused `wc`, not of the wrapped command.
+  static_cast<void>(co_await command_->ExecuteCooperative(innerCooperative));
+
+  LineSink sink(context);
+  sink.WriteLine(FormatStats(counter.Stats()));
   CommandResult r;
   r.exitCode = 0;
-  return r;
+  co_return r;
 }
 
 ExitCommand::ExitCommand(std::vector<std::string> args)
@@ -209,8 +403,19 @@ const std::map<std::string, BuiltinInfo> &GetBuiltinsInfo() {
         "Concatenate FILE(s) to standard output.\n"
         "With no FILE, or when FILE is -, read standard input."}},
       {"wc",
-       {"wc [FILE]", "Print newline, word, and byte counts for each FILE.\n"
-                     "With no FILE, or when FILE is -, read standard input."}},
+       {"wc [OPTIONS] [FILE]...",
+        "Print newline, word, and byte counts for each FILE, and a total\n"
+        "line if more than one FILE is given.\n"
+        "With no FILE, or when FILE is -, read standard input.\n"
+        "Options:\n"
+        "  -l, --lines          print the newline counts\n"
+        "  -w, --words          print the word counts\n"
+        "  -m, --chars          print the character counts (UTF-8)\n"
+        "  -c, --bytes          print the byte counts\n"
+        "  -L, --max-line-length\n"
+        "                       print the width of the longest line\n"
+        "      --validate-utf8  report where input that is not UTF-8 first\n"
+        "                       breaks, and exit with status 1"}},
       {"exit",
        {"exit [n]",
         "Exit the shell with a status of N.  If N is omitted, the exit "
@@ -219,15 +424,61 @@ const std::map<std::string, BuiltinInfo> &GetBuiltinsInfo() {
        {"grep [OPTIONS] PATTERN [FILE]...",
         "Search for PATTERN in each FILE or standard input.\n"
         "Options:\n"
+        "  -e, --regexp=PATTERN use PATTERN; may be repeated, and then no\n"
+        "                       PATTERN operand is given\n"
+        "  -f, --file=FILE      take patterns from FILE, one per line\n"
         "  -i, --ignore-case    ignore case distinctions\n"
         "  -w, --word-regexp    force PATTERN to match only whole words\n"
+        "  -F, --fixed-strings  PATTERN is a plain string, not a regex\n"
+        "  -v, --invert-match   select non-matching lines\n"
+        "  -n, --line-number    prefix each line with its line number\n"
+        "  -c, --count          print only the number of selected lines\n"
+        "  -l, --files-with-matches\n"
+        "                       print only names of FILEs with selected lines\n"
+        "  -L, --files-without-match\n"
+        "                       print only names of FILEs without them\n"
+        "  -q, --quiet          print nothing, exit at the first match\n"
+        "  -m, --max-count=NUM  stop reading a FILE after NUM selected lines\n"
         "  -A, --after-context=NUM\n"
         "                       print NUM lines of trailing context\n"
+        "  -B, --before-context=NUM\n"
+        "                       print NUM lines of leading context\n"
+        "  -C, --context=NUM    print NUM lines of context on both sides\n"
+        "  --binary-files=TYPE  treat binary FILEs as TYPE: binary (say\n"
+        "                       that they match), text or without-match\n"
+        "  -a, --text           same as --binary-files=text\n"
+        "  -I                   same as --binary-files=without-match\n"
+        "  -r, --recursive      search the files under each directory FILE\n"
+        "                       (the current one if there is none)\n"
+        "  -R, --dereference-recursive\n"
+        "                       likewise, following all symbolic links\n"
+        "  --include=GLOB       search only files whose name matches GLOB\n"
+        "  --exclude=GLOB       skip files whose name matches GLOB\n"
+        "  --exclude-dir=GLOB   skip directories whose name matches GLOB\n"
+        "  --ignore-file=NAME   obey gitignore-style rules in files NAME\n"
+        "  --sort=ORDER         order of files found: none (default) or path\n"
+        "  --index-build=DIR    write a trigram index of the files under DIR\n"
+        "                       (no PATTERN); run again to update it\n"
+        "  --index=DIR          search the files under DIR, skipping those\n"
+        "                       its index shows cannot match\n"
+        "  --cache-stats        report the compiled pattern cache on stderr\n"
         "Examples of PATTERN (ECMAScript syntax):\n"
         "  ^Error               lines starting with 'Error'\n"
         "  [0-9]+               lines containing one or more digits\n"
         "  (cpp|hpp)$           lines ending in .cpp or .hpp\n"
         "  \\bword\\b             lines containing 'word' as a whole word"}},
+      {"buffer",
+       {"buffer [OPTIONS]",
+        "Copy standard input to standard output, reading ahead of the\n"
+        "consumer.  Input is held in memory and, past the memory limit, in\n"
+        "a temporary file, so the producer is not slowed down by the\n"
+        "consumer until both limits are reached.\n"
+        "Options:\n"
+        "  -m, --memory=SIZE    memory limit (default 16M)\n"
+        "  -d, --disk=SIZE      temporary file limit, 0 disables it "
+        "(default 1G)\n"
+        "  --stats              print peak usage and stall times to stderr\n"
+        "SIZE is a number of bytes, optionally followed by K, M or G."}},
       {"help",
        {"help [pattern ...]",
         "Display information about builtin commands.\n"
@@ -1,8 +1,10 @@
 #include "cppshell/command.hpp"
 
+#include "cppshell/buffer_command.hpp"
 #include "cppshell/builtins.hpp"
 #include "cppshell/external_command.hpp"
 #include "cppshell/grep_command.hpp"
+#include "cppshell/wc_command.hpp"
 
 namespace cppshell {
 
@@ -31,8 +33,28 @@ CommandFactory::Create(const std::string &name,
   if (name == "help") {
     return std::make_unique<HelpCommand>(args);
   }
+  if (name == "buffer") {
+    return std::make_unique<BufferCommand>(args);
+  }
 
   return std::make_unique<ExternalCommand>(name, args, envForCommand);
 }
 
+std::unique_ptr<ICommand>
+CommandFactory::Create(const Command &command,
+                       const Environment &envForCommand) const {
+  std::unique_ptr<ICommand> cmd =
+      Create(command.command, command.args, envForCommand);
+  if (command.countOutput) {
+    return std::make_unique<CountOutputCommand>(std::move(cmd));
+  }
+  return cmd;
+}
+
+bool CommandFactory::IsBuiltin(const std::string &name) const {
+  return name == "echo" || name == "pwd" || name == "cat" || name == "wc" ||
+         name == "exit" || name == "grep" || name == "help" ||
+         name == "buffer";
+}
+
 } // namespace cppshell
@@ -0,0 +1,160 @@
+#include "cppshell/cooperative.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace cppshell {
+
+StageTask::StageTask(StageTask &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)) {}
+
+StageTask &StageTask::operator=(StageTask &&other) noexcept {
+  if (this != &other) {
+    if (handle_) {
+      handle_.destroy();
+    }
+    handle_ = std::exchange(other.handle_, nullptr);
+  }
+  return *this;
+}
+
+StageTask::~StageTask() {
+  if (handle_) {
+    handle_.destroy();
+  }
+}
+
+CommandResult StageTask::Result() const {
+  if (handle_.promise().exception) {
+    std::rethrow_exception(handle_.promise().exception);
+  }
+  return handle_.promise().result;
+}
+
+CommandResult StageTask::Awaiter::await_resume() const {
+  if (handle.promise().exception) {
+    std::rethrow_exception(handle.promise().exception);
+  }
+  return handle.promise().result;
+}
+
+std::coroutine_handle<> CooperativeScheduler::Next() {
+  if (ready_.empty()) {
+    return nullptr;
+  }
+  const std::coroutine_handle<> handle = ready_.front();
+  ready_.pop_front();
+  return handle;
+}
+
+CooperativeLineChannel::CooperativeLineChannel(CooperativeScheduler &scheduler)
+    : scheduler_(scheduler) {}
+
+bool CooperativeLineChannel::Push(std::shared_ptr<const LineChunk> chunk) {
+  if (readerClosed_) {
+    return false;
+  }
+  chunks_.push_back(std::move(chunk));
+  Wake(reader_);
+  return true;
+}
+
+std::shared_ptr<const LineChunk> CooperativeLineChannel::Pop() {
+  if (chunks_.empty()) {
+    if (!closed_) {
+      throw std::logic_error("cooperative channel read before InputReady()");
+    }
+    return nullptr; // EOF
+  }
+  std::shared_ptr<const LineChunk> chunk = std::move(chunks_.front());
+  chunks_.pop_front();
+  if (chunks_.empty()) {
+    Wake(writer_);
+  }
+  return chunk;
+}
+
+void CooperativeLineChannel::Close() {
+  closed_ = true;
+  Wake(reader_);
+}
+
+void CooperativeLineChannel::CloseReader() {
+  readerClosed_ = true;
+  chunks_.clear();
+  Wake(writer_);
+}
+
+void CooperativeLineChannel::Wake(std::coroutine_handle<> &waiter) {
+  if (waiter) {
+    scheduler_.Schedule(std::exchange(waiter, nullptr));
+  }
+}
+
+CooperativeContext::CooperativeContext(CommandContext &context)
+    : context_(context),
+      in_(dynamic_cast<CooperativeLineChannel *>(context.inChannel)),
+      out_(dynamic_cast<CooperativeLineChannel *>(context.outChannel)) {}
+
+CommandResult RunInline(ICommand &command, CommandContext &context) {
+  CooperativeContext cooperative(context);
+  const StageTask task = command.ExecuteCooperative(cooperative);
+  // Without cooperative channels nothing ever waits, so a single resume
+  // runs the whole body.
+  task.GetHandle().resume();
+  if (!task.Done()) {
+    throw std::logic_error("command suspended outside a cooperative pipeline");
+  }
+  return task.Result();
+}
+
+StageTask ICommand::ExecuteCooperative(CooperativeContext &context) {
+  CommandContext &ctx = context.Context();
+  if (ctx.inChannel == nullptr && ctx.outChannel == nullptr) {
+    co_return Execute(ctx);
+  }
+
+  // Execute() cannot yield: hand it all of its input at once.
+  std::istringstream in;
+  if (ctx.inChannel != nullptr) {
+    std::string input;
+    LineSource source(ctx);
+    while (true) {
+      co_await context.InputReady();
+      const auto chunk = source.Next();
+      if (chunk == nullptr) {
+        break;
+      }
+      for (size_t i = 0; i < chunk->lines.size(); ++i) {
+        input.append(chunk->Line(i));
+      }
+    }
+    in.str(std::move(input));
+  }
+
+  std::ostringstream out;
+  CommandContext inner{
+      CommandStreams{ctx.inChannel != nullptr ? in : ctx.streams.in,
+                     ctx.outChannel != nullptr ? out : ctx.streams.out,
+                     ctx.streams.err},
+      ctx.env};
+  const CommandResult result = Execute(inner);
+
+  if (ctx.outChannel != nullptr) {
+    std::istringstream produced(std::move(out).str());
+    LineSource source(produced);
+    LineSink sink(ctx);
+    while (const auto chunk = source.Next()) {
+      sink.Forward(chunk);
+      if (sink.Broken()) {
+        break;
+      }
+      co_await context.OutputSpace();
+    }
+  }
+  co_return result;
+}
+
+} // namespace cppshell
@@ -0,0 +1,224 @@
+#include "cppshell/cpu_placement.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+constexpr const char *kPlacementVariable = "CPPSHELL_PLACEMENT";
+
+/** First line of a sysfs attribute, empty if it cannot be read. */
+[[nodiscard]] std::string ReadAttribute(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+/** Parses a CPU list such as "0-3,8,10-11". Malformed parts are skipped. */
+[[nodiscard]] std::vector<int> ParseCpuList(const std::string &text) {
+  std::vector<int> cpus;
+  std::stringstream ss(text);
+  std::string part;
+  while (std::getline(ss, part, ',')) {
+    try {
+      const size_t dash = part.find('-');
+      const int first = std::stoi(part.substr(0, dash));
+      const int last =
+          dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (...) {
+      // Skip parts that are not numbers.
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+/** Position of `value` among the distinct values of `set`. */
+[[nodiscard]] int Rank(const std::set<int> &set, int value) {
+  return static_cast<int>(std::distance(set.begin(), set.find(value)));
+}
+
+#ifdef __linux__
+std::mutex gSavedMutex;
+/** Affinity of the first thread pinned by this process, before pinning. */
+std::optional<cpu_set_t> gSavedAffinity;
+#endif
+
+} // namespace
+
+PlacementPolicy PlacementFromEnv(const Environment &env) {
+  const std::string value = env.Get(kPlacementVariable);
+  if (value == "compact") {
+    return PlacementPolicy::kCompact;
+  }
+  if (value == "spread") {
+    return PlacementPolicy::kSpread;
+  }
+  return PlacementPolicy::kOs;
+}
+
+CpuTopology ReadCpuTopology(const std::filesystem::path &root,
+                            const std::vector<int> &allowed) {
+  CpuTopology topology;
+  std::vector<int> ids = allowed;
+  std::sort(ids.begin(), ids.end());
+  for (int id : ids) {
+    const std::filesystem::path dir = root / ("cpu" + std::to_string(id));
+    CpuInfo info;
+    info.id = id;
+
+    std::vector<int> siblings =
+        ParseCpuList(ReadAttribute(dir / "topology" / "thread_siblings_list"));
+    if (std::find(siblings.begin(), siblings.end(), id) == siblings.end()) {
+      siblings = {id};
+    }
+    info.core = siblings.front();
+    info.thread = static_cast<int>(
+        std::find(siblings.begin(), siblings.end(), id) - siblings.begin());
+
+    // Without cache information, the package stands in for the L3.
+    const std::vector<int> package =
+        ParseCpuList(ReadAttribute(dir / "topology" / "core_siblings_list"));
+    info.l2 = info.core;
+    info.l3 = package.empty() ? info.core : package.front();
+
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(dir / "cache", ec)) {
+      if (entry.path().filename().string().rfind("index", 0) != 0 ||
+          ReadAttribute(entry.path() / "type") == "Instruction") {
+        continue;
+      }
+      const std::string level = ReadAttribute(entry.path() / "level");
+      const std::vector<int> shared =
+          ParseCpuList(ReadAttribute(entry.path() / "shared_cpu_list"));
+      if (shared.empty()) {
+        continue;
+      }
+      if (level == "2") {
+        info.l2 = shared.front();
+      } else if (level == "3") {
+        info.l3 = shared.front();
+      }
+    }
+    topology.cpus.push_back(info);
+  }
+  return topology;
+}
+
+const CpuTopology &CurrentCpuTopology() {
+  static const CpuTopology topology = [] {
+    std::vector<int> allowed;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+          allowed.push_back(cpu);
+        }
+      }
+    }
+    return ReadCpuTopology("/sys/devices/system/cpu", allowed);
+#else
+    return CpuTopology{};
+#endif
+  }();
+  return topology;
+}
+
+std::vector<int> PlanPlacement(const CpuTopology &topology,
+                               PlacementPolicy policy, size_t stages) {
+  std::vector<int> plan(stages, -1);
+  const std::vector<CpuInfo> &cpus = topology.cpus;
+  if (policy == PlacementPolicy::kOs || cpus.empty()) {
+    return plan;
+  }
+
+  std::set<int> l3s;
+  std::map<int, std::set<int>> l2sOfL3;
+  std::map<int, std::set<int>> coresOfL2;
+  for (const CpuInfo &cpu : cpus) {
+    l3s.insert(cpu.l3);
+    l2sOfL3[cpu.l3].insert(cpu.l2);
+    coresOfL2[cpu.l2].insert(cpu.core);
+  }
+
+  // Both orders use one hardware thread per core before any SMT sibling.
+  // Compact fills an L3 domain, L2 group by L2 group, before the next one;
+  // spread takes one core from each domain and group in turn.
+  using Key = std::tuple<int, int, int, int, int>;
+  auto key = [&](const CpuInfo &cpu) {
+    const int l3 = Rank(l3s, cpu.l3);
+    const int l2 = Rank(l2sOfL3[cpu.l3], cpu.l2);
+    const int core = Rank(coresOfL2[cpu.l2], cpu.core);
+    return policy == PlacementPolicy::kCompact
+               ? Key{l3, cpu.thread, l2, core, cpu.id}
+               : Key{cpu.thread, core, l2, l3, cpu.id};
+  };
+  std::vector<std::pair<Key, int>> order;
+  order.reserve(cpus.size());
+  for (const CpuInfo &cpu : cpus) {
+    order.emplace_back(key(cpu), cpu.id);
+  }
+  std::sort(order.begin(), order.end());
+
+  for (size_t i = 0; i < stages; ++i) {
+    plan[i] = order[i % order.size()].second;
+  }
+  return plan;
+}
+
+bool PinCurrentThread(int cpu) {
+  if (cpu < 0) {
+    return true;
+  }
+#ifdef __linux__
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(gSavedMutex);
+    cpu_set_t current;
+    if (!gSavedAffinity.has_value() &&
+        sched_getaffinity(0, sizeof(current), &current) == 0) {
+      gSavedAffinity = current;
+    }
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+void UnpinCurrentThread() {
+#ifdef __linux__
+  std::lock_guard<std::mutex> lock(gSavedMutex);
+  if (gSavedAffinity.has_value()) {
+    static_cast<void>(
+        sched_setaffinity(0, sizeof(*gSavedAffinity), &*gSavedAffinity));
+  }
+#endif
+}
+
+} // namespace cppshell
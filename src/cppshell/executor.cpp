@@ -0,0 +1,437 @@
+#include "cppshell/executor.hpp"
+
+#include "cppshell/cooperative.hpp"
+#include "cppshell/cpu_placement.hpp"
+#include "cppshell/fd_stream.hpp"
+#include "cppshell/line_channel.hpp"
+#include "cppshell/pipe.hpp"
+#include "cppshell/redirection.hpp"
+#include "cppshell/shm_transport.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/**
+ * Selects how builtin-only pipelines run: "threads" (a thread per stage) or
+ * "fork" (a process per stage, POSIX only). Anything else means
+ * cooperative coroutines on the calling thread.
+ */
+constexpr const char *kPipelineModeVariable = "CPPSHELL_PIPELINE_MODE";
+
+/**
+ * Set to "pipe" to connect forked stages with plain pipes only. Otherwise,
+ * on Linux, adjacent builtins share a SharedRing and builtins feeding an
+ * external program splice their output into the pipe.
+ */
+constexpr const char *kForkTransportVariable = "CPPSHELL_FORK_TRANSPORT";
+
+/** Returns true if `cmd` redirects one of the given streams itself. */
+[[nodiscard]] bool Redirects(const Command &cmd,
+                             std::initializer_list<RedirectionKind> kinds) {
+  return std::any_of(cmd.redirections.begin(), cmd.redirections.end(),
+                     [&](const Redirection &r) {
+                       return std::find(kinds.begin(), kinds.end(), r.kind) !=
+                              kinds.end();
+                     });
+}
+
+/** Connection between stage `i` and stage `i + 1` of a threaded pipeline. */
+struct Edge {
+  /** Set when both ends exchange lines. */
+  std::unique_ptr<LineChannel> channel;
+  /** Set otherwise: a byte pipe. */
+  std::unique_ptr<Pipe> pipe;
+};
+
+} // namespace
+
+Executor::Executor(const CommandFactory &factory) : factory_(factory) {}
+
+int Executor::RunPipeline(const Pipeline &pipeline, const Environment &baseEnv,
+                          CommandStreams streams) const {
+  const bool builtinsOnly =
+      std::all_of(pipeline.commands.begin(), pipeline.commands.end(),
+                  [this](const Command &cmd) {
+                    return factory_.IsBuiltin(cmd.command);
+                  });
+  const std::string mode = baseEnv.Get(kPipelineModeVariable);
+#ifdef _WIN32
+  if (builtinsOnly && mode != "threads") {
+    return RunCooperative(pipeline, baseEnv, streams);
+  }
+  return RunThreaded(pipeline, baseEnv, streams);
+#else
+  if (!builtinsOnly || mode == "fork") {
+    return RunForked(pipeline, baseEnv);
+  }
+  if (mode == "threads") {
+    return RunThreaded(pipeline, baseEnv, streams);
+  }
+  return RunCooperative(pipeline, baseEnv, streams);
+#endif
+}
+
+int Executor::RunCooperative(const Pipeline &pipeline,
+                             const Environment &baseEnv,
+                             CommandStreams streams) const {
+  const size_t count = pipeline.commands.size();
+  CooperativeScheduler scheduler;
+
+  // Every edge is a channel: a stage without line support still exchanges
+  // chunks through the ICommand::ExecuteCooperative adapter.
+  std::vector<std::unique_ptr<CooperativeLineChannel>> edges;
+  edges.reserve(count - 1);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    edges.push_back(std::make_unique<CooperativeLineChannel>(scheduler));
+  }
+
+  struct Stage {
+    std::unique_ptr<ICommand> command;
+    std::unique_ptr<RedirectedStreams> redirected;
+    std::unique_ptr<CommandContext> context;
+    std::unique_ptr<CooperativeContext> cooperative;
+    std::optional<StageTask> task;
+    bool finished = false;
+    int exitCode = 0;
+  };
+  std::vector<Environment> envs;
+  std::vector<Stage> stages(count);
+  envs.reserve(count);
+
+  // Signal EOF to the next stage and release the previous one.
+  auto finish = [&](size_t i, int exitCode) {
+    stages[i].finished = true;
+    stages[i].exitCode = exitCode;
+    if (i + 1 < count) {
+      edges[i]->Close();
+    }
+    if (i > 0) {
+      edges[i - 1]->CloseReader();
+    }
+  };
+
+  for (size_t i = 0; i < count; ++i) {
+    const Command &cmdData = pipeline.commands[i];
+    Stage &stage = stages[i];
+    envs.push_back(baseEnv.WithOverrides(cmdData.assignments));
+    stage.command = factory_.Create(cmdData, envs.back());
+    stage.redirected =
+        std::make_unique<RedirectedStreams>(cmdData.redirections, streams);
+    if (!stage.redirected->Ok()) {
+      streams.err << "cppshell: " << stage.redirected->Error() << '\n';
+      finish(i, 1);
+      continue;
+    }
+
+    stage.context = std::make_unique<CommandContext>(
+        CommandContext{stage.redirected->Streams(), envs.back()});
+    // A redirected stream replaces the channel on that side.
+    if (i > 0) {
+      if (Redirects(cmdData, {RedirectionKind::Input})) {
+        edges[i - 1]->CloseReader();
+      } else {
+        stage.context->inChannel = edges[i - 1].get();
+      }
+    }
+    if (i + 1 < count &&
+        !Redirects(cmdData,
+                   {RedirectionKind::Output, RedirectionKind::Append})) {
+      stage.context->outChannel = edges[i].get();
+    }
+    stage.cooperative = std::make_unique<CooperativeContext>(*stage.context);
+    stage.task = stage.command->ExecuteCooperative(*stage.cooperative);
+    scheduler.Schedule(stage.task->GetHandle());
+  }
+
+  // Stages run until they wait on a channel; the peer they wait for is
+  // scheduled by the channel, so the queue drains only when all finished.
+  while (const std::coroutine_handle<> handle = scheduler.Next()) {
+    handle.resume();
+    for (size_t i = 0; i < count; ++i) {
+      Stage &stage = stages[i];
+      if (!stage.finished && stage.task && stage.task->Done()) {
+        finish(i, stage.task->Result().exitCode);
+      }
+    }
+  }
+
+  return stages.back().exitCode;
+}
+
+int Executor::RunThreaded(const Pipeline &pipeline, const Environment &baseEnv,
+                          CommandStreams streams) const {
+  const size_t count = pipeline.commands.size();
+
+  std::vector<Environment> envs;
+  std::vector<std::unique_ptr<ICommand>> commands;
+  envs.reserve(count);
+  commands.reserve(count);
+  for (const Command &cmdData : pipeline.commands) {
+    envs.push_back(baseEnv.WithOverrides(cmdData.assignments));
+    commands.push_back(factory_.Create(cmdData, envs.back()));
+  }
+
+  // Lines travel through a channel only if both neighbours speak it and
+  // neither redirects the connecting stream elsewhere.
+  std::vector<Edge> edges(count - 1);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    const bool lines =
+        commands[i]->SupportsLineChannels() &&
+        commands[i + 1]->SupportsLineChannels() &&
+        !Redirects(pipeline.commands[i],
+                   {RedirectionKind::Output, RedirectionKind::Append}) &&
+        !Redirects(pipeline.commands[i + 1], {RedirectionKind::Input});
+    if (lines) {
+      edges[i].channel = std::make_unique<BlockingLineChannel>();
+    } else {
+      edges[i].pipe = std::make_unique<Pipe>();
+    }
+  }
+
+  const std::vector<int> placement = PlanPlacement(
+      CurrentCpuTopology(), PlacementFromEnv(baseEnv), count);
+  std::vector<std::thread> threads;
+  std::vector<int> exitCodes(count, 0);
+
+  for (size_t i = 0; i < count; ++i) {
+    threads.emplace_back([&, i]() {
+      PinCurrentThread(placement[i]);
+      const Command &cmdData = pipeline.commands[i];
+      Edge *inEdge = i > 0 ? &edges[i - 1] : nullptr;
+      Edge *outEdge = i + 1 < count ? &edges[i] : nullptr;
+
+      // Input Setup
+      std::unique_ptr<PipeReadBuffer> readBuf;
+      std::unique_ptr<std::istream> pipeIn;
+      std::istream *currentIn = &streams.in;
+
+      if (inEdge != nullptr && inEdge->pipe) {
+        readBuf = std::make_unique<PipeReadBuffer>(*inEdge->pipe);
+        pipeIn = std::make_unique<std::istream>(readBuf.get());
+        currentIn = pipeIn.get();
+      }
+
+      // Output Setup
+      std::unique_ptr<PipeWriteBuffer> writeBuf;
+      std::unique_ptr<std::ostream> pipeOut;
+      std::ostream *currentOut = &streams.out;
+
+      if (outEdge != nullptr && outEdge->pipe) {
+        writeBuf = std::make_unique<PipeWriteBuffer>(*outEdge->pipe);
+        pipeOut = std::make_unique<std::ostream>(writeBuf.get());
+        currentOut = pipeOut.get();
+      }
+
+      {
+        RedirectedStreams redirected(
+            cmdData.redirections,
+            CommandStreams{*currentIn, *currentOut, streams.err});
+        if (!redirected.Ok()) {
+          streams.err << "cppshell: " << redirected.Error() << '\n';
+          exitCodes[i] = 1;
+        } else {
+          CommandStreams cmdStreams = redirected.Streams();
+          CommandContext ctx{cmdStreams, envs[i]};
+          ctx.inChannel = inEdge != nullptr ? inEdge->channel.get() : nullptr;
+          ctx.outChannel =
+              outEdge != nullptr ? outEdge->channel.get() : nullptr;
+          const CommandResult r = commands[i]->Execute(ctx);
+          exitCodes[i] = r.exitCode;
+        }
+      }
+
+      // Signal EOF to the next command and release the previous one if it
+      // is still producing.
+      if (outEdge != nullptr) {
+        if (outEdge->channel) {
+          outEdge->channel->Close();
+        } else {
+          outEdge->pipe->Close();
+        }
+      }
+      if (inEdge != nullptr && inEdge->channel) {
+        inEdge->channel->CloseReader();
+      }
+    });
+  }
+
+  // Wait for all threads
+  for (auto &t : threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+
+  return exitCodes.back();
+}
+
+#ifndef _WIN32
+int Executor::RunForked(const Pipeline &pipeline,
+                        const Environment &baseEnv) const {
+  const size_t count = pipeline.commands.size();
+  int lastExitCode = 0;
+  int prevPipeRead = -1;
+  std::vector<pid_t> pids;
+  const std::vector<int> placement = PlanPlacement(
+      CurrentCpuTopology(), PlacementFromEnv(baseEnv), count);
+
+#ifdef __linux__
+  // An edge uses the zero-copy transports only if its bytes really flow
+  // between the two stages. The pipe is created either way: holding its
+  // ends tells each side of a ring whether the other one is still alive.
+  const bool sharedMemory = baseEnv.Get(kForkTransportVariable) != "pipe";
+  auto connected = [&](size_t i) {
+    return !Redirects(pipeline.commands[i],
+                      {RedirectionKind::Output, RedirectionKind::Append}) &&
+           !Redirects(pipeline.commands[i + 1], {RedirectionKind::Input});
+  };
+  auto builtin = [&](size_t i) {
+    return factory_.IsBuiltin(pipeline.commands[i].command);
+  };
+  std::vector<std::unique_ptr<SharedRing>> rings(count);
+#endif
+
+  // Helper to close FDs safely
+  auto safe_close = [](int &fd) {
+    if (fd != -1) {
+      close(fd);
+      fd = -1;
+    }
+  };
+
+  for (size_t i = 0; i < count; ++i) {
+    int pipefds[2] = {-1, -1};
+    bool hasNext = (i + 1 < count);
+
+    if (hasNext) {
+      if (pipe(pipefds) == -1) {
+        perror("pipe");
+        break;
+      }
+    }
+
+#ifdef __linux__
+    bool splice = false;
+    if (hasNext && sharedMemory && builtin(i) && connected(i)) {
+      if (builtin(i + 1)) {
+        rings[i] = SharedRing::Create();
+      } else {
+        splice = true;
+      }
+    }
+#endif
+
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("fork");
+      safe_close(pipefds[0]);
+      safe_close(pipefds[1]);
+      break;
+    }
+
+    if (pid == 0) {
+      // Child process; an external program spawned below inherits the CPU.
+      PinCurrentThread(placement[i]);
+      if (prevPipeRead != -1) {
+        dup2(prevPipeRead, STDIN_FILENO);
+        safe_close(prevPipeRead);
+      }
+      if (hasNext) {
+        dup2(pipefds[1], STDOUT_FILENO);
+        safe_close(pipefds[1]);
+        safe_close(pipefds[0]); // Child does not read from next pipe
+      }
+
+      const auto &cmdData = pipeline.commands[i];
+      int exitCode = 1;
+      {
+        // FDs 0/1 now are the pipe ends. Builtins read and write them in
+        // blocks rather than through the stdio-synchronised std::cin/cout.
+        std::unique_ptr<std::streambuf> inBuf;
+        std::unique_ptr<std::streambuf> outBuf;
+#ifdef __linux__
+        if (i > 0 && rings[i - 1]) {
+          inBuf = std::make_unique<RingReadBuffer>(*rings[i - 1],
+                                                   STDIN_FILENO);
+        }
+        if (hasNext && rings[i]) {
+          outBuf = std::make_unique<RingWriteBuffer>(*rings[i], STDOUT_FILENO);
+        } else if (splice) {
+          outBuf = std::make_unique<VmspliceWriteBuffer>(STDOUT_FILENO);
+        }
+#endif
+        if (!inBuf) {
+          inBuf = std::make_unique<FdReadBuffer>(STDIN_FILENO, false);
+        }
+        if (!outBuf) {
+          outBuf = std::make_unique<FdWriteBuffer>(STDOUT_FILENO, false);
+        }
+
+        // Redirections override the pipe ends, as in POSIX shells.
+        const std::string redirectError =
+            RedirectStandardFds(cmdData.redirections);
+        if (!redirectError.empty()) {
+          std::cerr << "cppshell: " << redirectError << '\n';
+        } else {
+          Environment envForCommand =
+              baseEnv.WithOverrides(cmdData.assignments);
+          std::istream in(inBuf.get());
+          std::ostream out(outBuf.get());
+          CommandStreams streams{in, out, std::cerr};
+          CommandContext ctx{streams, envForCommand};
+
+          std::unique_ptr<ICommand> cmd =
+              factory_.Create(cmdData, envForCommand);
+          exitCode = cmd->Execute(ctx).exitCode;
+          out.flush();
+        }
+        // Leaving the scope closes ring ends, which std::exit would skip.
+      }
+      std::exit(exitCode);
+    } else {
+      // Parent process
+      pids.push_back(pid);
+      if (prevPipeRead != -1) {
+        safe_close(prevPipeRead);
+      }
+      if (hasNext) {
+        safe_close(pipefds[1]);    // Parent writes nothing
+        prevPipeRead = pipefds[0]; // Parent holds read end for next child
+      }
+    }
+  }
+
+  // Close last read end
+  safe_close(prevPipeRead);
+
+  // Wait for all children; the last one determines the exit code.
+  for (pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    if (WIFEXITED(status)) {
+      lastExitCode = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+      lastExitCode = 128 + WTERMSIG(status);
+    }
+  }
+  return lastExitCode;
+}
+#endif
+
+} // namespace cppshell
@@ -18,6 +18,8 @@
 
 #include <vector>
 #else
+#include "cppshell/fd_stream.hpp"
+
 #include <fcntl.h>
 #include <spawn.h>
 #include <sys/wait.h>
@@ -153,6 +155,15 @@ void PumpFdToStream(int fdRead, std::ostream &out) {
   }
 }
 
+/** Makes `fd` the child's `target` descriptor; returns true if it added one. */
+bool AddDirectFd(posix_spawn_file_actions_t &actions, int fd, int target) {
+  if (fd < 0 || fd == target) {
+    return false;
+  }
+  posix_spawn_file_actions_adddup2(&actions, fd, target);
+  return true;
+}
+
 void PumpStreamToFd(std::istream &in, int fdWrite) {
   char buffer[kBufferSize];
   while (in) {
@@ -281,11 +292,11 @@ ExternalCommand::ExternalCommand(std::string program,
       env_(std::move(envForCommand)) {}
 
 CommandResult ExternalCommand::Execute(CommandContext &context) {
+#ifdef _WIN32
   const bool inheritIn = (&context.streams.in == &std::cin);
   const bool inheritOut = (&context.streams.out == &std::cout);
   const bool inheritErr = (&context.streams.err == &std::cerr);
 
-#ifdef _WIN32
   std::vector<std::string> argv;
   argv.reserve(1 + args_.size());
   argv.push_back(program_);
@@ -429,13 +440,21 @@ CommandResult ExternalCommand::Execute(CommandContext &context) {
       [](const std::string &s) { return const_cast<char *>(s.c_str()); });
   envp.push_back(nullptr);
 
+  // Descriptors the child can use as is (the shell's own or redirection
+  // targets); streams without one are pumped through pipes.
+  const int directIn = DirectInputFd(context.streams.in);
+  const int directOut =
+      DirectOutputFd(context.streams.out, std::cout, STDOUT_FILENO);
+  const int directErr =
+      DirectOutputFd(context.streams.err, std::cerr, STDERR_FILENO);
+
   PipePair stdinPipe{};
   PipePair stdoutPipe{};
   PipePair stderrPipe{};
 
-  const bool needRedirectIn = !inheritIn;
-  const bool needRedirectOut = !inheritOut;
-  const bool needRedirectErr = !inheritErr;
+  const bool needRedirectIn = directIn < 0;
+  const bool needRedirectOut = directOut < 0;
+  const bool needRedirectErr = directErr < 0;
 
   if (needRedirectIn && !CreatePipe(stdinPipe)) {
     return CommandResult{.exitCode = 127};
@@ -455,6 +474,11 @@ CommandResult ExternalCommand::Execute(CommandContext &context) {
 
   posix_spawn_file_actions_t actions;
   posix_spawn_file_actions_init(&actions);
+  bool anyActions = false;
+  anyActions |= AddDirectFd(actions, directIn, STDIN_FILENO);
+  anyActions |= AddDirectFd(actions, directOut, STDOUT_FILENO);
+  anyActions |= AddDirectFd(actions, directErr, STDERR_FILENO);
+  anyActions |= needRedirectIn || needRedirectOut || needRedirectErr;
   if (needRedirectIn) {
     posix_spawn_file_actions_adddup2(&actions, stdinPipe.read, STDIN_FILENO);
     posix_spawn_file_actions_addclose(&actions, stdinPipe.write);
@@ -469,11 +493,9 @@ CommandResult ExternalCommand::Execute(CommandContext &context) {
   }
 
   pid_t pid{};
-  const int rc = posix_spawnp(
-      &pid, program_.c_str(),
-      (needRedirectIn || needRedirectOut || needRedirectErr) ? &actions
-                                                             : nullptr,
-      nullptr, argv.data(), envp.data());
+  const int rc =
+      posix_spawnp(&pid, program_.c_str(), anyActions ? &actions : nullptr,
+                   nullptr, argv.data(), envp.data());
   posix_spawn_file_actions_destroy(&actions);
   if (rc != 0) {
     if (rc == ENOENT) {
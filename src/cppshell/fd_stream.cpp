@@ -0,0 +1,197 @@
+#include "cppshell/fd_stream.hpp"
+
+#include "cppshell/shm_transport.hpp"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace cppshell {
+
+namespace {
+
+[[nodiscard]] ssize_t ReadRetry(int fd, char *buffer, size_t size) {
+  while (true) {
+    const ssize_t n = ::read(fd, buffer, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return n;
+  }
+}
+
+} // namespace
+
+bool WriteAll(int fd, const char *data, size_t size) {
+  while (size != 0) {
+    const ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+int DirectInputFd(std::istream &in) {
+  if (&in == &std::cin) {
+    return STDIN_FILENO;
+  }
+  const auto *buffer = dynamic_cast<const FdReadBuffer *>(in.rdbuf());
+  if (buffer != nullptr && !buffer->HasBufferedData()) {
+    return buffer->Fd();
+  }
+  return -1;
+}
+
+int DirectOutputFd(std::ostream &out, std::ostream &standard,
+                   int standardFd) {
+  if (&out == &standard) {
+    out.flush();
+    return standardFd;
+  }
+  int fd = -1;
+  if (const auto *buffer = dynamic_cast<FdWriteBuffer *>(out.rdbuf())) {
+    fd = buffer->Fd();
+  }
+#ifdef __linux__
+  if (const auto *buffer = dynamic_cast<VmspliceWriteBuffer *>(out.rdbuf())) {
+    fd = buffer->Fd();
+  }
+#endif
+  if (fd >= 0) {
+    out.flush();
+  }
+  return fd;
+}
+
+FdReadBuffer::FdReadBuffer(int fd, bool ownsFd)
+    : fd_(fd), ownsFd_(ownsFd), buffer_(kBufferSize) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+FdReadBuffer::~FdReadBuffer() {
+  if (ownsFd_ && fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+FdReadBuffer::int_type FdReadBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  const ssize_t n = ReadRetry(fd_, buffer_.data(), buffer_.size());
+  if (n <= 0) {
+    return traits_type::eof();
+  }
+
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize FdReadBuffer::xsgetn(char *s, std::streamsize n) {
+  std::streamsize done = 0;
+
+  // Drain what is already buffered first.
+  const std::streamsize buffered = egptr() - gptr();
+  if (buffered > 0) {
+    const std::streamsize take = std::min(buffered, n);
+    std::memcpy(s, gptr(), static_cast<size_t>(take));
+    gbump(static_cast<int>(take));
+    done += take;
+  }
+
+  // Big requests are served straight from the fd into the caller's memory.
+  while (done < n && n - done >= static_cast<std::streamsize>(kBufferSize)) {
+    const ssize_t got =
+        ReadRetry(fd_, s + done, static_cast<size_t>(n - done));
+    if (got <= 0) {
+      return done;
+    }
+    done += got;
+  }
+
+  while (done < n) {
+    if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+      break;
+    }
+    const std::streamsize take = std::min<std::streamsize>(
+        egptr() - gptr(), n - done);
+    std::memcpy(s + done, gptr(), static_cast<size_t>(take));
+    gbump(static_cast<int>(take));
+    done += take;
+  }
+  return done;
+}
+
+std::streamsize FdReadBuffer::showmanyc() {
+  // What the kernel holds for the descriptor; 0 where it cannot tell.
+  int queued = 0;
+  if (::ioctl(fd_, FIONREAD, &queued) != 0 || queued < 0) {
+    return 0;
+  }
+  return queued;
+}
+
+FdWriteBuffer::FdWriteBuffer(int fd, bool ownsFd)
+    : fd_(fd), ownsFd_(ownsFd), buffer_(kBufferSize) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+FdWriteBuffer::~FdWriteBuffer() {
+  (void)FlushBuffer();
+  if (ownsFd_ && fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool FdWriteBuffer::FlushBuffer() {
+  const size_t pending = static_cast<size_t>(pptr() - pbase());
+  const bool ok = WriteAll(fd_, pbase(), pending);
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  return ok;
+}
+
+FdWriteBuffer::int_type FdWriteBuffer::overflow(int_type ch) {
+  if (!FlushBuffer()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize FdWriteBuffer::xsputn(const char *s, std::streamsize n) {
+  const std::streamsize room = epptr() - pptr();
+  if (n <= room) {
+    std::memcpy(pptr(), s, static_cast<size_t>(n));
+    pbump(static_cast<int>(n));
+    return n;
+  }
+
+  // Too big to coalesce: flush what we have and hand the caller's bytes to
+  // the kernel without staging them.
+  if (!FlushBuffer() || !WriteAll(fd_, s, static_cast<size_t>(n))) {
+    return 0;
+  }
+  return n;
+}
+
+int FdWriteBuffer::sync() { return FlushBuffer() ? 0 : -1; }
+
+} // namespace cppshell
+
+#endif
@@ -0,0 +1,213 @@
+#include "cppshell/file_copy.hpp"
+
+#ifndef _WIN32
+
+#include "cppshell/fd_stream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Bytes moved per read and write when the kernel cannot copy. */
+constexpr size_t kCopyBufferSize = 1024 * 1024;
+
+/**
+ * Copies `in` to `out` through a buffer until end of file: with pread
+ * from `offset` if one is given, with read from the current offset if not.
+ */
+[[nodiscard]] bool CopyThroughBuffer(int in, int out,
+                                     std::optional<off_t> offset) {
+  thread_local std::vector<char> buffer(kCopyBufferSize);
+  while (true) {
+    const ssize_t got =
+        offset ? ::pread(in, buffer.data(), buffer.size(), *offset)
+               : ::read(in, buffer.data(), buffer.size());
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return got == 0;
+    }
+    if (!WriteAll(out, buffer.data(), static_cast<size_t>(got))) {
+      return false;
+    }
+    if (offset) {
+      *offset += got;
+    }
+  }
+}
+
+#ifdef __linux__
+/** Most bytes asked of one kernel call; the kernel moves less anyway. */
+constexpr size_t kMaxKernelChunk = size_t{1} << 30;
+
+/** Kernel calls that move a regular file's bytes, best first. */
+enum class KernelCopy { CopyFileRange, Splice, Sendfile };
+
+/**
+ * Moves up to `size` bytes of regular file `in`, from `offset`, to the
+ * current offset of `out`. Returns what the call returned; `offset` is
+ * advanced by what it moved.
+ */
+[[nodiscard]] ssize_t MoveRange(KernelCopy how, int in, off_t &offset,
+                                int out, size_t size) {
+  size = std::min(size, kMaxKernelChunk);
+  switch (how) {
+  case KernelCopy::CopyFileRange: {
+    loff_t from = offset;
+    const ssize_t n = ::copy_file_range(in, &from, out, nullptr, size, 0);
+    offset = static_cast<off_t>(from);
+    return n;
+  }
+  case KernelCopy::Splice: {
+    loff_t from = offset;
+    const ssize_t n =
+        ::splice(in, &from, out, nullptr, size, SPLICE_F_MORE);
+    offset = static_cast<off_t>(from);
+    return n;
+  }
+  case KernelCopy::Sendfile:
+    return ::sendfile(out, in, &offset, size);
+  }
+  return -1;
+}
+
+/**
+ * Copies regular file `in` from `offset` to `out`. `holes` says whether
+ * `out` is a regular file written at its offset, where holes can be left
+ * by seeking past them.
+ */
+[[nodiscard]] bool CopyRegular(int in, off_t offset, off_t size, int out,
+                               KernelCopy how, bool holes) {
+  while (offset < size) {
+    off_t end = size;
+    if (holes) {
+      // ENXIO: only a hole is left. Other errors: no holes are reported.
+      off_t data = ::lseek(in, offset, SEEK_DATA);
+      if (data < 0) {
+        data = errno == ENXIO ? size : offset;
+      }
+      data = std::min(data, size);
+      if (data > offset && ::lseek(out, data - offset, SEEK_CUR) < 0) {
+        return false;
+      }
+      offset = data;
+      const off_t hole = ::lseek(in, offset, SEEK_HOLE);
+      end = hole > offset ? std::min(hole, size) : size;
+    }
+    while (offset < end) {
+      const ssize_t n = MoveRange(how, in, offset, out,
+                                  static_cast<size_t>(end - offset));
+      if (n > 0 || (n < 0 && errno == EINTR)) {
+        continue;
+      }
+      if (n == 0) {
+        // The file shrank under us.
+        return true;
+      }
+      const bool unsupported = errno == EXDEV || errno == EINVAL ||
+                               errno == EOPNOTSUPP || errno == ENOSYS;
+      if (!unsupported) {
+        return false;
+      }
+      if (how == KernelCopy::Sendfile) {
+        return CopyThroughBuffer(in, out, offset);
+      }
+      // Not for this pair, such as files on different filesystems.
+      how = KernelCopy::Sendfile;
+    }
+  }
+  if (holes) {
+    // A trailing hole was seeked past, not written: extend `out` to it.
+    struct stat st {};
+    const off_t position = ::lseek(out, 0, SEEK_CUR);
+    if (position < 0 || ::fstat(out, &st) != 0) {
+      return false;
+    }
+    if (st.st_size < position && ::ftruncate(out, position) != 0) {
+      return false;
+    }
+  }
+  // Whatever was appended to `in` meanwhile.
+  return CopyThroughBuffer(in, out, offset);
+}
+
+/** Copies pipe `in` to `out` with splice until end of file. */
+[[nodiscard]] bool SplicePipe(int in, int out) {
+  while (true) {
+    const ssize_t n = ::splice(in, nullptr, out, nullptr, kMaxKernelChunk,
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n > 0) {
+      continue;
+    }
+    if (n == 0) {
+      return true;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    // splice moves all of a call's bytes or none, so nothing is lost.
+    return errno == EINVAL && CopyThroughBuffer(in, out, std::nullopt);
+  }
+}
+#endif
+
+} // namespace
+
+bool InputIsOutput(int in, int out) {
+  struct stat inStat {};
+  struct stat outStat {};
+  if (::fstat(in, &inStat) != 0 || ::fstat(out, &outStat) != 0 ||
+      !S_ISREG(inStat.st_mode) || inStat.st_dev != outStat.st_dev ||
+      inStat.st_ino != outStat.st_ino) {
+    return false;
+  }
+  // `cat f > f` truncated the file first and has nothing to read.
+  const off_t offset = ::lseek(in, 0, SEEK_CUR);
+  return offset < 0 || offset < inStat.st_size;
+}
+
+bool CopyToFd(int in, int out) {
+  if (InputIsOutput(in, out)) {
+    return false;
+  }
+#ifdef __linux__
+  struct stat inStat {};
+  struct stat outStat {};
+  if (::fstat(in, &inStat) == 0 && ::fstat(out, &outStat) == 0) {
+    if (S_ISFIFO(inStat.st_mode)) {
+      return SplicePipe(in, out);
+    }
+    // Files that report no size, such as those under /proc, are read.
+    const off_t offset = ::lseek(in, 0, SEEK_CUR);
+    if (S_ISREG(inStat.st_mode) && inStat.st_size > 0 && offset >= 0) {
+      const int outFlags = ::fcntl(out, F_GETFL);
+      const bool toFile = S_ISREG(outStat.st_mode) && outFlags >= 0 &&
+                          (outFlags & O_APPEND) == 0;
+      const KernelCopy how = toFile ? KernelCopy::CopyFileRange
+                             : S_ISFIFO(outStat.st_mode) ? KernelCopy::Splice
+                                                         : KernelCopy::Sendfile;
+      return CopyRegular(in, offset, inStat.st_size, out, how, toFile);
+    }
+  }
+#endif
+  return CopyThroughBuffer(in, out, std::nullopt);
+}
+
+} // namespace cppshell
+
+#endif
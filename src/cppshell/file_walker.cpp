@@ -0,0 +1,565 @@
+#include "cppshell/file_walker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/**
+ * Matches a `[...]` class at the start of `pattern` against `c`. Returns
+ * the length of the class, or 0 if it is not terminated.
+ */
+size_t MatchClass(std::string_view pattern, char c, bool &matched) {
+  size_t i = 1;
+  const bool negate =
+      i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+  if (negate) {
+    ++i;
+  }
+  bool found = false;
+  const size_t first = i;
+  for (; i < pattern.size() && (pattern[i] != ']' || i == first); ++i) {
+    char low = pattern[i];
+    if (low == '\\' && i + 1 < pattern.size()) {
+      low = pattern[++i];
+    }
+    char high = low;
+    if (i + 2 < pattern.size() && pattern[i + 1] == '-' &&
+        pattern[i + 2] != ']') {
+      high = pattern[i + 2];
+      i += 2;
+    }
+    if (low <= c && c <= high) {
+      found = true;
+    }
+  }
+  if (i >= pattern.size()) {
+    return 0;
+  }
+  matched = found != negate;
+  return i + 1;
+}
+
+/** Returns true if `name` matches one of `globs`. */
+[[nodiscard]] bool AnyGlob(const std::vector<std::string> &globs,
+                           std::string_view name) {
+  return std::any_of(globs.begin(), globs.end(), [&](const std::string &g) {
+    return GlobMatch(g, name);
+  });
+}
+
+/** Length of `directory` with the separator its entries add to it. */
+[[nodiscard]] size_t PrefixLength(const std::string &directory) {
+  if (directory.empty()) {
+    return 0;
+  }
+  return directory.back() == '/' ? directory.size() : directory.size() + 1;
+}
+
+/** The path of entry `name` of `directory`. */
+[[nodiscard]] std::string Join(const std::string &directory,
+                               std::string_view name) {
+  std::string path;
+  path.reserve(PrefixLength(directory) + name.size());
+  path = directory;
+  if (!path.empty() && path.back() != '/') {
+    path.push_back('/');
+  }
+  path.append(name);
+  return path;
+}
+
+/** Ignore rules in force in a directory: its own and its parents'. */
+struct IgnoreScope {
+  std::shared_ptr<const IgnoreScope> parent;
+  IgnoreRules rules;
+  // PrefixLength() of the directory the rules were read in.
+  size_t prefix = 0;
+};
+
+/** Asks the innermost scope with an opinion about `path`. */
+[[nodiscard]] bool Ignored(const IgnoreScope *scope, const std::string &path,
+                           bool directory) {
+  for (; scope != nullptr; scope = scope->parent.get()) {
+    const IgnoreRules::Verdict verdict = scope->rules.Judge(
+        std::string_view(path).substr(scope->prefix), directory);
+    if (verdict != IgnoreRules::Verdict::kNone) {
+      return verdict == IgnoreRules::Verdict::kIgnore;
+    }
+  }
+  return false;
+}
+
+/** What a directory entry is, after following a link if asked to. */
+enum class EntryKind { kFile, kDirectory, kOther };
+
+struct Entry {
+  std::string name;
+  EntryKind kind = EntryKind::kOther;
+  // Tells directories apart under WalkOptions::followLinks.
+  std::string identity;
+};
+
+#ifdef __linux__
+
+/** Fills the kind (and identity) of `entry` from a stat of it. */
+void Classify(const struct stat &st, bool followLinks, Entry &entry) {
+  if (S_ISDIR(st.st_mode)) {
+    entry.kind = EntryKind::kDirectory;
+    if (followLinks) {
+      entry.identity =
+          std::to_string(st.st_dev) + ':' + std::to_string(st.st_ino);
+    }
+  } else if (S_ISREG(st.st_mode)) {
+    entry.kind = EntryKind::kFile;
+  }
+}
+
+/**
+ * Reads the entries of `path` with getdents64. Only entries of unknown
+ * type, links that are followed and, when following, directories need a
+ * stat.
+ */
+bool ListDirectory(const std::string &path, bool followLinks,
+                   std::vector<Entry> &entries, std::string &error) {
+  const int fd = ::openat(AT_FDCWD, path.empty() ? "." : path.c_str(),
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    error = std::strerror(errno);
+    return false;
+  }
+  // struct linux_dirent64: ino (8), off (8), reclen (2), type (1), name.
+  constexpr size_t kReclenOffset = 16;
+  constexpr size_t kTypeOffset = 18;
+  constexpr size_t kNameOffset = 19;
+  thread_local std::vector<char> buffer(64 * 1024);
+  while (true) {
+    const long read = ::syscall(SYS_getdents64, fd, buffer.data(),
+                                static_cast<unsigned>(buffer.size()));
+    if (read < 0) {
+      error = std::strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    if (read == 0) {
+      break;
+    }
+    for (long offset = 0; offset < read;) {
+      const char *record = buffer.data() + offset;
+      unsigned short reclen = 0;
+      std::memcpy(&reclen, record + kReclenOffset, sizeof(reclen));
+      offset += reclen;
+      const auto type = static_cast<unsigned char>(record[kTypeOffset]);
+      const char *name = record + kNameOffset;
+      if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+        continue;
+      }
+      Entry entry;
+      entry.name = name;
+      if (type == DT_REG) {
+        entry.kind = EntryKind::kFile;
+      } else if (type == DT_DIR && !followLinks) {
+        entry.kind = EntryKind::kDirectory;
+      } else if (type == DT_UNKNOWN || type == DT_DIR ||
+                 (type == DT_LNK && followLinks)) {
+        struct stat st{};
+        const int flags = followLinks ? 0 : AT_SYMLINK_NOFOLLOW;
+        if (::fstatat(fd, name, &st, flags) == 0) {
+          Classify(st, followLinks, entry);
+        }
+      }
+      entries.push_back(std::move(entry));
+    }
+  }
+  ::close(fd);
+  return true;
+}
+
+/** The identity of the directory at `path` for WalkOptions::followLinks. */
+[[nodiscard]] std::string DirectoryIdentity(const std::string &path) {
+  struct stat st{};
+  if (::stat(path.empty() ? "." : path.c_str(), &st) != 0) {
+    return path;
+  }
+  return std::to_string(st.st_dev) + ':' + std::to_string(st.st_ino);
+}
+
+#else
+
+bool ListDirectory(const std::string &path, bool followLinks,
+                   std::vector<Entry> &entries, std::string &error) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::directory_iterator it(path.empty() ? fs::path(".") : fs::path(path),
+                            ec);
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  for (; it != fs::directory_iterator(); it.increment(ec)) {
+    if (ec) {
+      error = ec.message();
+      return false;
+    }
+    Entry entry;
+    entry.name = it->path().filename().string();
+    std::error_code entryError;
+    if (it->is_symlink(entryError) && !followLinks) {
+      entries.push_back(std::move(entry));
+      continue;
+    }
+    if (it->is_directory(entryError)) {
+      entry.kind = EntryKind::kDirectory;
+      if (followLinks) {
+        entry.identity = fs::canonical(it->path(), entryError).string();
+      }
+    } else if (it->is_regular_file(entryError)) {
+      entry.kind = EntryKind::kFile;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return true;
+}
+
+[[nodiscard]] std::string DirectoryIdentity(const std::string &path) {
+  std::error_code ec;
+  return std::filesystem::canonical(path.empty() ? "." : path, ec).string();
+}
+
+#endif
+
+/** The parallel walk of one tree; see WalkTree. */
+class Walker {
+public:
+  explicit Walker(const WalkOptions &options)
+      : options_(options), queues_(std::max<size_t>(options.threads, 1)),
+        found_(queues_.size()) {}
+
+  WalkResult Run(const std::string &root) {
+    if (options_.followLinks) {
+      static_cast<void>(FirstVisit(DirectoryIdentity(root)));
+    }
+    Push(0, Directory{root, nullptr});
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      helpers.emplace_back([this, i] { Work(i); });
+    }
+    Work(0);
+    for (std::thread &helper : helpers) {
+      helper.join();
+    }
+
+    WalkResult result;
+    for (Found &found : found_) {
+      result.files.insert(result.files.end(),
+                          std::make_move_iterator(found.files.begin()),
+                          std::make_move_iterator(found.files.end()));
+      result.errors.insert(result.errors.end(),
+                           std::make_move_iterator(found.errors.begin()),
+                           std::make_move_iterator(found.errors.end()));
+    }
+    if (options_.sorted) {
+      std::sort(result.files.begin(), result.files.end());
+      std::sort(result.errors.begin(), result.errors.end());
+    }
+    return result;
+  }
+
+private:
+  struct Directory {
+    std::string path;
+    std::shared_ptr<const IgnoreScope> scope;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Directory> directories;
+  };
+
+  /** What one worker found. */
+  struct Found {
+    std::vector<std::string> files;
+    std::vector<std::string> errors;
+  };
+
+  void Push(size_t worker, Directory directory) {
+    unfinished_.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+      queues_[worker].directories.push_back(std::move(directory));
+    }
+    queued_.fetch_add(1);
+    // Taking the lock orders this with an idle worker's check.
+    { std::lock_guard<std::mutex> lock(idleMutex_); }
+    wake_.notify_one();
+  }
+
+  /** Takes the newest own directory, else steals another's oldest. */
+  bool Pop(size_t worker, Directory &directory) {
+    for (size_t k = 0; k < queues_.size(); ++k) {
+      Queue &queue = queues_[(worker + k) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.directories.empty()) {
+        continue;
+      }
+      if (k == 0) {
+        directory = std::move(queue.directories.back());
+        queue.directories.pop_back();
+      } else {
+        directory = std::move(queue.directories.front());
+        queue.directories.pop_front();
+      }
+      queued_.fetch_sub(1);
+      return true;
+    }
+    return false;
+  }
+
+  void Work(size_t worker) {
+    Directory directory;
+    while (true) {
+      if (Pop(worker, directory)) {
+        List(worker, directory);
+        if (unfinished_.fetch_sub(1) == 1) {
+          { std::lock_guard<std::mutex> lock(idleMutex_); }
+          wake_.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(idleMutex_);
+      wake_.wait(lock, [this] {
+        return queued_.load() > 0 || unfinished_.load() == 0;
+      });
+      if (unfinished_.load() == 0) {
+        return;
+      }
+    }
+  }
+
+  void List(size_t worker, const Directory &directory) {
+    std::vector<Entry> entries;
+    std::string error;
+    if (!ListDirectory(directory.path, options_.followLinks, entries,
+                       error)) {
+      found_[worker].errors.push_back(
+          (directory.path.empty() ? "." : directory.path) + ": " + error);
+      return;
+    }
+
+    std::shared_ptr<const IgnoreScope> scope = directory.scope;
+    for (const std::string &name : options_.ignoreFiles) {
+      const bool present =
+          std::any_of(entries.begin(), entries.end(), [&](const Entry &e) {
+            return e.kind == EntryKind::kFile && e.name == name;
+          });
+      if (!present) {
+        continue;
+      }
+      std::ifstream in(Join(directory.path, name), std::ios::binary);
+      const std::string text((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+      IgnoreRules rules(text);
+      if (!rules.Empty()) {
+        scope = std::make_shared<const IgnoreScope>(IgnoreScope{
+            scope, std::move(rules), PrefixLength(directory.path)});
+      }
+    }
+
+    for (Entry &entry : entries) {
+      if (entry.kind == EntryKind::kDirectory) {
+        if (AnyGlob(options_.excludeDir, entry.name)) {
+          continue;
+        }
+        std::string path = Join(directory.path, entry.name);
+        if (Ignored(scope.get(), path, true) ||
+            (options_.followLinks && !FirstVisit(entry.identity))) {
+          continue;
+        }
+        Push(worker, Directory{std::move(path), scope});
+      } else if (entry.kind == EntryKind::kFile) {
+        if ((!options_.include.empty() &&
+             !AnyGlob(options_.include, entry.name)) ||
+            AnyGlob(options_.exclude, entry.name)) {
+          continue;
+        }
+        std::string path = Join(directory.path, entry.name);
+        if (!Ignored(scope.get(), path, false)) {
+          found_[worker].files.push_back(std::move(path));
+        }
+      }
+    }
+  }
+
+  /** Returns true the first time a directory is seen. */
+  bool FirstVisit(const std::string &identity) {
+    std::lock_guard<std::mutex> lock(visitedMutex_);
+    return visited_.insert(identity).second;
+  }
+
+  const WalkOptions &options_;
+  std::vector<Queue> queues_;
+  std::vector<Found> found_;
+  // Directories waiting in queues, and those not listed to the end yet.
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> unfinished_{0};
+  std::mutex idleMutex_;
+  std::condition_variable wake_;
+  std::mutex visitedMutex_;
+  std::unordered_set<std::string> visited_;
+};
+
+} // namespace
+
+bool GlobMatch(std::string_view pattern, std::string_view name) {
+  while (!pattern.empty()) {
+    if (pattern.starts_with("**")) {
+      std::string_view rest = pattern.substr(2);
+      if (rest.starts_with('/')) {
+        // Zero or more whole directories.
+        rest.remove_prefix(1);
+        if (GlobMatch(rest, name)) {
+          return true;
+        }
+        for (size_t i = 0; i < name.size(); ++i) {
+          if (name[i] == '/' && GlobMatch(rest, name.substr(i + 1))) {
+            return true;
+          }
+        }
+        return false;
+      }
+      for (size_t i = 0; i <= name.size(); ++i) {
+        if (GlobMatch(rest, name.substr(i))) {
+          return true;
+        }
+      }
+      return false;
+    }
+    if (pattern.front() == '*') {
+      const std::string_view rest = pattern.substr(1);
+      for (size_t i = 0; i <= name.size(); ++i) {
+        if (GlobMatch(rest, name.substr(i))) {
+          return true;
+        }
+        if (i < name.size() && name[i] == '/') {
+          break;
+        }
+      }
+      return false;
+    }
+    if (name.empty()) {
+      return false;
+    }
+    size_t used = 1;
+    if (pattern.front() == '?') {
+      if (name.front() == '/') {
+        return false;
+      }
+    } else if (pattern.front() == '[') {
+      bool matched = false;
+      used = MatchClass(pattern, name.front(), matched);
+      if (used == 0) {
+        // An unterminated '[' stands for itself.
+        used = 1;
+        matched = name.front() == '[';
+      }
+      if (!matched || name.front() == '/') {
+        return false;
+      }
+    } else {
+      char literal = pattern.front();
+      if (literal == '\\' && pattern.size() > 1) {
+        literal = pattern[1];
+        used = 2;
+      }
+      if (literal != name.front()) {
+        return false;
+      }
+    }
+    pattern.remove_prefix(used);
+    name.remove_prefix(1);
+  }
+  return name.empty();
+}
+
+IgnoreRules::IgnoreRules(std::string_view text) {
+  while (!text.empty()) {
+    const size_t nl = text.find('\n');
+    std::string_view line = text.substr(0, nl);
+    text = nl == std::string_view::npos ? std::string_view()
+                                        : text.substr(nl + 1);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    // Trailing spaces do not count unless quoted with a backslash.
+    while (!line.empty() && line.back() == ' ' &&
+           !(line.size() > 1 && line[line.size() - 2] == '\\')) {
+      line.remove_suffix(1);
+    }
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    Rule rule;
+    if (line.front() == '!') {
+      rule.negate = true;
+      line.remove_prefix(1);
+    }
+    if (!line.empty() && line.back() == '/') {
+      rule.directoryOnly = true;
+      line.remove_suffix(1);
+    }
+    if (line.find('/') != std::string_view::npos) {
+      rule.anchored = true;
+      if (line.front() == '/') {
+        line.remove_prefix(1);
+      }
+    }
+    if (line.empty()) {
+      continue;
+    }
+    rule.glob = line;
+    rules_.push_back(std::move(rule));
+  }
+}
+
+IgnoreRules::Verdict IgnoreRules::Judge(std::string_view path,
+                                        bool directory) const {
+  const size_t slash = path.rfind('/');
+  const std::string_view base =
+      slash == std::string_view::npos ? path : path.substr(slash + 1);
+  for (auto it = rules_.rbegin(); it != rules_.rend(); ++it) {
+    if (it->directoryOnly && !directory) {
+      continue;
+    }
+    if (GlobMatch(it->glob, it->anchored ? path : base)) {
+      return it->negate ? Verdict::kKeep : Verdict::kIgnore;
+    }
+  }
+  return Verdict::kNone;
+}
+
+WalkResult WalkTree(const std::string &root, const WalkOptions &options) {
+  return Walker(options).Run(root);
+}
+
+} // namespace cppshell
@@ -1,110 +1,1377 @@
 #include "cppshell/grep_command.hpp"
-#include "CLI/CLI.hpp"
+#include "cppshell/binary_detect.hpp"
+#include "cppshell/cooperative.hpp"
+#include "cppshell/file_walker.hpp"
+#include "cppshell/grep_matcher.hpp"
+#include "cppshell/line_channel.hpp"
+#include "cppshell/spill_queue.hpp"
+#include "cppshell/thread_pool.hpp"
+#include "cppshell/trigram_index.hpp"
 
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
-#include <regex>
-#include <sstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 
 namespace cppshell {
 
+namespace {
+
+/**
+ * Chunks a worker may be matching per thread before the oldest result must
+ * be written out. Bounds memory to a few chunks per worker.
+ */
+constexpr size_t kReorderWindowPerWorker = 2;
+
+/**
+ * Bytes grep reads from a file or stream at a time. Larger blocks measured
+ * no faster: the block no longer stays in cache while it is searched.
+ */
+constexpr size_t kBlockSize = 64 * 1024;
+
+/**
+ * Longest line kept in memory whole. A longer line is judged piece by
+ * piece while its bytes wait in a SpillQueue, of which at most
+ * kLongLineMemory stay in memory.
+ */
+constexpr size_t kMaxLineBytes = 8 * 1024 * 1024;
+constexpr size_t kLongLineMemory = 1024 * 1024;
+
+/**
+ * Bytes of selected lines a worker buffers for a file that is searched
+ * ahead of its turn. A worker that reaches it stops and leaves the rest of
+ * the file to be searched when the file is written out.
+ */
+constexpr size_t kFileBufferLimit = 1024 * 1024;
+
+/** Returns true if a file operand stands for the standard input. */
+[[nodiscard]] bool IsStdin(const std::string &file) {
+  return file.empty() || file == "-";
+}
+
+/** How grep names the standard input in -l and -L output. */
+constexpr std::string_view kStdinName = "(standard input)";
+
+/** Strips the "\n" or "\r\n" terminator from a line. */
+[[nodiscard]] std::string_view StripTerminator(std::string_view raw) {
+  if (!raw.empty() && raw.back() == '\n') {
+    raw.remove_suffix(1);
+  }
+  if (!raw.empty() && raw.back() == '\r') {
+    raw.remove_suffix(1);
+  }
+  return raw;
+}
+
+/** Returns true if `raw` ends in a plain "\n", not in "\r\n". */
+[[nodiscard]] bool EndsInNewline(std::string_view raw) {
+  return !raw.empty() && raw.back() == '\n' &&
+         (raw.size() == 1 || raw[raw.size() - 2] != '\r');
+}
+
+/** Writes line `i` of `chunk`, ending it with a plain "\n". */
+void EmitLine(LineSink &sink, const std::shared_ptr<const LineChunk> &chunk,
+              size_t i) {
+  const std::string_view raw = chunk->Line(i);
+  // Lines that need no normalisation are passed on without copying.
+  if (EndsInNewline(raw)) {
+    sink.Forward(chunk, i);
+  } else {
+    sink.WriteLine(StripTerminator(raw));
+  }
+}
+
+/** What grep reports about the lines it selects. */
+/** What grep does with a file whose first block LooksBinary(). */
+enum class BinaryFiles {
+  /** Search it, but print "Binary file NAME matches" for its lines. */
+  kBinary,
+  /** -a: search it as text. */
+  kText,
+  /** -I: take it, unread, for a file without selected lines. */
+  kWithoutMatch,
+  /** -r without any of the above: leave it out, as if it were not there. */
+  kSkip,
+};
+
+struct ReportOptions {
+  /** -v: select the lines that do not match. */
+  bool invert = false;
+  /** -c: print the number of selected lines of each file. */
+  bool count = false;
+  /** -l: print the names of files with a selected line. */
+  bool filesWithMatches = false;
+  /** -L: print the names of files without one. */
+  bool filesWithoutMatch = false;
+  /** -q: print nothing and exit at the first selected line. */
+  bool quiet = false;
+  /** -n: prefix each line with its number in its file. */
+  bool lineNumbers = false;
+  /** -r: prefix each line and count with the name of its file. */
+  bool withFilename = false;
+  /** --binary-files: how files that look binary are searched. */
+  BinaryFiles binaryFiles = BinaryFiles::kBinary;
+  /** -m: stop reading a file after this many selected lines; -1 if never. */
+  long long maxCount = -1;
+  /** -A: lines of trailing context after each selected line. */
+  int afterContext = 0;
+  /** -B: lines of leading context before each selected line. */
+  int beforeContext = 0;
+
+  /** Returns true if selected lines are printed with context around. */
+  [[nodiscard]] bool WithContext() const {
+    return (afterContext > 0 || beforeContext > 0) && PrintsLines();
+  }
+
+  /** Returns true if only whether a file has a selected line matters. */
+  [[nodiscard]] bool FirstOnly() const {
+    return quiet || filesWithMatches || filesWithoutMatch;
+  }
+
+  /** Returns true if lines are written after a prefix. */
+  [[nodiscard]] bool Prefixed() const { return lineNumbers || withFilename; }
+
+  /** Returns true if the selected lines themselves are written out. */
+  [[nodiscard]] bool PrintsLines() const { return !count && !FirstOnly(); }
+
+  /**
+   * The options for a file that looks binary under kBinary: where lines
+   * would be printed, only whether one is selected matters.
+   */
+  [[nodiscard]] ReportOptions ForBinary() const {
+    ReportOptions binary = *this;
+    binary.quiet = binary.quiet || PrintsLines();
+    return binary;
+  }
+
+  /** Selected lines after which the rest of a file cannot matter. */
+  [[nodiscard]] size_t Limit() const {
+    const size_t limit =
+        maxCount < 0 ? SIZE_MAX : static_cast<size_t>(maxCount);
+    return FirstOnly() ? std::min<size_t>(limit, 1) : limit;
+  }
+};
+
+/**
+ * Lines selected from one block or chunk. `selected` is their number.
+ * Unless only that number matters, `lines` holds them, sharing the storage
+ * of the input; `numbers` holds the index of each within the input (always
+ * for chunks, for blocks only under -n) and `lineCount` the number of
+ * lines the input had (for blocks only under -v or -n).
+ */
+struct Selection {
+  size_t selected = 0;
+  std::shared_ptr<const LineChunk> lines;
+  std::vector<size_t> numbers;
+  size_t lineCount = 0;
+};
+
+/**
+ * Selects the lines of a block read by a BlockReader: those that do not
+ * match if kInvert, keeping them if kKeep and their numbers if kNumbers.
+ */
+template <bool kInvert, bool kKeep, bool kNumbers>
+Selection SelectFromBlock(const std::shared_ptr<const std::string> &block,
+                          const GrepMatcher &matcher) {
+  static_assert(kKeep || !kNumbers);
+  std::vector<LineSpan> spans;
+  matcher.MatchBlock(*block, spans);
+  Selection selection;
+  const std::string_view data(*block);
+  if constexpr (!kInvert && !kNumbers) {
+    selection.selected = spans.size();
+    if constexpr (kKeep) {
+      auto selected = std::make_shared<LineChunk>();
+      selected->data = block;
+      selected->lines = std::move(spans);
+      selection.lines = std::move(selected);
+    }
+    return selection;
+  } else if constexpr (!kKeep) {
+    // Only how many lines did not match.
+    const size_t lines =
+        static_cast<size_t>(std::count(data.begin(), data.end(), '\n')) +
+        (data.empty() || data.back() == '\n' ? 0 : 1);
+    selection.selected = lines - spans.size();
+    selection.lineCount = lines;
+    return selection;
+  } else {
+    auto selected = std::make_shared<LineChunk>();
+    selected->data = block;
+    size_t pos = 0;
+    size_t line = 0;
+    // Takes the lines in [pos, end), none of which matched.
+    const auto skip = [&](size_t end) {
+      if constexpr (!kInvert) {
+        line += static_cast<size_t>(
+            std::count(data.begin() + static_cast<std::ptrdiff_t>(pos),
+                       data.begin() + static_cast<std::ptrdiff_t>(end), '\n'));
+        pos = end;
+        return;
+      }
+      while (pos < end) {
+        const size_t nl = data.find('\n', pos);
+        const size_t lineEnd = nl == std::string_view::npos ? end : nl + 1;
+        selected->lines.push_back(LineSpan{pos, lineEnd - pos});
+        if constexpr (kNumbers) {
+          selection.numbers.push_back(line);
+        }
+        ++line;
+        pos = lineEnd;
+      }
+    };
+    for (const LineSpan &span : spans) {
+      skip(span.offset);
+      if constexpr (!kInvert) {
+        selected->lines.push_back(span);
+        selection.numbers.push_back(line);
+      }
+      ++line;
+      pos = span.offset + span.size;
+    }
+    skip(data.size());
+    selection.selected = selected->lines.size();
+    selection.lineCount = line;
+    selection.lines = std::move(selected);
+    return selection;
+  }
+}
+
+/**
+ * Selects the lines of a chunk taken from a LineChannel: those that do not
+ * match if kInvert, keeping them if kKeep.
+ */
+template <bool kInvert, bool kKeep>
+Selection SelectFromChunk(const std::shared_ptr<const LineChunk> &chunk,
+                          const GrepMatcher &matcher) {
+  std::vector<size_t> matches;
+  matcher.MatchLines(*chunk, matches);
+  Selection selection;
+  selection.lineCount = chunk->lines.size();
+  if constexpr (!kKeep) {
+    selection.selected =
+        kInvert ? chunk->lines.size() - matches.size() : matches.size();
+    return selection;
+  }
+  if constexpr (!kInvert) {
+    selection.numbers = std::move(matches);
+  } else {
+    size_t next = 0;
+    for (size_t i = 0; i < chunk->lines.size(); ++i) {
+      if (next < matches.size() && matches[next] == i) {
+        ++next;
+      } else {
+        selection.numbers.push_back(i);
+      }
+    }
+  }
+  auto selected = std::make_shared<LineChunk>();
+  selected->data = chunk->data;
+  selected->lines.reserve(selection.numbers.size());
+  for (const size_t i : selection.numbers) {
+    selected->lines.push_back(chunk->lines[i]);
+  }
+  selection.selected = selected->lines.size();
+  selection.lines = std::move(selected);
+  return selection;
+}
+
+/** What grep knows so far about the file it reads. */
+struct FileTally {
+  /** Lines selected. */
+  size_t selected = 0;
+  /** Lines read, counted under -n only. */
+  size_t lines = 0;
+  /** Set once the rest of the file cannot change what is reported. */
+  bool done = false;
+};
+
+/**
+ * Counts the lines of `selection` into `tally` and returns how many of the
+ * first ones are reported: fewer than all once ReportOptions::Limit() is
+ * reached.
+ */
+size_t Take(const Selection &selection, const ReportOptions &report,
+            FileTally &tally) {
+  const size_t limit = report.Limit();
+  const size_t take = std::min(selection.selected, limit - tally.selected);
+  tally.selected += take;
+  tally.done = tally.selected >= limit;
+  return take;
+}
+
+/**
+ * The -r and -n prefix of line `number` (from 1) of file `name`: each part
+ * is followed by ':' for selected lines and by '-' for context.
+ */
+[[nodiscard]] std::string LinePrefix(const ReportOptions &report,
+                                     std::string_view name, size_t number,
+                                     char separator) {
+  std::string prefix;
+  if (report.withFilename) {
+    prefix.append(name);
+    prefix.push_back(separator);
+  }
+  if (report.lineNumbers) {
+    prefix.append(std::to_string(number));
+    prefix.push_back(separator);
+  }
+  return prefix;
+}
+
+/** Writes `line` after `prefix`. */
+void WritePrefixed(LineSink &sink, std::string prefix, std::string_view line) {
+  prefix.append(StripTerminator(line));
+  sink.WriteLine(prefix);
+}
+
+/**
+ * Counts `selection` into `tally` and writes the lines grep prints of it:
+ * none unless kPrints, each after its -n number if kNumbers and its file
+ * name if kFilename. Selections must arrive in input order.
+ */
+template <bool kPrints, bool kNumbers, bool kFilename>
+void Report(LineSink &sink, const Selection &selection,
+            const ReportOptions &report, std::string_view name,
+            FileTally &tally) {
+  const size_t take = Take(selection, report, tally);
+  if constexpr (kPrints && (kNumbers || kFilename)) {
+    // One buffer for all lines, like LinePrefix() and WritePrefixed().
+    std::string line;
+    for (size_t i = 0; i < take; ++i) {
+      line.clear();
+      if constexpr (kFilename) {
+        line.append(name);
+        line.push_back(':');
+      }
+      if constexpr (kNumbers) {
+        char digits[24];
+        const size_t number = tally.lines + selection.numbers[i] + 1;
+        line.append(digits,
+                    std::to_chars(digits, std::end(digits), number).ptr);
+        line.push_back(':');
+      }
+      line.append(StripTerminator(selection.lines->Line(i)));
+      sink.WriteLine(line);
+    }
+  } else if constexpr (kPrints) {
+    size_t i = 0;
+    while (i < take) {
+      // Runs of lines that need no normalisation go out at once.
+      size_t end = i;
+      while (end < take && EndsInNewline(selection.lines->Line(end))) {
+        ++end;
+      }
+      if (end > i) {
+        sink.Forward(selection.lines, i, end);
+        i = end;
+      } else {
+        EmitLine(sink, selection.lines, i++);
+      }
+    }
+  }
+  tally.lines += selection.lineCount;
+}
+
+/**
+ * The loops grep runs over the lines of each block or chunk, instantiated
+ * per combination of the options they depend on and picked once per file,
+ * so that none of them tests an option per line.
+ */
+struct GrepLoops {
+  using SelectBlock = Selection (*)(const std::shared_ptr<const std::string> &,
+                                    const GrepMatcher &);
+  using SelectChunk = Selection (*)(const std::shared_ptr<const LineChunk> &,
+                                    const GrepMatcher &);
+  using ReportLines = void (*)(LineSink &, const Selection &,
+                               const ReportOptions &, std::string_view,
+                               FileTally &);
+
+  SelectBlock selectBlock = nullptr;
+  SelectChunk selectChunk = nullptr;
+  ReportLines report = nullptr;
+
+  /** The loops for a file searched with `report`. */
+  [[nodiscard]] static GrepLoops For(const ReportOptions &report) {
+    GrepLoops loops;
+    if (!report.PrintsLines()) {
+      loops.selectBlock = report.invert
+                              ? &SelectFromBlock<true, false, false>
+                              : &SelectFromBlock<false, false, false>;
+      loops.selectChunk = report.invert ? &SelectFromChunk<true, false>
+                                        : &SelectFromChunk<false, false>;
+      loops.report = &Report<false, false, false>;
+      return loops;
+    }
+    // Indexed by -v and -n, and by -n and -r.
+    static constexpr SelectBlock kSelectBlock[] = {
+        &SelectFromBlock<false, true, false>,
+        &SelectFromBlock<false, true, true>,
+        &SelectFromBlock<true, true, false>,
+        &SelectFromBlock<true, true, true>,
+    };
+    static constexpr ReportLines kReport[] = {
+        &Report<true, false, false>,
+        &Report<true, false, true>,
+        &Report<true, true, false>,
+        &Report<true, true, true>,
+    };
+    const size_t numbers = report.lineNumbers ? 1 : 0;
+    loops.selectBlock = kSelectBlock[(report.invert ? 2 : 0) + numbers];
+    loops.selectChunk = report.invert ? &SelectFromChunk<true, true>
+                                      : &SelectFromChunk<false, true>;
+    loops.report = kReport[numbers * 2 + (report.withFilename ? 1 : 0)];
+    return loops;
+  }
+};
+
+/**
+ * Follows a line longer than kMaxLineBytes through the pieces a
+ * BlockReader hands out. Its bytes are queued until the matcher decides;
+ * a selected line is then written straight to `out`, the rest dropped.
+ */
+class LongLine {
+public:
+  /**
+   * Writes the line if it is selected and `print` is set, after `prefix`
+   * (its -n number). Without `print` nothing is queued.
+   */
+  LongLine(const GrepMatcher &matcher, std::ostream &out, bool invert,
+           bool print, std::string prefix)
+      : feed_(matcher), out_(out), held_(kLongLineMemory, SIZE_MAX),
+        prefix_(std::move(prefix)), invert_(invert), print_(print) {}
+
+  /** Takes the next piece; `last` if the line ends in it. */
+  void Add(std::string_view piece, bool last) {
+    if (last) {
+      if (!piece.empty() && piece.back() == '\n') {
+        piece.remove_suffix(1);
+      }
+      if (piece.empty()) {
+        heldCr_ = false; // It was the "\r\n" terminator.
+      } else if (piece.back() == '\r') {
+        piece.remove_suffix(1);
+      }
+    }
+    if (heldCr_) {
+      heldCr_ = false;
+      Take("\r");
+    }
+    // A '\r' at the end of a piece is only text if the line goes on.
+    if (!last && !piece.empty() && piece.back() == '\r') {
+      piece.remove_suffix(1);
+      heldCr_ = true;
+    }
+    Take(piece);
+    if (last) {
+      matched_ = feed_.End();
+      if (Selected() && print_) {
+        Drain();
+        out_.put('\n');
+      }
+    }
+  }
+
+  /** Returns true if the line was selected. Valid once it ended. */
+  [[nodiscard]] bool Selected() const { return matched_ != invert_; }
+
+  /** Why queued bytes were lost, empty if none were. */
+  [[nodiscard]] const std::string &Error() const { return held_.Error(); }
+
+private:
+  void Take(std::string_view text) {
+    if (!matched_ && feed_.Feed(text)) {
+      matched_ = true;
+    }
+    // A matching line is written as it arrives, unless -v drops it.
+    if (!print_ || (matched_ && invert_)) {
+      return;
+    }
+    if (matched_) {
+      Drain();
+      out_.write(text.data(), static_cast<std::streamsize>(text.size()));
+    } else {
+      static_cast<void>(held_.Append(text));
+    }
+  }
+
+  void Drain() {
+    out_ << prefix_;
+    prefix_.clear();
+    std::string buffer;
+    while (held_.Take(buffer, kLongLineMemory) > 0) {
+      out_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+  }
+
+  GrepMatcher::LineFeed feed_;
+  std::ostream &out_;
+  SpillQueue held_;
+  std::string prefix_;
+  bool invert_;
+  bool print_;
+  bool heldCr_ = false;
+  bool matched_ = false;
+};
+
+/**
+ * The last lines read, as slices of the chunks they came in, for -B. Whole
+ * chunks are kept, only as many as the newest `capacity` lines span, so no
+ * line is copied and nothing is done per line. Memory stays within
+ * `capacity` lines and one chunk.
+ */
+class LineHistory {
+public:
+  /** A remembered chunk; its first line is line `first` of the file. */
+  struct Entry {
+    std::shared_ptr<const LineChunk> chunk;
+    size_t first = 0;
+  };
+
+  explicit LineHistory(size_t capacity) : capacity_(capacity) {}
+
+  /** Remembers `chunk`, which follows the chunks remembered so far. */
+  void Push(std::shared_ptr<const LineChunk> chunk, size_t first) {
+    if (capacity_ == 0 || chunk->lines.empty()) {
+      return;
+    }
+    held_ += chunk->lines.size();
+    chunks_.push_back(Entry{std::move(chunk), first});
+    while (held_ - chunks_.front().chunk->lines.size() >= capacity_) {
+      held_ -= chunks_.front().chunk->lines.size();
+      chunks_.pop_front();
+    }
+  }
+
+  /** The chunk holding line `number`, one of the newest `capacity`. */
+  [[nodiscard]] const Entry &Find(size_t number) const {
+    auto it = chunks_.end();
+    do {
+      --it;
+    } while (it->first > number);
+    return *it;
+  }
+
+private:
+  size_t capacity_;
+  std::deque<Entry> chunks_;
+  // Lines in chunks_.
+  size_t held_ = 0;
+};
+
+/**
+ * Prints selected lines of one file with -A and -B context. Ranges that
+ * overlap or touch are merged; the others are separated by "--".
+ */
+class ContextPrinter {
+public:
+  ContextPrinter(LineSink &sink, const ReportOptions &report,
+                 std::string_view name)
+      : sink_(sink), report_(report), name_(name),
+        history_(static_cast<size_t>(report.beforeContext)) {}
+
+  /** Returns true if -A context is owed to line `number` or later. */
+  [[nodiscard]] bool Owes(size_t number) const { return number < afterEnd_; }
+
+  /**
+   * Prints what `chunk`, whose selected lines are `selection`, contributes
+   * and counts it into `tally`. Past the -m limit only owed context is
+   * printed.
+   */
+  void Add(const std::shared_ptr<const LineChunk> &chunk,
+           const Selection &selection, FileTally &tally) {
+    const size_t base = tally.lines;
+    tally.lines += chunk->lines.size();
+    if (selection.numbers.empty() && !Owes(base)) {
+      history_.Push(chunk, base);
+      return;
+    }
+    size_t next = 0;
+    for (size_t i = 0; i < chunk->lines.size(); ++i) {
+      const size_t number = base + i;
+      bool match = next < selection.numbers.size() &&
+                   selection.numbers[next] == i;
+      if (match) {
+        ++next;
+      }
+      if (tally.done) {
+        if (!Owes(number)) {
+          break;
+        }
+        match = false;
+      }
+      if (match) {
+        ++tally.selected;
+        tally.done = tally.selected >= report_.Limit();
+        const size_t before = static_cast<size_t>(report_.beforeContext);
+        const size_t from =
+            std::max(unprinted_, number - std::min(number, before));
+        if (printed_ && from > unprinted_) {
+          sink_.WriteLine("--");
+        }
+        for (size_t k = from; k < number; ++k) {
+          if (k >= base) {
+            Print(chunk, k - base, k, '-');
+          } else {
+            const LineHistory::Entry &entry = history_.Find(k);
+            Print(entry.chunk, k - entry.first, k, '-');
+          }
+        }
+        Print(chunk, i, number, ':');
+        afterEnd_ = number + 1 + static_cast<size_t>(report_.afterContext);
+      } else if (Owes(number)) {
+        Print(chunk, i, number, '-');
+      }
+    }
+    history_.Push(chunk, base);
+  }
+
+private:
+  void Print(const std::shared_ptr<const LineChunk> &chunk, size_t i,
+             size_t number, char separator) {
+    if (report_.Prefixed()) {
+      WritePrefixed(sink_, LinePrefix(report_, name_, number + 1, separator),
+                    chunk->Line(i));
+    } else {
+      EmitLine(sink_, chunk, i);
+    }
+    printed_ = true;
+    unprinted_ = number + 1;
+  }
+
+  LineSink &sink_;
+  const ReportOptions &report_;
+  std::string_view name_;
+  LineHistory history_;
+  // The first line not printed yet, and whether any line was.
+  size_t unprinted_ = 0;
+  bool printed_ = false;
+  // The first line after the owed -A context.
+  size_t afterEnd_ = 0;
+};
+
+/** A file argument searched on the worker pool ahead of its turn. */
+struct FileSearch {
+  /** False if the file could not be opened. */
+  bool opened = false;
+  /**
+   * True if the file looks binary and is not searched as text; under
+   * kBinary it was searched with ReportOptions::ForBinary().
+   */
+  bool binary = false;
+  /** The lines selected and read so far. */
+  FileTally tally;
+  /** The lines to print, each ending in a plain "\n". */
+  std::vector<std::shared_ptr<const LineChunk>> output;
+  /**
+   * Set if the search stopped at the buffer limit or at a long line;
+   * `reader` reads the rest, after the block in `next` if it has data.
+   */
+  std::unique_ptr<std::istream> stream;
+  std::unique_ptr<BlockReader> reader;
+  BlockReader::Block next;
+};
+
+/**
+ * Searches `path` until its end, until its answer is known, until
+ * kFileBufferLimit bytes of lines were selected, or until a long line,
+ * which needs the output stream. Runs on a pool worker, so it never
+ * touches the sink.
+ */
+FileSearch SearchFile(const std::string &path, const GrepMatcher &matcher,
+                      const ReportOptions &options, size_t maxLine) {
+  const ReportOptions binaryOptions = options.ForBinary();
+  const GrepLoops textLoops = GrepLoops::For(options);
+  const GrepLoops binaryLoops = GrepLoops::For(binaryOptions);
+  FileSearch found;
+  std::unique_ptr<std::istream> stream = std::make_unique<std::ifstream>(path);
+  if (!*stream) {
+    return found;
+  }
+  found.opened = true;
+  found.tally.done = options.Limit() == 0;
+  auto reader = std::make_unique<BlockReader>(*stream, kBlockSize, maxLine);
+  size_t buffered = 0;
+  bool first = true;
+  while (buffered < kFileBufferLimit && !found.tally.done) {
+    BlockReader::Block block = reader->Next();
+    if (block.data == nullptr) {
+      return found;
+    }
+    if (first && options.binaryFiles != BinaryFiles::kText &&
+        LooksBinary(*block.data)) {
+      found.binary = true;
+      if (options.binaryFiles == BinaryFiles::kWithoutMatch ||
+          options.binaryFiles == BinaryFiles::kSkip) {
+        return found;
+      }
+    }
+    first = false;
+    const ReportOptions &report = found.binary ? binaryOptions : options;
+    const GrepLoops &loops = found.binary ? binaryLoops : textLoops;
+    if (block.longLine) {
+      found.next = std::move(block);
+      break;
+    }
+    const Selection selection = loops.selectBlock(block.data, matcher);
+    const size_t take = Take(selection, report, found.tally);
+    if (report.PrintsLines() && take > 0) {
+      auto data = std::make_shared<std::string>();
+      auto selected = std::make_shared<LineChunk>();
+      for (size_t i = 0; i < take; ++i) {
+        const size_t start = data->size();
+        if (report.Prefixed()) {
+          data->append(LinePrefix(
+              report, path,
+              report.lineNumbers
+                  ? found.tally.lines + selection.numbers[i] + 1
+                  : 0,
+              ':'));
+        }
+        data->append(StripTerminator(selection.lines->Line(i)));
+        data->push_back('\n');
+        selected->lines.push_back(LineSpan{start, data->size() - start});
+      }
+      buffered += data->size();
+      selected->data = std::move(data);
+      found.output.push_back(std::move(selected));
+    }
+    found.tally.lines += selection.lineCount;
+  }
+  if (found.tally.done) {
+    return found;
+  }
+  found.stream = std::move(stream);
+  found.reader = std::move(reader);
+  return found;
+}
+
+/** Marks -A and -B as not given, so that -C applies. */
+constexpr int kUnsetContext = std::numeric_limits<int>::min();
+
+/** Everything grep's arguments set. */
+struct GrepSettings {
+  /** The pattern (unless -e or -f is given) and the files to search. */
+  std::vector<std::string> operands;
+  std::vector<std::string> expressions;
+  std::vector<std::string> patternFiles;
+  GrepPatternOptions pattern;
+  ReportOptions report;
+  int afterContext = kUnsetContext;
+  int beforeContext = kUnsetContext;
+  int bothContext = 0;
+  bool recursive = false;
+  /** --binary-files, -a or -I; without them -r skips binary files. */
+  std::optional<BinaryFiles> binaryFiles;
+  WalkOptions walk;
+  std::string sort = "none";
+  /** --index-build: the directory to index instead of searching. */
+  std::string indexBuild;
+  /** --index: the indexed directory to search. */
+  std::string index;
+  /** --cache-stats: report the GrepMatcherCache counters on stderr. */
+  bool cacheStats = false;
+  bool help = false;
+};
+
+/** Reads a whole decimal number, as -m and -A take. */
+template <typename T>
+[[nodiscard]] bool ParseNumber(std::string_view text, T &value) {
+  const char *end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  return ec == std::errc{} && ptr == end && !text.empty();
+}
+
+/** Reads the NUM of -A, -B or -C; returns the error, if any. */
+[[nodiscard]] std::string SetContext(int &lines, std::string_view value) {
+  return ParseNumber(value, lines)
+             ? std::string()
+             : std::string(value) + ": invalid context length argument";
+}
+
+/** One grep option: how it is spelled and what it sets. */
+struct GrepOption {
+  /** '\0' if the option has no short name. */
+  char shortName;
+  /** Empty if the option has no long name. */
+  std::string_view longName;
+  /** What the option takes, as --help names it; empty for a flag. */
+  std::string_view valueName;
+  std::string_view description;
+  /** Sets the option from its value; returns the error, if any. */
+  std::string (*apply)(GrepSettings &settings, std::string_view value);
+};
+
+/**
+ * grep's options. The table is fixed at compile time, so parsing a
+ * grep invocation is a scan over the arguments with no setup of its own.
+ */
+constexpr std::array kGrepOptions = {
+    GrepOption{'e', "regexp", "PATTERN", "Use PATTERN for matching",
+               [](GrepSettings &s, std::string_view v) {
+                 s.expressions.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'f', "file", "FILE", "Take patterns from FILE, one per line",
+               [](GrepSettings &s, std::string_view v) {
+                 s.patternFiles.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'i', "ignore-case", "", "Ignore case distinctions",
+               [](GrepSettings &s, std::string_view) {
+                 s.pattern.ignoreCase = true;
+                 return std::string();
+               }},
+    GrepOption{'w', "word-regexp", "",
+               "Select only those lines containing matches that form whole "
+               "words",
+               [](GrepSettings &s, std::string_view) {
+                 s.pattern.wordRegexp = true;
+                 return std::string();
+               }},
+    GrepOption{'F', "fixed-strings", "", "Interpret PATTERN as a fixed string",
+               [](GrepSettings &s, std::string_view) {
+                 s.pattern.fixedStrings = true;
+                 return std::string();
+               }},
+    GrepOption{'v', "invert-match", "", "Select non-matching lines",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.invert = true;
+                 return std::string();
+               }},
+    GrepOption{'c', "count", "",
+               "Print only a count of selected lines per FILE",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.count = true;
+                 return std::string();
+               }},
+    GrepOption{'l', "files-with-matches", "",
+               "Print only names of FILEs with selected lines",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.filesWithMatches = true;
+                 return std::string();
+               }},
+    GrepOption{'L', "files-without-match", "",
+               "Print only names of FILEs with no selected lines",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.filesWithoutMatch = true;
+                 return std::string();
+               }},
+    GrepOption{'q', "quiet", "", "Suppress all normal output",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.quiet = true;
+                 return std::string();
+               }},
+    GrepOption{'\0', "silent", "", "Same as --quiet",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.quiet = true;
+                 return std::string();
+               }},
+    GrepOption{'n', "line-number", "", "Print line number with output lines",
+               [](GrepSettings &s, std::string_view) {
+                 s.report.lineNumbers = true;
+                 return std::string();
+               }},
+    GrepOption{'m', "max-count", "NUM", "Stop after NUM selected lines",
+               [](GrepSettings &s, std::string_view v) {
+                 return ParseNumber(v, s.report.maxCount)
+                            ? std::string()
+                            : "invalid max count";
+               }},
+    GrepOption{'A', "after-context", "NUM",
+               "Print NUM lines of trailing context",
+               [](GrepSettings &s, std::string_view v) {
+                 return SetContext(s.afterContext, v);
+               }},
+    GrepOption{'B', "before-context", "NUM",
+               "Print NUM lines of leading context",
+               [](GrepSettings &s, std::string_view v) {
+                 return SetContext(s.beforeContext, v);
+               }},
+    GrepOption{'C', "context", "NUM",
+               "Print NUM lines of context on both sides",
+               [](GrepSettings &s, std::string_view v) {
+                 return SetContext(s.bothContext, v);
+               }},
+    GrepOption{'\0', "binary-files", "TYPE",
+               "How to search binary files: binary, text or without-match",
+               [](GrepSettings &s, std::string_view v) {
+                 if (v == "binary") {
+                   s.binaryFiles = BinaryFiles::kBinary;
+                 } else if (v == "text") {
+                   s.binaryFiles = BinaryFiles::kText;
+                 } else if (v == "without-match") {
+                   s.binaryFiles = BinaryFiles::kWithoutMatch;
+                 } else {
+                   return "invalid argument '" + std::string(v) +
+                          "' for --binary-files";
+                 }
+                 return std::string();
+               }},
+    GrepOption{'a', "text", "", "Same as --binary-files=text",
+               [](GrepSettings &s, std::string_view) {
+                 s.binaryFiles = BinaryFiles::kText;
+                 return std::string();
+               }},
+    GrepOption{'I', "", "", "Same as --binary-files=without-match",
+               [](GrepSettings &s, std::string_view) {
+                 s.binaryFiles = BinaryFiles::kWithoutMatch;
+                 return std::string();
+               }},
+    GrepOption{'r', "recursive", "", "Search directories recursively",
+               [](GrepSettings &s, std::string_view) {
+                 s.recursive = true;
+                 return std::string();
+               }},
+    GrepOption{'R', "dereference-recursive", "",
+               "Search directories recursively, following all symlinks",
+               [](GrepSettings &s, std::string_view) {
+                 s.walk.followLinks = true;
+                 return std::string();
+               }},
+    GrepOption{'\0', "include", "GLOB",
+               "Search only files whose name matches GLOB",
+               [](GrepSettings &s, std::string_view v) {
+                 s.walk.include.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'\0', "exclude", "GLOB", "Skip files whose name matches GLOB",
+               [](GrepSettings &s, std::string_view v) {
+                 s.walk.exclude.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'\0', "exclude-dir", "GLOB",
+               "Skip directories whose name matches GLOB",
+               [](GrepSettings &s, std::string_view v) {
+                 s.walk.excludeDir.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'\0', "ignore-file", "NAME",
+               "Read gitignore-style rules from files named NAME",
+               [](GrepSettings &s, std::string_view v) {
+                 s.walk.ignoreFiles.emplace_back(v);
+                 return std::string();
+               }},
+    GrepOption{'\0', "sort", "ORDER",
+               "Order of the files found in directories: none or path",
+               [](GrepSettings &s, std::string_view v) {
+                 s.sort = v;
+                 return std::string();
+               }},
+    GrepOption{'\0', "index-build", "DIR",
+               "Write a trigram index of the files under DIR and exit",
+               [](GrepSettings &s, std::string_view v) {
+                 s.indexBuild = v;
+                 return v.empty() ? "invalid argument '' for --index-build"
+                                  : std::string();
+               }},
+    GrepOption{'\0', "index", "DIR",
+               "Search the files under DIR, skipping those its index rules "
+               "out",
+               [](GrepSettings &s, std::string_view v) {
+                 s.index = v;
+                 return v.empty() ? "invalid argument '' for --index"
+                                  : std::string();
+               }},
+    GrepOption{'\0', "cache-stats", "",
+               "Print the compiled pattern cache counters to stderr",
+               [](GrepSettings &s, std::string_view) {
+                 s.cacheStats = true;
+                 return std::string();
+               }},
+    GrepOption{'h', "help", "", "Print this help message and exit",
+               [](GrepSettings &s, std::string_view) {
+                 s.help = true;
+                 return std::string();
+               }},
+};
+
+constexpr std::string_view kGrepUsage =
+    "Usage: grep [OPTION]... PATTERN [FILE]...\n";
+
+/** Writes --help: the usage line and the option table. */
+void WriteGrepHelp(std::ostream &out) {
+  out << kGrepUsage << "Search for PATTERN in each FILE.\n\nOptions:\n";
+  for (const GrepOption &option : kGrepOptions) {
+    std::string names = option.shortName != '\0'
+                            ? std::string{'-', option.shortName}
+                            : std::string("  ");
+    if (!option.longName.empty()) {
+      names += option.shortName != '\0' ? ", --" : "  --";
+      names += option.longName;
+    }
+    if (!option.valueName.empty()) {
+      names += '=';
+      names += option.valueName;
+    }
+    out << "  " << std::left << std::setw(32) << names << option.description
+        << "\n";
+  }
+}
+
+/**
+ * Parses grep's arguments into `settings`, GNU style: options and operands
+ * mix freely until "--", flags combine ("-in"), and a value follows its
+ * option attached ("-A2", "--context=2") or as the next argument. Returns
+ * the message to report after "grep: ", empty if the arguments are good.
+ */
+[[nodiscard]] std::string ParseGrepArgs(const std::vector<std::string> &args,
+                                        GrepSettings &settings) {
+  const auto usage = [](std::string message) {
+    return message + "\n" + std::string(kGrepUsage) +
+           "Try 'grep --help' for more information.";
+  };
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string_view arg = args[i];
+    if (arg == "--") {
+      settings.operands.insert(settings.operands.end(), args.begin() + i + 1,
+                               args.end());
+      break;
+    }
+    if (arg.size() < 2 || arg[0] != '-') {
+      settings.operands.push_back(args[i]);
+      continue;
+    }
+
+    if (arg[1] == '-') {
+      const size_t equals = arg.find('=');
+      const std::string_view name = arg.substr(2, equals - 2);
+      const auto option =
+          std::ranges::find(kGrepOptions, name, &GrepOption::longName);
+      if (name.empty() || option == kGrepOptions.end()) {
+        return usage("unrecognized option '" + std::string(arg) + "'");
+      }
+      std::string_view value;
+      if (option->valueName.empty()) {
+        if (equals != std::string_view::npos) {
+          return usage("option '--" + std::string(name) +
+                       "' doesn't allow an argument");
+        }
+      } else if (equals != std::string_view::npos) {
+        value = arg.substr(equals + 1);
+      } else if (i + 1 < args.size()) {
+        value = args[++i];
+      } else {
+        return usage("option '--" + std::string(name) +
+                     "' requires an argument");
+      }
+      if (std::string error = option->apply(settings, value); !error.empty()) {
+        return error;
+      }
+      continue;
+    }
+
+    for (size_t j = 1; j < arg.size(); ++j) {
+      const char name = arg[j];
+      const auto option =
+          std::ranges::find(kGrepOptions, name, &GrepOption::shortName);
+      if (option == kGrepOptions.end()) {
+        return usage(std::string("invalid option -- '") + name + "'");
+      }
+      std::string_view value;
+      if (!option->valueName.empty()) {
+        // The rest of the argument, or else the next one, is the value.
+        if (j + 1 < arg.size()) {
+          value = arg.substr(j + 1);
+        } else if (i + 1 < args.size()) {
+          value = args[++i];
+        } else {
+          return usage(std::string("option requires an argument -- '") +
+                       name + "'");
+        }
+        j = arg.size();
+      }
+      if (std::string error = option->apply(settings, value); !error.empty()) {
+        return error;
+      }
+    }
+  }
+  return {};
+}
+
+} // namespace
+
 GrepCommand::GrepCommand(std::vector<std::string> args)
     : args_(std::move(args)) {}
 
 CommandResult GrepCommand::Execute(CommandContext &context) {
-  // CLI11 expects a C-style `argv` array where `argv[0]` is the program name.
-  // Our `args_` vector contains only arguments, not the command name itself.
-  // We prepend a dummy "grep" string to satisfy CLI11's requirement.
-
-  std::vector<std::string> argv;
-  argv.reserve(args_.size() + 1);
-  argv.push_back("grep");
-  argv.insert(argv.end(), args_.begin(), args_.end());
-
-  // Create C-style argv array for CLI11 parsing.
-  std::vector<char *> c_argv;
-  c_argv.reserve(argv.size());
-  std::transform(
-      argv.begin(), argv.end(), std::back_inserter(c_argv),
-      [](const std::string &s) { return const_cast<char *>(s.data()); });
-
-  CLI::App app{"grep utility"};
-
-  std::string pattern;
-  std::vector<std::string> files;
-  bool ignoreCase = false;
-  bool wordRegexp = false;
-  int afterContext = 0;
+  return RunInline(*this, context);
+}
+
+StageTask GrepCommand::ExecuteCooperative(CooperativeContext &cooperative) {
+  CommandContext &context = cooperative.Context();
+
+  GrepSettings settings;
+  if (const std::string error = ParseGrepArgs(args_, settings);
+      !error.empty()) {
+    context.streams.err << "grep: " << error << "\n";
+    co_return {2};
+  }
+  if (settings.help) {
+    WriteGrepHelp(context.streams.out);
+    co_return {0};
+  }
+  std::vector<std::string> &files = settings.operands;
+  ReportOptions &report = settings.report;
+  WalkOptions &walk = settings.walk;
+  report.binaryFiles = settings.binaryFiles.value_or(BinaryFiles::kBinary);
+
+  // -A and -B take precedence over -C, whichever comes first.
+  report.afterContext = settings.afterContext != kUnsetContext
+                            ? settings.afterContext
+                            : settings.bothContext;
+  report.beforeContext = settings.beforeContext != kUnsetContext
+                             ? settings.beforeContext
+                             : settings.bothContext;
+  if (report.afterContext < 0 || report.beforeContext < 0) {
+    context.streams.err << "grep: invalid context length argument\n";
+    co_return {2};
+  }
+  if (settings.sort != "none" && settings.sort != "path") {
+    context.streams.err << "grep: invalid argument '" << settings.sort
+                        << "' for --sort\n";
+    co_return {2};
+  }
+  if (!settings.indexBuild.empty()) {
+    if (!files.empty() || !settings.expressions.empty() ||
+        !settings.patternFiles.empty() || !settings.index.empty()) {
+      context.streams.err << "grep: --index-build takes no pattern or FILE\n";
+      co_return {2};
+    }
+    const IndexBuild built =
+        TrigramIndex::Build(settings.indexBuild, WorkerCount(context.env));
+    for (const std::string &error : built.errors) {
+      context.streams.err << "grep: " << error << "\n";
+    }
+    co_return {built.written && built.errors.empty() ? 0 : 2};
+  }
+
+  // Without -e and -f the first operand is the pattern. Patterns from
+  // all sources are searched at once.
+  std::vector<std::string> patterns = std::move(settings.expressions);
+  if (patterns.empty() && settings.patternFiles.empty()) {
+    if (files.empty()) {
+      context.streams.err << "grep: no pattern given\n";
+      co_return {2};
+    }
+    patterns.push_back(std::move(files.front()));
+    files.erase(files.begin());
+  }
+  for (const std::string &file : settings.patternFiles) {
+    if (IsStdin(file)) {
+      LineSource source(context);
+      while (true) {
+        co_await cooperative.InputReady();
+        const std::shared_ptr<const LineChunk> chunk = source.Next();
+        if (chunk == nullptr) {
+          break;
+        }
+        for (size_t i = 0; i < chunk->lines.size(); ++i) {
+          patterns.emplace_back(StripTerminator(chunk->Line(i)));
+        }
+      }
+      continue;
+    }
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      context.streams.err << "grep: " << file
+                          << ": No such file or directory\n";
+      co_return {2};
+    }
+    for (std::string line; std::getline(in, line);) {
+      patterns.emplace_back(StripTerminator(line));
+    }
+  }
+
+  // Compiled once per process for the same patterns and options.
+  GrepMatcherCache &cache = GrepMatcherCache::Shared();
+  const std::shared_ptr<const GrepMatcher> compiled =
+      cache.Get(patterns, settings.pattern);
+  if (settings.cacheStats) {
+    const GrepMatcherCache::Stats stats = cache.Statistics();
+    context.streams.err << "grep: pattern cache: " << stats.hits
+                        << " hits, " << stats.misses << " misses, "
+                        << stats.evictions << " evictions, " << stats.entries
+                        << " entries\n";
+  }
+  const GrepMatcher &matcher = *compiled;
+  if (!matcher.Ok()) {
+    context.streams.err << "grep: invalid regex: " << matcher.Error() << "\n";
+    co_return {2};
+  }
+
+  int returnCode = 1; // 1 means "no line selected" (standard grep behavior)
+
+  // --index searches its directory as -r would, leaving out the files
+  // its index shows cannot hold a selected line. Under -v, -c and -L
+  // files without matches count too, so nothing is left out.
+  std::unique_ptr<TrigramIndex> index;
+  if (!settings.index.empty()) {
+    if (!files.empty()) {
+      context.streams.err << "grep: --index takes no FILE\n";
+      co_return {2};
+    }
+    files.push_back(settings.index);
+    settings.recursive = true;
+    walk.exclude.emplace_back(TrigramIndex::kFileName);
+    if (!report.invert && !report.count && !report.filesWithoutMatch) {
+      std::string error;
+      index = TrigramIndex::Open(settings.index, error);
+      if (index == nullptr) {
+        context.streams.err << "grep: " << error << "; searching every file\n";
+      }
+    }
+  }
 
-  // Define options
-  app.add_option("pattern", pattern, "Pattern to search for")->required();
-  app.add_option("files", files, "Files to search in");
-  app.add_flag("-i,--ignore-case", ignoreCase, "Ignore case distinctions");
-  app.add_flag(
-      "-w,--word-regexp", wordRegexp,
-      "Select only those lines containing matches that form whole words");
-  app.add_option("-A,--after-context", afterContext,
-                 "Print NUM lines of trailing context");
-
-  try {
-    app.parse(static_cast<int>(c_argv.size()), c_argv.data());
-  } catch (const CLI::ParseError &e) {
-    // If help flag is present, print to stdout, otherwise error
-    if (e.get_name() == "CallForHelp") {
-      std::stringstream ss;
-      app.exit(e, ss, ss);
-      context.streams.out << ss.str();
-      return {0};
-    }
-    // CLI11 formats the error message for us
-    std::stringstream ss;
-    int exitCode = app.exit(e, ss, ss);
-    context.streams.err << ss.str();
-    return {exitCode}; // Grep usually returns >0 on error
-  }
-
-  // Configure regex
-  std::regex_constants::syntax_option_type flags =
-      std::regex_constants::ECMAScript;
-  if (ignoreCase) {
-    flags |= std::regex_constants::icase;
-  }
-
-  std::regex re;
-  try {
-    // Implement -w (word regexp) logic.
-    // Ideally, we wrap the pattern with \b boundaries.
-    // This works well for standard word characters.
-    std::string finalPattern = pattern;
-    if (wordRegexp) {
-      finalPattern = "\\b" + pattern + "\\b";
-    }
-    re.assign(finalPattern, flags);
-  } catch (const std::regex_error &e) {
-    context.streams.err << "grep: invalid regex: " << e.what() << "\n";
-    return {2};
-  }
-
-  // If no files provided, read from stdin (represented by empty string in our
-  // logic below)
-  if (files.empty()) {
+  if (settings.recursive || walk.followLinks) {
+    // Directory operands are replaced by the files under them, listed in
+    // parallel. Without operands the current directory is searched and
+    // files are named relative to it.
+    report.withFilename = true;
+    report.binaryFiles = settings.binaryFiles.value_or(BinaryFiles::kSkip);
+    walk.sorted = settings.sort == "path";
+    walk.threads = WorkerCount(context.env);
+    const std::vector<std::string> operands =
+        files.empty() ? std::vector<std::string>{""} : files;
+    files.clear();
+    for (const std::string &operand : operands) {
+      std::error_code ec;
+      if (!operand.empty() &&
+          (IsStdin(operand) || !std::filesystem::is_directory(operand, ec))) {
+        files.push_back(operand);
+        continue;
+      }
+      WalkResult found = WalkTree(operand, walk);
+      for (const std::string &error : found.errors) {
+        context.streams.err << "grep: " << error << "\n";
+        returnCode = 2;
+      }
+      if (index != nullptr) {
+        found.files = index->Narrow(std::move(found.files),
+                                    TrigramQuery(patterns, settings.pattern));
+      }
+      files.insert(files.end(), std::make_move_iterator(found.files.begin()),
+                   std::make_move_iterator(found.files.end()));
+    }
+  } else if (files.empty()) {
+    // If no files provided, read from stdin (represented by empty string in
+    // our logic below)
     files.push_back("");
   }
 
-  int returnCode = 1; // 1 means "no match found" (standard grep behavior)
+  LineSink sink(context);
+
+  // Context needs the lines split, and in order on one thread.
+  const bool withContext = report.WithContext();
+
+  // Without context every line is judged on its own, so files and
+  // standard input are read in large blocks of unsplit lines and searched
+  // as a whole (GrepMatcher::MatchBlock). Lines longer than kMaxLineBytes
+  // are followed piece by piece; that needs a matcher that can stream and,
+  // if lines are printed, output that is a plain stream, since a
+  // LineChannel carries whole lines.
+  const bool blocks = !withContext;
+  size_t maxLine = SIZE_MAX;
+#ifndef _WIN32
+  if (matcher.Streams() &&
+      (!report.PrintsLines() || context.outChannel == nullptr)) {
+    maxLine = kMaxLineBytes;
+  }
+#endif
+
+  // Blocks after the first are matched on a worker pool and reported in
+  // input order. At most `window` blocks are in flight.
+  const size_t workers = withContext ? 1 : WorkerCount(context.env);
+  const size_t window = kReorderWindowPerWorker * workers;
+  std::unique_ptr<ThreadPool> pool;
+  std::deque<std::future<Selection>> pending;
 
-  // Logic for context printing (-A)
-  // We track how many lines to print remaining after a match using
-  // 'linesToPrint'. Standard grep merges overlapping contexts, which is
-  // naturally handled by resetting the counter on a new match.
+  // With several files, up to `window` files after the current one are
+  // searched on the pool, each into its own bounded buffer, and written out
+  // in argument order as their turn comes. Standard input is always read
+  // in its turn.
+  const bool searchAhead = workers > 1 && files.size() > 1;
+  std::vector<std::future<FileSearch>> searches(files.size());
+  size_t nextSearch = 0;
+
+  for (size_t f = 0; f < files.size(); ++f) {
+    const std::string &file = files[f];
+    for (; searchAhead && nextSearch < std::min(files.size(), f + 1 + window);
+         ++nextSearch) {
+      if (IsStdin(files[nextSearch])) {
+        continue;
+      }
+      if (!pool) {
+        pool = std::make_unique<ThreadPool>(workers);
+      }
+      searches[nextSearch] = pool->Submit(
+          [&path = files[nextSearch], &matcher, &report, maxLine] {
+            return SearchFile(path, matcher, report, maxLine);
+          });
+    }
 
-  for (const auto &file : files) {
     std::unique_ptr<std::istream> fileStream;
-    std::istream *in = nullptr;
+    // Chunks of split lines come from `source` (a LineChannel, or any
+    // input under -A), unsplit blocks from `reader`.
+    std::unique_ptr<LineSource> source;
+    std::unique_ptr<BlockReader> reader;
+    BlockReader::Block next;
+    const bool fromInput = IsStdin(file);
+    const std::string_view name = fromInput ? kStdinName : file;
+    // Whether the input looks binary is judged by its first block.
+    bool checkBinary = report.binaryFiles != BinaryFiles::kText;
+    bool binary = false;
+    // -m 0 reads nothing.
+    FileTally tally;
+    tally.done = report.Limit() == 0;
 
-    if (file.empty() || file == "-") {
-      in = &context.streams.in; // Use shared context stdin
+    if (searches[f].valid()) {
+      FileSearch found = searches[f].get();
+      if (!found.opened) {
+        context.streams.err << "grep: " << file
+                            << ": No such file or directory\n";
+        returnCode = 2; // Error occurred
+        continue;
+      }
+      if (found.binary && report.binaryFiles == BinaryFiles::kSkip) {
+        continue;
+      }
+      binary = found.binary;
+      checkBinary = false;
+      tally = found.tally;
+      for (const auto &selected : found.output) {
+        sink.Forward(selected);
+        sink.Flush();
+        co_await cooperative.OutputSpace();
+      }
+      if (found.reader != nullptr) {
+        fileStream = std::move(found.stream);
+        reader = std::move(found.reader);
+        next = std::move(found.next);
+      }
+    } else if (fromInput) {
+      if (blocks && context.inChannel == nullptr) {
+        reader = std::make_unique<BlockReader>(
+            context.streams.in, kBlockSize, maxLine, &context.streams.out);
+      } else {
+        // Shared context stdin, or the previous builtin's line channel.
+        source = std::make_unique<LineSource>(context);
+      }
     } else {
       auto fs = std::make_unique<std::ifstream>(file);
       if (!*fs) {
@@ -114,49 +1381,211 @@ CommandResult GrepCommand::Execute(CommandContext &context) {
         continue;
       }
       fileStream = std::move(fs);
-      in = fileStream.get();
+      if (blocks) {
+        reader =
+            std::make_unique<BlockReader>(*fileStream, kBlockSize, maxLine);
+      } else {
+        source = std::make_unique<LineSource>(*fileStream);
+      }
     }
 
-    std::string line;
-    int linesToPrint = 0;
-    bool previousPrinted = false;
-    bool skippedLines = false;
-
-    while (std::getline(*in, line)) {
-      if (!line.empty() && line.back() == '\r') {
-        line.pop_back();
+    // A chunk read ahead of the loop, to judge the input by.
+    std::shared_ptr<const LineChunk> peeked;
+    if (checkBinary && !tally.done &&
+        (reader != nullptr || source != nullptr)) {
+      if (fromInput) {
+        co_await cooperative.InputReady();
       }
+      if (reader != nullptr) {
+        next = reader->Next();
+      } else {
+        peeked = source->Next();
+      }
+      const std::string *first = reader != nullptr ? next.data.get()
+                                 : peeked != nullptr ? peeked->data.get()
+                                                     : nullptr;
+      binary = first != nullptr && LooksBinary(*first);
+    }
+    // -r leaves binary files out; standard input is reported as kBinary.
+    if (binary && !fromInput && report.binaryFiles == BinaryFiles::kSkip) {
+      continue;
+    }
+    // -I reads no further; under kBinary the first selected line decides.
+    if (binary && report.binaryFiles == BinaryFiles::kWithoutMatch) {
+      tally.done = true;
+    }
+    const ReportOptions binaryReport = report.ForBinary();
+    const ReportOptions &fileReport = binary ? binaryReport : report;
+    const GrepLoops loops = GrepLoops::For(fileReport);
 
-      bool match = false;
-      if (std::regex_search(line, re)) {
-        match = true;
-        returnCode = 0; // Found at least one match
+    std::optional<ContextPrinter> printer;
+    if (fileReport.WithContext()) {
+      printer.emplace(sink, fileReport, name);
+    }
+    bool firstChunk = true;
+    std::optional<LongLine> longLine;
+    bool exhausted = reader == nullptr && source == nullptr;
 
-        // Print separator for disjoint context blocks.
-        if (afterContext > 0 && previousPrinted && skippedLines) {
-          context.streams.out << "--\n";
+    // Reading stops as soon as the answer for the file is known: at the
+    // first selected line under -q, -l and -L, and after -m lines (and
+    // their -A context).
+    while (!exhausted &&
+           (!tally.done || (printer && printer->Owes(tally.lines)))) {
+      // Finished blocks are written before more input is read, all of
+      // them if the read may wait, so a slow producer's matches come out.
+      const bool mayWait =
+          next.data == nullptr && reader != nullptr && reader->MayWait();
+      bool reported = false;
+      while (!pending.empty() &&
+             (mayWait || pending.front().wait_for(std::chrono::seconds(0)) ==
+                             std::future_status::ready)) {
+        loops.report(sink, pending.front().get(), fileReport, name, tally);
+        pending.pop_front();
+        reported = true;
+      }
+      if (reported) {
+        sink.Flush();
+        co_await cooperative.OutputSpace();
+        if (tally.done) {
+          break;
         }
-
-        linesToPrint = afterContext;
-        skippedLines = false;
+      }
+      if (fromInput) {
+        co_await cooperative.InputReady();
+      }
+      std::shared_ptr<const LineChunk> chunk;
+      BlockReader::Block block;
+      if (reader != nullptr) {
+        block = next.data != nullptr ? std::move(next) : reader->Next();
+        exhausted = block.data == nullptr;
+      } else {
+        chunk = peeked != nullptr ? std::move(peeked) : source->Next();
+        exhausted = chunk == nullptr;
+      }
+      if (exhausted) {
+        break;
+      }
+      if (block.longLine) {
+        // Blocks before the long line are reported first.
+        while (!pending.empty()) {
+          loops.report(sink, pending.front().get(), fileReport, name, tally);
+          pending.pop_front();
+        }
+        sink.Flush();
+        if (tally.done) {
+          break;
+        }
+        if (!longLine) {
+          longLine.emplace(
+              matcher, context.streams.out, fileReport.invert,
+              fileReport.PrintsLines(),
+              fileReport.Prefixed()
+                  ? LinePrefix(fileReport, name, tally.lines + 1, ':')
+                  : "");
+        }
+        longLine->Add(*block.data, block.lineEnds);
+        if (block.lineEnds) {
+          if (longLine->Selected()) {
+            ++tally.selected;
+            tally.done = tally.selected >= fileReport.Limit();
+          }
+          ++tally.lines;
+          if (!longLine->Error().empty()) {
+            context.streams.err << "grep: " << longLine->Error() << "\n";
+            returnCode = 2;
+          }
+          longLine.reset();
+        }
+        co_await cooperative.OutputSpace();
+        continue;
       }
 
-      if (match || linesToPrint > 0) {
-        context.streams.out << line << '\n';
-        previousPrinted = true;
-        if (!match) {
-          linesToPrint--;
+      // Small inputs fit in one block and never pay for the pool.
+      if (workers > 1 && !firstChunk) {
+        if (!pool) {
+          pool = std::make_unique<ThreadPool>(workers);
         }
-        skippedLines = false;
-      } else {
-        if (previousPrinted) {
-          skippedLines = true;
+        if (pending.size() == window) {
+          loops.report(sink, pending.front().get(), fileReport, name, tally);
+          pending.pop_front();
+          sink.Flush();
+          co_await cooperative.OutputSpace();
+          if (tally.done) {
+            break;
+          }
+        }
+        if (reader != nullptr) {
+          pending.push_back(
+              pool->Submit([data = block.data, &matcher, &loops] {
+                return loops.selectBlock(data, matcher);
+              }));
+        } else {
+          pending.push_back(pool->Submit([chunk, &matcher, &loops] {
+            return loops.selectChunk(chunk, matcher);
+          }));
         }
+        continue;
+      }
+      firstChunk = false;
+
+      if (printer) {
+        printer->Add(chunk, loops.selectChunk(chunk, matcher), tally);
+      } else {
+        loops.report(sink,
+                     reader != nullptr ? loops.selectBlock(block.data, matcher)
+                                       : loops.selectChunk(chunk, matcher),
+                     fileReport, name, tally);
+      }
+
+      // Hand this chunk's lines to the next stage before reading more.
+      sink.Flush();
+      co_await cooperative.OutputSpace();
+    }
+
+    // Drain the reorder window before the next file starts. Blocks past
+    // the answer are dropped unreported.
+    while (!pending.empty() && !tally.done) {
+      loops.report(sink, pending.front().get(), fileReport, name, tally);
+      pending.pop_front();
+      sink.Flush();
+      co_await cooperative.OutputSpace();
+    }
+    pending.clear();
+    if (!exhausted && fromInput && context.inChannel != nullptr) {
+      // The previous stage need not produce the rest.
+      context.inChannel->CloseReader();
+    }
+
+    if (tally.selected > 0) {
+      returnCode = 0; // Found at least one match
+      if (report.quiet) {
+        co_return {0};
+      }
+    }
+    if (report.quiet) {
+      // Nothing is printed for -q, not even -L's names or -c's counts.
+      continue;
+    }
+    if (binary && report.PrintsLines()) {
+      if (tally.selected > 0) {
+        sink.WriteLine("Binary file " + std::string(name) + " matches");
+      }
+    } else if (report.filesWithMatches) {
+      if (tally.selected > 0) {
+        sink.WriteLine(name);
+      }
+    } else if (report.filesWithoutMatch) {
+      if (tally.selected == 0) {
+        sink.WriteLine(name);
       }
+    } else if (report.count) {
+      sink.WriteLine((report.withFilename ? std::string(name) + ":" : "") +
+                     std::to_string(tally.selected));
     }
+    sink.Flush();
   }
 
-  return {returnCode};
+  co_return {returnCode};
 }
 
 } // namespace cppshell
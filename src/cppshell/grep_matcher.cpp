@@ -0,0 +1,502 @@
+#include "cppshell/grep_matcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cppshell {
+
+namespace {
+
+/** Strips the "\n" or "\r\n" terminator from a line. */
+[[nodiscard]] std::string_view StripTerminator(std::string_view raw) {
+  if (!raw.empty() && raw.back() == '\n') {
+    raw.remove_suffix(1);
+  }
+  if (!raw.empty() && raw.back() == '\r') {
+    raw.remove_suffix(1);
+  }
+  return raw;
+}
+
+[[nodiscard]] bool IsWordByte(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z') || c == '_';
+}
+
+/** Returns true if an ECMAScript \b holds at `pos` of `line`. */
+[[nodiscard]] bool WordBoundary(std::string_view line, size_t pos) {
+  const bool before = pos > 0 && IsWordByte(line[pos - 1]);
+  const bool after = pos < line.size() && IsWordByte(line[pos]);
+  return before != after;
+}
+
+/**
+ * Returns the string `pattern` matches literally, or nullopt if it uses
+ * regular expression syntax. A backslash before punctuation stands for that
+ * character, as in ECMAScript.
+ */
+[[nodiscard]] std::optional<std::string> LiteralOf(const std::string &pattern) {
+  std::string literal;
+  literal.reserve(pattern.size());
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    const auto c = static_cast<unsigned char>(pattern[i]);
+    if (c == '\\') {
+      if (i + 1 == pattern.size()) {
+        return std::nullopt;
+      }
+      const auto next = static_cast<unsigned char>(pattern[++i]);
+      if (IsWordByte(next) || next >= 0x80) {
+        return std::nullopt; // \d, \b, \1 and the like.
+      }
+      literal.push_back(static_cast<char>(next));
+      continue;
+    }
+    if (c != '\0' && std::strchr("^$.|?*+()[]{}", c) != nullptr) {
+      return std::nullopt;
+    }
+    literal.push_back(static_cast<char>(c));
+  }
+  return literal;
+}
+
+} // namespace
+
+GrepMatcher::GrepMatcher(const std::string &pattern,
+                         const GrepPatternOptions &options)
+    : GrepMatcher(std::vector<std::string>{pattern}, options) {}
+
+GrepMatcher::GrepMatcher(const std::vector<std::string> &patterns,
+                         const GrepPatternOptions &options)
+    : wordRegexp_(options.wordRegexp) {
+  std::vector<std::string> literals;
+  std::vector<std::string> others;
+  for (const std::string &pattern : patterns) {
+    std::optional<std::string> literal =
+        options.fixedStrings ? pattern : LiteralOf(pattern);
+    // An empty word match depends on \b alone; leave that to the regex.
+    if (literal.has_value() && !(wordRegexp_ && literal->empty())) {
+      literals.push_back(std::move(*literal));
+    } else {
+      // Only an empty fixed string gets here under -F.
+      others.push_back(options.fixedStrings ? "" : pattern);
+    }
+  }
+  if (literals.size() == 1 && others.empty()) {
+    literal_.emplace(std::move(literals.front()), options.ignoreCase);
+  } else {
+    Compile(literals, others, options);
+  }
+  PickLoops();
+}
+
+void GrepMatcher::Compile(const std::vector<std::string> &literals,
+                          const std::vector<std::string> &others,
+                          const GrepPatternOptions &options) {
+  if (!literals.empty() || others.empty()) {
+    literals_ =
+        std::make_unique<MultiLiteralSearcher>(literals, options.ignoreCase);
+  }
+
+  std::regex_constants::syntax_option_type flags =
+      std::regex_constants::ECMAScript;
+  if (options.ignoreCase) {
+    flags |= std::regex_constants::icase;
+  }
+  // Patterns the automaton understands are joined into one alternation;
+  // std::regex gets the rest, each on its own since joining them would
+  // renumber their backreferences.
+  std::vector<std::string> joined;
+  for (const std::string &pattern : others) {
+    std::string finalPattern =
+        wordRegexp_ ? "\\b(?:" + pattern + ")\\b" : pattern;
+    std::unique_ptr<RegexAutomaton> automaton =
+        RegexAutomaton::Compile(finalPattern, options.ignoreCase);
+    if (automaton != nullptr) {
+      if (joined.empty()) {
+        automaton_ = std::move(automaton);
+      }
+      joined.push_back(std::move(finalPattern));
+      continue;
+    }
+    try {
+      regexes_.emplace_back(finalPattern, flags);
+    } catch (const std::regex_error &e) {
+      error_ = e.what();
+      return;
+    }
+  }
+  if (joined.size() > 1) {
+    std::string alternation;
+    for (const std::string &pattern : joined) {
+      alternation += (alternation.empty() ? "(?:" : "|(?:") + pattern + ")";
+    }
+    automaton_ = RegexAutomaton::Compile(alternation, options.ignoreCase);
+    if (automaton_ == nullptr) {
+      try {
+        for (const std::string &pattern : joined) {
+          regexes_.emplace_back(pattern, flags);
+        }
+      } catch (const std::regex_error &e) {
+        error_ = e.what();
+      }
+    }
+  }
+}
+
+void GrepMatcher::PickLoops() {
+  if (literal_.has_value()) {
+    blockLoop_ = wordRegexp_ ? &GrepMatcher::LiteralBlock<true, true>
+                             : &GrepMatcher::LiteralBlock<true, false>;
+    linesLoop_ = wordRegexp_ ? &GrepMatcher::LiteralLines<true>
+                             : &GrepMatcher::LiteralLines<false>;
+    return;
+  }
+  // Indexed by which of literals_, automaton_ and regexes_ there are.
+  static constexpr BlockLoop kBlockLoops[] = {
+      &GrepMatcher::BlockByLine<false, false, false>,
+      &GrepMatcher::BlockByLine<false, false, true>,
+      &GrepMatcher::BlockByLine<false, true, false>,
+      &GrepMatcher::BlockByLine<false, true, true>,
+      &GrepMatcher::BlockByLine<true, false, false>,
+      &GrepMatcher::BlockByLine<true, false, true>,
+      &GrepMatcher::BlockByLine<true, true, false>,
+      &GrepMatcher::BlockByLine<true, true, true>,
+  };
+  static constexpr LinesLoop kLinesLoops[] = {
+      &GrepMatcher::LinesByLine<false, false, false>,
+      &GrepMatcher::LinesByLine<false, false, true>,
+      &GrepMatcher::LinesByLine<false, true, false>,
+      &GrepMatcher::LinesByLine<false, true, true>,
+      &GrepMatcher::LinesByLine<true, false, false>,
+      &GrepMatcher::LinesByLine<true, false, true>,
+      &GrepMatcher::LinesByLine<true, true, false>,
+      &GrepMatcher::LinesByLine<true, true, true>,
+  };
+  const size_t index = (literals_ != nullptr ? 4 : 0) +
+                       (automaton_ != nullptr ? 2 : 0) +
+                       (!regexes_.empty() ? 1 : 0);
+  linesLoop_ = kLinesLoops[index];
+  if (index != 4) {
+    blockLoop_ = kBlockLoops[index];
+  } else {
+    // Literals alone are searched across the block.
+    blockLoop_ = wordRegexp_ ? &GrepMatcher::LiteralBlock<false, true>
+                             : &GrepMatcher::LiteralBlock<false, false>;
+  }
+}
+
+template <bool kWord>
+bool GrepMatcher::LiteralInLine(std::string_view line, size_t from) const {
+  const size_t n = literal_->Needle().size();
+  for (size_t pos = literal_->Find(line, from); pos != std::string_view::npos;
+       pos = literal_->Find(line, pos + 1)) {
+    if (!kWord || (WordBoundary(line, pos) && WordBoundary(line, pos + n))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <bool kLiterals, bool kAutomaton, bool kRegexes>
+bool GrepMatcher::AnyInLine(std::string_view line,
+                            RegexAutomaton::Searcher *searcher) const {
+  if constexpr (kLiterals) {
+    if (literals_->Contains(line, wordRegexp_)) {
+      return true;
+    }
+  }
+  if constexpr (kAutomaton) {
+    if (searcher->Search(line)) {
+      return true;
+    }
+  }
+  if constexpr (kRegexes) {
+    return std::any_of(regexes_.begin(), regexes_.end(),
+                       [&](const std::regex &regex) {
+                         return std::regex_search(line.begin(), line.end(),
+                                                  regex);
+                       });
+  }
+  return false;
+}
+
+void GrepMatcher::MatchBlock(std::string_view block,
+                             std::vector<LineSpan> &out) const {
+  (this->*blockLoop_)(block, out);
+}
+
+template <bool kLiterals, bool kAutomaton, bool kRegexes>
+void GrepMatcher::BlockByLine(std::string_view block,
+                              std::vector<LineSpan> &out) const {
+  std::unique_ptr<RegexAutomaton::Searcher> searcher =
+      kAutomaton ? automaton_->Acquire() : nullptr;
+  size_t start = 0;
+  while (start < block.size()) {
+    const size_t nl = block.find('\n', start);
+    const size_t end = nl == std::string_view::npos ? block.size() : nl + 1;
+    if (AnyInLine<kLiterals, kAutomaton, kRegexes>(
+            StripTerminator(block.substr(start, end - start)),
+            searcher.get())) {
+      out.push_back(LineSpan{start, end - start});
+    }
+    start = end;
+  }
+  if constexpr (kAutomaton) {
+    automaton_->Release(std::move(searcher));
+  }
+}
+
+template <bool kSingle, bool kWord>
+void GrepMatcher::LiteralBlock(std::string_view block,
+                               std::vector<LineSpan> &out) const {
+  // `pos` is always at the start of a line, so the line of a hit begins
+  // after the last '\n' between the two. With several literals the hit is
+  // the last byte of the first occurrence to end.
+  size_t pos = 0;
+  while (pos < block.size()) {
+    size_t hit = std::string_view::npos;
+    if constexpr (kSingle) {
+      hit = literal_->Find(block, pos);
+    } else {
+      const size_t end = literals_->FindEnd(block, pos);
+      hit = end == std::string_view::npos || end == pos ? end : end - 1;
+    }
+    if (hit == std::string_view::npos) {
+      break;
+    }
+    const size_t nl = hit == pos ? std::string_view::npos
+                                 : block.rfind('\n', hit - 1);
+    const size_t lineStart =
+        nl == std::string_view::npos || nl < pos ? pos : nl + 1;
+    const size_t lineNl = block.find('\n', hit);
+    const size_t lineEnd =
+        lineNl == std::string_view::npos ? block.size() : lineNl + 1;
+    const std::string_view line =
+        StripTerminator(block.substr(lineStart, lineEnd - lineStart));
+    bool matches = false;
+    if constexpr (kSingle) {
+      // Without -w a hit that ends within the line settles it.
+      matches = (!kWord && hit + literal_->Needle().size() <=
+                               lineStart + line.size()) ||
+                LiteralInLine<kWord>(line, hit - lineStart);
+    } else {
+      matches = literals_->Contains(line, kWord);
+    }
+    if (matches) {
+      out.push_back(LineSpan{lineStart, lineEnd - lineStart});
+    }
+    pos = lineEnd;
+  }
+}
+
+GrepMatcher::LineFeed::LineFeed(const GrepMatcher &matcher)
+    : matcher_(matcher) {
+  if (matcher_.automaton_ != nullptr) {
+    searcher_ = matcher_.automaton_->Acquire();
+    searcher_->Begin();
+  }
+}
+
+GrepMatcher::LineFeed::~LineFeed() {
+  if (searcher_ != nullptr) {
+    matcher_.automaton_->Release(std::move(searcher_));
+  }
+}
+
+bool GrepMatcher::LineFeed::Feed(std::string_view piece) {
+  if (matched_) {
+    return true;
+  }
+  if (matcher_.literals_ != nullptr &&
+      matcher_.literals_->Feed(literalsState_, piece)) {
+    matched_ = true;
+    return matched_;
+  }
+  if (searcher_ != nullptr) {
+    matched_ = searcher_->Feed(piece);
+    return matched_;
+  }
+  if (!matcher_.literal_.has_value()) {
+    return false;
+  }
+
+  tail_.append(piece);
+  matched_ = LiteralHit(false);
+  // Keep the bytes a hit crossing into the next piece may start in, and
+  // the byte before them for the -w check.
+  const size_t keep = matcher_.literal_->Needle().size() + 1;
+  if (tail_.size() > keep) {
+    dropped_ += tail_.size() - keep;
+    tail_.erase(0, tail_.size() - keep);
+  }
+  return matched_;
+}
+
+bool GrepMatcher::LineFeed::End() {
+  if (!matched_ && searcher_ != nullptr) {
+    matched_ = searcher_->End();
+  } else if (!matched_ && matcher_.literal_.has_value()) {
+    matched_ = LiteralHit(true);
+  }
+  return matched_;
+}
+
+bool GrepMatcher::LineFeed::LiteralHit(bool atEnd) const {
+  const LiteralSearcher &literal = *matcher_.literal_;
+  const size_t n = literal.Needle().size();
+  for (size_t pos = literal.Find(tail_); pos != std::string_view::npos;
+       pos = literal.Find(tail_, pos + 1)) {
+    if (!matcher_.wordRegexp_) {
+      return true;
+    }
+    // A hit at the very start of a trimmed tail was checked with the piece
+    // before; one that ends at the end of the tail needs the next byte.
+    if (pos == 0 && dropped_ > 0) {
+      continue;
+    }
+    if (pos + n == tail_.size() && !atEnd) {
+      break;
+    }
+    if (WordBoundary(tail_, pos) && WordBoundary(tail_, pos + n)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GrepMatcher::MatchLines(const LineChunk &chunk,
+                             std::vector<size_t> &out) const {
+  (this->*linesLoop_)(chunk, out);
+}
+
+template <bool kLiterals, bool kAutomaton, bool kRegexes>
+void GrepMatcher::LinesByLine(const LineChunk &chunk,
+                              std::vector<size_t> &out) const {
+  std::unique_ptr<RegexAutomaton::Searcher> searcher =
+      kAutomaton ? automaton_->Acquire() : nullptr;
+  for (size_t i = 0; i < chunk.lines.size(); ++i) {
+    if (AnyInLine<kLiterals, kAutomaton, kRegexes>(
+            StripTerminator(chunk.Line(i)), searcher.get())) {
+      out.push_back(i);
+    }
+  }
+  if constexpr (kAutomaton) {
+    automaton_->Release(std::move(searcher));
+  }
+}
+
+template <bool kWord>
+void GrepMatcher::LiteralLines(const LineChunk &chunk,
+                               std::vector<size_t> &out) const {
+  // Search each run of adjacent lines as one haystack and only look at the
+  // lines the searcher stops in.
+  const std::vector<LineSpan> &lines = chunk.lines;
+  const std::string_view data(*chunk.data);
+  const size_t n = literal_->Needle().size();
+  size_t i = 0;
+  while (i < lines.size()) {
+    const size_t begin = lines[i].offset;
+    size_t end = begin + lines[i].size;
+    size_t runEnd = i + 1;
+    for (; runEnd < lines.size() && lines[runEnd].offset == end; ++runEnd) {
+      end += lines[runEnd].size;
+    }
+    const std::string_view run = data.substr(begin, end - begin);
+
+    size_t pos = 0;
+    size_t k = i;
+    while (k < runEnd) {
+      const size_t hit = literal_->Find(run, pos);
+      if (hit == std::string_view::npos) {
+        break;
+      }
+      while (k < runEnd && lines[k].offset + lines[k].size - begin <= hit) {
+        ++k;
+      }
+      if (k == runEnd) {
+        break;
+      }
+      const size_t lineStart = lines[k].offset - begin;
+      const std::string_view line =
+          StripTerminator(run.substr(lineStart, lines[k].size));
+      // The hit may cross the end of the line or fail the -w check; the
+      // line still matches if a later occurrence in it does not.
+      if ((!kWord && hit + n <= lineStart + line.size()) ||
+          LiteralInLine<kWord>(line, hit - lineStart)) {
+        out.push_back(k);
+      }
+      pos = lineStart + lines[k].size;
+      ++k;
+    }
+    i = runEnd;
+  }
+}
+
+GrepMatcherCache &GrepMatcherCache::Shared() {
+  static GrepMatcherCache cache;
+  return cache;
+}
+
+GrepMatcherCache::GrepMatcherCache(size_t capacity) : capacity_(capacity) {}
+
+std::shared_ptr<const GrepMatcher>
+GrepMatcherCache::Get(const std::vector<std::string> &patterns,
+                      const GrepPatternOptions &options) {
+  // The options, then each pattern after its length.
+  std::string key;
+  key.push_back(static_cast<char>('0' + (options.ignoreCase ? 1 : 0) +
+                                  (options.wordRegexp ? 2 : 0) +
+                                  (options.fixedStrings ? 4 : 0)));
+  for (const std::string &pattern : patterns) {
+    key += std::to_string(pattern.size());
+    key.push_back(':');
+    key += pattern;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+      ++stats_.hits;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->matcher;
+    }
+    ++stats_.misses;
+  }
+
+  // Compiled unlocked: a large set of patterns takes a while.
+  auto matcher = std::make_shared<const GrepMatcher>(patterns, options);
+  if (key.size() > kMaxPatternBytes) {
+    return matcher;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (capacity_ == 0 || index_.contains(key)) {
+    return matcher;
+  }
+  entries_.push_front(Entry{std::move(key), matcher});
+  index_.emplace(entries_.front().key, entries_.begin());
+  Trim();
+  return matcher;
+}
+
+GrepMatcherCache::Stats GrepMatcherCache::Statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
+
+void GrepMatcherCache::SetCapacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = capacity;
+  Trim();
+}
+
+void GrepMatcherCache::Trim() {
+  while (entries_.size() > capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+}
+
+} // namespace cppshell
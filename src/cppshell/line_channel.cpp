@@ -0,0 +1,361 @@
+#include "cppshell/line_channel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace cppshell {
+
+namespace {
+
+/** Splits `data` (complete lines, last one maybe unterminated) into spans. */
+[[nodiscard]] std::vector<LineSpan> SplitLines(const std::string &data) {
+  std::vector<LineSpan> lines;
+  size_t start = 0;
+  while (start < data.size()) {
+    const auto *nl = static_cast<const char *>(
+        std::memchr(data.data() + start, '\n', data.size() - start));
+    const size_t end = nl == nullptr
+                           ? data.size()
+                           : static_cast<size_t>(nl - data.data()) + 1;
+    lines.push_back(LineSpan{start, end - start});
+    start = end;
+  }
+  return lines;
+}
+
+} // namespace
+
+size_t ReadAvailable(std::istream &in, char *buffer, size_t size) {
+  std::streambuf *sb = in.rdbuf();
+  if (sb == nullptr || size == 0) {
+    return 0;
+  }
+  if (std::istream::traits_type::eq_int_type(
+          sb->sgetc(), std::istream::traits_type::eof())) {
+    in.setstate(std::ios::eofbit);
+    return 0;
+  }
+
+  // Only take what is already buffered so interactive input is not held
+  // back waiting for a full block.
+  const std::streamsize avail = sb->in_avail();
+  const std::streamsize want =
+      avail > 0 ? std::min(avail, static_cast<std::streamsize>(size)) : 1;
+  return static_cast<size_t>(sb->sgetn(buffer, want));
+}
+
+BlockingLineChannel::BlockingLineChannel(size_t capacity)
+    : capacity_(capacity) {}
+
+bool BlockingLineChannel::Push(std::shared_ptr<const LineChunk> chunk) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  notFull_.wait(lock,
+                [this] { return chunks_.size() < capacity_ || readerClosed_; });
+  if (readerClosed_) {
+    return false;
+  }
+  chunks_.push_back(std::move(chunk));
+  notEmpty_.notify_one();
+  return true;
+}
+
+std::shared_ptr<const LineChunk> BlockingLineChannel::Pop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  notEmpty_.wait(lock, [this] { return !chunks_.empty() || closed_; });
+  if (chunks_.empty()) {
+    return nullptr; // EOF
+  }
+  std::shared_ptr<const LineChunk> chunk = std::move(chunks_.front());
+  chunks_.pop_front();
+  notFull_.notify_one();
+  return chunk;
+}
+
+void BlockingLineChannel::Close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  closed_ = true;
+  notEmpty_.notify_all();
+}
+
+void BlockingLineChannel::CloseReader() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  readerClosed_ = true;
+  chunks_.clear();
+  notFull_.notify_all();
+}
+
+BlockReader::BlockReader(std::istream &in, size_t blockSize, size_t maxLine,
+                         std::ostream *out)
+    : in_(&in), out_(out), blockSize_(blockSize),
+      maxLine_(std::max(maxLine, blockSize)) {}
+
+BlockReader::Block BlockReader::Next() {
+  std::string data = std::move(carry_);
+  carry_.clear();
+  if (inLongLine_) {
+    return NextPiece(std::move(data));
+  }
+  if (in_ == nullptr) {
+    return {};
+  }
+
+  // Keep reading while input is immediately available, until there is at
+  // least one complete line and a block's worth of data.
+  // The carry holds whole lines only after the end of a long line.
+  size_t lastNewline = data.rfind('\n');
+  while (true) {
+    const size_t used = data.size();
+    const size_t got = Append(data);
+    if (got == 0) {
+      in_ = nullptr;
+      if (data.empty()) {
+        return {};
+      }
+      return Block{std::make_shared<const std::string>(std::move(data))};
+    }
+
+    const size_t nl = std::string_view(data).substr(used).rfind('\n');
+    if (nl != std::string::npos) {
+      lastNewline = used + nl;
+    }
+    if (lastNewline != std::string::npos &&
+        (data.size() >= blockSize_ || in_->rdbuf()->in_avail() <= 0)) {
+      break;
+    }
+    if (lastNewline == std::string::npos && data.size() >= maxLine_) {
+      inLongLine_ = true;
+      return Block{std::make_shared<const std::string>(std::move(data)), true,
+                   false};
+    }
+  }
+
+  carry_.assign(data, lastNewline + 1);
+  data.resize(lastNewline + 1);
+  return Block{std::make_shared<const std::string>(std::move(data))};
+}
+
+bool BlockReader::MayWait() const {
+  return in_ != nullptr && in_->rdbuf() != nullptr &&
+         in_->rdbuf()->in_avail() <= 0;
+}
+
+BlockReader::Block BlockReader::NextPiece(std::string data) {
+  // Read until the line ends or a block's worth of it is here.
+  size_t nl = data.find('\n');
+  while (nl == std::string::npos && data.size() < blockSize_) {
+    const size_t used = data.size();
+    const size_t got = in_ == nullptr ? 0 : Append(data);
+    if (got == 0) {
+      in_ = nullptr;
+      inLongLine_ = false;
+      return Block{std::make_shared<const std::string>(std::move(data)), true,
+                   true};
+    }
+    nl = data.find('\n', used);
+  }
+
+  if (nl == std::string::npos) {
+    return Block{std::make_shared<const std::string>(std::move(data)), true,
+                 false};
+  }
+  carry_.assign(data, nl + 1);
+  data.resize(nl + 1);
+  inLongLine_ = false;
+  return Block{std::make_shared<const std::string>(std::move(data)), true,
+               true};
+}
+
+size_t BlockReader::Append(std::string &data) {
+  // Read straight into the string instead of through a bounce buffer,
+  // grown by what the stream has buffered rather than a whole block, so a
+  // short input does not pay for clearing a block.
+  std::streambuf *sb = in_->rdbuf();
+  if (sb != nullptr && sb->in_avail() <= 0) {
+    // sgetn skips the sentry, which would flush the tie before waiting.
+    for (std::ostream *waiting : {in_->tie(), out_}) {
+      if (waiting != nullptr) {
+        waiting->flush();
+      }
+    }
+  }
+  if (sb == nullptr || std::istream::traits_type::eq_int_type(
+                           sb->sgetc(), std::istream::traits_type::eof())) {
+    in_->setstate(std::ios::eofbit);
+    return 0;
+  }
+  const std::streamsize avail = sb->in_avail();
+  const size_t want =
+      avail > 0 ? std::min(static_cast<size_t>(avail), blockSize_) : blockSize_;
+  const size_t used = data.size();
+  if (used != 0) {
+    data.reserve(blockSize_); // More is coming: make room for a block.
+  }
+  data.resize(used + want);
+  const size_t got = ReadAvailable(*in_, data.data() + used, want);
+  data.resize(used + got);
+  return got;
+}
+
+LineSource::LineSource(const CommandContext &context)
+    : channel_(context.inChannel) {
+  if (channel_ == nullptr) {
+    reader_ = std::make_unique<BlockReader>(context.streams.in, kBlockSize,
+                                            SIZE_MAX, &context.streams.out);
+  }
+}
+
+LineSource::LineSource(std::istream &in)
+    : reader_(std::make_unique<BlockReader>(in, kBlockSize, SIZE_MAX)) {}
+
+std::shared_ptr<const LineChunk> LineSource::Next() {
+  if (channel_ != nullptr) {
+    return channel_->Pop();
+  }
+  const BlockReader::Block block = reader_->Next();
+  if (block.data == nullptr) {
+    return nullptr;
+  }
+  auto chunk = std::make_shared<LineChunk>();
+  chunk->lines = SplitLines(*block.data);
+  chunk->data = block.data;
+  return chunk;
+}
+
+LineSink::LineSink(const CommandContext &context)
+    : channel_(context.outChannel), out_(&context.streams.out) {}
+
+LineSink::~LineSink() { Flush(); }
+
+void LineSink::WriteLine(std::string_view text) {
+  if (channel_ == nullptr) {
+    out_->write(text.data(), static_cast<std::streamsize>(text.size()));
+    out_->put('\n');
+    return;
+  }
+
+  FlushForwarded();
+  ownedLines_.push_back(LineSpan{owned_.size(), text.size() + 1});
+  owned_.append(text);
+  owned_.push_back('\n');
+  if (owned_.size() >= kChunkSize) {
+    FlushOwned();
+  }
+}
+
+void LineSink::WriteLastLine(std::string_view text) {
+  if (channel_ == nullptr) {
+    out_->write(text.data(), static_cast<std::streamsize>(text.size()));
+    return;
+  }
+
+  FlushForwarded();
+  ownedLines_.push_back(LineSpan{owned_.size(), text.size()});
+  owned_.append(text);
+  FlushOwned();
+}
+
+void LineSink::Forward(const std::shared_ptr<const LineChunk> &chunk,
+                       size_t i) {
+  if (channel_ == nullptr) {
+    const std::string_view line = chunk->Line(i);
+    out_->write(line.data(), static_cast<std::streamsize>(line.size()));
+    return;
+  }
+
+  FlushOwned();
+  if (forwardedFrom_ != chunk) {
+    FlushForwarded();
+    forwardedFrom_ = chunk;
+  }
+  forwardedLines_.push_back(chunk->lines[i]);
+}
+
+void LineSink::Forward(const std::shared_ptr<const LineChunk> &chunk,
+                       size_t first, size_t last) {
+  if (channel_ == nullptr) {
+    // Coalesce adjacent spans into as few writes as possible.
+    const std::string &data = *chunk->data;
+    size_t i = first;
+    while (i < last) {
+      const size_t begin = chunk->lines[i].offset;
+      size_t end = begin + chunk->lines[i].size;
+      ++i;
+      while (i < last && chunk->lines[i].offset == end) {
+        end += chunk->lines[i].size;
+        ++i;
+      }
+      out_->write(data.data() + begin,
+                  static_cast<std::streamsize>(end - begin));
+    }
+    return;
+  }
+
+  FlushOwned();
+  if (forwardedFrom_ != chunk) {
+    FlushForwarded();
+    forwardedFrom_ = chunk;
+  }
+  forwardedLines_.insert(forwardedLines_.end(),
+                         chunk->lines.begin() +
+                             static_cast<std::ptrdiff_t>(first),
+                         chunk->lines.begin() +
+                             static_cast<std::ptrdiff_t>(last));
+}
+
+void LineSink::Forward(const std::shared_ptr<const LineChunk> &chunk) {
+  if (channel_ == nullptr) {
+    Forward(chunk, 0, chunk->lines.size());
+    return;
+  }
+
+  Flush();
+  Publish(chunk);
+}
+
+void LineSink::Flush() {
+  FlushOwned();
+  FlushForwarded();
+}
+
+void LineSink::FlushOwned() {
+  if (ownedLines_.empty()) {
+    return;
+  }
+  auto chunk = std::make_shared<LineChunk>();
+  chunk->data = std::make_shared<const std::string>(std::move(owned_));
+  chunk->lines = std::move(ownedLines_);
+  owned_.clear();
+  ownedLines_.clear();
+  Publish(std::move(chunk));
+}
+
+void LineSink::FlushForwarded() {
+  if (forwardedLines_.empty()) {
+    forwardedFrom_.reset();
+    return;
+  }
+
+  if (forwardedLines_.size() == forwardedFrom_->lines.size()) {
+    // Every line passed through: republish the chunk itself.
+    Publish(std::move(forwardedFrom_));
+  } else {
+    auto chunk = std::make_shared<LineChunk>();
+    chunk->data = forwardedFrom_->data;
+    chunk->lines = std::move(forwardedLines_);
+    Publish(std::move(chunk));
+  }
+  forwardedFrom_.reset();
+  forwardedLines_.clear();
+}
+
+void LineSink::Publish(std::shared_ptr<const LineChunk> chunk) {
+  if (broken_) {
+    return;
+  }
+  if (!channel_->Push(std::move(chunk))) {
+    broken_ = true;
+  }
+}
+
+} // namespace cppshell
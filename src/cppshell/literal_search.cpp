@@ -0,0 +1,119 @@
+#include "cppshell/literal_search.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+[[nodiscard]] bool IsAsciiLetter(unsigned char c) {
+  const unsigned char lower = c | 0x20;
+  return lower >= 'a' && lower <= 'z';
+}
+
+[[nodiscard]] unsigned char FoldAscii(unsigned char c) {
+  return IsAsciiLetter(c) ? c | 0x20 : c;
+}
+
+} // namespace
+
+LiteralSearcher::LiteralSearcher(std::string needle, bool ignoreCase)
+    : needle_(std::move(needle)), ignoreCase_(ignoreCase) {
+  if (ignoreCase_) {
+    std::transform(needle_.begin(), needle_.end(), needle_.begin(),
+                   [](char c) { return static_cast<char>(FoldAscii(c)); });
+  }
+  if (needle_.empty()) {
+    return;
+  }
+  const auto setup = [this](char c, unsigned char &value,
+                            unsigned char &fold) {
+    const auto byte = static_cast<unsigned char>(c);
+    fold = ignoreCase_ && IsAsciiLetter(byte) ? 0x20 : 0;
+    value = byte | fold;
+  };
+  setup(needle_.front(), firstValue_, firstFold_);
+  setup(needle_.back(), lastValue_, lastFold_);
+}
+
+template <bool kFold> bool LiteralSearcher::EqualAt(const char *at) const {
+  if constexpr (!kFold) {
+    return std::memcmp(at, needle_.data(), needle_.size()) == 0;
+  }
+  for (size_t i = 0; i < needle_.size(); ++i) {
+    if (static_cast<char>(FoldAscii(at[i])) != needle_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t LiteralSearcher::Find(std::string_view haystack, size_t from) const {
+  return ignoreCase_ ? FindIn<true>(haystack, from)
+                     : FindIn<false>(haystack, from);
+}
+
+template <bool kFold>
+size_t LiteralSearcher::FindIn(std::string_view haystack, size_t from) const {
+  const size_t n = needle_.size();
+  if (from > haystack.size() || n > haystack.size() - from) {
+    return std::string_view::npos;
+  }
+  if (n == 0) {
+    return from;
+  }
+  const char *data = haystack.data();
+  if (n == 1 && !kFold) {
+    const void *hit =
+        std::memchr(data + from, needle_[0], haystack.size() - from);
+    return hit == nullptr ? std::string_view::npos
+                          : static_cast<const char *>(hit) - data;
+  }
+
+  // Last position an occurrence can start at.
+  const size_t last = haystack.size() - n;
+  size_t i = from;
+#ifdef __SSE2__
+  const __m128i firstValue = _mm_set1_epi8(static_cast<char>(firstValue_));
+  const __m128i firstFold = _mm_set1_epi8(static_cast<char>(firstFold_));
+  const __m128i lastValue = _mm_set1_epi8(static_cast<char>(lastValue_));
+  const __m128i lastFold = _mm_set1_epi8(static_cast<char>(lastFold_));
+  for (; i + 15 <= last; i += 16) {
+    const __m128i first = _mm_or_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)),
+        firstFold);
+    const __m128i tail = _mm_or_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + n - 1)),
+        lastFold);
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, firstValue),
+                      _mm_cmpeq_epi8(tail, lastValue))));
+    while (mask != 0) {
+      const size_t candidate = i + std::countr_zero(mask);
+      if (EqualAt<kFold>(data + candidate)) {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  if constexpr (!kFold) {
+    return haystack.find(needle_, i);
+  }
+  for (; i <= last; ++i) {
+    if ((static_cast<unsigned char>(data[i]) | firstFold_) == firstValue_ &&
+        EqualAt<true>(data + i)) {
+      return i;
+    }
+  }
+  return std::string_view::npos;
+}
+
+} // namespace cppshell
@@ -0,0 +1,245 @@
+#include "cppshell/multi_literal_search.hpp"
+
+#include <algorithm>
+
+namespace cppshell {
+
+namespace {
+
+[[nodiscard]] unsigned char FoldAscii(unsigned char c) {
+  const unsigned char lower = c | 0x20;
+  return lower >= 'a' && lower <= 'z' ? lower : c;
+}
+
+[[nodiscard]] bool IsWordByte(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z') || c == '_';
+}
+
+/** Returns true if an ECMAScript \b holds at `pos` of `line`. */
+[[nodiscard]] bool WordBoundary(std::string_view line, size_t pos) {
+  const bool before = pos > 0 && IsWordByte(line[pos - 1]);
+  const bool after = pos < line.size() && IsWordByte(line[pos]);
+  return before != after;
+}
+
+/** Children lists longer than this are binary searched. */
+constexpr uint32_t kLinearChildren = 8;
+
+} // namespace
+
+MultiLiteralSearcher::MultiLiteralSearcher(
+    const std::vector<std::string> &needles, bool ignoreCase) {
+  std::vector<std::string> keys;
+  keys.reserve(needles.size());
+  std::array<bool, 256> used{};
+  for (const std::string &needle : needles) {
+    std::string key = needle;
+    for (char &c : key) {
+      const auto byte = static_cast<unsigned char>(c);
+      c = static_cast<char>(ignoreCase ? FoldAscii(byte) : byte);
+      used[static_cast<unsigned char>(c)] = true;
+    }
+    keys.push_back(std::move(key));
+  }
+  // Classes follow byte order, so sorted keys have their children sorted.
+  for (size_t b = 0; b < used.size(); ++b) {
+    if (used[b]) {
+      classOf_[b] = static_cast<uint16_t>(classes_++);
+    }
+  }
+  if (ignoreCase) {
+    for (unsigned c = 'A'; c <= 'Z'; ++c) {
+      classOf_[c] = classOf_[c | 0x20];
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  size_ = keys.size();
+
+  // The trie in insertion order: each key shares the nodes of its common
+  // prefix with the key before it.
+  std::vector<uint32_t> firstChild{0};
+  std::vector<uint32_t> lastChild{0};
+  std::vector<uint32_t> sibling{0};
+  std::vector<uint16_t> label{0};
+  std::vector<uint32_t> length{0};
+  std::vector<uint32_t> path{0};
+  const std::string *previous = nullptr;
+  for (const std::string &key : keys) {
+    if (key.empty()) {
+      matchesEmpty_ = true;
+      continue;
+    }
+    size_t common = 0;
+    if (previous != nullptr) {
+      while (common < std::min(key.size(), previous->size()) &&
+             key[common] == (*previous)[common]) {
+        ++common;
+      }
+    }
+    path.resize(common + 1);
+    for (size_t d = common; d < key.size(); ++d) {
+      const auto node = static_cast<uint32_t>(label.size());
+      const uint32_t parent = path[d];
+      firstChild.push_back(0);
+      lastChild.push_back(0);
+      sibling.push_back(0);
+      label.push_back(classOf_[static_cast<unsigned char>(key[d])]);
+      length.push_back(0);
+      if (lastChild[parent] == 0) {
+        firstChild[parent] = node;
+      } else {
+        sibling[lastChild[parent]] = node;
+      }
+      lastChild[parent] = node;
+      path.push_back(node);
+    }
+    length[path.back()] = static_cast<uint32_t>(key.size());
+    previous = &key;
+  }
+
+  // Renumber breadth first, so the children of a state are consecutive
+  // and every state comes after the states nearer the root.
+  const size_t states = label.size();
+  std::vector<uint32_t> order;
+  order.reserve(states);
+  order.push_back(0);
+  states_.assign(states, State{});
+  label_.assign(states, 0);
+  length_.assign(states, 0);
+  for (size_t s = 0; s < order.size(); ++s) {
+    const auto first = static_cast<uint32_t>(order.size());
+    states_[s].firstChild = first;
+    for (uint32_t old = firstChild[order[s]]; old != 0; old = sibling[old]) {
+      label_[order.size()] = label[old];
+      length_[order.size()] = length[old];
+      order.push_back(old);
+    }
+    states_[s].children = static_cast<uint16_t>(order.size() - first);
+  }
+
+  for (uint32_t s = 0; s < states; ++s) {
+    const State &state = states_[s];
+    for (uint32_t u = state.firstChild; u < state.firstChild + state.children;
+         ++u) {
+      if (s != 0) {
+        for (uint32_t t = state.fail;; t = states_[t].fail) {
+          const uint32_t next = Child(t, label_[u]);
+          if (next != 0 || t == 0) {
+            states_[u].fail = next;
+            break;
+          }
+        }
+      }
+      states_[u].output =
+          length_[u] != 0 ? u : states_[states_[u].fail].output;
+    }
+  }
+
+  // Rows copy the rows of their failure states, which come before them,
+  // and then point their own children's classes at the children.
+  dense_ = static_cast<uint32_t>(
+      std::clamp<size_t>(kDenseEntries / classes_, 1, states));
+  delta_.assign(dense_ * classes_, 0);
+  for (uint32_t s = 0; s < dense_; ++s) {
+    const State &state = states_[s];
+    if (s != 0) {
+      std::copy_n(delta_.begin() + state.fail * classes_, classes_,
+                  delta_.begin() + s * classes_);
+    }
+    for (uint32_t u = state.firstChild; u < state.firstChild + state.children;
+         ++u) {
+      delta_[s * classes_ + label_[u]] =
+          u | (states_[u].output != 0 ? kOutputBit : 0);
+    }
+  }
+}
+
+uint32_t MultiLiteralSearcher::Child(uint32_t state, uint16_t c) const {
+  const uint32_t first = states_[state].firstChild;
+  const uint32_t last = first + states_[state].children;
+  if (last - first <= kLinearChildren) {
+    for (uint32_t u = first; u < last; ++u) {
+      if (label_[u] == c) {
+        return u;
+      }
+    }
+    return 0;
+  }
+  const auto begin = label_.begin() + first;
+  const auto it = std::lower_bound(begin, label_.begin() + last, c);
+  return it != label_.begin() + last && *it == c
+             ? first + static_cast<uint32_t>(it - begin)
+             : 0;
+}
+
+uint32_t MultiLiteralSearcher::Next(uint32_t state, uint16_t c) const {
+  state &= ~kOutputBit;
+  while (state >= dense_) {
+    const uint32_t next = Child(state, c);
+    if (next != 0) {
+      return next | (states_[next].output != 0 ? kOutputBit : 0);
+    }
+    state = states_[state].fail;
+  }
+  return delta_[state * classes_ + c];
+}
+
+size_t MultiLiteralSearcher::FindEnd(std::string_view haystack,
+                                     size_t from) const {
+  if (matchesEmpty_) {
+    return from;
+  }
+  uint32_t state = kStart;
+  for (size_t i = from; i < haystack.size(); ++i) {
+    const uint16_t c = classOf_[static_cast<unsigned char>(haystack[i])];
+    state = c == 0 ? 0 : Next(state, c);
+    if ((state & kOutputBit) != 0) {
+      return i + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+bool MultiLiteralSearcher::Contains(std::string_view line, bool word) const {
+  if (matchesEmpty_ && !word) {
+    return true;
+  }
+  uint32_t state = kStart;
+  for (size_t i = 0; i < line.size(); ++i) {
+    const uint16_t c = classOf_[static_cast<unsigned char>(line[i])];
+    state = c == 0 ? 0 : Next(state, c);
+    if ((state & kOutputBit) == 0) {
+      continue;
+    }
+    if (!word) {
+      return true;
+    }
+    for (uint32_t t = states_[state & ~kOutputBit].output; t != 0;
+         t = states_[states_[t].fail].output) {
+      if (WordBoundary(line, i + 1 - length_[t]) &&
+          WordBoundary(line, i + 1)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool MultiLiteralSearcher::Feed(uint32_t &state,
+                                std::string_view piece) const {
+  if (matchesEmpty_) {
+    return true;
+  }
+  for (const char byte : piece) {
+    const uint16_t c = classOf_[static_cast<unsigned char>(byte)];
+    state = c == 0 ? 0 : Next(state, c);
+    if ((state & kOutputBit) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace cppshell
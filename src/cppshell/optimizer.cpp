@@ -0,0 +1,356 @@
+#include "cppshell/optimizer.hpp"
+#include "cppshell/binary_detect.hpp"
+#include "cppshell/line_channel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace cppshell {
+
+namespace {
+
+/** Returns true if `cmd` has a redirection of one of the given kinds. */
+[[nodiscard]] bool Redirects(const Command &cmd,
+                             std::initializer_list<RedirectionKind> kinds) {
+  return std::any_of(cmd.redirections.begin(), cmd.redirections.end(),
+                     [&](const Redirection &r) {
+                       return std::find(kinds.begin(), kinds.end(), r.kind) !=
+                              kinds.end();
+                     });
+}
+
+/** Returns true for a stage with no assignments, redirections or fusion. */
+[[nodiscard]] bool IsPlain(const Command &cmd) {
+  return cmd.assignments.empty() && cmd.redirections.empty() &&
+         !cmd.countOutput;
+}
+
+/** What the optimizer knows about a grep invocation. */
+struct GrepArgs {
+  /** The pattern, unless given by -e or -f, and the files. */
+  size_t operands = 0;
+  /** -e or -f: no operand is the pattern. */
+  bool patternOption = false;
+  /** -q, -l, -L or -m: grep may stop before the end of its input. */
+  bool stopsEarly = false;
+  /** -l or -L: the output names the input, "(standard input)" for stdin. */
+  bool namesInput = false;
+  /** -c or -q: no line is printed. */
+  bool printsNoLines = false;
+  /** -a, -I or --binary-files other than binary. */
+  bool binaryNotReported = false;
+
+  /**
+   * Returns true if a binary input would be reported by name, as "Binary
+   * file NAME matches".
+   */
+  [[nodiscard]] bool NamesBinaryInput() const {
+    return !printsNoLines && !binaryNotReported;
+  }
+};
+
+/**
+ * Reads the arguments of a grep invocation. Returns nullopt for options
+ * the optimizer does not know, so such invocations are never rewritten.
+ */
+[[nodiscard]] std::optional<GrepArgs>
+ParseGrepArgs(const std::vector<std::string> &args) {
+  GrepArgs grep;
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string &arg = args[i];
+    if (arg == "--") {
+      grep.operands += args.size() - i - 1;
+      return grep;
+    }
+    if (arg.size() < 2 || arg[0] != '-') {
+      ++grep.operands;
+      continue;
+    }
+    if (arg == "-i" || arg == "--ignore-case" || arg == "-w" ||
+        arg == "--word-regexp" || arg == "-F" || arg == "--fixed-strings" ||
+        arg == "-v" || arg == "--invert-match" || arg == "-n" ||
+        arg == "--line-number" || arg.starts_with("--after-context=") ||
+        arg.starts_with("--before-context=") ||
+        arg.starts_with("--context=")) {
+      continue;
+    }
+    if (arg == "-c" || arg == "--count") {
+      grep.printsNoLines = true;
+      continue;
+    }
+    if (arg == "-a" || arg == "--text" || arg == "-I" ||
+        arg == "--binary-files=text" ||
+        arg == "--binary-files=without-match") {
+      grep.binaryNotReported = true;
+      continue;
+    }
+    if (arg == "--binary-files=binary") {
+      grep.binaryNotReported = false;
+      continue;
+    }
+    if (arg == "-l" || arg == "--files-with-matches" || arg == "-L" ||
+        arg == "--files-without-match") {
+      grep.stopsEarly = true;
+      grep.namesInput = true;
+      continue;
+    }
+    if (arg.starts_with("--regexp=") ||
+        (arg.starts_with("--file=") && arg != "--file=-" &&
+         arg != "--file=")) {
+      grep.patternOption = true;
+      continue;
+    }
+    if (arg == "-q" || arg == "--quiet" || arg == "--silent") {
+      grep.stopsEarly = true;
+      grep.printsNoLines = true;
+      continue;
+    }
+    if (arg.starts_with("--max-count=")) {
+      grep.stopsEarly = true;
+      continue;
+    }
+    if (arg == "-A" || arg == "--after-context" || arg == "-B" ||
+        arg == "--before-context" || arg == "-C" || arg == "--context" ||
+        arg == "-m" || arg == "--max-count") {
+      if (++i == args.size()) {
+        return std::nullopt;
+      }
+      grep.stopsEarly = grep.stopsEarly || arg == "-m" || arg == "--max-count";
+      continue;
+    }
+    if (arg == "-e" || arg == "--regexp" || arg == "-f" || arg == "--file") {
+      // -f - reads the patterns from standard input.
+      if (++i == args.size() || ((arg == "-f" || arg == "--file") &&
+                                 (args[i] == "-" || args[i].empty()))) {
+        return std::nullopt;
+      }
+      grep.patternOption = true;
+      continue;
+    }
+    return std::nullopt;
+  }
+  return grep;
+}
+
+/**
+ * Returns the arguments of `cmd` if it is grep given a pattern only, as
+ * its first operand or with -e and -f.
+ */
+[[nodiscard]] std::optional<GrepArgs> GrepOnStdin(const Command &cmd) {
+  if (cmd.command != "grep") {
+    return std::nullopt;
+  }
+  const std::optional<GrepArgs> grep = ParseGrepArgs(cmd.args);
+  if (!grep.has_value() ||
+      grep->operands != (grep->patternOption ? 0 : 1)) {
+    return std::nullopt;
+  }
+  return grep;
+}
+
+/** Returns true if `cmd` reads its standard input through to EOF. */
+[[nodiscard]] bool ReadsWholeInput(const Command &cmd) {
+  if (Redirects(cmd, {RedirectionKind::Input})) {
+    return false;
+  }
+  if (cmd.command == "cat" || cmd.command == "wc") {
+    return cmd.args.empty();
+  }
+  const std::optional<GrepArgs> grep = GrepOnStdin(cmd);
+  return grep.has_value() && !grep->stopsEarly;
+}
+
+/**
+ * Returns true if `cat path` would print the file without complaint. The
+ * path must also not look like an option once moved to another command.
+ */
+[[nodiscard]] bool IsReadableFile(const std::string &path) {
+  if (path.empty() || path[0] == '-') {
+    return false;
+  }
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return false;
+  }
+  return std::ifstream(path, std::ios::binary).good();
+}
+
+/**
+ * Returns true if grep would take the file at `path` for binary, judged by
+ * its first block as grep reads it.
+ */
+[[nodiscard]] bool LooksBinaryFile(const std::string &path) {
+  constexpr size_t kGrepBlockSize = 64 * 1024;
+  std::ifstream in(path, std::ios::binary);
+  BlockReader reader(in, kGrepBlockSize, SIZE_MAX);
+  const BlockReader::Block first = reader.Next();
+  return first.data != nullptr && LooksBinary(*first.data);
+}
+
+/** `cat FILE | wc` -> `wc FILE`, `cat FILE | grep P` -> `grep P FILE`. */
+[[nodiscard]] bool PushFileIntoConsumer(std::vector<Command> &commands,
+                                        size_t i) {
+  const Command &cat = commands[i];
+  Command &consumer = commands[i + 1];
+  if (cat.command != "cat" || !IsPlain(cat) || cat.args.size() != 1 ||
+      Redirects(consumer, {RedirectionKind::Input})) {
+    return false;
+  }
+  const bool wc = consumer.command == "wc" && consumer.args.empty();
+  const std::optional<GrepArgs> grep = GrepOnStdin(consumer);
+  if (!wc && (!grep.has_value() || grep->namesInput)) {
+    return false;
+  }
+  if (!IsReadableFile(cat.args.front())) {
+    return false;
+  }
+  // A binary file is reported under its name, standard input not.
+  if (grep.has_value() && grep->NamesBinaryInput() &&
+      LooksBinaryFile(cat.args.front())) {
+    return false;
+  }
+
+  consumer.args.push_back(cat.args.front());
+  commands.erase(commands.begin() + static_cast<std::ptrdiff_t>(i));
+  return true;
+}
+
+/** `X | cat | Y` -> `X | Y`; also `cat | Y` when Y reads all of its input. */
+[[nodiscard]] bool DropIdentityCat(std::vector<Command> &commands, size_t i) {
+  const Command &cat = commands[i];
+  if (cat.command != "cat" || !IsPlain(cat) || !cat.args.empty()) {
+    return false;
+  }
+  // A leading `cat` consumes the shell's input; dropping it is only
+  // invisible if the next stage would consume all of it as well.
+  if (i == 0 && !ReadsWholeInput(commands[i + 1])) {
+    return false;
+  }
+
+  commands.erase(commands.begin() + static_cast<std::ptrdiff_t>(i));
+  return true;
+}
+
+/** `grep ... | wc` -> grep counting its own output. */
+[[nodiscard]] bool FuseCount(std::vector<Command> &commands, size_t i) {
+  Command &grep = commands[i];
+  const Command &wc = commands[i + 1];
+  if (grep.command != "grep" || grep.countOutput ||
+      Redirects(grep, {RedirectionKind::Output, RedirectionKind::Append}) ||
+      wc.command != "wc" || !IsPlain(wc) || !wc.args.empty()) {
+    return false;
+  }
+
+  grep.countOutput = true;
+  commands.erase(commands.begin() + static_cast<std::ptrdiff_t>(i + 1));
+  return true;
+}
+
+/** Quotes `word` if the tokenizer would not read it back unchanged. */
+[[nodiscard]] std::string Quote(const std::string &word) {
+  const bool plain =
+      !word.empty() && std::all_of(word.begin(), word.end(), [](char ch) {
+        return std::isalnum(static_cast<unsigned char>(ch)) != 0 ||
+               std::string_view("_-./,:+=@%^").find(ch) !=
+                   std::string_view::npos;
+      });
+  if (plain) {
+    return word;
+  }
+  if (word.find('\'') == std::string::npos) {
+    return '\'' + word + '\'';
+  }
+  std::string quoted = "\"";
+  for (const char ch : word) {
+    if (ch == '"' || ch == '\\') {
+      quoted.push_back('\\');
+    }
+    quoted.push_back(ch);
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+[[nodiscard]] std::string FormatCommand(const Command &cmd) {
+  std::vector<std::string> words;
+  // Assignments live in an unordered_map; sort them for a stable dump.
+  const std::map<std::string, std::string> assignments(
+      cmd.assignments.begin(), cmd.assignments.end());
+  for (const auto &[name, value] : assignments) {
+    words.push_back(name + '=' + Quote(value));
+  }
+  if (!cmd.command.empty()) {
+    words.push_back(Quote(cmd.command));
+  }
+  for (const std::string &arg : cmd.args) {
+    words.push_back(Quote(arg));
+  }
+  for (const Redirection &r : cmd.redirections) {
+    switch (r.kind) {
+    case RedirectionKind::Input:
+      words.emplace_back("<");
+      break;
+    case RedirectionKind::Output:
+      words.emplace_back(">");
+      break;
+    case RedirectionKind::Append:
+      words.emplace_back(">>");
+      break;
+    case RedirectionKind::Error:
+      words.emplace_back("2>");
+      break;
+    }
+    words.push_back(Quote(r.target));
+  }
+
+  std::string text;
+  for (const std::string &word : words) {
+    if (!text.empty()) {
+      text.push_back(' ');
+    }
+    text += word;
+  }
+  if (cmd.countOutput) {
+    text = '[' + text + " | wc]";
+  }
+  return text;
+}
+
+} // namespace
+
+Pipeline OptimizePipeline(Pipeline pipeline) {
+  std::vector<Command> &commands = pipeline.commands;
+
+  // Every rewrite removes a stage, so this terminates.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i + 1 < commands.size() && !changed; ++i) {
+      changed = PushFileIntoConsumer(commands, i) ||
+                DropIdentityCat(commands, i) || FuseCount(commands, i);
+    }
+  }
+  return pipeline;
+}
+
+std::string FormatPipeline(const Pipeline &pipeline) {
+  std::string text;
+  for (const Command &cmd : pipeline.commands) {
+    if (!text.empty()) {
+      text += " | ";
+    }
+    text += FormatCommand(cmd);
+  }
+  return text;
+}
+
+} // namespace cppshell
@@ -28,6 +28,23 @@ namespace {
   return true;
 }
 
+[[nodiscard]] std::optional<RedirectionKind>
+RedirectionOperator(const std::string &token) {
+  if (token == "<") {
+    return RedirectionKind::Input;
+  }
+  if (token == ">") {
+    return RedirectionKind::Output;
+  }
+  if (token == ">>") {
+    return RedirectionKind::Append;
+  }
+  if (token == "2>") {
+    return RedirectionKind::Error;
+  }
+  return std::nullopt;
+}
+
 } // namespace
 
 ParseResult ParseLine(std::string_view input) {
@@ -50,7 +67,8 @@ ParseResult ParseLine(std::string_view input) {
   while (start < tok.tokens.size()) {
     // Find next pipe or end
     size_t end = start;
-    while (end < tok.tokens.size() && tok.tokens[end] != "|") {
+    while (end < tok.tokens.size() &&
+           !(tok.operators[end] && tok.tokens[end] == "|")) {
       end++;
     }
 
@@ -75,11 +93,26 @@ ParseResult ParseLine(std::string_view input) {
       cmd.assignments.emplace(name, value);
     }
 
-    if (i < end) {
-      cmd.command = tok.tokens[i];
-      for (size_t j = i + 1; j < end; ++j) {
-        cmd.args.push_back(tok.tokens[j]);
+    // Command words with redirections interleaved anywhere among them.
+    for (; i < end; ++i) {
+      const std::string &t = tok.tokens[i];
+      const std::optional<RedirectionKind> kind =
+          tok.operators[i] ? RedirectionOperator(t) : std::nullopt;
+      if (!kind.has_value()) {
+        if (cmd.command.empty()) {
+          cmd.command = t;
+        } else {
+          cmd.args.push_back(t);
+        }
+        continue;
+      }
+
+      if (i + 1 >= end || tok.operators[i + 1]) {
+        result.error = "expected file name after '" + t + "'";
+        return result;
       }
+      cmd.redirections.push_back(Redirection{*kind, tok.tokens[i + 1]});
+      ++i;
     }
 
     pipeline.commands.push_back(std::move(cmd));
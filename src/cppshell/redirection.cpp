@@ -0,0 +1,166 @@
+#include "cppshell/redirection.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include "cppshell/fd_stream.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+#ifndef _WIN32
+
+[[nodiscard]] int OpenFlags(RedirectionKind kind) {
+  switch (kind) {
+  case RedirectionKind::Input:
+    return O_RDONLY | O_CLOEXEC;
+  case RedirectionKind::Append:
+    return O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+  case RedirectionKind::Output:
+  case RedirectionKind::Error:
+    break;
+  }
+  return O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+}
+
+[[nodiscard]] int TargetFd(RedirectionKind kind) {
+  switch (kind) {
+  case RedirectionKind::Input:
+    return STDIN_FILENO;
+  case RedirectionKind::Error:
+    return STDERR_FILENO;
+  case RedirectionKind::Output:
+  case RedirectionKind::Append:
+    break;
+  }
+  return STDOUT_FILENO;
+}
+
+/** Opens a redirection target; returns -1 and fills `error` on failure. */
+[[nodiscard]] int OpenTarget(const Redirection &r, std::string &error) {
+  int fd = -1;
+  do {
+    fd = ::open(r.target.c_str(), OpenFlags(r.kind), 0666);
+  } while (fd < 0 && errno == EINTR);
+
+  if (fd < 0) {
+    error = r.target + ": " + std::strerror(errno);
+  }
+  return fd;
+}
+
+#endif
+
+} // namespace
+
+RedirectedStreams::RedirectedStreams(
+    const std::vector<Redirection> &redirections, CommandStreams inherited)
+    : in_(&inherited.in), out_(&inherited.out), err_(&inherited.err) {
+  std::streambuf *inBuf = nullptr;
+  std::streambuf *outBuf = nullptr;
+  std::streambuf *errBuf = nullptr;
+
+  for (const Redirection &r : redirections) {
+#ifdef _WIN32
+    auto file = std::make_unique<std::filebuf>();
+    std::ios::openmode mode = std::ios::binary;
+    switch (r.kind) {
+    case RedirectionKind::Input:
+      mode |= std::ios::in;
+      break;
+    case RedirectionKind::Append:
+      mode |= std::ios::out | std::ios::app;
+      break;
+    case RedirectionKind::Output:
+    case RedirectionKind::Error:
+      mode |= std::ios::out | std::ios::trunc;
+      break;
+    }
+    if (file->open(r.target, mode) == nullptr) {
+      error_ = r.target + ": cannot open file";
+      return;
+    }
+    std::unique_ptr<std::streambuf> buffer = std::move(file);
+#else
+    const int fd = OpenTarget(r, error_);
+    if (fd < 0) {
+      return;
+    }
+    std::unique_ptr<std::streambuf> buffer;
+    if (r.kind == RedirectionKind::Input) {
+      buffer = std::make_unique<FdReadBuffer>(fd, true);
+    } else {
+      buffer = std::make_unique<FdWriteBuffer>(fd, true);
+    }
+#endif
+
+    switch (r.kind) {
+    case RedirectionKind::Input:
+      inBuf = buffer.get();
+      break;
+    case RedirectionKind::Output:
+    case RedirectionKind::Append:
+      outBuf = buffer.get();
+      break;
+    case RedirectionKind::Error:
+      errBuf = buffer.get();
+      break;
+    }
+    buffers_.push_back(std::move(buffer));
+  }
+
+  if (inBuf != nullptr) {
+    ownedIn_ = std::make_unique<std::istream>(inBuf);
+    in_ = ownedIn_.get();
+  }
+  if (outBuf != nullptr) {
+    ownedOut_ = std::make_unique<std::ostream>(outBuf);
+    out_ = ownedOut_.get();
+  }
+  if (errBuf != nullptr) {
+    ownedErr_ = std::make_unique<std::ostream>(errBuf);
+    err_ = ownedErr_.get();
+  }
+}
+
+RedirectedStreams::~RedirectedStreams() {
+  // Streams must go before the buffers they point to; buffers flush and
+  // close their files when destroyed.
+  ownedIn_.reset();
+  ownedOut_.reset();
+  ownedErr_.reset();
+  buffers_.clear();
+}
+
+CommandStreams RedirectedStreams::Streams() const {
+  return CommandStreams{*in_, *out_, *err_};
+}
+
+#ifndef _WIN32
+std::string RedirectStandardFds(const std::vector<Redirection> &redirections) {
+  std::string error;
+  for (const Redirection &r : redirections) {
+    const int fd = OpenTarget(r, error);
+    if (fd < 0) {
+      return error;
+    }
+    if (::dup2(fd, TargetFd(r.kind)) < 0) {
+      error = r.target + ": " + std::strerror(errno);
+      ::close(fd);
+      return error;
+    }
+    ::close(fd);
+  }
+  return error;
+}
+#endif
+
+} // namespace cppshell
@@ -0,0 +1,896 @@
+#include "cppshell/regex_automaton.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+namespace cppshell {
+
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+/** Upper bound of a repetition without one. */
+constexpr size_t kUnbounded = SIZE_MAX;
+
+/** Largest bound accepted in {n,m}; larger ones go to std::regex. */
+constexpr size_t kMaxRepeat = 1000;
+
+/** Largest NFA compiled; counted repetition can multiply the pattern. */
+constexpr size_t kMaxNfaNodes = 20000;
+
+/** Deepest group nesting parsed (the parser recurses per level). */
+constexpr int kMaxDepth = 200;
+
+enum class Assertion : uint8_t {
+  kLineStart,
+  kLineEnd,
+  kWordBoundary,
+  kNotWordBoundary,
+};
+
+[[nodiscard]] bool IsWordByte(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z') || c == '_';
+}
+
+[[nodiscard]] ByteSet MakeSet(bool (*member)(unsigned char)) {
+  ByteSet set;
+  for (int c = 0; c < 256; ++c) {
+    set[c] = member(static_cast<unsigned char>(c));
+  }
+  return set;
+}
+
+[[nodiscard]] const ByteSet &WordSet() {
+  static const ByteSet set = MakeSet(IsWordByte);
+  return set;
+}
+
+[[nodiscard]] const ByteSet &DigitSet() {
+  static const ByteSet set =
+      MakeSet([](unsigned char c) { return c >= '0' && c <= '9'; });
+  return set;
+}
+
+[[nodiscard]] const ByteSet &SpaceSet() {
+  static const ByteSet set = MakeSet([](unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  });
+  return set;
+}
+
+/** Adds the other case of every ASCII letter in `set`. */
+[[nodiscard]] ByteSet FoldCase(ByteSet set) {
+  for (int c = 'a'; c <= 'z'; ++c) {
+    const int upper = c - 'a' + 'A';
+    if (set[c] || set[upper]) {
+      set[c] = true;
+      set[upper] = true;
+    }
+  }
+  return set;
+}
+
+/** Parsed pattern. */
+struct AstNode {
+  enum class Kind : uint8_t {
+    kEmpty,
+    kSet,
+    kConcat,
+    kAlternate,
+    kRepeat,
+    kAssert,
+  };
+
+  Kind kind = Kind::kEmpty;
+  ByteSet set;
+  Assertion assertion = Assertion::kLineStart;
+  size_t min = 0;
+  size_t max = 0;
+  std::vector<AstNode> children;
+};
+
+/**
+ * Recursive descent parser for the supported subset. Any failure, be it an
+ * invalid pattern or unsupported syntax, makes Parse() return nullopt.
+ */
+class Parser {
+public:
+  Parser(std::string_view pattern, bool ignoreCase)
+      : pattern_(pattern), ignoreCase_(ignoreCase) {}
+
+  [[nodiscard]] std::optional<AstNode> Parse() {
+    AstNode root;
+    if (!ParseAlternation(root, 0) || pos_ != pattern_.size()) {
+      return std::nullopt;
+    }
+    return root;
+  }
+
+private:
+  [[nodiscard]] bool AtEnd() const { return pos_ == pattern_.size(); }
+  [[nodiscard]] unsigned char Peek() const {
+    return static_cast<unsigned char>(pattern_[pos_]);
+  }
+
+  [[nodiscard]] AstNode SetNode(const ByteSet &set) const {
+    AstNode node;
+    node.kind = AstNode::Kind::kSet;
+    node.set = ignoreCase_ ? FoldCase(set) : set;
+    return node;
+  }
+
+  bool ParseAlternation(AstNode &out, int depth) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    AstNode first;
+    if (!ParseConcat(first, depth)) {
+      return false;
+    }
+    if (AtEnd() || Peek() != '|') {
+      out = std::move(first);
+      return true;
+    }
+    out.kind = AstNode::Kind::kAlternate;
+    out.children.push_back(std::move(first));
+    while (!AtEnd() && Peek() == '|') {
+      ++pos_;
+      AstNode next;
+      if (!ParseConcat(next, depth)) {
+        return false;
+      }
+      out.children.push_back(std::move(next));
+    }
+    return true;
+  }
+
+  bool ParseConcat(AstNode &out, int depth) {
+    out.kind = AstNode::Kind::kConcat;
+    while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+      AstNode item;
+      if (!ParseRepeat(item, depth)) {
+        return false;
+      }
+      out.children.push_back(std::move(item));
+    }
+    return true;
+  }
+
+  bool ParseRepeat(AstNode &out, int depth) {
+    AstNode atom;
+    if (!ParseAtom(atom, depth)) {
+      return false;
+    }
+    if (AtEnd()) {
+      out = std::move(atom);
+      return true;
+    }
+
+    size_t min = 0;
+    size_t max = kUnbounded;
+    switch (Peek()) {
+    case '*':
+      ++pos_;
+      break;
+    case '+':
+      min = 1;
+      ++pos_;
+      break;
+    case '?':
+      max = 1;
+      ++pos_;
+      break;
+    case '{':
+      if (!ParseBounds(min, max)) {
+        return false;
+      }
+      break;
+    default:
+      out = std::move(atom);
+      return true;
+    }
+    if (atom.kind == AstNode::Kind::kAssert) {
+      return false;
+    }
+    if (!AtEnd() && Peek() == '?') {
+      ++pos_; // Lazy: the same lines match.
+    }
+    if (!AtEnd() && (Peek() == '*' || Peek() == '+' || Peek() == '?' ||
+                     Peek() == '{')) {
+      return false; // Nothing to repeat.
+    }
+    out.kind = AstNode::Kind::kRepeat;
+    out.min = min;
+    out.max = max;
+    out.children.push_back(std::move(atom));
+    return true;
+  }
+
+  /** Parses "{n}", "{n,}" or "{n,m}". */
+  bool ParseBounds(size_t &min, size_t &max) {
+    ++pos_;
+    const auto number = [this](size_t &value) {
+      const size_t start = pos_;
+      value = 0;
+      while (!AtEnd() && Peek() >= '0' && Peek() <= '9') {
+        value = value * 10 + (Peek() - '0');
+        if (value > kMaxRepeat) {
+          return false;
+        }
+        ++pos_;
+      }
+      return pos_ != start;
+    };
+    if (!number(min)) {
+      return false;
+    }
+    max = min;
+    if (!AtEnd() && Peek() == ',') {
+      ++pos_;
+      max = kUnbounded;
+      if (!AtEnd() && Peek() != '}' && !number(max)) {
+        return false;
+      }
+    }
+    if (AtEnd() || Peek() != '}' || max < min) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  bool ParseAtom(AstNode &out, int depth) {
+    const unsigned char c = Peek();
+    switch (c) {
+    case '(': {
+      ++pos_;
+      if (!AtEnd() && Peek() == '?') {
+        if (pos_ + 1 >= pattern_.size() || pattern_[pos_ + 1] != ':') {
+          return false; // Lookahead.
+        }
+        pos_ += 2;
+      }
+      if (!ParseAlternation(out, depth + 1) || AtEnd() || Peek() != ')') {
+        return false;
+      }
+      ++pos_;
+      return true;
+    }
+    case '[': {
+      ++pos_;
+      ByteSet set;
+      if (!ParseClass(set)) {
+        return false;
+      }
+      out.kind = AstNode::Kind::kSet;
+      out.set = set;
+      return true;
+    }
+    case '.': {
+      ++pos_;
+      ByteSet set;
+      set.set();
+      set['\n'] = false;
+      set['\r'] = false;
+      out = SetNode(set);
+      return true;
+    }
+    case '^':
+    case '$':
+      ++pos_;
+      out.kind = AstNode::Kind::kAssert;
+      out.assertion = c == '^' ? Assertion::kLineStart : Assertion::kLineEnd;
+      return true;
+    case '\\': {
+      ++pos_;
+      if (AtEnd()) {
+        return false;
+      }
+      if (Peek() == 'b' || Peek() == 'B') {
+        out.kind = AstNode::Kind::kAssert;
+        out.assertion = Peek() == 'b' ? Assertion::kWordBoundary
+                                      : Assertion::kNotWordBoundary;
+        ++pos_;
+        return true;
+      }
+      ByteSet set;
+      bool single = false;
+      if (!ParseEscape(set, single, false)) {
+        return false;
+      }
+      out = SetNode(set);
+      return true;
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+    case ')':
+    case '|':
+      return false;
+    default: {
+      ++pos_;
+      ByteSet set;
+      set[c] = true;
+      out = SetNode(set);
+      return true;
+    }
+    }
+  }
+
+  /**
+   * Parses the escape after a backslash into `set`. `single` tells whether
+   * it stands for one byte (and so may bound a range).
+   */
+  bool ParseEscape(ByteSet &set, bool &single, bool inClass) {
+    const unsigned char c = Peek();
+    ++pos_;
+    single = false;
+    switch (c) {
+    case 'd':
+      set = DigitSet();
+      return true;
+    case 'D':
+      set = ~DigitSet();
+      return true;
+    case 'w':
+      set = WordSet();
+      return true;
+    case 'W':
+      set = ~WordSet();
+      return true;
+    case 's':
+      set = SpaceSet();
+      return true;
+    case 'S':
+      set = ~SpaceSet();
+      return true;
+    default:
+      break;
+    }
+
+    int byte = -1;
+    switch (c) {
+    case 'n':
+      byte = '\n';
+      break;
+    case 't':
+      byte = '\t';
+      break;
+    case 'r':
+      byte = '\r';
+      break;
+    case 'f':
+      byte = '\f';
+      break;
+    case 'v':
+      byte = '\v';
+      break;
+    case 'b':
+      byte = inClass ? '\b' : -1;
+      break;
+    case '0':
+      byte = AtEnd() || Peek() < '0' || Peek() > '9' ? 0 : -1;
+      break;
+    case 'x': {
+      const auto hex = [](unsigned char h) {
+        if (h >= '0' && h <= '9') {
+          return h - '0';
+        }
+        h |= 0x20;
+        return h >= 'a' && h <= 'f' ? h - 'a' + 10 : -1;
+      };
+      if (pos_ + 2 <= pattern_.size()) {
+        const int high = hex(pattern_[pos_]);
+        const int low = hex(pattern_[pos_ + 1]);
+        if (high >= 0 && low >= 0) {
+          byte = high * 16 + low;
+          pos_ += 2;
+        }
+      }
+      break;
+    }
+    default:
+      // Backreferences, \u, \c and unknown letters are left to std::regex.
+      if (!IsWordByte(c) && c < 0x80) {
+        byte = c;
+      }
+      break;
+    }
+    if (byte < 0) {
+      return false;
+    }
+    set[byte] = true;
+    single = true;
+    return true;
+  }
+
+  /** Parses a bracket expression after its '['. */
+  bool ParseClass(ByteSet &out) {
+    ByteSet set;
+    bool negate = false;
+    if (!AtEnd() && Peek() == '^') {
+      negate = true;
+      ++pos_;
+    }
+    if (!AtEnd() && Peek() == ']') {
+      return false; // "[]" and "[^]" differ between dialects.
+    }
+    while (true) {
+      if (AtEnd()) {
+        return false;
+      }
+      if (Peek() == ']') {
+        ++pos_;
+        break;
+      }
+      unsigned char low = 0;
+      ByteSet item;
+      bool single = false;
+      if (!ParseClassItem(item, single, low)) {
+        return false;
+      }
+      const bool range = single && pos_ + 1 < pattern_.size() &&
+                         Peek() == '-' && pattern_[pos_ + 1] != ']';
+      if (!range) {
+        set |= item;
+        continue;
+      }
+      ++pos_;
+      unsigned char high = 0;
+      if (!ParseClassItem(item, single, high) || !single || high < low) {
+        return false;
+      }
+      for (int b = low; b <= high; ++b) {
+        set[b] = true;
+      }
+    }
+    if (ignoreCase_) {
+      set = FoldCase(set);
+    }
+    out = negate ? ~set : set;
+    return true;
+  }
+
+  bool ParseClassItem(ByteSet &item, bool &single, unsigned char &byte) {
+    item.reset();
+    const unsigned char c = Peek();
+    if (c == '[' && pos_ + 1 < pattern_.size() &&
+        (pattern_[pos_ + 1] == ':' || pattern_[pos_ + 1] == '=' ||
+         pattern_[pos_ + 1] == '.')) {
+      return false; // POSIX classes.
+    }
+    if (c == '\\') {
+      ++pos_;
+      if (AtEnd() || !ParseEscape(item, single, true)) {
+        return false;
+      }
+    } else {
+      ++pos_;
+      item[c] = true;
+      single = true;
+    }
+    if (single) {
+      for (int b = 0; b < 256; ++b) {
+        if (item[b]) {
+          byte = static_cast<unsigned char>(b);
+        }
+      }
+    }
+    return true;
+  }
+
+  std::string_view pattern_;
+  bool ignoreCase_;
+  size_t pos_ = 0;
+};
+
+} // namespace
+
+/** Thompson NFA plus what the DFA needs to know about it. */
+struct RegexAutomaton::Nfa {
+  struct Node {
+    enum class Kind : uint8_t { kSet, kSplit, kEmpty, kAssert, kMatch };
+
+    Kind kind = Kind::kEmpty;
+    Assertion assertion = Assertion::kLineStart;
+    int out = -1;
+    int out1 = -1;
+    /** Index into `sets` for kSet. */
+    int set = -1;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<ByteSet> sets;
+  int start = -1;
+  /** Whether ^ or \b/\B occur; otherwise state flags are not needed. */
+  bool usesStart = false;
+  bool usesWord = false;
+  /** Bytes that no part of the pattern tells apart share a class. */
+  std::array<uint8_t, 256> byteClass{};
+  size_t classCount = 0;
+  /** One byte of each class. */
+  std::vector<unsigned char> classByte;
+
+  /** Adds a node and returns its index, or -1 once the NFA is too big. */
+  int Add(Node node) {
+    if (nodes.size() >= kMaxNfaNodes) {
+      return -1;
+    }
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size() - 1);
+  }
+
+  /** Compiles `ast` to continue at `next`; returns the entry, -1 if full. */
+  int Compile(const AstNode &ast, int next) {
+    if (next < 0) {
+      return -1;
+    }
+    switch (ast.kind) {
+    case AstNode::Kind::kEmpty:
+      return next;
+    case AstNode::Kind::kSet: {
+      sets.push_back(ast.set);
+      Node node;
+      node.kind = Node::Kind::kSet;
+      node.set = static_cast<int>(sets.size() - 1);
+      node.out = next;
+      return Add(node);
+    }
+    case AstNode::Kind::kAssert: {
+      Node node;
+      node.kind = Node::Kind::kAssert;
+      node.assertion = ast.assertion;
+      node.out = next;
+      usesStart |= ast.assertion == Assertion::kLineStart;
+      usesWord |= ast.assertion == Assertion::kWordBoundary ||
+                  ast.assertion == Assertion::kNotWordBoundary;
+      return Add(node);
+    }
+    case AstNode::Kind::kConcat:
+      for (auto it = ast.children.rbegin(); it != ast.children.rend(); ++it) {
+        next = Compile(*it, next);
+      }
+      return next;
+    case AstNode::Kind::kAlternate: {
+      int entry = Compile(ast.children.back(), next);
+      for (size_t i = ast.children.size() - 1; i-- > 0;) {
+        const int branch = Compile(ast.children[i], next);
+        Node split;
+        split.kind = Node::Kind::kSplit;
+        split.out = branch;
+        split.out1 = entry;
+        entry = branch < 0 || entry < 0 ? -1 : Add(split);
+      }
+      return entry;
+    }
+    case AstNode::Kind::kRepeat:
+      return CompileRepeat(ast, next);
+    }
+    return -1;
+  }
+
+  int CompileRepeat(const AstNode &ast, int next) {
+    const AstNode &child = ast.children.front();
+    int entry = next;
+    if (ast.max == kUnbounded) {
+      // child*: a split looping back through the child.
+      Node split;
+      split.kind = Node::Kind::kSplit;
+      split.out1 = next;
+      const int loop = Add(split);
+      if (loop < 0) {
+        return -1;
+      }
+      const int body = Compile(child, loop);
+      if (body < 0) {
+        return -1;
+      }
+      nodes[loop].out = body;
+      entry = loop;
+    } else {
+      // (child(child(...)?)?)? for the optional copies.
+      for (size_t i = ast.min; i < ast.max; ++i) {
+        const int body = Compile(child, entry);
+        Node split;
+        split.kind = Node::Kind::kSplit;
+        split.out = body;
+        split.out1 = next;
+        entry = body < 0 ? -1 : Add(split);
+        if (entry < 0) {
+          return -1;
+        }
+      }
+    }
+    for (size_t i = 0; i < ast.min; ++i) {
+      entry = Compile(child, entry);
+      if (entry < 0) {
+        return -1;
+      }
+    }
+    return entry;
+  }
+
+  /** Splits the bytes into classes no set or assertion distinguishes. */
+  void ComputeByteClasses() {
+    std::vector<const ByteSet *> all;
+    for (const ByteSet &set : sets) {
+      all.push_back(&set);
+    }
+    if (usesWord) {
+      all.push_back(&WordSet());
+    }
+    uint8_t cls = 0;
+    classByte.assign(1, 0);
+    for (int b = 1; b < 256; ++b) {
+      const bool boundary =
+          std::any_of(all.begin(), all.end(), [b](const ByteSet *set) {
+            return (*set)[b] != (*set)[b - 1];
+          });
+      if (boundary) {
+        ++cls;
+        classByte.push_back(static_cast<unsigned char>(b));
+      }
+      byteClass[b] = cls;
+    }
+    classCount = classByte.size();
+  }
+};
+
+/** Lazily built DFA over one Nfa. */
+struct RegexAutomaton::Searcher::Cache {
+  /** Transition to a state whose closure already contains the match. */
+  static constexpr int kMatched = -2;
+  static constexpr int kUnknown = -1;
+
+  struct State {
+    /** NFA nodes reached, before following their epsilon edges. */
+    std::vector<int> nodes;
+    bool atStart = false;
+    bool prevWord = false;
+    /** Whether the pattern matches if the line ends here: -1 not known. */
+    int8_t endMatch = -1;
+  };
+
+  explicit Cache(const Nfa &nfa) : nfa(nfa), visited(nfa.nodes.size(), 0) {
+    Reset();
+  }
+
+  void Reset() {
+    states.clear();
+    index.clear();
+    table.clear();
+    State start;
+    start.nodes = {nfa.start};
+    start.atStart = nfa.usesStart;
+    static_cast<void>(Intern(std::move(start)));
+  }
+
+  /** Returns the id of `state`, adding it if new. */
+  int Intern(State state) {
+    std::string key(reinterpret_cast<const char *>(state.nodes.data()),
+                    state.nodes.size() * sizeof(int));
+    key.push_back(static_cast<char>(state.atStart * 2 + state.prevWord));
+    const auto it = index.find(key);
+    if (it != index.end()) {
+      return it->second;
+    }
+    const int id = static_cast<int>(states.size());
+    states.push_back(std::move(state));
+    index.emplace(std::move(key), id);
+    table.resize(states.size() * nfa.classCount, kUnknown);
+    return id;
+  }
+
+  /**
+   * Follows the epsilon edges of `state` with the next byte's word-ness
+   * (or the line end) known. Collects the byte-consuming nodes reached and
+   * returns true if the match node is among them.
+   */
+  bool Closure(const State &state, bool nextWord, bool atEnd,
+               std::vector<int> &consuming) {
+    if (++generation == 0) {
+      std::fill(visited.begin(), visited.end(), 0);
+      generation = 1;
+    }
+    stack.assign(state.nodes.begin(), state.nodes.end());
+    while (!stack.empty()) {
+      const int n = stack.back();
+      stack.pop_back();
+      if (n < 0 || visited[n] == generation) {
+        continue;
+      }
+      visited[n] = generation;
+      const Nfa::Node &node = nfa.nodes[n];
+      switch (node.kind) {
+      case Nfa::Node::Kind::kMatch:
+        return true;
+      case Nfa::Node::Kind::kSet:
+        consuming.push_back(n);
+        break;
+      case Nfa::Node::Kind::kSplit:
+        stack.push_back(node.out1);
+        stack.push_back(node.out);
+        break;
+      case Nfa::Node::Kind::kEmpty:
+        stack.push_back(node.out);
+        break;
+      case Nfa::Node::Kind::kAssert: {
+        bool holds = false;
+        switch (node.assertion) {
+        case Assertion::kLineStart:
+          holds = state.atStart;
+          break;
+        case Assertion::kLineEnd:
+          holds = atEnd;
+          break;
+        case Assertion::kWordBoundary:
+          holds = state.prevWord != nextWord;
+          break;
+        case Assertion::kNotWordBoundary:
+          holds = state.prevWord == nextWord;
+          break;
+        }
+        if (holds) {
+          stack.push_back(node.out);
+        }
+        break;
+      }
+      }
+    }
+    return false;
+  }
+
+  /** Computes the transition of state `s` on `byte`. */
+  int Step(int s, unsigned char byte) {
+    const bool word = IsWordByte(byte);
+    consuming.clear();
+    if (Closure(states[s], word, false, consuming)) {
+      table[s * nfa.classCount + nfa.byteClass[byte]] = kMatched;
+      return kMatched;
+    }
+
+    // A match may also start at the next position, so the start node is
+    // always part of the new state.
+    State next;
+    next.nodes.push_back(nfa.start);
+    for (const int n : consuming) {
+      const Nfa::Node &node = nfa.nodes[n];
+      if (nfa.sets[node.set][byte]) {
+        next.nodes.push_back(node.out);
+      }
+    }
+    std::sort(next.nodes.begin(), next.nodes.end());
+    next.nodes.erase(std::unique(next.nodes.begin(), next.nodes.end()),
+                     next.nodes.end());
+    next.prevWord = nfa.usesWord && word;
+
+    if (states.size() >= kMaxStates) {
+      // Start over; the state being left is not needed any more.
+      ++resets;
+      Reset();
+      return Intern(std::move(next));
+    }
+    const int id = Intern(std::move(next));
+    table[s * nfa.classCount + nfa.byteClass[byte]] = id;
+    return id;
+  }
+
+  bool EndMatches(int s) {
+    State &state = states[s];
+    if (state.endMatch < 0) {
+      consuming.clear();
+      state.endMatch = Closure(state, false, true, consuming) ? 1 : 0;
+    }
+    return state.endMatch == 1;
+  }
+
+  const Nfa &nfa;
+  std::vector<State> states;
+  std::unordered_map<std::string, int> index;
+  /** states.size() x classCount transitions. */
+  std::vector<int> table;
+  size_t resets = 0;
+
+  // Scratch space for Closure().
+  std::vector<uint32_t> visited;
+  uint32_t generation = 0;
+  std::vector<int> stack;
+  std::vector<int> consuming;
+};
+
+RegexAutomaton::Searcher::Searcher(const Nfa &nfa)
+    : cache_(std::make_unique<Cache>(nfa)) {}
+
+RegexAutomaton::Searcher::~Searcher() = default;
+
+bool RegexAutomaton::Searcher::Search(std::string_view line) {
+  Begin();
+  return Feed(line) || End();
+}
+
+void RegexAutomaton::Searcher::Begin() {
+  // The start state keeps id 0 across cache resets.
+  state_ = 0;
+  matched_ = false;
+}
+
+bool RegexAutomaton::Searcher::Feed(std::string_view piece) {
+  if (matched_) {
+    return true;
+  }
+  Cache &cache = *cache_;
+  const auto *byteClass = cache.nfa.byteClass.data();
+  const size_t classes = cache.nfa.classCount;
+  int s = state_;
+  for (const char ch : piece) {
+    const auto byte = static_cast<unsigned char>(ch);
+    int next = cache.table[s * classes + byteClass[byte]];
+    if (next == Cache::kUnknown) {
+      next = cache.Step(s, byte);
+    }
+    if (next == Cache::kMatched) {
+      matched_ = true;
+      return true;
+    }
+    s = next;
+  }
+  state_ = s;
+  return false;
+}
+
+bool RegexAutomaton::Searcher::End() {
+  return matched_ || cache_->EndMatches(state_);
+}
+
+size_t RegexAutomaton::Searcher::CacheResets() const {
+  return cache_->resets;
+}
+
+std::unique_ptr<RegexAutomaton>
+RegexAutomaton::Compile(std::string_view pattern, bool ignoreCase) {
+  std::optional<AstNode> ast = Parser(pattern, ignoreCase).Parse();
+  if (!ast.has_value()) {
+    return nullptr;
+  }
+  auto nfa = std::make_unique<Nfa>();
+  Nfa::Node match;
+  match.kind = Nfa::Node::Kind::kMatch;
+  nfa->start = nfa->Compile(*ast, nfa->Add(match));
+  if (nfa->start < 0) {
+    return nullptr;
+  }
+  nfa->ComputeByteClasses();
+  return std::unique_ptr<RegexAutomaton>(new RegexAutomaton(std::move(nfa)));
+}
+
+RegexAutomaton::RegexAutomaton(std::unique_ptr<Nfa> nfa)
+    : nfa_(std::move(nfa)) {}
+
+RegexAutomaton::~RegexAutomaton() = default;
+
+std::unique_ptr<RegexAutomaton::Searcher> RegexAutomaton::Acquire() const {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_.empty()) {
+      std::unique_ptr<Searcher> searcher = std::move(idle_.back());
+      idle_.pop_back();
+      return searcher;
+    }
+  }
+  return std::unique_ptr<Searcher>(new Searcher(*nfa_));
+}
+
+void RegexAutomaton::Release(std::unique_ptr<Searcher> searcher) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.push_back(std::move(searcher));
+}
+
+} // namespace cppshell
@@ -0,0 +1,432 @@
+#include "cppshell/shm_transport.hpp"
+
+#ifdef __linux__
+
+#include "cppshell/fd_stream.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cppshell {
+
+/**
+ * Shared state at the start of the memfd. Each group of fields is written
+ * by one side only; positions only grow, and the event counters are the
+ * futex words the other side sleeps on.
+ */
+struct SharedRing::Header {
+  // Written by the consumer.
+  alignas(64) std::atomic<uint64_t> head{0};
+  std::atomic<uint32_t> spaceEvent{0};
+  std::atomic<uint32_t> readerWaiting{0};
+  std::atomic<uint32_t> readerClosed{0};
+  // Written by the producer.
+  alignas(64) std::atomic<uint64_t> tail{0};
+  std::atomic<uint32_t> dataEvent{0};
+  std::atomic<uint32_t> writerWaiting{0};
+  std::atomic<uint32_t> writerClosed{0};
+};
+
+namespace {
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory atomics must not use process-local locks");
+
+/** How long a side sleeps before checking whether its peer still exists. */
+constexpr long kPeerCheckNanos = 50'000'000;
+
+[[nodiscard]] size_t RoundUp(size_t value, size_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+/**
+ * Sleeps while `word` equals `expected`, until woken or the peer check
+ * interval expires. Returns false on timeout.
+ */
+bool FutexWait(std::atomic<uint32_t> &word, uint32_t expected) {
+  timespec timeout{0, kPeerCheckNanos};
+  const long r = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+                         FUTEX_WAIT, expected, &timeout, nullptr, 0);
+  return !(r == -1 && errno == ETIMEDOUT);
+}
+
+void FutexWake(std::atomic<uint32_t> &word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+/** Returns true if the other end of pipe `fd` has been closed. */
+[[nodiscard]] bool PeerGone(int fd) {
+  if (fd < 0) {
+    return false;
+  }
+  pollfd p{fd, 0, 0};
+  return ::poll(&p, 1, 0) > 0 && (p.revents & (POLLHUP | POLLERR)) != 0;
+}
+
+/** Anonymous private pages, released with munmap. */
+[[nodiscard]] char *MapPages(size_t size) {
+  void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return p == MAP_FAILED ? nullptr : static_cast<char *>(p);
+}
+
+} // namespace
+
+std::unique_ptr<SharedRing> SharedRing::Create(size_t capacity) {
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  capacity = RoundUp(std::max<size_t>(capacity, 1), page);
+  const size_t headerSize = RoundUp(sizeof(Header), page);
+
+  const int fd = memfd_create("cppshell-ring", MFD_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (ftruncate(fd, static_cast<off_t>(headerSize + capacity)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void *header = mmap(nullptr, headerSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  // Reserve twice the capacity, then map the data pages into both halves:
+  // a region running past the end continues at the start.
+  void *area = mmap(nullptr, 2 * capacity, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  bool ok = header != MAP_FAILED && area != MAP_FAILED;
+  for (int half = 0; ok && half < 2; ++half) {
+    void *at = static_cast<char *>(area) + half * capacity;
+    ok = mmap(at, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+              fd, static_cast<off_t>(headerSize)) == at;
+  }
+  close(fd);
+  if (!ok) {
+    if (header != MAP_FAILED) {
+      munmap(header, headerSize);
+    }
+    if (area != MAP_FAILED) {
+      munmap(area, 2 * capacity);
+    }
+    return nullptr;
+  }
+
+  return std::unique_ptr<SharedRing>(
+      new SharedRing(new (header) Header{}, static_cast<char *>(area),
+                     capacity, headerSize));
+}
+
+SharedRing::SharedRing(Header *header, char *data, size_t capacity,
+                       size_t headerSize)
+    : header_(header), data_(data), capacity_(capacity),
+      headerSize_(headerSize) {}
+
+SharedRing::~SharedRing() {
+  munmap(data_, 2 * capacity_);
+  munmap(header_, headerSize_);
+}
+
+std::span<char> SharedRing::WaitWritable(size_t maxBytes, int peerFd) {
+  Header &h = *header_;
+  const uint64_t tail = h.tail.load(std::memory_order_relaxed);
+  while (true) {
+    const uint32_t event = h.spaceEvent.load();
+    if (h.readerClosed.load(std::memory_order_acquire) != 0) {
+      return {};
+    }
+    const uint64_t head = h.head.load(std::memory_order_acquire);
+    const uint64_t free = capacity_ - (tail - head);
+    if (free != 0) {
+      return {data_ + tail % capacity_,
+              static_cast<size_t>(std::min<uint64_t>(free, maxBytes))};
+    }
+
+    h.writerWaiting.store(1);
+    const bool woken = FutexWait(h.spaceEvent, event);
+    h.writerWaiting.store(0);
+    if (!woken && PeerGone(peerFd)) {
+      h.readerClosed.store(1, std::memory_order_release);
+    }
+  }
+}
+
+void SharedRing::Commit(size_t size) {
+  if (size == 0) {
+    return;
+  }
+  Header &h = *header_;
+  h.tail.store(h.tail.load(std::memory_order_relaxed) + size,
+               std::memory_order_release);
+  h.dataEvent.fetch_add(1);
+  if (h.readerWaiting.load() != 0) {
+    FutexWake(h.dataEvent);
+  }
+}
+
+void SharedRing::CloseWriter() {
+  header_->writerClosed.store(1, std::memory_order_release);
+  header_->dataEvent.fetch_add(1);
+  FutexWake(header_->dataEvent);
+}
+
+bool SharedRing::ReaderClosed() const {
+  return header_->readerClosed.load(std::memory_order_acquire) != 0;
+}
+
+size_t SharedRing::Readable() const {
+  return static_cast<size_t>(
+      header_->tail.load(std::memory_order_acquire) -
+      header_->head.load(std::memory_order_relaxed));
+}
+
+std::span<const char> SharedRing::WaitReadable(size_t maxBytes, int peerFd) {
+  Header &h = *header_;
+  const uint64_t head = h.head.load(std::memory_order_relaxed);
+  while (true) {
+    const uint32_t event = h.dataEvent.load();
+    const uint64_t tail = h.tail.load(std::memory_order_acquire);
+    if (tail != head) {
+      return {data_ + head % capacity_,
+              static_cast<size_t>(std::min<uint64_t>(tail - head, maxBytes))};
+    }
+    if (h.writerClosed.load(std::memory_order_acquire) != 0) {
+      // The final commit precedes the close; look at the tail once more.
+      if (h.tail.load(std::memory_order_acquire) == head) {
+        return {};
+      }
+      continue;
+    }
+
+    h.readerWaiting.store(1);
+    const bool woken = FutexWait(h.dataEvent, event);
+    h.readerWaiting.store(0);
+    if (!woken && PeerGone(peerFd)) {
+      h.writerClosed.store(1, std::memory_order_release);
+    }
+  }
+}
+
+void SharedRing::Consume(size_t size) {
+  if (size == 0) {
+    return;
+  }
+  Header &h = *header_;
+  h.head.store(h.head.load(std::memory_order_relaxed) + size,
+               std::memory_order_release);
+  h.spaceEvent.fetch_add(1);
+  if (h.writerWaiting.load() != 0) {
+    FutexWake(h.spaceEvent);
+  }
+}
+
+void SharedRing::CloseReader() {
+  header_->readerClosed.store(1, std::memory_order_release);
+  header_->spaceEvent.fetch_add(1);
+  FutexWake(header_->spaceEvent);
+}
+
+RingReadBuffer::RingReadBuffer(SharedRing &ring, int peerFd)
+    : ring_(ring), peerFd_(peerFd) {}
+
+RingReadBuffer::~RingReadBuffer() { ring_.CloseReader(); }
+
+RingReadBuffer::int_type RingReadBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  // The previous region has been read in full; hand it back.
+  ring_.Consume(static_cast<size_t>(egptr() - eback()));
+  const std::span<const char> region = ring_.WaitReadable(kRegionSize, peerFd_);
+  if (region.empty()) {
+    setg(nullptr, nullptr, nullptr);
+    return traits_type::eof();
+  }
+
+  // The get area is never written through.
+  char *begin = const_cast<char *>(region.data());
+  setg(begin, begin, begin + region.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize RingReadBuffer::showmanyc() {
+  // The get area stays in the ring until underflow() consumes it.
+  const auto region = static_cast<size_t>(egptr() - eback());
+  return static_cast<std::streamsize>(ring_.Readable() - region);
+}
+
+RingWriteBuffer::RingWriteBuffer(SharedRing &ring, int peerFd)
+    : ring_(ring), peerFd_(peerFd) {}
+
+RingWriteBuffer::~RingWriteBuffer() {
+  (void)sync();
+  ring_.CloseWriter();
+}
+
+bool RingWriteBuffer::NextRegion() {
+  ring_.Commit(static_cast<size_t>(pptr() - pbase()));
+  const std::span<char> region = ring_.WaitWritable(kRegionSize, peerFd_);
+  if (region.empty()) {
+    setp(nullptr, nullptr);
+    std::raise(SIGPIPE);
+    return false;
+  }
+  setp(region.data(), region.data() + region.size());
+  return true;
+}
+
+RingWriteBuffer::int_type RingWriteBuffer::overflow(int_type ch) {
+  if (!NextRegion()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize RingWriteBuffer::xsputn(const char *s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done < n) {
+    if (pptr() == epptr() && !NextRegion()) {
+      break;
+    }
+    const std::streamsize take =
+        std::min<std::streamsize>(epptr() - pptr(), n - done);
+    std::memcpy(pptr(), s + done, static_cast<size_t>(take));
+    pbump(static_cast<int>(take));
+    done += take;
+  }
+  return done;
+}
+
+int RingWriteBuffer::sync() {
+  if (pptr() == pbase()) {
+    return 0;
+  }
+  if (ring_.ReaderClosed()) {
+    setp(nullptr, nullptr);
+    std::raise(SIGPIPE);
+    return -1;
+  }
+  ring_.Commit(static_cast<size_t>(pptr() - pbase()));
+  setp(pptr(), epptr());
+  return 0;
+}
+
+VmspliceWriteBuffer::VmspliceWriteBuffer(int fd) : fd_(fd) {
+  // A bigger pipe moves more pages per call; keep whatever is granted.
+  (void)fcntl(fd_, F_SETPIPE_SZ, static_cast<int>(kPipeSize));
+  const int pipeSize = fcntl(fd_, F_GETPIPE_SZ);
+  if (pipeSize > 0) {
+    size_ = static_cast<size_t>(pipeSize);
+    buffer_ = MapPages(size_);
+    splice_ = buffer_ != nullptr;
+  }
+  if (!splice_) {
+    size_ = 64 * 1024;
+    buffer_ = MapPages(size_);
+    if (buffer_ == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  setp(buffer_, buffer_ + size_);
+}
+
+VmspliceWriteBuffer::~VmspliceWriteBuffer() {
+  (void)WritePending();
+  // Spliced pages stay referenced by the pipe after munmap, so a reader
+  // that has not caught up yet still sees their contents.
+  munmap(buffer_, size_);
+}
+
+bool VmspliceWriteBuffer::SpliceFull() {
+  // Mapped first: if that fails, the full buffer is written instead.
+  char *next = MapPages(size_);
+  if (next == nullptr) {
+    splice_ = false;
+    return WritePending();
+  }
+  iovec iov{pbase(), size_};
+  while (iov.iov_len != 0) {
+    const ssize_t n = vmsplice(fd_, &iov, 1, SPLICE_F_GIFT);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      munmap(next, size_);
+      if (errno != EPIPE && iov.iov_len == size_) {
+        // Not a pipe after all: write this and everything after it.
+        splice_ = false;
+        return WritePending();
+      }
+      return false;
+    }
+    iov.iov_base = static_cast<char *>(iov.iov_base) + n;
+    iov.iov_len -= static_cast<size_t>(n);
+  }
+
+  // The pipe may hold the gifted pages indefinitely; never touch them.
+  munmap(buffer_, size_);
+  buffer_ = next;
+  setp(buffer_, buffer_ + size_);
+  return true;
+}
+
+bool VmspliceWriteBuffer::WritePending() {
+  const bool ok = WriteAll(fd_, pbase(), static_cast<size_t>(pptr() - pbase()));
+  // Written data was copied, so the same buffer is free again.
+  setp(buffer_, buffer_ + size_);
+  return ok;
+}
+
+VmspliceWriteBuffer::int_type VmspliceWriteBuffer::overflow(int_type ch) {
+  const bool flushed = splice_ ? SpliceFull() : WritePending();
+  if (!flushed) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize VmspliceWriteBuffer::xsputn(const char *s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done < n) {
+    if (pptr() == epptr() &&
+        traits_type::eq_int_type(overflow(traits_type::eof()),
+                                 traits_type::eof())) {
+      break;
+    }
+    const std::streamsize take =
+        std::min<std::streamsize>(epptr() - pptr(), n - done);
+    std::memcpy(pptr(), s + done, static_cast<size_t>(take));
+    pbump(static_cast<int>(take));
+    done += take;
+  }
+  return done;
+}
+
+int VmspliceWriteBuffer::sync() { return WritePending() ? 0 : -1; }
+
+} // namespace cppshell
+
+#endif
@@ -0,0 +1,198 @@
+#include "cppshell/spill_queue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Smallest ring allocated once memory is first used. */
+constexpr size_t kInitialRing = 64 * 1024;
+
+} // namespace
+
+SpillQueue::SpillQueue(size_t memoryLimit, size_t diskLimit)
+    : memoryLimit_(memoryLimit), diskLimit_(diskLimit) {
+#ifdef _WIN32
+  diskLimit_ = 0;
+#endif
+}
+
+SpillQueue::~SpillQueue() {
+#ifndef _WIN32
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+#endif
+}
+
+size_t SpillQueue::Room() const {
+  const size_t memory = Spilled() == 0 ? memoryLimit_ - size_ : 0;
+  return memory + (diskLimit_ - diskEnd_);
+}
+
+size_t SpillQueue::Append(std::string_view data) {
+  size_t taken = 0;
+  if (Spilled() == 0) {
+    taken = std::min(data.size(), memoryLimit_ - size_);
+    PushMemory(data.substr(0, taken));
+    data.remove_prefix(taken);
+  }
+
+  const size_t toDisk = std::min(data.size(), diskLimit_ - diskEnd_);
+  if (toDisk == 0 || !WriteFile(data.substr(0, toDisk))) {
+    return taken;
+  }
+  return taken + toDisk;
+}
+
+size_t SpillQueue::Take(std::string &out, size_t maxBytes) {
+  if (size_ != 0) {
+    const size_t n = std::min(maxBytes, size_);
+    const size_t first = std::min(n, ring_.size() - head_);
+    out.append(ring_.data() + head_, first);
+    out.append(ring_.data(), n - first);
+    head_ = (head_ + n) % ring_.size();
+    size_ -= n;
+    return n;
+  }
+
+  const size_t n = std::min(maxBytes, Spilled());
+  if (n == 0) {
+    return 0;
+  }
+  const size_t old = out.size();
+  out.resize(old + n);
+  if (!ReadFile(out.data() + old, n)) {
+    out.resize(old);
+    return 0;
+  }
+  return n;
+}
+
+void SpillQueue::PushMemory(std::string_view data) {
+  if (data.empty()) {
+    return;
+  }
+  const size_t needed = size_ + data.size();
+  if (needed > ring_.size()) {
+    // Grow geometrically, but never past the limit.
+    const size_t grown = std::min(
+        memoryLimit_, std::max({needed, 2 * ring_.size(), kInitialRing}));
+    std::vector<char> ring(grown);
+    const size_t first = std::min(size_, ring_.size() - head_);
+    std::copy_n(ring_.data() + head_, first, ring.data());
+    std::copy_n(ring_.data(), size_ - first, ring.data() + first);
+    ring_.swap(ring);
+    head_ = 0;
+  }
+
+  const size_t tail = (head_ + size_) % ring_.size();
+  const size_t first = std::min(data.size(), ring_.size() - tail);
+  std::copy_n(data.data(), first, ring_.data() + tail);
+  std::copy_n(data.data() + first, data.size() - first, ring_.data());
+  size_ += data.size();
+  peakMemory_ = std::max(peakMemory_, size_);
+}
+
+#ifndef _WIN32
+
+bool SpillQueue::OpenFile() {
+  if (fd_ >= 0) {
+    return true;
+  }
+  std::error_code ec;
+  std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+  if (ec) {
+    dir = "/tmp";
+  }
+
+#ifdef O_TMPFILE
+  fd_ = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+  if (fd_ < 0) {
+    // File systems without O_TMPFILE: create a file and unlink it at once.
+    std::string name = (dir / "cppshell_spill_XXXXXX").string();
+    fd_ = mkstemp(name.data());
+    if (fd_ >= 0) {
+      unlink(name.c_str());
+      fcntl(fd_, F_SETFD, FD_CLOEXEC);
+    }
+  }
+  if (fd_ < 0) {
+    error_ = "cannot create spill file in " + dir.string() + ": " +
+             std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool SpillQueue::WriteFile(std::string_view data) {
+  if (!OpenFile()) {
+    return false;
+  }
+  const size_t start = diskEnd_;
+  while (!data.empty()) {
+    const ssize_t n = pwrite(fd_, data.data(), data.size(),
+                             static_cast<off_t>(diskEnd_));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error_ = std::string("cannot write spill file: ") + std::strerror(errno);
+      diskEnd_ = start;
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+    diskEnd_ += static_cast<size_t>(n);
+  }
+  peakDisk_ = std::max(peakDisk_, diskEnd_);
+  return true;
+}
+
+bool SpillQueue::ReadFile(char *out, size_t size) {
+  while (size != 0) {
+    const ssize_t n = pread(fd_, out, size, static_cast<off_t>(diskRead_));
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      error_ = std::string("cannot read spill file: ") +
+               (n < 0 ? std::strerror(errno) : "unexpected end of file");
+      return false;
+    }
+    out += n;
+    size -= static_cast<size_t>(n);
+    diskRead_ += static_cast<size_t>(n);
+  }
+
+  if (diskRead_ == diskEnd_) {
+    // Everything was read back: give the space to the file system. If that
+    // fails the file is simply overwritten from the start.
+    diskRead_ = 0;
+    diskEnd_ = 0;
+    static_cast<void>(ftruncate(fd_, 0));
+  }
+  return true;
+}
+
+#else
+
+bool SpillQueue::OpenFile() { return false; }
+
+bool SpillQueue::WriteFile(std::string_view) { return false; }
+
+bool SpillQueue::ReadFile(char *, size_t) { return false; }
+
+#endif
+
+} // namespace cppshell
@@ -0,0 +1,74 @@
+#include "cppshell/thread_pool.hpp"
+
+#include "cppshell/cpu_placement.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace cppshell {
+
+ThreadPool::ThreadPool(size_t workers) {
+  workers = std::max<size_t>(workers, 1);
+  workers_.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  hasWork_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  hasWork_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+  // A pool started by a pinned pipeline stage spreads over the shell's CPUs.
+  UnpinCurrentThread();
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      hasWork_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return; // Stopping and nothing left to do.
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+size_t WorkerCount(const Environment &env) {
+  const std::string value = env.Get("CPPSHELL_THREADS");
+  if (!value.empty()) {
+    try {
+      const long long count = std::stoll(value);
+      if (count > 0) {
+        return static_cast<size_t>(count);
+      }
+    } catch (...) {
+      // Fall through to the hardware default on garbage.
+    }
+  }
+  // Asked once: the count is read from /sys on every call.
+  static const size_t hardware =
+      std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  return hardware;
+}
+
+} // namespace cppshell
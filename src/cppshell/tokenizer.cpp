@@ -9,12 +9,21 @@ TokenizeResult Tokenize(std::string_view line) {
   std::string current;
   char quote = '\0';
   bool escaped = false; // Add state for escape
+  bool currentQuoted = false; // Current token contains quoted/escaped text
 
   auto Flush = [&]() {
     if (!current.empty()) {
       result.tokens.push_back(current);
+      result.operators.push_back(false);
       current.clear();
     }
+    currentQuoted = false;
+  };
+
+  auto EmitOperator = [&](const char *op) {
+    Flush();
+    result.tokens.emplace_back(op);
+    result.operators.push_back(true);
   };
 
   for (size_t i = 0; i < line.size(); ++i) {
@@ -24,6 +33,7 @@ TokenizeResult Tokenize(std::string_view line) {
       // Append escaped character literally.
       current.push_back(ch);
       escaped = false;
+      currentQuoted = true;
       continue;
     }
 
@@ -40,13 +50,32 @@ TokenizeResult Tokenize(std::string_view line) {
       }
 
       if (ch == '|') {
-        Flush();
-        result.tokens.emplace_back("|");
+        EmitOperator("|");
+        continue;
+      }
+
+      if (ch == '<') {
+        EmitOperator("<");
+        continue;
+      }
+
+      if (ch == '>') {
+        // A bare `2` right before `>` is the stderr descriptor, not a word.
+        if (current == "2" && !currentQuoted) {
+          current.clear();
+          EmitOperator("2>");
+        } else if (i + 1 < line.size() && line[i + 1] == '>') {
+          EmitOperator(">>");
+          ++i;
+        } else {
+          EmitOperator(">");
+        }
         continue;
       }
 
       if (ch == '\'' || ch == '"') {
         quote = ch;
+        currentQuoted = true;
         continue;
       }
 
@@ -0,0 +1,706 @@
+#include "cppshell/trigram_index.hpp"
+#include "cppshell/file_walker.hpp"
+#include "cppshell/thread_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Trigrams of byte values: 256 to the third. */
+constexpr size_t kTrigramSpace = size_t{1} << 24;
+
+/** Bytes read from a file at once while indexing it. */
+constexpr size_t kReadSize = 1024 * 1024;
+
+/**
+ * Files changed this close before a build are indexed but not trusted
+ * later, since a change in the same clock tick would keep their time.
+ */
+constexpr int64_t kRacyNanoseconds = 2'000'000'000;
+
+/** Stored in place of the time of a file that is not trusted. */
+constexpr int64_t kUntrusted = std::numeric_limits<int64_t>::min();
+
+constexpr char kMagic[8] = {'C', 'S', 'G', 'R', 'I', 'D', 'X', '\0'};
+constexpr uint32_t kVersion = 1;
+
+[[nodiscard]] unsigned char Fold(unsigned char c) {
+  return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+[[nodiscard]] uint32_t Trigram(char a, char b, char c) {
+  return (uint32_t{Fold(static_cast<unsigned char>(a))} << 16) |
+         (uint32_t{Fold(static_cast<unsigned char>(b))} << 8) |
+         Fold(static_cast<unsigned char>(c));
+}
+
+[[nodiscard]] bool IsWordByte(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+         (c >= 'a' && c <= 'z') || c == '_';
+}
+
+/** Length of `directory` with the separator WalkTree adds to it. */
+[[nodiscard]] size_t PrefixLength(const std::string &directory) {
+  if (directory.empty()) {
+    return 0;
+  }
+  return directory.back() == '/' ? directory.size() : directory.size() + 1;
+}
+
+[[nodiscard]] std::string IndexPath(const std::string &dir) {
+  std::string path = dir.empty() ? "." : dir;
+  if (path.back() != '/') {
+    path.push_back('/');
+  }
+  return path.append(TrigramIndex::kFileName);
+}
+
+/** What identifies the contents of a file without reading it. */
+struct FileKey {
+  uint64_t inode = 0;
+  uint64_t size = 0;
+  int64_t mtime = 0;
+};
+
+/** Stats `path`; returns false if it cannot. */
+[[nodiscard]] bool KeyOf(const std::string &path, FileKey &key) {
+#ifndef _WIN32
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+#ifdef __APPLE__
+  const struct timespec &mtime = st.st_mtimespec;
+#else
+  const struct timespec &mtime = st.st_mtim;
+#endif
+  key.inode = static_cast<uint64_t>(st.st_ino);
+  key.size = static_cast<uint64_t>(st.st_size);
+  key.mtime = static_cast<int64_t>(mtime.tv_sec) * 1'000'000'000 +
+              static_cast<int64_t>(mtime.tv_nsec);
+#else
+  std::error_code ec;
+  key.size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return false;
+  }
+  const auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return false;
+  }
+  key.inode = 0;
+  key.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  time.time_since_epoch())
+                  .count();
+#endif
+  return true;
+}
+
+/** The current time on the clock file times are taken from. */
+[[nodiscard]] int64_t Now() {
+#ifndef _WIN32
+  struct timespec now {};
+  ::clock_gettime(CLOCK_REALTIME, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1'000'000'000 +
+         static_cast<int64_t>(now.tv_nsec);
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::filesystem::file_time_type::clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * The sorted, folded trigrams of the lines of `in`. A bitmap per thread
+ * remembers the trigrams seen; only those are cleared afterwards.
+ */
+[[nodiscard]] std::vector<uint32_t> ReadTrigrams(std::istream &in) {
+  thread_local std::vector<uint64_t> seen(kTrigramSpace / 64);
+  std::vector<uint32_t> found;
+  std::vector<char> buffer(kReadSize);
+  uint32_t window = 0;
+  size_t run = 0; // Bytes since the last '\n'.
+  while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) ||
+         in.gcount() > 0) {
+    const auto count = static_cast<size_t>(in.gcount());
+    for (size_t i = 0; i < count; ++i) {
+      const auto c = static_cast<unsigned char>(buffer[i]);
+      if (c == '\n') {
+        run = 0;
+        continue;
+      }
+      window = ((window << 8) | Fold(c)) & (kTrigramSpace - 1);
+      if (++run < 3) {
+        continue;
+      }
+      uint64_t &word = seen[window / 64];
+      const uint64_t bit = uint64_t{1} << (window % 64);
+      if ((word & bit) == 0) {
+        word |= bit;
+        found.push_back(window);
+      }
+    }
+  }
+  for (const uint32_t trigram : found) {
+    seen[trigram / 64] &= ~(uint64_t{1} << (trigram % 64));
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+/**
+ * Index just past the class or group that starts at `i` of `pattern`, or
+ * npos if it does not close. In ECMAScript `[]` is an empty class.
+ */
+[[nodiscard]] size_t SkipBracket(std::string_view pattern, size_t i) {
+  int depth = 0;
+  const bool group = pattern[i] == '(';
+  while (i < pattern.size()) {
+    const char c = pattern[i];
+    if (c == '\\') {
+      i += 2;
+      continue;
+    }
+    if (c == '[' && group) {
+      i = SkipBracket(pattern, i);
+      if (i == std::string_view::npos) {
+        return i;
+      }
+      continue;
+    }
+    if (!group && c == ']') {
+      return i + 1;
+    }
+    if (group && c == '(') {
+      ++depth;
+    } else if (group && c == ')' && --depth == 0) {
+      return i + 1;
+    }
+    ++i;
+  }
+  return std::string_view::npos;
+}
+
+/** The top-level `|` branches of `pattern`. */
+[[nodiscard]] std::vector<std::string_view> Branches(std::string_view pattern) {
+  std::vector<std::string_view> branches;
+  size_t start = 0;
+  size_t i = 0;
+  while (i < pattern.size()) {
+    const char c = pattern[i];
+    if (c == '\\') {
+      i += 2;
+    } else if (c == '[' || c == '(') {
+      i = SkipBracket(pattern, i);
+    } else if (c == '|') {
+      branches.push_back(pattern.substr(start, i - start));
+      start = ++i;
+    } else {
+      ++i;
+    }
+  }
+  branches.push_back(pattern.substr(std::min(start, pattern.size())));
+  return branches;
+}
+
+/** The runs of plain characters every match of `branch` contains. */
+[[nodiscard]] std::vector<std::string> Runs(std::string_view branch) {
+  std::vector<std::string> runs;
+  std::string run;
+  const auto endRun = [&] {
+    if (run.size() >= 3) {
+      runs.push_back(run);
+    }
+    run.clear();
+  };
+  size_t i = 0;
+  while (i < branch.size()) {
+    const char c = branch[i];
+    // The atom at `i` ends at `next`; `literal` is set if it is one
+    // character that matches itself.
+    size_t next = i + 1;
+    bool literal = false;
+    char value = c;
+    if (c == '\\') {
+      next = std::min(i + 2, branch.size());
+      if (i + 1 < branch.size()) {
+        value = branch[i + 1];
+        const auto escaped = static_cast<unsigned char>(value);
+        literal = !IsWordByte(escaped) && escaped < 0x80;
+      }
+    } else if (c == '[' || c == '(') {
+      next = std::min(SkipBracket(branch, i), branch.size());
+    } else {
+      literal = std::strchr(".^$*+?{}", c) == nullptr || c == '\0';
+    }
+
+    const char quantifier = next < branch.size() ? branch[next] : '\0';
+    if (quantifier == '*' || quantifier == '?' || quantifier == '{') {
+      // The atom may be missing or repeated.
+      endRun();
+      next = quantifier == '{'
+                 ? std::min(branch.find('}', next), branch.size() - 1) + 1
+                 : next + 1;
+    } else if (quantifier == '+') {
+      if (literal) {
+        run.push_back(value);
+      }
+      endRun();
+      ++next;
+    } else if (literal) {
+      run.push_back(value);
+    } else {
+      endRun();
+    }
+    if (next < branch.size() && branch[next] == '?' && next > i + 1 &&
+        std::strchr("*+?}", branch[next - 1]) != nullptr) {
+      ++next; // Lazy quantifier.
+    }
+    i = next;
+  }
+  endRun();
+  return runs;
+}
+
+} // namespace
+
+struct TrigramIndex::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t fileCount;
+  uint64_t pathBytes;
+  uint64_t trigramCount;
+  uint64_t postingCount;
+};
+
+struct TrigramIndex::FileEntry {
+  uint64_t inode;
+  uint64_t size;
+  int64_t mtime;
+  uint64_t pathOffset;
+  uint64_t pathLength;
+};
+
+struct TrigramIndex::TrigramEntry {
+  uint32_t trigram;
+  uint32_t count;
+  uint64_t offset;
+};
+
+TrigramQuery::TrigramQuery(const std::vector<std::string> &patterns,
+                           const GrepPatternOptions &options) {
+  for (const std::string &pattern : patterns) {
+    const std::vector<std::string_view> branches =
+        options.fixedStrings ? std::vector<std::string_view>{pattern}
+                             : Branches(pattern);
+    for (const std::string_view branch : branches) {
+      const std::vector<std::string> runs =
+          options.fixedStrings
+              ? std::vector<std::string>{std::string(branch)}
+              : Runs(branch);
+      std::vector<uint32_t> trigrams;
+      for (const std::string &run : runs) {
+        for (size_t i = 0; i + 3 <= run.size(); ++i) {
+          trigrams.push_back(Trigram(run[i], run[i + 1], run[i + 2]));
+        }
+      }
+      if (trigrams.empty()) {
+        all_ = true;
+        alternatives_.clear();
+        return;
+      }
+      std::sort(trigrams.begin(), trigrams.end());
+      trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                     trigrams.end());
+      alternatives_.push_back(std::move(trigrams));
+    }
+  }
+}
+
+IndexBuild TrigramIndex::Build(const std::string &dir, size_t threads) {
+  IndexBuild result;
+  const int64_t started = Now();
+  WalkOptions walk;
+  walk.sorted = true;
+  walk.threads = threads;
+  const std::string indexPath = IndexPath(dir);
+  const std::string tempPath = indexPath + ".tmp";
+  walk.exclude = {std::string(kFileName), std::string(kFileName) + ".tmp"};
+  WalkResult found = WalkTree(dir, walk);
+  result.errors = std::move(found.errors);
+
+  // What the current index holds, for the files that did not change.
+  std::string ignored;
+  const std::unique_ptr<TrigramIndex> old = Open(dir, ignored);
+  std::vector<std::vector<uint32_t>> oldTrigrams;
+  if (old != nullptr) {
+    oldTrigrams = old->FileTrigrams();
+  }
+
+  struct Indexed {
+    std::string path;
+    std::string relative;
+    FileKey key;
+    std::vector<uint32_t> trigrams;
+  };
+  std::vector<Indexed> files;
+  // Files to read have a valid future; the others kept their trigrams.
+  std::vector<std::future<std::optional<std::vector<uint32_t>>>> reads;
+  ThreadPool pool(threads);
+  const size_t prefix = PrefixLength(dir);
+  for (const std::string &path : found.files) {
+    FileKey key;
+    if (!KeyOf(path, key)) {
+      result.errors.push_back(path + ": No such file or directory");
+      continue;
+    }
+    std::string relative = path.substr(std::min(prefix, path.size()));
+    if (old != nullptr) {
+      const auto it = old->paths_.find(relative);
+      if (it != old->paths_.end()) {
+        const FileEntry &entry = old->files_[it->second];
+        if (entry.inode == key.inode && entry.size == key.size &&
+            entry.mtime == key.mtime) {
+          files.push_back(Indexed{path, std::move(relative), key,
+                                  std::move(oldTrigrams[it->second])});
+          reads.emplace_back();
+          continue;
+        }
+      }
+    }
+    reads.push_back(
+        pool.Submit([path]() -> std::optional<std::vector<uint32_t>> {
+          std::ifstream in(path, std::ios::binary);
+          if (!in) {
+            return std::nullopt;
+          }
+          return ReadTrigrams(in);
+        }));
+    files.push_back(Indexed{path, std::move(relative), key, {}});
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (reads[i].valid()) {
+      std::optional<std::vector<uint32_t>> trigrams = reads[i].get();
+      if (!trigrams.has_value()) {
+        result.errors.push_back(files[i].path + ": Permission denied");
+        continue;
+      }
+      files[i].trigrams = std::move(*trigrams);
+      ++result.read;
+    }
+    if (files[i].key.mtime > started - kRacyNanoseconds) {
+      files[i].key.mtime = kUntrusted;
+    }
+    if (kept != i) {
+      files[kept] = std::move(files[i]);
+    }
+    ++kept;
+  }
+  files.resize(kept);
+  result.files = files.size();
+
+  // Posting lists: count the files of each trigram, then fill them in
+  // file order, so that each list comes out sorted. The trigrams present
+  // are numbered by their rank in a bitmap, which keeps the counts as
+  // small as the set of trigrams.
+  std::vector<uint64_t> present(kTrigramSpace / 64, 0);
+  for (const Indexed &file : files) {
+    for (const uint32_t trigram : file.trigrams) {
+      present[trigram / 64] |= uint64_t{1} << (trigram % 64);
+    }
+  }
+  std::vector<uint32_t> rank(present.size());
+  uint32_t distinct = 0;
+  for (size_t word = 0; word < present.size(); ++word) {
+    rank[word] = distinct;
+    distinct += static_cast<uint32_t>(std::popcount(present[word]));
+  }
+  const auto slot = [&](uint32_t trigram) {
+    const uint64_t below = (uint64_t{1} << (trigram % 64)) - 1;
+    return rank[trigram / 64] +
+           static_cast<uint32_t>(std::popcount(present[trigram / 64] & below));
+  };
+  std::vector<uint64_t> starts(size_t{distinct} + 1, 0);
+  for (const Indexed &file : files) {
+    for (const uint32_t trigram : file.trigrams) {
+      ++starts[slot(trigram) + 1];
+    }
+  }
+  std::vector<TrigramEntry> trigrams;
+  trigrams.reserve(distinct);
+  for (size_t word = 0; word < present.size(); ++word) {
+    for (uint64_t bits = present[word]; bits != 0; bits &= bits - 1) {
+      const auto trigram =
+          static_cast<uint32_t>(word * 64 + std::countr_zero(bits));
+      const size_t i = trigrams.size();
+      trigrams.push_back(TrigramEntry{
+          trigram, static_cast<uint32_t>(starts[i + 1]), starts[i]});
+      starts[i + 1] += starts[i];
+    }
+  }
+  std::vector<uint32_t> postings(starts[distinct]);
+  for (size_t i = 0; i < files.size(); ++i) {
+    for (const uint32_t trigram : files[i].trigrams) {
+      postings[starts[slot(trigram)]++] = static_cast<uint32_t>(i);
+    }
+    std::vector<uint32_t>().swap(files[i].trigrams);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.fileCount = static_cast<uint32_t>(files.size());
+  std::vector<FileEntry> entries;
+  entries.reserve(files.size());
+  std::string paths;
+  for (const Indexed &file : files) {
+    entries.push_back(FileEntry{file.key.inode, file.key.size,
+                                file.key.mtime, paths.size(),
+                                file.relative.size()});
+    paths += file.relative;
+  }
+  paths.resize((paths.size() + 7) / 8 * 8, '\0');
+  header.pathBytes = paths.size();
+  header.trigramCount = trigrams.size();
+  header.postingCount = postings.size();
+
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    const auto write = [&out](const void *data, size_t size) {
+      out.write(static_cast<const char *>(data),
+                static_cast<std::streamsize>(size));
+    };
+    write(&header, sizeof(header));
+    write(entries.data(), entries.size() * sizeof(FileEntry));
+    write(paths.data(), paths.size());
+    write(trigrams.data(), trigrams.size() * sizeof(TrigramEntry));
+    write(postings.data(), postings.size() * sizeof(uint32_t));
+    if (!out.flush()) {
+      result.errors.push_back(tempPath + ": cannot write the index");
+      return result;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tempPath, indexPath, ec);
+  if (ec) {
+    result.errors.push_back(indexPath + ": " + ec.message());
+    std::filesystem::remove(tempPath, ec);
+    return result;
+  }
+  result.written = true;
+  return result;
+}
+
+std::unique_ptr<TrigramIndex> TrigramIndex::Open(const std::string &dir,
+                                                 std::string &error) {
+  const std::string path = IndexPath(dir);
+  std::unique_ptr<TrigramIndex> index;
+#ifndef _WIN32
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = path + ": " + std::strerror(errno);
+    return nullptr;
+  }
+  struct stat st {};
+  void *data = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                  MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error = path + ": not a grep index";
+    return nullptr;
+  }
+  index.reset(new TrigramIndex(dir, std::string(),
+                               static_cast<const char *>(data),
+                               static_cast<size_t>(st.st_size)));
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = path + ": No such file or directory";
+    return nullptr;
+  }
+  std::string buffer((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+  index.reset(new TrigramIndex(dir, std::move(buffer), nullptr, 0));
+#endif
+  error = index->Load();
+  if (!error.empty()) {
+    error = path + ": " + error;
+    return nullptr;
+  }
+  return index;
+}
+
+TrigramIndex::TrigramIndex(std::string dir, std::string buffer,
+                           const char *data, size_t size)
+    : dir_(std::move(dir)), buffer_(std::move(buffer)), data_(data),
+      size_(size), mapped_(data != nullptr) {
+  if (!mapped_) {
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+}
+
+TrigramIndex::~TrigramIndex() {
+#ifndef _WIN32
+  if (mapped_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
+
+std::string TrigramIndex::Load() {
+  if (size_ < sizeof(Header)) {
+    return "not a grep index";
+  }
+  header_ = reinterpret_cast<const Header *>(data_);
+  if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header_->version != kVersion) {
+    return "not a grep index";
+  }
+  // Each section must fit in what is left before it is sized.
+  size_t offset = sizeof(Header);
+  const auto section = [&](uint64_t count, size_t size) -> const char * {
+    if (offset > size_ || count > (size_ - offset) / size) {
+      return nullptr;
+    }
+    const char *at = data_ + offset;
+    offset += static_cast<size_t>(count) * size;
+    return at;
+  };
+  files_ = reinterpret_cast<const FileEntry *>(
+      section(header_->fileCount, sizeof(FileEntry)));
+  pathData_ = section(header_->pathBytes, 1);
+  trigrams_ = reinterpret_cast<const TrigramEntry *>(
+      section(header_->trigramCount, sizeof(TrigramEntry)));
+  postings_ = reinterpret_cast<const uint32_t *>(
+      section(header_->postingCount, sizeof(uint32_t)));
+  if (files_ == nullptr || pathData_ == nullptr || trigrams_ == nullptr ||
+      postings_ == nullptr || offset != size_ ||
+      header_->pathBytes % 8 != 0) {
+    return "damaged index";
+  }
+  paths_.reserve(header_->fileCount);
+  for (uint32_t i = 0; i < header_->fileCount; ++i) {
+    const FileEntry &entry = files_[i];
+    if (entry.pathOffset > header_->pathBytes ||
+        entry.pathLength > header_->pathBytes - entry.pathOffset) {
+      return "damaged index";
+    }
+    paths_.emplace(std::string_view(pathData_ + entry.pathOffset,
+                                    static_cast<size_t>(entry.pathLength)),
+                   i);
+  }
+  return std::string();
+}
+
+std::optional<std::span<const uint32_t>>
+TrigramIndex::Postings(uint32_t trigram) const {
+  const TrigramEntry *end = trigrams_ + header_->trigramCount;
+  const TrigramEntry *it =
+      std::lower_bound(trigrams_, end, trigram,
+                       [](const TrigramEntry &entry, uint32_t value) {
+                         return entry.trigram < value;
+                       });
+  if (it == end || it->trigram != trigram) {
+    return std::span<const uint32_t>();
+  }
+  if (it->offset > header_->postingCount ||
+      it->count > header_->postingCount - it->offset) {
+    return std::nullopt;
+  }
+  return std::span<const uint32_t>(postings_ + it->offset, it->count);
+}
+
+std::vector<std::string>
+TrigramIndex::Narrow(std::vector<std::string> files,
+                     const TrigramQuery &query) const {
+  if (query.All()) {
+    return files;
+  }
+  // The indexed files some alternative leaves in: its posting lists
+  // intersected, shortest first.
+  std::vector<char> candidate(header_->fileCount, 0);
+  for (const std::vector<uint32_t> &alternative : query.Alternatives()) {
+    std::vector<std::span<const uint32_t>> lists;
+    for (const uint32_t trigram : alternative) {
+      const std::optional<std::span<const uint32_t>> list = Postings(trigram);
+      if (!list.has_value()) {
+        return files;
+      }
+      lists.push_back(*list);
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](const auto &a, const auto &b) { return a.size() < b.size(); });
+    std::vector<uint32_t> common(lists.front().begin(), lists.front().end());
+    std::vector<uint32_t> next;
+    for (size_t i = 1; i < lists.size() && !common.empty(); ++i) {
+      next.clear();
+      std::set_intersection(common.begin(), common.end(), lists[i].begin(),
+                            lists[i].end(), std::back_inserter(next));
+      common.swap(next);
+    }
+    for (const uint32_t file : common) {
+      if (file < candidate.size()) {
+        candidate[file] = 1;
+      }
+    }
+  }
+
+  // Files the index does not hold as they are now stay in.
+  const size_t prefix = PrefixLength(dir_);
+  std::erase_if(files, [&](const std::string &path) {
+    const auto it =
+        paths_.find(std::string_view(path).substr(std::min(prefix,
+                                                           path.size())));
+    if (it == paths_.end() || candidate[it->second] != 0) {
+      return false;
+    }
+    const FileEntry &entry = files_[it->second];
+    FileKey key;
+    return KeyOf(path, key) && entry.inode == key.inode &&
+           entry.size == key.size && entry.mtime == key.mtime;
+  });
+  return files;
+}
+
+std::vector<std::vector<uint32_t>> TrigramIndex::FileTrigrams() const {
+  std::vector<std::vector<uint32_t>> trigrams(header_->fileCount);
+  for (uint64_t i = 0; i < header_->trigramCount; ++i) {
+    const TrigramEntry &entry = trigrams_[i];
+    const std::optional<std::span<const uint32_t>> list =
+        Postings(entry.trigram);
+    if (!list.has_value()) {
+      continue;
+    }
+    for (const uint32_t file : *list) {
+      if (file < trigrams.size()) {
+        trigrams[file].push_back(entry.trigram);
+      }
+    }
+  }
+  return trigrams;
+}
+
+} // namespace cppshell
@@ -0,0 +1,192 @@
+#include "cppshell/utf8_validator.hpp"
+
+#include <bit>
+#include <cstddef>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Bytes checked at once; bit i of a mask stands for byte i. */
+constexpr size_t kWindow = 64;
+
+/** Byte classes of a window, as masks. */
+struct Classes {
+  uint64_t nonAscii = 0;
+  // Non-ASCII bytes at least the given value.
+  uint64_t ge90 = 0;
+  uint64_t geA0 = 0;
+  uint64_t geC0 = 0;
+  uint64_t geC2 = 0;
+  uint64_t geE0 = 0;
+  uint64_t geF0 = 0;
+  uint64_t geF5 = 0;
+  // Leads whose second byte has a narrower range than 80..BF.
+  uint64_t e0 = 0;
+  uint64_t ed = 0;
+  uint64_t f0 = 0;
+  uint64_t f4 = 0;
+};
+
+#ifdef __SSE2__
+/** Gathers `test`, applied to each 16 bytes of the window at `p`. */
+template <typename Test> uint64_t Gather(const char *p, Test &&test) {
+  uint64_t mask = 0;
+  for (size_t k = 0; k < kWindow / 16; ++k) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * k));
+    mask |= static_cast<uint64_t>(
+                static_cast<uint16_t>(_mm_movemask_epi8(test(v))))
+            << (16 * k);
+  }
+  return mask;
+}
+
+[[nodiscard]] uint64_t NonAscii(const char *p) {
+  return Gather(p, [](__m128i v) { return v; });
+}
+
+[[nodiscard]] Classes Classify(const char *p) {
+  // Flipping the top bit orders non-ASCII bytes as non-negative signed
+  // bytes, below which all ASCII bytes fall.
+  const auto atLeast = [p](unsigned char value) {
+    const __m128i bound =
+        _mm_set1_epi8(static_cast<char>((value ^ 0x80) - 1));
+    return Gather(p, [bound](__m128i v) {
+      return _mm_cmpgt_epi8(_mm_xor_si128(v, _mm_set1_epi8(-128)), bound);
+    });
+  };
+  const auto equal = [p](unsigned char value) {
+    const __m128i byte = _mm_set1_epi8(static_cast<char>(value));
+    return Gather(p, [byte](__m128i v) { return _mm_cmpeq_epi8(v, byte); });
+  };
+  Classes c;
+  c.nonAscii = NonAscii(p);
+  c.ge90 = atLeast(0x90);
+  c.geA0 = atLeast(0xA0);
+  c.geC0 = atLeast(0xC0);
+  c.geC2 = atLeast(0xC2);
+  c.geE0 = atLeast(0xE0);
+  c.geF0 = atLeast(0xF0);
+  c.geF5 = atLeast(0xF5);
+  c.e0 = equal(0xE0);
+  c.ed = equal(0xED);
+  c.f0 = equal(0xF0);
+  c.f4 = equal(0xF4);
+  return c;
+}
+#else
+[[nodiscard]] uint64_t NonAscii(const char *p) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kWindow; ++i) {
+    mask |= static_cast<uint64_t>(static_cast<unsigned char>(p[i]) >= 0x80)
+            << i;
+  }
+  return mask;
+}
+
+[[nodiscard]] Classes Classify(const char *p) {
+  Classes c;
+  for (size_t i = 0; i < kWindow; ++i) {
+    const auto b = static_cast<unsigned char>(p[i]);
+    const auto bit = [i](bool set) { return static_cast<uint64_t>(set) << i; };
+    c.nonAscii |= bit(b >= 0x80);
+    c.ge90 |= bit(b >= 0x90);
+    c.geA0 |= bit(b >= 0xA0);
+    c.geC0 |= bit(b >= 0xC0);
+    c.geC2 |= bit(b >= 0xC2);
+    c.geE0 |= bit(b >= 0xE0);
+    c.geF0 |= bit(b >= 0xF0);
+    c.geF5 |= bit(b >= 0xF5);
+    c.e0 |= bit(b == 0xE0);
+    c.ed |= bit(b == 0xED);
+    c.f0 |= bit(b == 0xF0);
+    c.f4 |= bit(b == 0xF4);
+  }
+  return c;
+}
+#endif
+
+[[nodiscard]] bool NarrowsNext(unsigned char c) {
+  return c == 0xE0 || c == 0xED || c == 0xF0 || c == 0xF4;
+}
+
+} // namespace
+
+uint64_t Utf8Validator::NextWindow(const char *p) {
+  // Continuation bytes the open sequence expects at the window's start.
+  const uint64_t carry = (uint64_t{1} << need_) - 1;
+  if (NonAscii(p) == 0) {
+    // All ASCII: decoding fails at byte 0 if a sequence is open.
+    Reset();
+    return carry;
+  }
+  const Classes c = Classify(p);
+  const uint64_t cont = c.nonAscii & ~c.geC0;
+  const uint64_t lead2 = c.geC2 & ~c.geE0;
+  const uint64_t lead3 = c.geE0 & ~c.geF0;
+  const uint64_t lead4 = c.geF0 & ~c.geF5;
+  const uint64_t bad = (c.geC0 & ~c.geC2) | c.geF5;
+  // Every continuation byte is expected by a lead, and only those.
+  const uint64_t expected = (lead2 << 1) | (lead3 << 1) | (lead3 << 2) |
+                            (lead4 << 1) | (lead4 << 2) | (lead4 << 3) |
+                            carry;
+  // Overlong forms, surrogates and code points past U+10FFFF show in the
+  // byte after E0, ED, F0 and F4.
+  const auto after = [this](uint64_t now, unsigned char lead) {
+    return (now << 1) | (narrowLead_ == lead ? 1 : 0);
+  };
+  const uint64_t narrow =
+      (after(c.e0, 0xE0) & ~c.geA0) | (after(c.ed, 0xED) & c.geA0) |
+      (after(c.f0, 0xF0) & ~c.ge90) | (after(c.f4, 0xF4) & c.ge90);
+  const uint64_t failed = (expected ^ cont) | bad | (narrow & cont);
+
+  // Sequences that run into the next window.
+  need_ = static_cast<unsigned>(std::popcount(
+      (lead2 >> 63) | (lead3 >> 63) | (lead3 >> 62) | (lead4 >> 63) |
+      (lead4 >> 62) | (lead4 >> 61)));
+  const auto last = static_cast<unsigned char>(p[kWindow - 1]);
+  narrowLead_ = NarrowsNext(last) ? last : 0;
+  return failed;
+}
+
+bool Utf8Validator::NextByte(unsigned char c) {
+  if (need_ > 0) {
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    switch (narrowLead_) {
+    case 0xE0:
+      low = 0xA0;
+      break;
+    case 0xED:
+      high = 0x9F;
+      break;
+    case 0xF0:
+      low = 0x90;
+      break;
+    case 0xF4:
+      high = 0x8F;
+      break;
+    default:
+      break;
+    }
+    --need_;
+    narrowLead_ = 0;
+    return c >= low && c <= high;
+  }
+  if (c < 0x80) {
+    return true;
+  }
+  if (c < 0xC2 || c >= 0xF5) {
+    return false;
+  }
+  need_ = c < 0xE0 ? 1 : c < 0xF0 ? 2 : 3;
+  narrowLead_ = NarrowsNext(c) ? c : 0;
+  return true;
+}
+
+} // namespace cppshell
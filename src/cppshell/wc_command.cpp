@@ -0,0 +1,468 @@
+#include "cppshell/wc_command.hpp"
+
+#include "cppshell/cooperative.hpp"
+#include "cppshell/line_channel.hpp"
+#include "cppshell/thread_pool.hpp"
+#include "cppshell/word_count.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/magic.h>
+#include <sys/vfs.h>
+#endif
+#else
+#include <filesystem>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Bytes wc reads from a stream at once. */
+constexpr size_t kWcReadSize = 256 * 1024;
+
+/**
+ * Files a worker may be counting ahead of the one being printed. Bounds
+ * the futures in flight, not memory, which each count needs little of.
+ */
+constexpr size_t kCountAheadPerWorker = 4;
+
+/**
+ * Regular files at least this large are counted in ranges on several
+ * threads; smaller ones are not worth the threads.
+ */
+constexpr uint64_t kSplitMinBytes = 32 * 1024 * 1024;
+
+/** Smallest range a split file is cut into. */
+constexpr uint64_t kMinRangeBytes = 8 * 1024 * 1024;
+
+/** Ranges per worker, so that a slow range does not hold the rest up. */
+constexpr uint64_t kRangesPerWorker = 4;
+
+/**
+ * The counts wc prints, in the order it prints them, and whether it
+ * reports input that is not UTF-8.
+ */
+struct WcSelection {
+  bool lines = false;
+  bool words = false;
+  bool chars = false;
+  bool bytes = false;
+  bool maxLineLength = false;
+  bool validateUtf8 = false;
+
+  [[nodiscard]] bool Empty() const {
+    return !lines && !words && !chars && !bytes && !maxLineLength;
+  }
+
+  /** What a WordCounter must keep for these. */
+  [[nodiscard]] WcFields Fields() const {
+    return WcFields{lines, words, chars, maxLineLength, validateUtf8};
+  }
+
+  /** Returns true if only bytes are asked for: a file's size answers. */
+  [[nodiscard]] bool BytesOnly() const {
+    return bytes && !lines && !words && !chars && !maxLineLength &&
+           !validateUtf8;
+  }
+};
+
+/**
+ * One wc flag: its short name ('\0' if it has none), its long name and
+ * what it selects.
+ */
+struct WcOption {
+  char shortName;
+  std::string_view longName;
+  bool WcSelection::*count;
+};
+
+constexpr std::array kWcOptions = {
+    WcOption{'l', "lines", &WcSelection::lines},
+    WcOption{'w', "words", &WcSelection::words},
+    WcOption{'m', "chars", &WcSelection::chars},
+    WcOption{'c', "bytes", &WcSelection::bytes},
+    WcOption{'L', "max-line-length", &WcSelection::maxLineLength},
+    WcOption{'\0', "validate-utf8", &WcSelection::validateUtf8},
+};
+
+/**
+ * Splits wc's arguments into `selection` and `files`, GNU style: flags
+ * combine ("-lw") and "--" ends them. Returns the message to report after
+ * "wc: ", empty if the arguments are good.
+ */
+[[nodiscard]] std::string ParseWcArgs(const std::vector<std::string> &args,
+                                      WcSelection &selection,
+                                      std::vector<std::string> &files) {
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string_view arg = args[i];
+    if (arg == "--") {
+      files.insert(files.end(), args.begin() + static_cast<ptrdiff_t>(i) + 1,
+                   args.end());
+      break;
+    }
+    if (arg.size() < 2 || arg[0] != '-') {
+      files.push_back(args[i]);
+      continue;
+    }
+    if (arg[1] == '-') {
+      const auto option =
+          std::ranges::find(kWcOptions, arg.substr(2), &WcOption::longName);
+      if (option == kWcOptions.end()) {
+        return "unrecognized option '" + std::string(arg) + "'";
+      }
+      selection.*option->count = true;
+      continue;
+    }
+    for (const char name : arg.substr(1)) {
+      const auto option =
+          std::ranges::find(kWcOptions, name, &WcOption::shortName);
+      if (option == kWcOptions.end()) {
+        return std::string("invalid option -- '") + name + "'";
+      }
+      selection.*option->count = true;
+    }
+  }
+  if (selection.Empty()) {
+    selection.lines = selection.words = selection.bytes = true;
+  }
+  return {};
+}
+
+/** The selected counts of `counts`, separated by spaces. */
+[[nodiscard]] std::string Format(const WcCounts &counts,
+                                 const WcSelection &selection) {
+  std::string line;
+  const auto add = [&line](bool selected, size_t value) {
+    if (selected) {
+      line += (line.empty() ? "" : " ") + std::to_string(value);
+    }
+  };
+  add(selection.lines, counts.lines);
+  add(selection.words, counts.words);
+  add(selection.chars, counts.chars);
+  add(selection.bytes, counts.bytes);
+  add(selection.maxLineLength, counts.maxLineLength);
+  return line;
+}
+
+[[nodiscard]] WcCounts CountStream(std::istream &in, WcFields fields) {
+  WordCounter counter(fields);
+  // One buffer per thread, as most files are far smaller.
+  thread_local std::vector<char> buffer(kWcReadSize);
+  std::streambuf *source = in.rdbuf();
+  while (true) {
+    const std::streamsize got =
+        source->sgetn(buffer.data(), static_cast<std::streamsize>(kWcReadSize));
+    if (got <= 0) {
+      break;
+    }
+    counter.Add(std::string_view(buffer.data(), static_cast<size_t>(got)));
+  }
+  return counter.Counts();
+}
+
+/**
+ * Counts lines arriving through a LineChannel without re-reading bytes.
+ * Lines that lie next to each other in the chunk are counted as one run.
+ */
+void CountChunk(WordCounter &counter, const LineChunk &chunk) {
+  const std::string_view data(*chunk.data);
+  size_t i = 0;
+  while (i < chunk.lines.size()) {
+    const size_t begin = chunk.lines[i].offset;
+    size_t end = begin + chunk.lines[i].size;
+    for (++i; i < chunk.lines.size() && chunk.lines[i].offset == end; ++i) {
+      end += chunk.lines[i].size;
+    }
+    counter.Add(data.substr(begin, end - begin));
+  }
+}
+
+/** What counting one file found. */
+struct FileCount {
+  bool opened = false;
+  WcCounts counts;
+};
+
+#ifdef __linux__
+/**
+ * Whether `fd` is on a filesystem whose files report a size unrelated to
+ * what reading them returns: a page under /sys, 0 under /proc.
+ */
+[[nodiscard]] bool OnPseudoFilesystem(int fd) {
+  struct statfs fs {};
+  if (::fstatfs(fd, &fs) != 0) {
+    return true;
+  }
+  return fs.f_type == PROC_SUPER_MAGIC || fs.f_type == SYSFS_MAGIC ||
+         fs.f_type == DEBUGFS_MAGIC || fs.f_type == TRACEFS_MAGIC;
+}
+#endif
+
+/**
+ * Size of `path` if it is a regular file that reports one; nullopt if it
+ * must be read to be measured (pipes, /proc and /sys files, errors).
+ */
+[[nodiscard]] std::optional<size_t> RegularFileSize(const std::string &path) {
+#ifndef _WIN32
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st {};
+  bool sized =
+      ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+#ifdef __linux__
+  sized = sized && !OnPseudoFilesystem(fd);
+#endif
+  ::close(fd);
+  if (!sized) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(st.st_size);
+#else
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return std::nullopt;
+  }
+  const auto size = std::filesystem::file_size(path, ec);
+  if (ec || size == 0) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(size);
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * Counts bytes [begin, end) of `fd` with pread into a buffer of this
+ * thread. Returns nullopt if reading fails.
+ */
+[[nodiscard]] std::optional<WordCounter>
+CountRange(int fd, uint64_t begin, uint64_t end, WcFields fields) {
+  thread_local std::vector<char> buffer(kWcReadSize);
+  WordCounter counter(fields);
+  while (begin < end) {
+    const size_t want =
+        static_cast<size_t>(std::min<uint64_t>(end - begin, kWcReadSize));
+    const ssize_t got = ::pread(fd, buffer.data(), want,
+                                static_cast<off_t>(begin));
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return std::nullopt;
+    }
+    counter.Add(std::string_view(buffer.data(), static_cast<size_t>(got)));
+    begin += static_cast<uint64_t>(got);
+  }
+  return counter;
+}
+
+/**
+ * Counts a regular file of at least kSplitMinBytes in ranges on a pool of
+ * `workers` threads and joins the ranges' counts in order. Returns nullopt
+ * if the file is not such a file or cannot be read this way; it is then
+ * read from start to end.
+ */
+[[nodiscard]] std::optional<WcCounts>
+CountSplit(const std::string &path, WcFields fields, size_t workers) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      static_cast<uint64_t>(st.st_size) < kSplitMinBytes) {
+    ::close(fd);
+    return std::nullopt;
+  }
+  const auto size = static_cast<uint64_t>(st.st_size);
+  const uint64_t ranges = std::clamp<uint64_t>(
+      size / kMinRangeBytes, 1, kRangesPerWorker * workers);
+  std::vector<std::future<std::optional<WordCounter>>> counts;
+  {
+    ThreadPool pool(workers);
+    for (uint64_t i = 0; i < ranges; ++i) {
+      counts.push_back(pool.Submit([fd, fields, begin = size * i / ranges,
+                                    end = size * (i + 1) / ranges] {
+        return CountRange(fd, begin, end, fields);
+      }));
+    }
+  }
+  ::close(fd);
+  WordCounter total(fields);
+  for (auto &count : counts) {
+    const std::optional<WordCounter> range = count.get();
+    if (!range.has_value()) {
+      return std::nullopt;
+    }
+    total.Append(*range);
+  }
+  return total.Counts();
+}
+#endif
+
+/**
+ * Counts the file at `path`. With more than one worker, no -L and no
+ * validation, a large regular file is split across `workers` threads.
+ */
+[[nodiscard]] FileCount CountFile(const std::string &path,
+                                  const WcSelection &selection,
+                                  size_t workers) {
+  FileCount result;
+  if (selection.BytesOnly()) {
+    if (const std::optional<size_t> size = RegularFileSize(path)) {
+      result.opened = true;
+      result.counts.bytes = *size;
+      return result;
+    }
+  }
+#ifndef _WIN32
+  if (workers > 1 && !selection.maxLineLength && !selection.validateUtf8) {
+    if (const std::optional<WcCounts> counts =
+            CountSplit(path, selection.Fields(), workers)) {
+      result.opened = true;
+      result.counts = *counts;
+      return result;
+    }
+  }
+#endif
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return result;
+  }
+  result.opened = true;
+  result.counts = CountStream(in, selection.Fields());
+  return result;
+}
+
+[[nodiscard]] bool IsStdin(const std::string &file) { return file == "-"; }
+
+} // namespace
+
+WcCommand::WcCommand(std::vector<std::string> args) : args_(std::move(args)) {}
+
+CommandResult WcCommand::Execute(CommandContext &context) {
+  return RunInline(*this, context);
+}
+
+StageTask WcCommand::ExecuteCooperative(CooperativeContext &cooperative) {
+  CommandContext &context = cooperative.Context();
+
+  WcSelection selection;
+  std::vector<std::string> files;
+  if (const std::string error = ParseWcArgs(args_, selection, files);
+      !error.empty()) {
+    context.streams.err << "wc: " << error << "\n";
+    CommandResult r;
+    r.exitCode = 2;
+    co_return r;
+  }
+  // One input prints its counts alone, as stdin always did.
+  const bool named = files.size() > 1;
+  if (files.empty()) {
+    files.push_back("-");
+  }
+
+  LineSink sink(context);
+  int exitCode = 0;
+  WcCounts total;
+
+  // Files after the current one are counted ahead on the pool, at most
+  // `window` of them; standard input is read in its turn.
+  const size_t workers = WorkerCount(context.env);
+  const size_t window = kCountAheadPerWorker * workers;
+  const bool countAhead = workers > 1 && files.size() > 1;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<std::future<FileCount>> counts(files.size());
+  size_t nextCount = 0;
+
+  for (size_t f = 0; f < files.size(); ++f) {
+    const std::string &file = files[f];
+    for (; countAhead && nextCount < std::min(files.size(), f + 1 + window);
+         ++nextCount) {
+      if (IsStdin(files[nextCount])) {
+        continue;
+      }
+      if (!pool) {
+        pool = std::make_unique<ThreadPool>(workers);
+      }
+      counts[nextCount] =
+          pool->Submit([&path = files[nextCount], &selection] {
+            return CountFile(path, selection, 1);
+          });
+    }
+
+    FileCount found;
+    if (counts[f].valid()) {
+      found = counts[f].get();
+    } else if (!IsStdin(file)) {
+      // Counted in turn, so a large file may use all the workers.
+      found = CountFile(file, selection, workers);
+    } else if (context.inChannel != nullptr) {
+      WordCounter counter(selection.Fields());
+      LineSource source(context);
+      while (true) {
+        co_await cooperative.InputReady();
+        const auto chunk = source.Next();
+        if (chunk == nullptr) {
+          break;
+        }
+        CountChunk(counter, *chunk);
+      }
+      found = FileCount{true, counter.Counts()};
+    } else {
+      found = FileCount{true, CountStream(context.streams.in,
+                                          selection.Fields())};
+    }
+
+    if (!found.opened) {
+      context.streams.err << "wc: cannot open file: " << file << "\n";
+      exitCode = 1;
+      continue;
+    }
+    total.lines += found.counts.lines;
+    total.words += found.counts.words;
+    total.chars += found.counts.chars;
+    total.bytes += found.counts.bytes;
+    total.maxLineLength =
+        std::max(total.maxLineLength, found.counts.maxLineLength);
+    sink.WriteLine(named ? Format(found.counts, selection) + " " + file
+                         : Format(found.counts, selection));
+    if (found.counts.invalidUtf8) {
+      context.streams.err << "wc: " << file << ": invalid UTF-8 at byte "
+                          << *found.counts.invalidUtf8 << "\n";
+      exitCode = 1;
+    }
+    if (sink.Broken()) {
+      break;
+    }
+    co_await cooperative.OutputSpace();
+  }
+  if (named && !sink.Broken()) {
+    sink.WriteLine(Format(total, selection) + " total");
+  }
+
+  CommandResult r;
+  r.exitCode = exitCode;
+  co_return r;
+}
+
+} // namespace cppshell
@@ -0,0 +1,256 @@
+#include "cppshell/word_count.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cppshell {
+
+namespace {
+
+/** Bytes counted at once; bit i of a mask stands for byte i. */
+constexpr size_t kWindow = 64;
+
+/** Columns between tab stops, for -L. */
+constexpr size_t kTabWidth = 8;
+
+[[nodiscard]] bool IsSpace(unsigned char c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+[[nodiscard]] bool IsContinuation(unsigned char c) {
+  return (c & 0xC0) == 0x80;
+}
+
+/** Whitespace, newline and UTF-8 continuation bytes of a window. */
+struct Masks {
+  uint64_t space = 0;
+  uint64_t newline = 0;
+  uint64_t continuation = 0;
+};
+
+#ifdef __SSE2__
+/** Gathers `test`, applied to each 16 bytes of the window at `p`. */
+template <typename Test> uint64_t Gather(const char *p, Test &&test) {
+  uint64_t mask = 0;
+  for (size_t k = 0; k < kWindow / 16; ++k) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * k));
+    mask |= static_cast<uint64_t>(
+                static_cast<uint16_t>(_mm_movemask_epi8(test(v))))
+            << (16 * k);
+  }
+  return mask;
+}
+
+[[nodiscard]] uint64_t Newlines(const char *p) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  return Gather(p, [newline](__m128i v) {
+    return _mm_cmpeq_epi8(v, newline);
+  });
+}
+
+[[nodiscard]] Masks Classify(const char *p, bool chars) {
+  // '\t'..'\r' are the bytes b with b - '\t' below 5 unsigned; flipping
+  // the top bit lets a signed comparison test that.
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i flip = _mm_set1_epi8(-128);
+  const __m128i bound = _mm_set1_epi8(static_cast<char>(-128 + 5));
+  const __m128i blank = _mm_set1_epi8(' ');
+  Masks m;
+  m.space = Gather(p, [&](__m128i v) {
+    const __m128i control = _mm_cmplt_epi8(
+        _mm_xor_si128(_mm_sub_epi8(v, tab), flip), bound);
+    return _mm_or_si128(control, _mm_cmpeq_epi8(v, blank));
+  });
+  m.newline = Newlines(p);
+  if (chars) {
+    // 0x80..0xBF are the signed bytes below -64.
+    const __m128i lead = _mm_set1_epi8(-64);
+    m.continuation =
+        Gather(p, [lead](__m128i v) { return _mm_cmplt_epi8(v, lead); });
+  }
+  return m;
+}
+#else
+[[nodiscard]] uint64_t Newlines(const char *p) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kWindow; ++i) {
+    mask |= static_cast<uint64_t>(p[i] == '\n') << i;
+  }
+  return mask;
+}
+
+[[nodiscard]] Masks Classify(const char *p, bool chars) {
+  Masks m;
+  for (size_t i = 0; i < kWindow; ++i) {
+    const auto c = static_cast<unsigned char>(p[i]);
+    m.space |= static_cast<uint64_t>(IsSpace(c)) << i;
+    m.newline |= static_cast<uint64_t>(c == '\n') << i;
+    m.continuation |= static_cast<uint64_t>(chars && IsContinuation(c)) << i;
+  }
+  return m;
+}
+#endif
+
+} // namespace
+
+WordCounter::WordCounter(WcFields fields) : fields_(fields) {}
+
+void WordCounter::Add(std::string_view data) {
+  if (counts_.bytes == 0 && !data.empty()) {
+    startsInWord_ = !IsSpace(static_cast<unsigned char>(data.front()));
+  }
+  const size_t offset = counts_.bytes;
+  counts_.bytes += data.size();
+  if (fields_.maxLineLength) {
+    MeasureLines(data);
+  }
+  if (fields_.words || fields_.chars || fields_.validateUtf8) {
+    AddWindows(data, offset);
+  } else if (fields_.lines) {
+    AddNewlines(data);
+  }
+}
+
+void WordCounter::Append(const WordCounter &next) {
+  if (next.counts_.bytes == 0) {
+    return;
+  }
+  if (counts_.bytes == 0) {
+    startsInWord_ = next.startsInWord_;
+  }
+  counts_.lines += next.counts_.lines;
+  counts_.words += next.counts_.words;
+  if (inWord_ && next.startsInWord_ && next.counts_.words > 0) {
+    --counts_.words;
+  }
+  counts_.bytes += next.counts_.bytes;
+  continuation_ += next.continuation_;
+  inWord_ = next.inWord_;
+}
+
+WcCounts WordCounter::Counts() const {
+  WcCounts counts = counts_;
+  if (!fields_.lines) {
+    counts.lines = 0;
+  }
+  if (!fields_.words) {
+    counts.words = 0;
+  }
+  if (fields_.chars) {
+    counts.chars = counts.bytes - continuation_;
+  }
+  counts.maxLineLength = std::max(counts.maxLineLength, linePosition_);
+  if (fields_.validateUtf8 && !counts.invalidUtf8 && utf8_.Open()) {
+    counts.invalidUtf8 = counts.bytes;
+  }
+  return counts;
+}
+
+void WordCounter::AddWindows(std::string_view data, size_t offset) {
+  // Only the first failure is reported, so validation stops there.
+  const bool validate = fields_.validateUtf8 && !counts_.invalidUtf8;
+  if (data.size() < kWindow) {
+    if (validate) {
+      ValidateBytes(data, offset);
+    }
+    // Short pieces, such as single characters written to a stream.
+    for (const char ch : data) {
+      const auto c = static_cast<unsigned char>(ch);
+      counts_.lines += c == '\n' ? 1 : 0;
+      const bool space = IsSpace(c);
+      counts_.words += !space && !inWord_ ? 1 : 0;
+      inWord_ = !space;
+      continuation_ += IsContinuation(c) ? 1 : 0;
+    }
+    return;
+  }
+
+  // Bit 0 is set if the byte before the window is whitespace.
+  uint64_t spaceBefore = inWord_ ? 0 : 1;
+  size_t lines = 0;
+  size_t words = 0;
+  size_t continuation = 0;
+  const auto count = [&](const Masks &m) {
+    lines += static_cast<size_t>(std::popcount(m.newline));
+    words += static_cast<size_t>(
+        std::popcount(~m.space & ((m.space << 1) | spaceBefore)));
+    continuation += static_cast<size_t>(std::popcount(m.continuation));
+  };
+  size_t i = 0;
+  for (; i + kWindow <= data.size(); i += kWindow) {
+    const Masks m = Classify(data.data() + i, fields_.chars);
+    count(m);
+    spaceBefore = m.space >> 63;
+    if (validate && !counts_.invalidUtf8) {
+      if (const uint64_t failed = utf8_.NextWindow(data.data() + i)) {
+        counts_.invalidUtf8 =
+            offset + i + static_cast<size_t>(std::countr_zero(failed));
+      }
+    }
+  }
+  if (i < data.size()) {
+    if (validate && !counts_.invalidUtf8) {
+      ValidateBytes(data.substr(i), offset + i);
+    }
+    // The rest, padded with spaces, which start no word.
+    const size_t rest = data.size() - i;
+    char tail[kWindow];
+    std::memset(tail, ' ', kWindow);
+    std::memcpy(tail, data.data() + i, rest);
+    const Masks m = Classify(tail, fields_.chars);
+    count(m);
+    spaceBefore = (m.space >> (rest - 1)) & 1;
+  }
+  counts_.lines += lines;
+  counts_.words += words;
+  continuation_ += continuation;
+  inWord_ = spaceBefore == 0;
+}
+
+void WordCounter::ValidateBytes(std::string_view data, size_t offset) {
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (!utf8_.NextByte(static_cast<unsigned char>(data[i]))) {
+      counts_.invalidUtf8 = offset + i;
+      return;
+    }
+  }
+}
+
+void WordCounter::AddNewlines(std::string_view data) {
+  size_t lines = 0;
+  size_t i = 0;
+  for (; i + kWindow <= data.size(); i += kWindow) {
+    lines += static_cast<size_t>(std::popcount(Newlines(data.data() + i)));
+  }
+  lines += static_cast<size_t>(
+      std::count(data.begin() + static_cast<std::ptrdiff_t>(i), data.end(),
+                 '\n'));
+  counts_.lines += lines;
+}
+
+void WordCounter::MeasureLines(std::string_view data) {
+  size_t position = linePosition_;
+  size_t widest = counts_.maxLineLength;
+  for (const char ch : data) {
+    const auto c = static_cast<unsigned char>(ch);
+    if (c == '\n' || c == '\r' || c == '\f') {
+      widest = std::max(widest, position);
+      position = 0;
+    } else if (c == '\t') {
+      position += kTabWidth - position % kTabWidth;
+    } else if ((c >= 0x20 && c < 0x7F) || c >= 0xC0) {
+      ++position;
+    }
+  }
+  linePosition_ = position;
+  counts_.maxLineLength = widest;
+}
+
+} // namespace cppshell
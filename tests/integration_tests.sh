@@ -290,6 +290,55 @@ else
   exit 1
 fi
 
+echo "------------------------------------------------"
+echo "Testing Redirections: > >> < 2>"
+OUT_FILE="redir_out.tmp"
+ERR_FILE="redir_err.tmp"
+COPY_FILE="redir_copy.tmp"
+$BIN > /dev/null <<EOF
+echo first > $OUT_FILE
+echo second >> $OUT_FILE
+cat < $OUT_FILE | grep sec > $COPY_FILE
+ls /nonexistent_file_for_test 2> $ERR_FILE
+EOF
+if [[ "$(cat $OUT_FILE)" == $'first\nsecond' ]] && [[ "$(cat $COPY_FILE)" == "second" ]] && [ -s $ERR_FILE ]; then
+  echo "✅ PASS (Redirections)"
+else
+  echo "❌ FAIL: Unexpected redirection result:"
+  cat $OUT_FILE $COPY_FILE $ERR_FILE
+  rm -f $OUT_FILE $COPY_FILE $ERR_FILE
+  exit 1
+fi
+rm -f $OUT_FILE $COPY_FILE $ERR_FILE
+
+echo "------------------------------------------------"
+echo "Testing Fork Transports: shared memory vs pipes"
+BIG_FILE="transport_big.tmp"
+seq 1 300000 > $BIG_FILE
+EXPECTED_WC="$(wc -l < $BIG_FILE) $(wc -w < $BIG_FILE) $(wc -c < $BIG_FILE)"
+EXPECTED_SUM=$(md5sum < $BIG_FILE)
+for TRANSPORT in shm pipe; do
+  RESULT=$(timeout 20 $BIN <<EOF
+CPPSHELL_PIPELINE_MODE=fork
+CPPSHELL_FORK_TRANSPORT=$TRANSPORT
+cat $BIG_FILE | cat | cat | wc
+cat $BIG_FILE | cat | md5sum
+cat $BIG_FILE | cat | head -n 1
+cat $BIG_FILE | cat | pwd > /dev/null
+echo done
+EOF
+)
+  if [[ "$RESULT" == *"$EXPECTED_WC"*"$EXPECTED_SUM"*"> 1"*"done"* ]]; then
+    echo "✅ PASS ($TRANSPORT)"
+  else
+    echo "❌ FAIL ($TRANSPORT): got:"
+    echo "$RESULT"
+    rm -f $BIG_FILE
+    exit 1
+  fi
+done
+rm -f $BIG_FILE
+
 echo "------------------------------------------------"
 
 echo "------------------------------------------------"
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/executor.hpp"
+#include "cppshell/parser.hpp"
+
+#include <doctest/doctest.h>
+
+#include <sstream>
+#include <string>
+
+namespace cppshell::testing {
+
+/** What a pipeline or script printed and returned. */
+struct RunResult {
+  int exitCode = 0;
+  std::string out;
+  std::string err;
+};
+
+/**
+ * Parses `line` and runs it with the Executor on `input`, in the pipeline
+ * mode `mode` (CPPSHELL_PIPELINE_MODE; empty for the default).
+ */
+[[nodiscard]] inline RunResult Run(const std::string &line,
+                                   const std::string &input = "",
+                                   const std::string &mode = "") {
+  const ParseResult parsed = ParseLine(line);
+  REQUIRE(parsed.Ok());
+  REQUIRE(parsed.pipeline.has_value());
+
+  std::istringstream in(input);
+  std::ostringstream out;
+  std::ostringstream err;
+  const CommandFactory factory;
+  Environment env;
+  env.Set("CPPSHELL_PIPELINE_MODE", mode);
+  const Executor executor(factory);
+
+  RunResult r;
+  r.exitCode =
+      executor.RunPipeline(*parsed.pipeline, env, CommandStreams{in, out, err});
+  r.out = out.str();
+  r.err = err.str();
+  return r;
+}
+
+} // namespace cppshell::testing
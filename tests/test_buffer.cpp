@@ -0,0 +1,102 @@
+#include "cppshell/buffer_command.hpp"
+#include "cppshell/spill_queue.hpp"
+
+#include "pipeline_runner.hpp"
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+using cppshell::testing::Run;
+
+namespace {
+
+[[nodiscard]] std::string Lines(int count) {
+  std::string text;
+  for (int i = 0; i < count; ++i) {
+    text += "line " + std::to_string(i) + '\n';
+  }
+  return text;
+}
+
+} // namespace
+
+TEST_CASE("SpillQueue: keeps order across memory and disk") {
+  cppshell::SpillQueue queue(8, 1024);
+  CHECK(queue.Room() == 8 + 1024);
+  CHECK(queue.Append("0123456789") == 10);
+  CHECK(queue.PeakMemory() == 8);
+  CHECK(queue.PeakDisk() == 2);
+
+  std::string out;
+  CHECK(queue.Take(out, 5) == 5);
+  // Memory has room again, but while bytes are on disk new ones go there.
+  CHECK(queue.Room() == 1024 - 2);
+  CHECK(queue.Append("abc") == 3);
+  while (!queue.Empty()) {
+    CHECK(queue.Take(out, 4) != 0);
+  }
+  CHECK(out == "0123456789abc");
+  CHECK(queue.Error().empty());
+
+  // Once the file is read back memory is used again.
+  CHECK(queue.Append("xy") == 2);
+  CHECK(queue.PeakDisk() == 5);
+  CHECK(queue.Room() == 6 + 1024);
+}
+
+TEST_CASE("SpillQueue: a zero disk limit stops at the memory limit") {
+  cppshell::SpillQueue queue(4, 0);
+  CHECK(queue.Append("abcdef") == 4);
+  CHECK(queue.Room() == 0);
+  std::string out;
+  CHECK(queue.Take(out, 10) == 4);
+  CHECK(out == "abcd");
+  CHECK(queue.Empty());
+  CHECK(queue.PeakDisk() == 0);
+}
+
+TEST_CASE("buffer: passes data through unchanged in every mode") {
+  const std::string input = Lines(20000) + "no newline";
+  for (const char *mode : {"", "threads"}) {
+    CAPTURE(mode);
+    for (const char *line :
+         {"cat | buffer | cat", "cat | buffer -m 1K -d 64K | cat",
+          "cat | buffer -m 100 -d 0 | cat", "buffer -m 1K"}) {
+      CAPTURE(line);
+      const auto r = Run(line, input, mode);
+      CHECK(r.exitCode == 0);
+      CHECK(r.out == input);
+      CHECK(r.err.empty());
+    }
+  }
+}
+
+TEST_CASE("buffer: works in the middle of a channel pipeline") {
+  const auto r = Run("cat | buffer -m 4K | grep 7 | wc", Lines(10000));
+  const auto plain = Run("cat | grep 7 | wc", Lines(10000));
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == plain.out);
+}
+
+TEST_CASE("buffer: --stats reports peak usage") {
+  const std::string input = Lines(1000);
+  const auto r = Run("cat | buffer --stats -m 1K | cat", input, "threads");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == input);
+  CHECK(r.err.starts_with("buffer: " + std::to_string(input.size()) +
+                          " bytes, peak memory "));
+  CHECK(r.err.find("producer stalled") != std::string::npos);
+  CHECK(r.err.find("consumer idle") != std::string::npos);
+}
+
+TEST_CASE("buffer: rejects invalid sizes") {
+  for (const char *line :
+       {"buffer -m 0", "buffer -m 12X", "buffer -d -1", "buffer -m K"}) {
+    CAPTURE(line);
+    const auto r = Run(line, "data\n");
+    CHECK(r.exitCode == 2);
+    CHECK(r.out.empty());
+    CHECK(r.err.starts_with("buffer: "));
+  }
+}
@@ -1,11 +1,16 @@
 #include "cppshell/builtins.hpp"
 #include "cppshell/environment.hpp"
+#include "cppshell/wc_command.hpp"
+#include "cppshell/word_count.hpp"
 
 #include <doctest/doctest.h>
 
+#include <cctype>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <sstream>
+#include <utility>
 
 namespace {
 
@@ -71,6 +76,40 @@ TEST_CASE("cat outputs file") {
   std::filesystem::remove(tmp, ec);
 }
 
+TEST_CASE("cat goes on after an empty file or empty input") {
+  const auto dir =
+      std::filesystem::temp_directory_path() / "cppshell_cat_empty";
+  std::filesystem::create_directories(dir);
+  const std::string empty = (dir / "empty").string();
+  const std::string full = (dir / "full").string();
+  std::ofstream(empty, std::ios::binary).close();
+  std::ofstream(full, std::ios::binary) << "abc\n";
+
+  const cppshell::Environment env;
+  {
+    std::istringstream in("");
+    std::ostringstream out;
+    std::ostringstream err;
+    cppshell::CatCommand cmd(std::vector<std::string>{empty, full, empty});
+    auto ctx = MakeCtx(in, out, err, env);
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    CHECK(out.str() == "abc\n");
+  }
+  {
+    std::istringstream in("");
+    std::ostringstream out;
+    std::ostringstream err;
+    cppshell::CatCommand cmd(std::vector<std::string>{});
+    auto ctx = MakeCtx(in, out, err, env);
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    out << "after";
+    CHECK(out.str() == "after");
+  }
+
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+}
+
 TEST_CASE("wc reports lines words bytes") {
   const auto tmp =
       std::filesystem::temp_directory_path() / "cppshell_wc_test.txt";
@@ -96,6 +135,228 @@ TEST_CASE("wc reports lines words bytes") {
   std::filesystem::remove(tmp, ec);
 }
 
+TEST_CASE("wc counts several files, selected counts and a total") {
+  const auto dir = std::filesystem::temp_directory_path() / "cppshell_wc_many";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const std::string a = (dir / "a.txt").string();
+  const std::string b = (dir / "b.txt").string();
+  const std::string c = (dir / "c.txt").string();
+  const std::string d = (dir / "d.txt").string();
+  std::ofstream(a, std::ios::binary) << "a b\ncd\n";
+  std::ofstream(b, std::ios::binary) << "\tx\xc3\xa9y z";
+  std::ofstream(c, std::ios::binary) << "";
+  std::ofstream(d, std::ios::binary) << "ab\xff\n";
+
+  auto run = [](const std::string &threads, std::vector<std::string> args) {
+    std::istringstream in("from stdin\n");
+    std::ostringstream out;
+    std::ostringstream err;
+    cppshell::Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    cppshell::WcCommand cmd(std::move(args));
+    auto ctx = MakeCtx(in, out, err, env);
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  for (const std::string threads : {"1", "4"}) {
+    CHECK(run(threads, {a, b, c}) == "0\n2 3 7 " + a + "\n0 2 7 " + b +
+                                         "\n0 0 0 " + c + "\n2 5 14 total\n");
+    CHECK(run(threads, {"-l", a, b}) ==
+          "0\n2 " + a + "\n0 " + b + "\n2 total\n");
+    CHECK(run(threads, {"-c", a, b, c}) ==
+          "0\n7 " + a + "\n7 " + b + "\n0 " + c + "\n14 total\n");
+    CHECK(run(threads, {"-cmlLw", a, b}) == "0\n2 3 7 7 3 " + a +
+                                                "\n0 2 6 7 13 " + b +
+                                                "\n2 5 13 14 13 total\n");
+    CHECK(run(threads, {a, (dir / "none").string(), "-", "-w"}) ==
+          "1\nwc: cannot open file: " + (dir / "none").string() + "\n3 " +
+              a + "\n2 -\n5 total\n");
+    CHECK(run(threads, {"--validate-utf8", "-m", b, d}) ==
+          "1\nwc: " + d + ": invalid UTF-8 at byte 2\n6 " + b + "\n4 " + d +
+              "\n10 total\n");
+  }
+  // A single input prints no name, as wc on stdin does.
+  CHECK(run("1", {"--lines", "--", a}) == "0\n2\n");
+  CHECK(run("1", {}) == "0\n1 2 11\n");
+  CHECK(run("1", {"-x", a}) == "2\nwc: invalid option -- 'x'\n");
+  CHECK(run("1", {"--line", a}) == "2\nwc: unrecognized option '--line'\n");
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("WordCounter: counts as std::isspace does, however split") {
+  // Every byte value, near window edges, in runs of each length.
+  std::string text;
+  uint32_t state = 7;
+  for (size_t i = 0; i < 5000; ++i) {
+    state = state * 1103515245 + 12345;
+    const unsigned pick = (state >> 16) % 8;
+    text.push_back(pick < 3   ? "  \t\n\v\f\r"[(state >> 8) % 7]
+                   : pick < 4 ? static_cast<char>(state >> 24)
+                              : static_cast<char>('a' + pick));
+  }
+
+  for (size_t length : {0, 1, 63, 64, 65, 127, 128, 129, 1000, 5000}) {
+    const std::string_view data = std::string_view(text).substr(0, length);
+    cppshell::WcCounts expected;
+    bool inWord = false;
+    for (const char ch : data) {
+      const auto c = static_cast<unsigned char>(ch);
+      expected.lines += c == '\n' ? 1 : 0;
+      const bool space = std::isspace(c) != 0;
+      expected.words += !space && !inWord ? 1 : 0;
+      inWord = !space;
+      expected.chars += (c & 0xC0) != 0x80 ? 1 : 0;
+    }
+    expected.bytes = data.size();
+
+    for (size_t piece : {1, 5, 64, 100, 5000}) {
+      cppshell::WordCounter counter;
+      cppshell::WordCounter chars({.words = false, .chars = true});
+      cppshell::WordCounter lines({.words = false});
+      for (size_t i = 0; i < data.size(); i += piece) {
+        counter.Add(data.substr(i, piece));
+        chars.Add(data.substr(i, piece));
+        lines.Add(data.substr(i, piece));
+      }
+      CHECK(counter.Counts().lines == expected.lines);
+      CHECK(counter.Counts().words == expected.words);
+      CHECK(counter.Counts().bytes == expected.bytes);
+      CHECK(chars.Counts().chars == expected.chars);
+      CHECK(chars.Counts().lines == expected.lines);
+      CHECK(lines.Counts().lines == expected.lines);
+      CHECK(lines.Counts().bytes == expected.bytes);
+    }
+  }
+}
+
+TEST_CASE("WordCounter: Append joins counts split anywhere") {
+  const std::string text = "ab cd\n\t\xc3\xa9" "f  gh\n\nij\xe2\x82\xac k ";
+  cppshell::WordCounter whole({.chars = true});
+  whole.Add(text);
+  const cppshell::WcCounts expected = whole.Counts();
+
+  for (size_t first = 0; first <= text.size(); ++first) {
+    for (size_t second = first; second <= text.size(); ++second) {
+      cppshell::WordCounter joined({.chars = true});
+      for (const auto &[begin, end] : {std::pair{size_t{0}, first},
+                                      std::pair{first, second},
+                                      std::pair{second, text.size()}}) {
+        cppshell::WordCounter range({.chars = true});
+        range.Add(std::string_view(text).substr(begin, end - begin));
+        joined.Append(range);
+      }
+      const cppshell::WcCounts counts = joined.Counts();
+      CHECK(counts.lines == expected.lines);
+      CHECK(counts.words == expected.words);
+      CHECK(counts.chars == expected.chars);
+      CHECK(counts.bytes == expected.bytes);
+    }
+  }
+}
+
+TEST_CASE("WordCounter: finds the first byte that is not UTF-8") {
+  // Each sample with the offset at which decoding fails, if it does.
+  const std::vector<std::pair<std::string, std::optional<size_t>>> samples =
+      {{"caf\xC3\xA9", {}},
+       {"\xF0\x9F\x98\x80\xF4\x8F\xBF\xBF", {}},
+       {std::string("a\0b", 3), {}},
+       {"\xE2\x82\xAC \x80", 4},
+       {"caf\xE9 au lait", 4},
+       {"\xC0\x80", 0},
+       {"\xE0\x80\x80", 1},
+       {"\xED\xA0\x80", 1},
+       {"\xF0\x80\x80\x80", 1},
+       {"\xF4\x90\x80\x80", 1},
+       {"\xF5\x80", 0},
+       {"\xE2\x82x", 2},
+       {"\xE2\x82", 2}};
+  for (size_t pad : {0, 1, 30, 61, 62, 63, 64, 100}) {
+    const std::string ascii(pad, 'x');
+    for (const auto &[sample, failsAt] : samples) {
+      const auto expected =
+          failsAt ? std::optional<size_t>(pad + *failsAt) : std::nullopt;
+      // Followed by ASCII, an open sequence fails at the ASCII byte.
+      for (const std::string &text : {ascii + sample, ascii + sample + ascii}) {
+        for (size_t piece : {1, 3, 64, 1000}) {
+          CAPTURE(text);
+          CAPTURE(piece);
+          cppshell::WordCounter counter({.validateUtf8 = true});
+          cppshell::WordCounter lines({.words = false, .validateUtf8 = true});
+          for (size_t i = 0; i < text.size(); i += piece) {
+            counter.Add(std::string_view(text).substr(i, piece));
+            lines.Add(std::string_view(text).substr(i, piece));
+          }
+          CHECK(counter.Counts().invalidUtf8 == expected);
+          CHECK(lines.Counts().invalidUtf8 == expected);
+        }
+      }
+    }
+  }
+  CHECK_FALSE(cppshell::WordCounter().Counts().invalidUtf8);
+}
+
+TEST_CASE("wc counts a large file in ranges as it does in one piece") {
+  const auto tmp =
+      std::filesystem::temp_directory_path() / "cppshell_wc_large.txt";
+  {
+    // Just over the size at which wc splits a file, with words cut by
+    // the range boundaries.
+    std::string block;
+    uint32_t state = 3;
+    while (block.size() < 1024 * 1024 + 7) {
+      state = state * 1103515245 + 12345;
+      block.append(1 + (state >> 16) % 9, "\xc3\xa9xyz"[(state >> 8) % 5]);
+      block.push_back((state >> 28) == 0 ? '\n' : ' ');
+    }
+    std::ofstream f(tmp, std::ios::binary);
+    for (size_t i = 0; i < 33; ++i) {
+      f << block;
+    }
+  }
+
+  auto run = [&tmp](const std::string &threads) {
+    std::istringstream in("");
+    std::ostringstream out;
+    std::ostringstream err;
+    cppshell::Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    cppshell::WcCommand cmd({"-lwmc", tmp.string()});
+    auto ctx = MakeCtx(in, out, err, env);
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    return out.str();
+  };
+  CHECK(run("4") == run("1"));
+
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+}
+
+TEST_CASE("wc -c reads files whose size is made up") {
+  // sysfs reports a page for every file.
+  for (const char *path : {"/sys/kernel/mm/transparent_hugepage/enabled",
+                           "/sys/devices/system/cpu/online"}) {
+    CAPTURE(path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      continue;
+    }
+    std::ostringstream data;
+    data << file.rdbuf();
+
+    std::istringstream in("");
+    std::ostringstream out;
+    std::ostringstream err;
+    const cppshell::Environment env;
+    cppshell::WcCommand cmd({"-c", path});
+    auto ctx = MakeCtx(in, out, err, env);
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    CHECK(out.str() == std::to_string(data.str().size()) + "\n");
+  }
+}
+
 TEST_CASE("exit requests termination") {
   std::istringstream in("");
   std::ostringstream out;
@@ -0,0 +1,119 @@
+#include "cppshell/builtins.hpp"
+#include "cppshell/cooperative.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <doctest/doctest.h>
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+[[nodiscard]] std::shared_ptr<const cppshell::LineChunk>
+MakeChunk(const std::string &text) {
+  auto chunk = std::make_shared<cppshell::LineChunk>();
+  chunk->data = std::make_shared<const std::string>(text);
+  chunk->lines = {{0, text.size()}};
+  return chunk;
+}
+
+} // namespace
+
+TEST_CASE("Cooperative: reader suspends until a chunk arrives") {
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+  const cppshell::Environment env;
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+
+  cppshell::CooperativeScheduler scheduler;
+  cppshell::CooperativeLineChannel channel(scheduler);
+  ctx.inChannel = &channel;
+  cppshell::CooperativeContext cooperative(ctx);
+
+  cppshell::CatCommand cat({});
+  cppshell::StageTask task = cat.ExecuteCooperative(cooperative);
+  task.GetHandle().resume();
+  CHECK_FALSE(task.Done());
+  CHECK(!scheduler.Next()); // Nothing to do until the writer pushes.
+
+  REQUIRE(channel.Push(MakeChunk("a\n")));
+  const auto next = scheduler.Next();
+  REQUIRE(next == task.GetHandle());
+  next.resume();
+  CHECK_FALSE(task.Done());
+  CHECK(out.str() == "a\n");
+
+  channel.Close();
+  scheduler.Next().resume();
+  REQUIRE(task.Done());
+  CHECK(task.Result().exitCode == 0);
+}
+
+TEST_CASE("Cooperative: writer suspends until its chunk is consumed") {
+  std::istringstream in("apple\nplum\ncherry\n");
+  std::ostringstream out;
+  std::ostringstream err;
+  const cppshell::Environment env;
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+
+  cppshell::CooperativeScheduler scheduler;
+  cppshell::CooperativeLineChannel channel(scheduler);
+  ctx.outChannel = &channel;
+  cppshell::CooperativeContext cooperative(ctx);
+
+  cppshell::GrepCommand grep({"p"});
+  cppshell::StageTask task = grep.ExecuteCooperative(cooperative);
+  task.GetHandle().resume();
+  CHECK_FALSE(task.Done());
+  CHECK_FALSE(channel.Writable());
+
+  const auto chunk = channel.Pop();
+  REQUIRE(chunk != nullptr);
+  REQUIRE(chunk->lines.size() == 2);
+  CHECK(chunk->Line(1) == "plum\n");
+
+  scheduler.Next().resume();
+  REQUIRE(task.Done());
+  CHECK(task.Result().exitCode == 0);
+}
+
+TEST_CASE("Cooperative: reading before InputReady is a logic error") {
+  cppshell::CooperativeScheduler scheduler;
+  cppshell::CooperativeLineChannel channel(scheduler);
+  CHECK_THROWS_AS(static_cast<void>(channel.Pop()), std::logic_error);
+  channel.Close();
+  CHECK(channel.Pop() == nullptr);
+}
+
+TEST_CASE("Cooperative: Execute() adapter serves non-streaming builtins") {
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+  const cppshell::Environment env;
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+
+  cppshell::CooperativeScheduler scheduler;
+  cppshell::CooperativeLineChannel input(scheduler);
+  ctx.inChannel = &input;
+  cppshell::CooperativeContext cooperative(ctx);
+
+  // `help` ignores its input but may only run once all of it arrived.
+  cppshell::HelpCommand help({"echo"});
+  cppshell::StageTask task = help.ExecuteCooperative(cooperative);
+  task.GetHandle().resume();
+  CHECK_FALSE(task.Done());
+
+  REQUIRE(input.Push(MakeChunk("ignored\n")));
+  input.Close();
+  scheduler.Next().resume();
+  REQUIRE(task.Done());
+  CHECK(task.Result().exitCode == 0);
+  CHECK(out.str().find("echo: echo [arg ...]") == 0);
+}
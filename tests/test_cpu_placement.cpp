@@ -0,0 +1,140 @@
+#include "cppshell/cpu_placement.hpp"
+#include "cppshell/environment.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+void WriteAttribute(const std::filesystem::path &path,
+                    const std::string &value) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << value << '\n';
+}
+
+/**
+ * Two packages with two SMT cores each. CPU ids follow Linux numbering:
+ * first threads 0-3, their siblings 4-7. L2 per core, L3 per package.
+ */
+[[nodiscard]] std::filesystem::path MakeSysfs() {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_test_sysfs";
+  std::filesystem::remove_all(root);
+  for (int cpu = 0; cpu < 8; ++cpu) {
+    const int first = cpu % 4;
+    const int package = first / 2;
+    const std::string core = std::to_string(first) + "," +
+                             std::to_string(first + 4);
+    const std::string packageCpus = std::to_string(package * 2) + "-" +
+                                    std::to_string(package * 2 + 1) + "," +
+                                    std::to_string(package * 2 + 4) + "-" +
+                                    std::to_string(package * 2 + 5);
+    const auto dir = root / ("cpu" + std::to_string(cpu));
+    WriteAttribute(dir / "topology" / "thread_siblings_list", core);
+    WriteAttribute(dir / "topology" / "core_siblings_list", packageCpus);
+    WriteAttribute(dir / "cache" / "index0" / "level", "1");
+    WriteAttribute(dir / "cache" / "index0" / "type", "Data");
+    WriteAttribute(dir / "cache" / "index0" / "shared_cpu_list", core);
+    WriteAttribute(dir / "cache" / "index2" / "level", "2");
+    WriteAttribute(dir / "cache" / "index2" / "type", "Unified");
+    WriteAttribute(dir / "cache" / "index2" / "shared_cpu_list", core);
+    WriteAttribute(dir / "cache" / "index3" / "level", "3");
+    WriteAttribute(dir / "cache" / "index3" / "type", "Unified");
+    WriteAttribute(dir / "cache" / "index3" / "shared_cpu_list",
+                   packageCpus);
+  }
+  return root;
+}
+
+} // namespace
+
+TEST_CASE("CpuTopology: reads cores and caches from sysfs") {
+  const auto root = MakeSysfs();
+  const cppshell::CpuTopology topology =
+      cppshell::ReadCpuTopology(root, {5, 0, 3});
+  REQUIRE(topology.cpus.size() == 3);
+
+  CHECK(topology.cpus[0].id == 0);
+  CHECK(topology.cpus[0].thread == 0);
+  CHECK(topology.cpus[0].l3 == 0);
+  CHECK(topology.cpus[1].id == 3);
+  CHECK(topology.cpus[1].l3 == 2);
+  CHECK(topology.cpus[2].id == 5);
+  CHECK(topology.cpus[2].core == 1);
+  CHECK(topology.cpus[2].thread == 1);
+  CHECK(topology.cpus[2].l2 == 1);
+
+  // A CPU without sysfs entries is a domain of its own.
+  const cppshell::CpuTopology missing = cppshell::ReadCpuTopology(root, {42});
+  REQUIRE(missing.cpus.size() == 1);
+  CHECK(missing.cpus[0].core == 42);
+  CHECK(missing.cpus[0].l3 == 42);
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("PlanPlacement: compact and spread orders") {
+  const auto root = MakeSysfs();
+  const cppshell::CpuTopology topology =
+      cppshell::ReadCpuTopology(root, {0, 1, 2, 3, 4, 5, 6, 7});
+  std::filesystem::remove_all(root);
+
+  // Compact: both cores of package 0, their siblings, then package 1.
+  CHECK(cppshell::PlanPlacement(topology, cppshell::PlacementPolicy::kCompact,
+                                5) == std::vector<int>{0, 1, 4, 5, 2});
+  // Spread: alternate packages, physical cores before siblings.
+  CHECK(cppshell::PlanPlacement(topology, cppshell::PlacementPolicy::kSpread,
+                                5) == std::vector<int>{0, 2, 1, 3, 4});
+  // More stages than CPUs wrap around.
+  CHECK(cppshell::PlanPlacement(topology, cppshell::PlacementPolicy::kSpread,
+                                9)
+            .back() == 0);
+  CHECK(cppshell::PlanPlacement(topology, cppshell::PlacementPolicy::kOs, 3) ==
+        std::vector<int>{-1, -1, -1});
+  CHECK(cppshell::PlanPlacement({}, cppshell::PlacementPolicy::kCompact, 2) ==
+        std::vector<int>{-1, -1});
+}
+
+TEST_CASE("PlacementFromEnv: CPPSHELL_PLACEMENT selects the policy") {
+  cppshell::Environment env;
+  CHECK(cppshell::PlacementFromEnv(env) == cppshell::PlacementPolicy::kOs);
+  env.Set("CPPSHELL_PLACEMENT", "compact");
+  CHECK(cppshell::PlacementFromEnv(env) ==
+        cppshell::PlacementPolicy::kCompact);
+  env.Set("CPPSHELL_PLACEMENT", "spread");
+  CHECK(cppshell::PlacementFromEnv(env) == cppshell::PlacementPolicy::kSpread);
+  env.Set("CPPSHELL_PLACEMENT", "everywhere");
+  CHECK(cppshell::PlacementFromEnv(env) == cppshell::PlacementPolicy::kOs);
+}
+
+#ifdef __linux__
+TEST_CASE("PinCurrentThread: pins and unpins the calling thread") {
+  const cppshell::CpuTopology &topology = cppshell::CurrentCpuTopology();
+  REQUIRE(!topology.cpus.empty());
+  const int cpu = topology.cpus.back().id;
+
+  std::thread([&] {
+    cpu_set_t before;
+    REQUIRE(sched_getaffinity(0, sizeof(before), &before) == 0);
+
+    CHECK(cppshell::PinCurrentThread(cpu));
+    cpu_set_t pinned;
+    REQUIRE(sched_getaffinity(0, sizeof(pinned), &pinned) == 0);
+    CHECK(CPU_COUNT(&pinned) == 1);
+    CHECK(CPU_ISSET(cpu, &pinned));
+
+    cppshell::UnpinCurrentThread();
+    cpu_set_t after;
+    REQUIRE(sched_getaffinity(0, sizeof(after), &after) == 0);
+    CHECK(CPU_EQUAL(&before, &after));
+  }).join();
+}
+#endif
@@ -0,0 +1,71 @@
+#include "pipeline_runner.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <string>
+#include <utility>
+
+using cppshell::testing::Run;
+
+TEST_CASE("Executor: builtin pipeline runs in-process") {
+  const auto r = Run("echo 'one two three' | wc | cat");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == "1 3 14\n");
+}
+
+TEST_CASE("Executor: stdin feeds the first builtin") {
+  const auto r = Run("cat | grep -A 1 b | wc", "a\nb\nc\nd\n");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == "2 2 4\n");
+}
+
+TEST_CASE("Executor: channel and byte edges mix") {
+  // `help` has no line channel support, so its edge falls back to bytes.
+  const auto r = Run("help echo | grep -i output | cat");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out.find("Output the args") != std::string::npos);
+}
+
+TEST_CASE("Executor: exit code comes from the last command") {
+  CHECK(Run("echo abc | grep zzz").exitCode == 1);
+  CHECK(Run("echo abc | grep zzz | cat").exitCode == 0);
+}
+
+TEST_CASE("Executor: cooperative and threaded modes agree") {
+  const std::pair<std::string, std::string> cases[] = {
+      {"echo 'one two' | wc", ""},
+      {"cat | grep -A 1 b | cat | wc", "a\nb\nc\nd\nb\n"},
+      {"cat | cat | cat", "x\ny"},
+      {"echo abc | grep zzz", ""},
+      {"help echo | grep -i output | wc", ""},
+      {"echo ignored | help cat", ""},
+      {"cat | exit 3", "input\n"},
+      {"grep | wc", ""},
+  };
+  for (const auto &[line, input] : cases) {
+    CAPTURE(line);
+    const auto cooperative = Run(line, input, "cooperative");
+    const auto threaded = Run(line, input, "threads");
+    CHECK(cooperative.out == threaded.out);
+    CHECK(cooperative.err == threaded.err);
+    CHECK(cooperative.exitCode == threaded.exitCode);
+  }
+}
+
+TEST_CASE("Executor: redirections inside a cooperative pipeline") {
+  const auto tmp =
+      std::filesystem::temp_directory_path() / "cppshell_cooperative.txt";
+  const std::string path = tmp.string();
+
+  auto r = Run("echo abc > " + path + " | wc", "", "cooperative");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == "0 0 0\n");
+
+  r = Run("echo ignored | grep b < " + path + " | wc", "", "cooperative");
+  CHECK(r.exitCode == 0);
+  CHECK(r.out == "1 1 4\n");
+
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+}
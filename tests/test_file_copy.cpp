@@ -0,0 +1,258 @@
+#include "cppshell/file_copy.hpp"
+
+#include <doctest/doctest.h>
+
+#ifndef _WIN32
+
+#include "cppshell/builtins.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/fd_stream.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/** Deterministic data whose every byte depends on its position. */
+[[nodiscard]] std::string Pattern(size_t size) {
+  std::string data(size, '\0');
+  uint32_t x = 777;
+  for (char &ch : data) {
+    x = x * 1103515245 + 12345;
+    ch = static_cast<char>(x >> 24);
+  }
+  return data;
+}
+
+[[nodiscard]] std::string ReadAll(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream data;
+  data << in.rdbuf();
+  return data.str();
+}
+
+/** Everything read from `fd` until end of file. */
+[[nodiscard]] std::string Drain(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t n = 0;
+  while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+    data.append(buffer, static_cast<size_t>(n));
+  }
+  return data;
+}
+
+struct TempDir {
+  TempDir() {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+  ~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+  }
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "cppshell_file_copy_test";
+};
+
+} // namespace
+
+TEST_CASE("CopyToFd: file to file, from the current offset") {
+  TempDir dir;
+  const std::string data = Pattern(3 * 1024 * 1024 + 17);
+  std::ofstream(dir.path / "in", std::ios::binary) << data;
+
+  for (const int flags : {O_TRUNC, O_APPEND}) {
+    CAPTURE(flags);
+    const int in = ::open((dir.path / "in").c_str(), O_RDONLY);
+    const int out = ::open((dir.path / "out").c_str(),
+                           O_WRONLY | O_CREAT | O_TRUNC | flags, 0644);
+    REQUIRE(in >= 0);
+    REQUIRE(out >= 0);
+    REQUIRE(::write(out, "head", 4) == 4);
+    REQUIRE(::lseek(in, 5, SEEK_SET) == 5);
+    CHECK(cppshell::CopyToFd(in, out));
+    ::close(in);
+    ::close(out);
+    CHECK(ReadAll(dir.path / "out") == "head" + data.substr(5));
+  }
+}
+
+TEST_CASE("CopyToFd: holes between regular files stay holes") {
+  TempDir dir;
+  const off_t size = 16 * 1024 * 1024;
+  const off_t middle = 5 * 1024 * 1024;
+  {
+    const int fd = ::open((dir.path / "sparse").c_str(),
+                          O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    REQUIRE(::pwrite(fd, "data", 4, middle) == 4);
+    REQUIRE(::ftruncate(fd, size) == 0);
+    ::close(fd);
+  }
+  const int in = ::open((dir.path / "sparse").c_str(), O_RDONLY);
+  const int out = ::open((dir.path / "copy").c_str(),
+                         O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(in >= 0);
+  REQUIRE(out >= 0);
+  CHECK(cppshell::CopyToFd(in, out));
+  ::close(in);
+  ::close(out);
+
+  const std::string copy = ReadAll(dir.path / "copy");
+  REQUIRE(copy.size() == static_cast<size_t>(size));
+  CHECK(copy.substr(static_cast<size_t>(middle), 4) == "data");
+  CHECK(copy.find_first_not_of('\0') == static_cast<size_t>(middle));
+  CHECK(copy.find_last_not_of('\0') == static_cast<size_t>(middle) + 3);
+
+  struct stat source {};
+  struct stat copied {};
+  REQUIRE(::stat((dir.path / "sparse").c_str(), &source) == 0);
+  REQUIRE(::stat((dir.path / "copy").c_str(), &copied) == 0);
+  // Only where the filesystem kept the source sparse.
+  if (source.st_blocks * 512 < size / 2) {
+    CHECK(copied.st_blocks * 512 < size / 2);
+  }
+}
+
+TEST_CASE("CopyToFd: through pipes at either end") {
+  TempDir dir;
+  const std::string data = Pattern(1024 * 1024 + 3);
+  std::ofstream(dir.path / "in", std::ios::binary) << data;
+
+  SUBCASE("file to pipe") {
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    std::string received;
+    std::thread reader([&] { received = Drain(fds[0]); });
+    const int in = ::open((dir.path / "in").c_str(), O_RDONLY);
+    REQUIRE(in >= 0);
+    CHECK(cppshell::CopyToFd(in, fds[1]));
+    ::close(in);
+    ::close(fds[1]);
+    reader.join();
+    ::close(fds[0]);
+    CHECK(received == data);
+  }
+
+  SUBCASE("pipe to file") {
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    std::thread writer([&] {
+      CHECK(cppshell::WriteAll(fds[1], data.data(), data.size()));
+      ::close(fds[1]);
+    });
+    const int out = ::open((dir.path / "out").c_str(),
+                           O_WRONLY | O_CREAT | O_APPEND, 0644);
+    REQUIRE(out >= 0);
+    CHECK(cppshell::CopyToFd(fds[0], out));
+    writer.join();
+    ::close(fds[0]);
+    ::close(out);
+    CHECK(ReadAll(dir.path / "out") == data);
+  }
+}
+
+TEST_CASE("CopyToFd: files that report no size are read") {
+  const int in = ::open("/proc/self/status", O_RDONLY);
+  if (in < 0) {
+    return;
+  }
+  int fds[2];
+  REQUIRE(::pipe(fds) == 0);
+  CHECK(cppshell::CopyToFd(in, fds[1]));
+  ::close(in);
+  ::close(fds[1]);
+  CHECK(Drain(fds[0]).find("Name:") != std::string::npos);
+  ::close(fds[0]);
+}
+
+TEST_CASE("CopyToFd: a file is not appended to itself") {
+  TempDir dir;
+  const auto path = dir.path / "self";
+  std::ofstream(path, std::ios::binary) << "data\n";
+
+  const int in = ::open(path.c_str(), O_RDONLY);
+  const int out = ::open(path.c_str(), O_WRONLY | O_APPEND);
+  REQUIRE(in >= 0);
+  REQUIRE(out >= 0);
+  CHECK(cppshell::InputIsOutput(in, out));
+  CHECK_FALSE(cppshell::CopyToFd(in, out));
+  ::close(in);
+  ::close(out);
+  CHECK(ReadAll(path) == "data\n");
+}
+
+TEST_CASE("cat refuses to append a file to itself") {
+  TempDir dir;
+  const auto self = dir.path / "self";
+  const auto other = dir.path / "other";
+  std::ofstream(self, std::ios::binary) << "self\n";
+  std::ofstream(other, std::ios::binary) << "other\n";
+
+  // cat ARGS >> self (or > self with `flags` O_TRUNC).
+  auto run = [&](std::vector<std::string> args, int flags) {
+    const int fd = ::open(self.c_str(), O_WRONLY | flags);
+    REQUIRE(fd >= 0);
+    cppshell::FdWriteBuffer buffer(fd, true);
+    std::istringstream in;
+    std::ostream out(&buffer);
+    std::ostringstream err;
+    const cppshell::Environment env;
+    cppshell::CommandStreams streams{in, out, err};
+    cppshell::CommandContext ctx{streams, env};
+    cppshell::CatCommand cat(std::move(args));
+    const int code = cat.Execute(ctx).exitCode;
+    out.flush();
+    return std::to_string(code) + "\n" + err.str();
+  };
+
+  CHECK(run({other.string(), self.string(), other.string()}, O_APPEND) ==
+        "1\ncat: " + self.string() + ": input file is output file\n");
+  CHECK(ReadAll(self) == "self\nother\nother\n");
+  // The truncated file has nothing left to feed back.
+  CHECK(run({self.string(), other.string()}, O_TRUNC) == "0\n");
+  CHECK(ReadAll(self) == "other\n");
+}
+
+TEST_CASE("cat writes files to a descriptor after what was buffered") {
+  TempDir dir;
+  const std::string data = Pattern(200 * 1024);
+  const std::string a = (dir.path / "a").string();
+  std::ofstream(a, std::ios::binary) << data;
+
+  const int fd = ::open((dir.path / "out").c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(fd >= 0);
+  int code = 0;
+  std::string err;
+  {
+    cppshell::FdWriteBuffer buffer(fd, true);
+    std::istringstream in;
+    std::ostream out(&buffer);
+    std::ostringstream errStream;
+    const cppshell::Environment env;
+    cppshell::CommandStreams streams{in, out, errStream};
+    cppshell::CommandContext ctx{streams, env};
+    out << "before\n";
+    cppshell::CatCommand cat({a, (dir.path / "none").string(), a});
+    code = cat.Execute(ctx).exitCode;
+    out << "after\n";
+    err = errStream.str();
+  }
+  CHECK(code == 1);
+  CHECK(err == "cat: cannot open file: " + (dir.path / "none").string() +
+                   "\n");
+  CHECK(ReadAll(dir.path / "out") == "before\n" + data + data + "after\n");
+}
+
+#endif
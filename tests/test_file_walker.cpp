@@ -0,0 +1,153 @@
+#include "cppshell/file_walker.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace cppshell;
+
+namespace {
+
+void WriteFile(const std::filesystem::path &path, const std::string &text) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path, std::ios::binary) << text;
+}
+
+/** The files of `result` relative to `root`, sorted. */
+std::vector<std::string> Relative(const WalkResult &result,
+                                  const std::filesystem::path &root) {
+  std::vector<std::string> files;
+  for (const std::string &file : result.files) {
+    files.push_back(std::filesystem::path(file)
+                        .lexically_relative(root)
+                        .generic_string());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+} // namespace
+
+TEST_CASE("GlobMatch: shell globs") {
+  CHECK(GlobMatch("*.cpp", "grep.cpp"));
+  CHECK_FALSE(GlobMatch("*.cpp", "grep.hpp"));
+  CHECK_FALSE(GlobMatch("*.cpp", "src/grep.cpp"));
+  CHECK(GlobMatch("?.txt", "a.txt"));
+  CHECK_FALSE(GlobMatch("?.txt", "ab.txt"));
+  CHECK(GlobMatch("[a-c]x", "bx"));
+  CHECK_FALSE(GlobMatch("[!a-c]x", "bx"));
+  CHECK(GlobMatch("[^a-c]x", "dx"));
+  CHECK(GlobMatch("\\*", "*"));
+  CHECK_FALSE(GlobMatch("\\*", "a"));
+  CHECK(GlobMatch("src/**/*.cpp", "src/grep.cpp"));
+  CHECK(GlobMatch("src/**/*.cpp", "src/a/b/grep.cpp"));
+  CHECK(GlobMatch("**", "a/b/c"));
+  CHECK_FALSE(GlobMatch("src/**/*.cpp", "include/grep.cpp"));
+}
+
+TEST_CASE("IgnoreRules: the last matching rule decides") {
+  const IgnoreRules rules("# build output\n"
+                          "\n"
+                          "*.o\n"
+                          "!keep.o\n"
+                          "build/\n"
+                          "/top.txt\n"
+                          "docs/*.tmp\n");
+  using Verdict = IgnoreRules::Verdict;
+  CHECK(rules.Judge("main.o", false) == Verdict::kIgnore);
+  CHECK(rules.Judge("src/main.o", false) == Verdict::kIgnore);
+  CHECK(rules.Judge("src/keep.o", false) == Verdict::kKeep);
+  CHECK(rules.Judge("build", true) == Verdict::kIgnore);
+  CHECK(rules.Judge("src/build", true) == Verdict::kIgnore);
+  CHECK(rules.Judge("build", false) == Verdict::kNone);
+  CHECK(rules.Judge("top.txt", false) == Verdict::kIgnore);
+  CHECK(rules.Judge("src/top.txt", false) == Verdict::kNone);
+  CHECK(rules.Judge("docs/a.tmp", false) == Verdict::kIgnore);
+  CHECK(rules.Judge("src/docs/a.tmp", false) == Verdict::kNone);
+  CHECK(rules.Judge("main.cpp", false) == Verdict::kNone);
+  CHECK(IgnoreRules("# nothing\n\n").Empty());
+}
+
+TEST_CASE("WalkTree: filters, ignore files and thread counts") {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_walk_test";
+  std::filesystem::remove_all(root);
+  WriteFile(root / "a.cpp", "a");
+  WriteFile(root / "b.hpp", "b");
+  WriteFile(root / "notes.txt", "n");
+  WriteFile(root / "src" / "c.cpp", "c");
+  WriteFile(root / "src" / "gen" / "d.cpp", "d");
+  WriteFile(root / "src" / "gen" / "keep.cpp", "k");
+  WriteFile(root / "src" / ".ignore", "gen/*\n!keep.cpp\n");
+  WriteFile(root / ".git" / "config", "g");
+  for (int i = 0; i < 40; ++i) {
+    WriteFile(root / "many" / std::to_string(i % 7) /
+                  (std::to_string(i) + ".txt"),
+              "m");
+  }
+
+  WalkOptions options;
+  const WalkResult all = WalkTree(root.string(), options);
+  CHECK(all.errors.empty());
+  CHECK(all.files.size() == 48);
+
+  options.threads = 4;
+  CHECK(Relative(WalkTree(root.string(), options), root) ==
+        Relative(all, root));
+
+  options.sorted = true;
+  const WalkResult sorted = WalkTree(root.string(), options);
+  CHECK(std::is_sorted(sorted.files.begin(), sorted.files.end()));
+  CHECK(sorted.files.front() == (root / ".git" / "config").string());
+
+  WalkOptions filtered;
+  filtered.threads = 3;
+  filtered.include = {"*.cpp", "*.hpp"};
+  filtered.exclude = {"b.*"};
+  filtered.excludeDir = {".git", "many"};
+  filtered.ignoreFiles = {".ignore"};
+  CHECK(Relative(WalkTree(root.string(), filtered), root) ==
+        std::vector<std::string>{"a.cpp", "src/c.cpp", "src/gen/keep.cpp"});
+
+  const WalkResult missing = WalkTree((root / "missing").string(), options);
+  CHECK(missing.files.empty());
+  REQUIRE(missing.errors.size() == 1);
+  CHECK(missing.errors[0].starts_with((root / "missing").string() + ": "));
+
+  std::filesystem::remove_all(root);
+}
+
+#ifndef _WIN32
+TEST_CASE("WalkTree: symbolic links are followed only when asked") {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_walk_links";
+  std::filesystem::remove_all(root);
+  WriteFile(root / "inner" / "file.txt", "f");
+  WriteFile(root / "outside" / "other.txt", "o");
+  std::filesystem::create_directory_symlink(root, root / "inner" / "loop");
+  std::filesystem::create_directory_symlink(root / "outside",
+                                            root / "inner" / "out");
+  std::filesystem::create_symlink(root / "inner" / "file.txt",
+                                  root / "inner" / "alias.txt");
+
+  WalkOptions options;
+  options.threads = 2;
+  CHECK(Relative(WalkTree((root / "inner").string(), options),
+                 root / "inner") == std::vector<std::string>{"file.txt"});
+
+  // Every directory is entered once, so the loop ends.
+  options.followLinks = true;
+  const std::vector<std::string> followed =
+      Relative(WalkTree((root / "inner").string(), options), root / "inner");
+  CHECK(followed == std::vector<std::string>{"alias.txt", "file.txt",
+                                             "loop/outside/other.txt"} ||
+        followed == std::vector<std::string>{"alias.txt", "file.txt",
+                                             "out/other.txt"});
+
+  std::filesystem::remove_all(root);
+}
+#endif
@@ -1,7 +1,23 @@
 #include "cppshell/environment.hpp"
 #include "cppshell/grep_command.hpp"
+#include "cppshell/grep_matcher.hpp"
 #include "doctest/doctest.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include "cppshell/fd_stream.hpp"
+
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 using namespace cppshell;
 
@@ -140,3 +156,715 @@ TEST_CASE("GrepCommand") {
     CHECK_FALSE(err.str().empty());
   }
 }
+
+TEST_CASE("GrepCommand: parallel matching keeps the input order") {
+  // Several LineSource blocks, so chunks after the first reach the pool.
+  std::string input;
+  for (int i = 0; i < 60000; ++i) {
+    input += "line " + std::to_string(i) + (i % 3 == 0 ? "\r\n" : "\n");
+  }
+
+  auto run = [&](const std::string &threads) {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd({"7[0-9]*5"});
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    return out.str();
+  };
+
+  REQUIRE(input.size() > 4 * 64 * 1024);
+  const std::string serial = run("1");
+  CHECK_FALSE(serial.empty());
+  CHECK(run("4") == serial);
+  CHECK(run("13") == serial);
+}
+
+TEST_CASE("GrepCommand: parallel matching reports no match") {
+  std::string input;
+  for (int i = 0; i < 30000; ++i) {
+    input += "nothing to see on line " + std::to_string(i) + '\n';
+  }
+  std::stringstream in(input);
+  std::stringstream out;
+  std::stringstream err;
+  Environment env;
+  env.Set("CPPSHELL_THREADS", "4");
+  CommandStreams streams{in, out, err};
+  CommandContext ctx{streams, env};
+  GrepCommand cmd({"zebra"});
+  CHECK(cmd.Execute(ctx).exitCode == 1);
+  CHECK(out.str().empty());
+}
+
+TEST_CASE("GrepCommand: -F matches metacharacters literally") {
+  std::stringstream in("a.b\naxb\n(a+b)\nA.B\n");
+  std::stringstream out;
+  std::stringstream err;
+  Environment env;
+  CommandStreams streams{in, out, err};
+  CommandContext ctx{streams, env};
+  GrepCommand cmd({"-F", "-i", "a.b"});
+  CHECK(cmd.Execute(ctx).exitCode == 0);
+  CHECK(out.str() == "a.b\nA.B\n");
+  CHECK(err.str().empty());
+}
+
+TEST_CASE("GrepCommand: files searched in parallel keep argument order") {
+  // The third file selects more than a worker buffers ahead of its turn.
+  const auto dir = std::filesystem::temp_directory_path();
+  std::vector<std::string> files;
+  for (int f = 0; f < 7; ++f) {
+    files.push_back(
+        (dir / ("cppshell_grep_files_" + std::to_string(f) + ".txt")).string());
+    std::ofstream out(files.back(), std::ios::binary);
+    const int lines = f == 2 ? 150000 : 100 * f;
+    for (int i = 0; i < lines; ++i) {
+      out << "file " << f << " line " << i << (i % 5 == 0 ? "\r\n" : "\n");
+    }
+  }
+
+  auto run = [&](const std::string &threads, std::vector<std::string> args) {
+    std::stringstream in("stdin line 1\nstdin line 2\n");
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  std::vector<std::string> args = {"line [0-9]*[13579]$"};
+  args.insert(args.end(), files.begin(), files.begin() + 4);
+  args.push_back("-");
+  args.insert(args.end(), files.begin() + 4, files.end());
+  const std::string serial = run("1", args);
+  REQUIRE(serial.size() > 1024 * 1024);
+  CHECK(serial.starts_with("0\nfile 1 line 1\nfile 1 line 3\n"));
+  CHECK(serial.find("stdin line 1\nfile 4 line 1\n") != std::string::npos);
+  CHECK(run("4", args) == serial);
+  CHECK(run("16", args) == serial);
+
+  args.insert(args.begin() + 2, (dir / "cppshell_grep_missing.txt").string());
+  CHECK(run("4", args) == run("1", args));
+  CHECK(run("4", args).starts_with("0\ngrep: "));
+
+  for (const std::string option : {"-c", "-l", "-L", "-n"}) {
+    std::vector<std::string> modeArgs = args;
+    modeArgs.insert(modeArgs.begin(), option);
+    CHECK(run("4", modeArgs) == run("1", modeArgs));
+  }
+  CHECK(run("4", {"-l", "line", files[0], files[2], files[3]}) ==
+        "0\n" + files[2] + "\n" + files[3] + "\n");
+
+  CHECK(run("4", {"zebra", files[1], files[2]}) == "1\n");
+  CHECK(run("4", {"zebra", files[1], "cppshell_grep_missing.txt"}) ==
+        "2\ngrep: cppshell_grep_missing.txt: No such file or directory\n");
+
+  for (const auto &file : files) {
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+  }
+}
+
+TEST_CASE("GrepCommand: lines longer than memory holds are still printed") {
+  // Just over the 8 MiB a line may take in memory.
+  std::string longLine(9 * 1024 * 1024, 'a');
+  longLine[8 * 1024 * 1024 + 7] = 'X';
+  const std::string input = "short X\n" + longLine + "\r\nX end";
+
+  auto run = [&](std::vector<std::string> args) {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    CHECK(err.str().empty());
+    return out.str();
+  };
+
+  CHECK(run({"X"}) == "short X\n" + longLine + "\nX end\n");
+  CHECK(run({"-w", "X"}) == "short X\nX end\n");
+  CHECK(run({"a{3}X"}) == longLine + "\n");
+  CHECK(run({"-n", "X"}) ==
+        "1:short X\n2:" + longLine + "\n3:X end\n");
+  CHECK(run({"-vn", "-w", "X"}) == "2:" + longLine + "\n");
+}
+
+TEST_CASE("GrepCommand: -c, -l, -L, -q, -m, -n and -v") {
+  auto run = [](std::vector<std::string> args, const std::string &input,
+                const std::string &threads = "1") {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+  const std::string input = "x1\ny2\ny3\nx4\r\ny5\nx6";
+
+  CHECK(run({"-n", "x"}, input) == "0\n1:x1\n4:x4\n6:x6\n");
+  CHECK(run({"-v", "x"}, input) == "0\ny2\ny3\ny5\n");
+  CHECK(run({"-vn", "x"}, input) == "0\n2:y2\n3:y3\n5:y5\n");
+  CHECK(run({"-v", "."}, input) == "1\n");
+  CHECK(run({"-c", "x"}, input) == "0\n3\n");
+  CHECK(run({"-c", "-v", "x"}, input) == "0\n3\n");
+  CHECK(run({"-c", "z"}, input) == "1\n0\n");
+  CHECK(run({"-l", "x"}, input) == "0\n(standard input)\n");
+  CHECK(run({"-l", "z"}, input) == "1\n");
+  CHECK(run({"-L", "x"}, input) == "0\n");
+  CHECK(run({"-L", "z"}, input) == "1\n(standard input)\n");
+  CHECK(run({"-q", "y"}, input) == "0\n");
+  CHECK(run({"-q", "z"}, input) == "1\n");
+  // -q prints nothing, not even what -L and -c report without a match.
+  CHECK(run({"-q", "-L", "z"}, input) == "1\n");
+  CHECK(run({"-q", "-L", "z", "-", "-"}, input) == "1\n");
+  CHECK(run({"-q", "-c", "z"}, input) == "1\n");
+  CHECK(run({"-q", "-c", "x"}, input) == "0\n");
+  CHECK(run({"-m", "2", "-n", "x"}, input) == "0\n1:x1\n4:x4\n");
+  CHECK(run({"--max-count=1", "-c", "x"}, input) == "0\n1\n");
+  CHECK(run({"-m", "0", "x"}, input) == "1\n");
+  // Trailing context of the last line -m allows is still printed.
+  CHECK(run({"-m", "1", "-A", "2", "-n", "x"}, input) ==
+        "0\n1:x1\n2-y2\n3-y3\n");
+  CHECK(run({"-n", "-A", "1", "x1|y5"}, input) ==
+        "0\n1:x1\n2-y2\n--\n5:y5\n6-x6\n");
+  CHECK(run({"-v", "-A", "1", "y"}, input) == "0\nx1\ny2\n--\nx4\ny5\nx6\n");
+
+  // Blocks matched on the pool number and count their lines the same.
+  std::string large;
+  for (int i = 0; i < 100000; ++i) {
+    large += "line " + std::to_string(i) + (i % 7 == 0 ? " x\n" : "\n");
+  }
+  for (const std::vector<std::string> &args :
+       {std::vector<std::string>{"-n", "9 x"},
+        std::vector<std::string>{"-vn", "[0-8]$"},
+        std::vector<std::string>{"-c", "-v", "x"},
+        std::vector<std::string>{"-m", "5000", "x"}}) {
+    CAPTURE(args.front());
+    CHECK(run(args, large, "4") == run(args, large, "1"));
+  }
+  CHECK(run({"-n", "line 99995 x"}, large, "4") == "0\n99996:line 99995 x\n");
+  CHECK(run({"-c", "x"}, large, "4") == "0\n14286\n");
+}
+
+TEST_CASE("GrepCommand: each option combination selects the same lines") {
+  const auto path =
+      (std::filesystem::temp_directory_path() / "cppshell_grep_loops.txt")
+          .string();
+  const std::vector<std::string> lines = {
+      "ab",  "xAB y", "cab", "ab_1", "zz top", "no", "AB\r", "", "b a", "ab"};
+  std::string input;
+  for (const std::string &line : lines) {
+    input += line + (&line == &lines.back() ? "" : "\n");
+  }
+  std::ofstream(path, std::ios::binary) << input;
+
+  auto run = [](std::vector<std::string> args, const std::string &text) {
+    std::stringstream in(text);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", "1");
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+  // What grep should print, line by line: "ab" (a word under -w, any case
+  // under -i) or "zz" selects a line.
+  auto expect = [&](bool invert, bool numbers, bool count, bool fold,
+                    bool word, const std::string &prefix) {
+    const auto isWord = [](char c) {
+      return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+    };
+    std::string printed;
+    size_t selected = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+      std::string line = lines[i];
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      std::string folded = line;
+      for (char &c : folded) {
+        c = fold ? static_cast<char>(std::tolower(c)) : c;
+      }
+      bool match = line.find("zz") != std::string::npos;
+      for (size_t at = folded.find("ab"); at != std::string::npos;
+           at = folded.find("ab", at + 1)) {
+        match = match || !word ||
+                ((at == 0 || !isWord(line[at - 1])) &&
+                 (at + 2 == line.size() || !isWord(line[at + 2])));
+      }
+      if (match != invert) {
+        ++selected;
+        printed += prefix + (numbers ? std::to_string(i + 1) + ":" : "") +
+                   line + "\n";
+      }
+    }
+    if (count) {
+      printed = prefix + std::to_string(selected) + "\n";
+    }
+    return (selected > 0 ? "0\n" : "1\n") + printed;
+  };
+
+  const std::vector<std::vector<std::string>> patterns = {
+      {"-e", "ab", "-e", "zz"}, {"-e", "a[b]|zz"}, {"-e", "ab|zz"}};
+  for (int flags = 0; flags < 32; ++flags) {
+    const bool invert = (flags & 1) != 0;
+    const bool numbers = (flags & 2) != 0;
+    const bool count = (flags & 4) != 0;
+    const bool fold = (flags & 8) != 0;
+    const bool word = (flags & 16) != 0;
+    for (const std::vector<std::string> &pattern : patterns) {
+      std::vector<std::string> args = pattern;
+      for (const auto &[set, flag] :
+           {std::pair{invert, "-v"}, std::pair{numbers, "-n"},
+            std::pair{count, "-c"}, std::pair{fold, "-i"},
+            std::pair{word, "-w"}}) {
+        if (set) {
+          args.emplace_back(flag);
+        }
+      }
+      CAPTURE(flags);
+      CAPTURE(pattern[1]);
+      CHECK(run(args, input) ==
+            expect(invert, numbers, count, fold, word, ""));
+      args.emplace_back("-r");
+      args.push_back(path);
+      CHECK(run(args, "") ==
+            expect(invert, numbers, count, fold, word, path + ":"));
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("GrepCommand: -q, -l and -m stop reading once the answer is known") {
+  std::string input;
+  for (int i = 0; i < 200000; ++i) {
+    input += "record " + std::to_string(i) + '\n';
+  }
+  REQUIRE(input.size() > 2 * 1024 * 1024);
+
+  // Returns how far grep read its input.
+  auto consumed = [&](std::vector<std::string> args,
+                      const std::string &threads) {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    CHECK(cmd.Execute(ctx).exitCode == 0);
+    return in.eof() ? input.size() : static_cast<size_t>(in.tellg());
+  };
+
+  for (const std::string threads : {"1", "4"}) {
+    CAPTURE(threads);
+    CHECK(consumed({"-q", "record 1"}, threads) < 256 * 1024);
+    CHECK(consumed({"-l", "record 1"}, threads) < 256 * 1024);
+    CHECK(consumed({"-m", "3", "record 1"}, threads) < 256 * 1024);
+    // The first match is past the first blocks, which the pool reads ahead.
+    CHECK(consumed({"-q", "record 50000"}, threads) < input.size() / 2);
+    CHECK(consumed({"-c", "record 1"}, threads) == input.size());
+  }
+}
+
+TEST_CASE("GrepCommand: -B and -C print merged context around lines") {
+  auto run = [](std::vector<std::string> args, const std::string &input) {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+  const std::string input = "a\nb\nm1\nc\nd\ne\nm2\nf\nm3\ng\n";
+
+  CHECK(run({"-B", "1", "m"}, input) == "0\nb\nm1\n--\ne\nm2\nf\nm3\n");
+  CHECK(run({"-C", "1", "m"}, input) ==
+        "0\nb\nm1\nc\n--\ne\nm2\nf\nm3\ng\n");
+  CHECK(run({"-B", "5", "m1"}, input) == "0\na\nb\nm1\n");
+  CHECK(run({"-n", "-C", "1", "m"}, input) ==
+        "0\n2-b\n3:m1\n4-c\n--\n6-e\n7:m2\n8-f\n9:m3\n10-g\n");
+  // -A and -B win over -C in either order.
+  CHECK(run({"-C", "2", "-A", "0", "m1"}, input) == "0\na\nb\nm1\n");
+  CHECK(run({"-B", "0", "--context=1", "m1"}, input) == "0\nm1\nc\n");
+  CHECK(run({"-m", "1", "-C", "1", "m"}, input) == "0\nb\nm1\nc\n");
+  CHECK(run({"-c", "-C", "1", "m"}, input) == "0\n3\n");
+  CHECK(run({"-B", "-1", "m"}, input) ==
+        "2\ngrep: invalid context length argument\n");
+
+  // Leading context reaching back across several chunks of input.
+  std::vector<std::string> lines;
+  std::string large;
+  for (int i = 0; i < 300000; ++i) {
+    lines.push_back("line " + std::to_string(i));
+    large += lines.back() + "\n";
+  }
+  auto expected = [&](const std::string &suffix, size_t before,
+                      size_t after) {
+    std::vector<bool> shown(lines.size(), false);
+    for (size_t i = 0; i < lines.size(); ++i) {
+      if (lines[i].ends_with(suffix)) {
+        for (size_t k = i - std::min(i, before);
+             k <= std::min(lines.size() - 1, i + after); ++k) {
+          shown[k] = true;
+        }
+      }
+    }
+    std::string text = "0\n";
+    for (size_t i = 0; i < lines.size(); ++i) {
+      if (shown[i]) {
+        if (i > 0 && !shown[i - 1] && text != "0\n") {
+          text += "--\n";
+        }
+        text += lines[i] + "\n";
+      }
+    }
+    return text;
+  };
+  CHECK(run({"-B", "20000", "77777$"}, large) == expected("77777", 20000, 0));
+  CHECK(run({"-C", "3", "000$"}, large) == expected("000", 3, 3));
+  CHECK(run({"-B", "700", "-A", "300", "000$"}, large) ==
+        expected("000", 700, 300));
+}
+
+TEST_CASE("GrepCommand: -r searches directories and skips binary files") {
+  const auto root = std::filesystem::temp_directory_path() / "cppshell_grep_r";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "src" / "deep");
+  std::filesystem::create_directories(root / "build");
+  std::ofstream(root / "a.txt") << "alpha\nneedle one\n";
+  std::ofstream(root / "src" / "b.cpp") << "needle two\nbeta\nneedle three\n";
+  std::ofstream(root / "src" / "deep" / "c.cpp") << "gamma\n";
+  std::ofstream(root / "build" / "d.txt") << "needle built\n";
+  std::ofstream(root / "blob.bin", std::ios::binary)
+      << std::string("needle\0binary\n", 14);
+  std::ofstream(root / ".ignore") << "build/\n";
+
+  auto run = [&](const std::string &threads, std::vector<std::string> args) {
+    std::stringstream in("needle on stdin\n");
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  const std::string r = root.string() + "/";
+  CHECK(run("1", {"-r", "--sort=path", "needle", root.string()}) ==
+        "0\n" + r + "a.txt:needle one\n" + r + "build/d.txt:needle built\n" +
+            r + "src/b.cpp:needle two\n" + r + "src/b.cpp:needle three\n");
+  for (const std::string threads : {"1", "4"}) {
+    CHECK(run(threads, {"-rn", "--sort=path", "--ignore-file=.ignore",
+                        "needle", root.string()}) ==
+          "0\n" + r + "a.txt:2:needle one\n" + r + "src/b.cpp:1:needle two\n" +
+              r + "src/b.cpp:3:needle three\n");
+  }
+  CHECK(run("4", {"-rc", "--sort=path", "--include=*.cpp", "needle",
+                  root.string()}) ==
+        "0\n" + r + "src/b.cpp:2\n" + r + "src/deep/c.cpp:0\n");
+  CHECK(run("1", {"-rl", "--sort=path", "--exclude-dir=src", "--exclude=a.*",
+                  "needle", root.string()}) ==
+        "0\n" + r + "build/d.txt\n");
+  // Binary files are searched under -r only when asked to.
+  CHECK(run("4", {"-rl", "--binary-files=binary", "--sort=path",
+                  "--exclude-dir=src", "--exclude=a.*", "needle",
+                  root.string()}) ==
+        "0\n" + r + "blob.bin\n" + r + "build/d.txt\n");
+  CHECK(run("1", {"-rac", "--include=*.bin", "needle", root.string()}) ==
+        "0\n" + r + "blob.bin:1\n");
+  CHECK(run("1", {"-rL", "--include=*.bin", "needle", root.string()}) == "1\n");
+  CHECK(run("1", {"-r", "-A", "1", "needle two", root.string()}) ==
+        "0\n" + r + "src/b.cpp:needle two\n" + r + "src/b.cpp-beta\n");
+  // Non-directory operands are searched as they are, standard input too.
+  CHECK(run("1", {"-r", "needle", "-", (root / "a.txt").string()}) ==
+        "0\n(standard input):needle on stdin\n" + r + "a.txt:needle one\n");
+  CHECK(run("1", {"-r", "--sort=random", "needle"}) ==
+        "2\ngrep: invalid argument 'random' for --sort\n");
+  CHECK(run("1", {"-r", "zebra", root.string()}) == "1\n");
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("GrepCommand: -e and -f give several patterns") {
+  const auto dir = std::filesystem::temp_directory_path();
+  const std::string input = (dir / "cppshell_grep_e_input.txt").string();
+  const std::string list = (dir / "cppshell_grep_e_list.txt").string();
+  std::ofstream(input) << "user 17 ok\nuser 42 denied\nhost a1\nuser 99\n";
+  std::ofstream(list) << "42\r\nhost\n";
+
+  auto run = [&](const std::string &stdinText, std::vector<std::string> args) {
+    std::stringstream in(stdinText);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  CHECK(run("", {"-e", "17", "-e", "99", input}) ==
+        "0\nuser 17 ok\nuser 99\n");
+  CHECK(run("", {"--regexp=17", "-e", "a[0-9]", input}) ==
+        "0\nuser 17 ok\nhost a1\n");
+  CHECK(run("", {"-f", list, input}) == "0\nuser 42 denied\nhost a1\n");
+  CHECK(run("", {"-f", list, "-e", "ok$", "-c", input}) == "0\n3\n");
+  CHECK(run("", {"-v", "-f", list, input}) == "0\nuser 17 ok\nuser 99\n");
+  // Patterns from standard input leave nothing of it to search.
+  CHECK(run("99\n17\n", {"-f", "-", input}) == "0\nuser 17 ok\nuser 99\n");
+  CHECK(run("99\n", {"-f", "-"}) == "1\n");
+  // An empty pattern list selects nothing.
+  CHECK(run("", {"-f", "/dev/null", input}) == "1\n");
+  CHECK(run("", {"-f", (dir / "cppshell_grep_no_list").string(), input}) ==
+        "2\ngrep: " + (dir / "cppshell_grep_no_list").string() +
+            ": No such file or directory\n");
+  CHECK(run("", {"-c"}) == "2\ngrep: no pattern given\n");
+  CHECK(run("", {"-e", "("}).starts_with("2\ngrep: invalid regex: "));
+
+  std::filesystem::remove(input);
+  std::filesystem::remove(list);
+}
+
+TEST_CASE("GrepCommand: options are parsed GNU style") {
+  const std::string input = "alpha\nBeta\n-gamma\n";
+  auto run = [&](std::vector<std::string> args) {
+    std::stringstream in(input);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  CHECK(run({"-in", "beta"}) == "0\n2:Beta\n");
+  CHECK(run({"-ve", "^a", "-c"}) == "0\n2\n");
+  CHECK(run({"-ic", "A"}) == "0\n3\n");
+  CHECK(run({"-m1", "a"}) == "0\nalpha\n");
+  CHECK(run({"-A1", "alpha"}) == "0\nalpha\nBeta\n");
+  CHECK(run({"--max-count", "1", "a"}) == "0\nalpha\n");
+  CHECK(run({"a", "-", "-c"}) == "0\n3\n");
+  CHECK(run({"-c", "--", "-gamma"}) == "0\n1\n");
+  CHECK(run({"-e", "-gamma"}) == "0\n-gamma\n");
+
+  CHECK(run({"-x", "a"}) ==
+        "2\ngrep: invalid option -- 'x'\n"
+        "Usage: grep [OPTION]... PATTERN [FILE]...\n"
+        "Try 'grep --help' for more information.\n");
+  CHECK(run({"--colour", "a"}).starts_with(
+      "2\ngrep: unrecognized option '--colour'\nUsage: "));
+  CHECK(run({"a", "-A"}).starts_with(
+      "2\ngrep: option requires an argument -- 'A'\n"));
+  CHECK(run({"a", "--context"}).starts_with(
+      "2\ngrep: option '--context' requires an argument\n"));
+  CHECK(run({"--count=1", "a"}).starts_with(
+      "2\ngrep: option '--count' doesn't allow an argument\n"));
+  CHECK(run({"-m", "x", "a"}) == "2\ngrep: invalid max count\n");
+  CHECK(run({"-C", "2x", "a"}) ==
+        "2\ngrep: 2x: invalid context length argument\n");
+
+  const std::string help = run({"--help"});
+  CHECK(help.starts_with("0\nUsage: grep [OPTION]... PATTERN [FILE]...\n"));
+  CHECK(help.find("-i, --ignore-case") != std::string::npos);
+  CHECK(help.find("--exclude-dir=GLOB") != std::string::npos);
+}
+
+TEST_CASE("GrepCommand: repeated patterns come from the matcher cache") {
+  GrepMatcherCache &cache = GrepMatcherCache::Shared();
+  auto run = [](std::vector<std::string> args) {
+    std::stringstream in("one\ntwo\n");
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  const GrepMatcherCache::Stats before = cache.Statistics();
+  CHECK(run({"-i", "T[W]O"}) == "0\ntwo\n");
+  CHECK(run({"T[W]O", "-i"}) == "0\ntwo\n");
+  CHECK(run({"-i", "-w", "T[W]O"}) == "0\ntwo\n");
+  const GrepMatcherCache::Stats after = cache.Statistics();
+  CHECK(after.hits >= before.hits + 1);
+  CHECK(after.misses <= before.misses + 2);
+
+  const std::string stats = run({"--cache-stats", "-c", "one"});
+  CHECK(stats.starts_with("0\ngrep: pattern cache: "));
+  CHECK(stats.find(" hits, ") != std::string::npos);
+  CHECK(stats.ends_with(" entries\n1\n"));
+}
+
+TEST_CASE("GrepCommand: binary files and --binary-files") {
+  const auto dir = std::filesystem::temp_directory_path();
+  const std::string blob = (dir / "cppshell_grep_blob.bin").string();
+  const std::string latin = (dir / "cppshell_grep_latin1.txt").string();
+  std::ofstream(blob, std::ios::binary)
+      << std::string("header\0\x01\x02\nneedle 1\nneedle 2\n", 28);
+  std::ofstream(latin, std::ios::binary) << "caf\xE9 needle\n";
+
+  auto run = [&](const std::string &stdinText, std::vector<std::string> args) {
+    std::stringstream in(stdinText);
+    std::stringstream out;
+    std::stringstream err;
+    Environment env;
+    // Files after the first are searched ahead on the pool.
+    env.Set("CPPSHELL_THREADS", "4");
+    CommandStreams streams{in, out, err};
+    CommandContext ctx{streams, env};
+    GrepCommand cmd(std::move(args));
+    const int code = cmd.Execute(ctx).exitCode;
+    return std::to_string(code) + "\n" + err.str() + out.str();
+  };
+
+  CHECK(run("", {"needle", blob}) ==
+        "0\nBinary file " + blob + " matches\n");
+  CHECK(run("", {"-n", "-A", "1", "needle", blob}) ==
+        "0\nBinary file " + blob + " matches\n");
+  CHECK(run("", {"needle", latin}) ==
+        "0\nBinary file " + latin + " matches\n");
+  CHECK(run("", {"zebra", blob}) == "1\n");
+  CHECK(run("", {"needle", latin, blob, latin}) ==
+        "0\nBinary file " + latin + " matches\nBinary file " + blob +
+            " matches\nBinary file " + latin + " matches\n");
+  CHECK(run("", {"-a", "needle", blob, blob}) ==
+        "0\nneedle 1\nneedle 2\nneedle 1\nneedle 2\n");
+  // Counts and file names are not lines, so they are given as for text.
+  CHECK(run("", {"-c", "needle", blob}) == "0\n2\n");
+  CHECK(run("", {"-l", "needle", blob}) == "0\n" + blob + "\n");
+  CHECK(run("", {"--binary-files=text", "-n", "needle", blob}) ==
+        "0\n2:needle 1\n3:needle 2\n");
+  CHECK(run("", {"-a", "needle", latin}) == "0\ncaf\xE9 needle\n");
+  // -I takes binary files for files without selected lines.
+  CHECK(run("", {"-I", "needle", blob}) == "1\n");
+  CHECK(run("", {"--binary-files=without-match", "-c", "needle", blob}) ==
+        "1\n0\n");
+  CHECK(run("", {"-IL", "needle", blob, latin}) ==
+        "1\n" + blob + "\n" + latin + "\n");
+  CHECK(run("", {"--binary-files=maybe", "needle", blob}) ==
+        "2\ngrep: invalid argument 'maybe' for --binary-files\n");
+
+  // Standard input is judged the same way.
+  CHECK(run(std::string("\0needle\n", 8), {"needle"}) ==
+        "0\nBinary file (standard input) matches\n");
+  CHECK(run(std::string("\0needle\n", 8), {"-I", "needle"}) == "1\n");
+  CHECK(run("needle\n", {"-I", "needle"}) == "0\nneedle\n");
+
+  // The search of a binary file stops at its first selected line.
+  std::string large("\0", 1);
+  for (int i = 0; i < 200000; ++i) {
+    large += "record " + std::to_string(i) + '\n';
+  }
+  std::stringstream in(large);
+  std::stringstream out;
+  std::stringstream err;
+  Environment env;
+  env.Set("CPPSHELL_THREADS", "4");
+  CommandStreams streams{in, out, err};
+  CommandContext ctx{streams, env};
+  GrepCommand cmd({"record"});
+  CHECK(cmd.Execute(ctx).exitCode == 0);
+  CHECK(out.str() == "Binary file (standard input) matches\n");
+  CHECK_FALSE(in.eof());
+  CHECK(static_cast<size_t>(in.tellg()) < 256 * 1024);
+
+  std::filesystem::remove(blob);
+  std::filesystem::remove(latin);
+}
+
+#ifndef _WIN32
+namespace {
+
+/** Up to `size` bytes from `fd`, giving up after two quiet seconds. */
+std::string ReadWithin(int fd, size_t size) {
+  std::string data;
+  char buffer[256];
+  while (data.size() < size) {
+    pollfd ready{fd, POLLIN, 0};
+    if (::poll(&ready, 1, 2000) <= 0) {
+      break;
+    }
+    const ssize_t n =
+        ::read(fd, buffer, std::min(sizeof(buffer), size - data.size()));
+    if (n <= 0) {
+      break;
+    }
+    data.append(buffer, static_cast<size_t>(n));
+  }
+  return data;
+}
+
+} // namespace
+
+TEST_CASE("GrepCommand: lines are written before waiting for more input") {
+  // With workers, lines after the first are matched on the pool.
+  for (const char *threads : {"1", "4"}) {
+    CAPTURE(threads);
+    int in[2];
+    int out[2];
+    REQUIRE(::pipe(in) == 0);
+    REQUIRE(::pipe(out) == 0);
+    Environment env;
+    env.Set("CPPSHELL_THREADS", threads);
+    int code = -1;
+    std::thread grep([&] {
+      FdReadBuffer inBuffer(in[0], true);
+      FdWriteBuffer outBuffer(out[1], true);
+      std::istream input(&inBuffer);
+      std::ostream output(&outBuffer);
+      std::ostringstream err;
+      CommandStreams streams{input, output, err};
+      CommandContext ctx{streams, env};
+      GrepCommand cmd({"o"});
+      code = cmd.Execute(ctx).exitCode;
+    });
+
+    // Each line is fed only once the previous match came out.
+    for (const std::string_view line :
+         {"foo\n", "bar\n", "boo\n", "moo\n", "zoo\n"}) {
+      REQUIRE(::write(in[1], line.data(), line.size()) ==
+              static_cast<ssize_t>(line.size()));
+      if (line != "bar\n") {
+        CHECK(ReadWithin(out[0], line.size()) == line);
+      }
+    }
+    ::close(in[1]);
+    grep.join();
+    CHECK(code == 0);
+    CHECK(ReadWithin(out[0], 1) == "");
+    ::close(out[0]);
+  }
+}
+#endif
@@ -0,0 +1,427 @@
+#include "cppshell/binary_detect.hpp"
+#include "cppshell/grep_matcher.hpp"
+#include "cppshell/literal_search.hpp"
+#include "cppshell/multi_literal_search.hpp"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Reference search: first `needle` at or after `from`, ASCII-folded. */
+[[nodiscard]] size_t NaiveFind(const std::string &haystack,
+                               const std::string &needle, size_t from,
+                               bool ignoreCase) {
+  auto fold = [&](char c) {
+    return ignoreCase ? static_cast<char>(std::tolower(c)) : c;
+  };
+  for (size_t i = from; i + needle.size() <= haystack.size(); ++i) {
+    size_t j = 0;
+    while (j < needle.size() && fold(haystack[i + j]) == fold(needle[j])) {
+      ++j;
+    }
+    if (j == needle.size()) {
+      return i;
+    }
+  }
+  return std::string::npos;
+}
+
+/** A chunk holding `text` split into lines. */
+[[nodiscard]] cppshell::LineChunk MakeChunk(const std::string &text) {
+  cppshell::LineChunk chunk;
+  chunk.data = std::make_shared<const std::string>(text);
+  size_t start = 0;
+  while (start < text.size()) {
+    const size_t nl = text.find('\n', start);
+    const size_t end = nl == std::string::npos ? text.size() : nl + 1;
+    chunk.lines.push_back({start, end - start});
+    start = end;
+  }
+  return chunk;
+}
+
+[[nodiscard]] std::vector<size_t>
+Match(const std::string &pattern, const cppshell::GrepPatternOptions &options,
+      const cppshell::LineChunk &chunk) {
+  const cppshell::GrepMatcher matcher(pattern, options);
+  REQUIRE(matcher.Ok());
+  std::vector<size_t> out;
+  matcher.MatchLines(chunk, out);
+  return out;
+}
+
+} // namespace
+
+TEST_CASE("LiteralSearcher: agrees with a naive search") {
+  std::mt19937 rng(7);
+  // A small alphabet makes partial matches around block edges common.
+  const std::string alphabet = "abAB-_\n";
+  for (int round = 0; round < 300; ++round) {
+    std::string haystack(rng() % 80, ' ');
+    for (char &c : haystack) {
+      c = alphabet[rng() % alphabet.size()];
+    }
+    std::string needle(1 + rng() % 4, ' ');
+    for (char &c : needle) {
+      c = alphabet[rng() % (alphabet.size() - 1)];
+    }
+    const bool ignoreCase = round % 2 == 1;
+    const cppshell::LiteralSearcher searcher(needle, ignoreCase);
+    for (size_t from = 0; from <= haystack.size(); from += 7) {
+      CAPTURE(haystack);
+      CAPTURE(needle);
+      CAPTURE(from);
+      CHECK(searcher.Find(haystack, from) ==
+            NaiveFind(haystack, needle, from, ignoreCase));
+    }
+  }
+}
+
+TEST_CASE("LiteralSearcher: folds only ASCII letters") {
+  const cppshell::LiteralSearcher searcher("Error@[x]", true);
+  CHECK(searcher.Find("....error@[X]") == 4);
+  // '@' | 0x20 is '`' and '[' | 0x20 is '{': these must not match.
+  CHECK(searcher.Find("ERROR`{X]") == std::string_view::npos);
+  CHECK(cppshell::LiteralSearcher("", false).Find("abc", 2) == 2);
+  CHECK(cppshell::LiteralSearcher("abc", false).Find("ab", 0) ==
+        std::string_view::npos);
+}
+
+TEST_CASE("GrepMatcher: literal patterns take the fast path") {
+  CHECK(cppshell::GrepMatcher("ERROR", {}).Literal());
+  CHECK(cppshell::GrepMatcher("a\\.b", {}).Literal());
+  CHECK_FALSE(cppshell::GrepMatcher("a.b", {}).Literal());
+  CHECK_FALSE(cppshell::GrepMatcher("\\bword", {}).Literal());
+  CHECK(cppshell::GrepMatcher("a.b", {.fixedStrings = true}).Literal());
+  CHECK_FALSE(cppshell::GrepMatcher("(", {}).Ok());
+  CHECK(cppshell::GrepMatcher("(", {.fixedStrings = true}).Ok());
+}
+
+TEST_CASE("GrepMatcher: literal and regex paths select the same lines") {
+  const cppshell::LineChunk chunk = MakeChunk(
+      "an error here\nERROR: disk\nerrors\nterror\n_error_\nerror\r\n"
+      "no match\n-error-\nerror.log\nerrorerror error\n");
+  for (const bool ignoreCase : {false, true}) {
+    for (const bool word : {false, true}) {
+      CAPTURE(ignoreCase);
+      CAPTURE(word);
+      const cppshell::GrepPatternOptions options{.ignoreCase = ignoreCase,
+                                                 .wordRegexp = word};
+      // "[e]rror" means the same but is not a literal.
+      CHECK(cppshell::GrepMatcher("error", options).Literal());
+      CHECK_FALSE(cppshell::GrepMatcher("[e]rror", options).Literal());
+      CHECK(Match("error", options, chunk) == Match("[e]rror", options, chunk));
+    }
+  }
+  CHECK(Match("error", {.wordRegexp = true}, chunk) ==
+        std::vector<size_t>{0, 5, 7, 8, 9});
+}
+
+TEST_CASE("GrepMatcher: matches never span lines") {
+  const cppshell::LineChunk chunk = MakeChunk("ab\ncd\nab\r\ncd\n");
+  CHECK(Match("b\nc", {.fixedStrings = true}, chunk).empty());
+  CHECK(Match("b\rc", {.fixedStrings = true}, chunk).empty());
+  CHECK(Match("", {.fixedStrings = true}, chunk) ==
+        std::vector<size_t>{0, 1, 2, 3});
+}
+
+TEST_CASE("GrepMatcher: lines forwarded from elsewhere are searched too") {
+  // Spans that are not adjacent in the buffer form separate runs.
+  cppshell::LineChunk chunk;
+  chunk.data = std::make_shared<const std::string>("xx\nkey\nyy\nkey two\n");
+  chunk.lines = {{10, 8}, {3, 4}, {0, 3}};
+  CHECK(Match("key", {}, chunk) == std::vector<size_t>{0, 1});
+}
+
+TEST_CASE("GrepMatcher: blocks select the same lines as chunks") {
+  const std::string text =
+      "an error here\nERROR: disk\nerrors\nterror\n_error_\nerror\r\n"
+      "\nno match\n-error-\nerror.log\nerrorerror error\nlast error";
+  const cppshell::LineChunk chunk = MakeChunk(text);
+  for (const char *pattern : {"error", "[e]rror", "r\\.l", "^e", "r$", ""}) {
+    for (const bool ignoreCase : {false, true}) {
+      for (const bool word : {false, true}) {
+        CAPTURE(pattern);
+        CAPTURE(ignoreCase);
+        CAPTURE(word);
+        const cppshell::GrepMatcher matcher(
+            pattern, {.ignoreCase = ignoreCase, .wordRegexp = word});
+        REQUIRE(matcher.Ok());
+        std::vector<size_t> lines;
+        matcher.MatchLines(chunk, lines);
+        std::vector<cppshell::LineSpan> spans;
+        matcher.MatchBlock(text, spans);
+        REQUIRE(spans.size() == lines.size());
+        for (size_t i = 0; i < spans.size(); ++i) {
+          CHECK(spans[i].offset == chunk.lines[lines[i]].offset);
+          CHECK(spans[i].size == chunk.lines[lines[i]].size);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("GrepMatcher: lines fed in pieces are judged like whole lines") {
+  std::mt19937 rng(11);
+  const std::string alphabet = "ab_ -";
+  for (int round = 0; round < 400; ++round) {
+    std::string line(rng() % 40, ' ');
+    for (char &c : line) {
+      c = alphabet[rng() % alphabet.size()];
+    }
+    const char *pattern =
+        round % 3 == 0 ? "ab" : (round % 3 == 1 ? "a_b" : "b+a");
+    const bool word = round % 2 == 1;
+    const cppshell::GrepMatcher matcher(
+        pattern, {.ignoreCase = round % 5 == 0, .wordRegexp = word});
+    REQUIRE(matcher.Streams());
+
+    std::vector<size_t> whole;
+    matcher.MatchLines(MakeChunk(line), whole);
+    cppshell::GrepMatcher::LineFeed feed(matcher);
+    for (size_t pos = 0; pos < line.size();) {
+      const size_t size = rng() % 5;
+      static_cast<void>(feed.Feed(std::string_view(line).substr(pos, size)));
+      pos += size;
+    }
+    CAPTURE(line);
+    CAPTURE(pattern);
+    CAPTURE(word);
+    CHECK(feed.End() == (line.empty() ? !whole.empty() : whole.size() == 1));
+  }
+  CHECK_FALSE(cppshell::GrepMatcher("(a)\\1", {}).Streams());
+}
+
+namespace {
+
+/** Returns true if `needle` occurs in `line` as a whole word, naively. */
+[[nodiscard]] bool NaiveWord(const std::string &line, const std::string &needle,
+                             bool ignoreCase) {
+  const auto word = [&](size_t i) {
+    return i < line.size() && (std::isalnum(static_cast<unsigned char>(
+                                   line[i])) != 0 ||
+                               line[i] == '_');
+  };
+  for (size_t at = NaiveFind(line, needle, 0, ignoreCase);
+       at != std::string::npos;
+       at = NaiveFind(line, needle, at + 1, ignoreCase)) {
+    const size_t end = at + needle.size();
+    if ((at > 0 && word(at - 1)) != word(at) &&
+        (end > 0 && word(end - 1)) != word(end)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+TEST_CASE("MultiLiteralSearcher: agrees with a naive search") {
+  std::mt19937 rng(5);
+  for (int round = 0; round < 300; ++round) {
+    // Large sets over many bytes reach past the states that get a full
+    // DFA row.
+    const bool large = round % 50 == 0;
+    const std::string alphabet =
+        large ? "abcdefghijklmnopqrstuvwxyz"
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-"
+              : "abcAB_-";
+    std::vector<std::string> needles(large ? 5000 : 1 + rng() % 30);
+    for (std::string &needle : needles) {
+      needle.resize(1 + rng() % (large ? 9 : 4));
+      for (char &c : needle) {
+        c = alphabet[rng() % alphabet.size()];
+      }
+    }
+    const bool ignoreCase = round % 2 == 1;
+    const cppshell::MultiLiteralSearcher searcher(needles, ignoreCase);
+    for (int line = 0; line < 5; ++line) {
+      std::string haystack(rng() % 60, ' ');
+      for (char &c : haystack) {
+        c = alphabet[rng() % alphabet.size()];
+      }
+      if (large && line % 2 == 0) {
+        haystack.insert(haystack.size() / 2, needles[rng() % needles.size()]);
+      }
+      CAPTURE(haystack);
+      CAPTURE(round);
+      size_t end = std::string::npos;
+      bool word = false;
+      for (const std::string &needle : needles) {
+        const size_t at = NaiveFind(haystack, needle, 3, ignoreCase);
+        if (at != std::string::npos) {
+          end = std::min(end, at + needle.size());
+        }
+        word = word || NaiveWord(haystack, needle, ignoreCase);
+      }
+      CHECK(searcher.FindEnd(haystack, 3) == end);
+      const bool any = std::any_of(
+          needles.begin(), needles.end(), [&](const std::string &needle) {
+            return NaiveFind(haystack, needle, 0, ignoreCase) !=
+                   std::string::npos;
+          });
+      CHECK(searcher.Contains(haystack, false) == any);
+      CHECK(searcher.Contains(haystack, true) == word);
+
+      uint32_t state = cppshell::MultiLiteralSearcher::kStart;
+      bool fed = false;
+      for (size_t pos = 0; pos < haystack.size() && !fed; pos += 3) {
+        fed = searcher.Feed(state, std::string_view(haystack).substr(pos, 3));
+      }
+      CHECK(fed == any);
+    }
+  }
+  const cppshell::MultiLiteralSearcher none({}, false);
+  CHECK(none.FindEnd("abc") == std::string_view::npos);
+  CHECK_FALSE(none.Contains("abc", false));
+  const cppshell::MultiLiteralSearcher empty({"x", ""}, false);
+  CHECK(empty.Size() == 2);
+  CHECK(empty.FindEnd("abc", 1) == 1);
+  CHECK(empty.Contains("abc", false));
+  CHECK_FALSE(empty.Contains("abc", true));
+}
+
+TEST_CASE("GrepMatcher: several patterns select lines any of them match") {
+  const std::string text =
+      "an error here\nWARN: disk\nerrors\nfatal\n_error_\nwarning\r\n"
+      "\nno match\n-error-\naaa.log\nabcabc\nlast error";
+  const cppshell::LineChunk chunk = MakeChunk(text);
+  // Each set against the lines each of its patterns selects alone.
+  const std::vector<std::vector<std::string>> sets = {
+      {"error", "warn"},
+      {"error", "warn", "fatal", "log"},
+      {"error", "^f", "g$"},
+      {"(abc)\\1", "WARN", "a+\\.log"},
+      {"^$", "disk"},
+      {"", "error"},
+  };
+  for (const auto &patterns : sets) {
+    for (const bool ignoreCase : {false, true}) {
+      for (const bool word : {false, true}) {
+        CAPTURE(patterns.front());
+        CAPTURE(ignoreCase);
+        CAPTURE(word);
+        const cppshell::GrepPatternOptions options{.ignoreCase = ignoreCase,
+                                                   .wordRegexp = word};
+        const cppshell::GrepMatcher matcher(patterns, options);
+        REQUIRE(matcher.Ok());
+        std::vector<size_t> expected;
+        for (const std::string &pattern : patterns) {
+          const std::vector<size_t> one = Match(pattern, options, chunk);
+          expected.insert(expected.end(), one.begin(), one.end());
+        }
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()),
+                       expected.end());
+
+        std::vector<size_t> lines;
+        matcher.MatchLines(chunk, lines);
+        CHECK(lines == expected);
+        std::vector<cppshell::LineSpan> spans;
+        matcher.MatchBlock(text, spans);
+        REQUIRE(spans.size() == expected.size());
+        for (size_t i = 0; i < spans.size(); ++i) {
+          CHECK(spans[i].offset == chunk.lines[expected[i]].offset);
+        }
+      }
+    }
+  }
+
+  CHECK(cppshell::GrepMatcher(std::vector<std::string>{"a", "b"}, {})
+            .MultiLiteral());
+  CHECK(cppshell::GrepMatcher(std::vector<std::string>{"a", "b."}, {})
+            .Automaton());
+  CHECK(cppshell::GrepMatcher(std::vector<std::string>{"a"}, {}).Literal());
+  CHECK_FALSE(
+      cppshell::GrepMatcher(std::vector<std::string>{"a", "("}, {}).Ok());
+  const cppshell::GrepMatcher none(std::vector<std::string>{}, {});
+  REQUIRE(none.Ok());
+  std::vector<size_t> lines;
+  none.MatchLines(chunk, lines);
+  CHECK(lines.empty());
+
+  // Literals and the automaton both follow a line fed in pieces.
+  const cppshell::GrepMatcher mixed(std::vector<std::string>{"xyz", "a+b"},
+                                    {});
+  REQUIRE(mixed.Streams());
+  for (const std::string line : {"--xy", "--x", "yz--", "--aaa", "ab"}) {
+    cppshell::GrepMatcher::LineFeed feed(mixed);
+    static_cast<void>(feed.Feed("--x"));
+    static_cast<void>(feed.Feed(line));
+    CAPTURE(line);
+    CHECK(feed.End() == (line == "yz--" || line == "ab"));
+  }
+  CHECK_FALSE(
+      cppshell::GrepMatcher(std::vector<std::string>{"a", "b"},
+                            {.wordRegexp = true})
+          .Streams());
+}
+
+TEST_CASE("GrepMatcherCache: keeps the most recently used matchers") {
+  using Patterns = std::vector<std::string>;
+  cppshell::GrepMatcherCache cache(2);
+  const auto foo = cache.Get(Patterns{"foo"}, {});
+  CHECK(cache.Get(Patterns{"foo"}, {}) == foo);
+  // Options and the split into patterns are part of the key.
+  CHECK(cache.Get(Patterns{"foo"}, {.ignoreCase = true}) != foo);
+  CHECK(cache.Get(Patterns{"fo", "o"}, {}) != foo);
+  cppshell::GrepMatcherCache::Stats stats = cache.Statistics();
+  CHECK(stats.hits == 1);
+  CHECK(stats.misses == 3);
+  CHECK(stats.evictions == 1);
+  CHECK(stats.entries == 2);
+
+  // A lookup makes "-i foo" the most recent, so "fo|o" goes next.
+  static_cast<void>(cache.Get(Patterns{"foo"}, {.ignoreCase = true}));
+  static_cast<void>(cache.Get(Patterns{"bar"}, {}));
+  CHECK(cache.Statistics().hits == 2);
+  static_cast<void>(cache.Get(Patterns{"foo"}, {.ignoreCase = true}));
+  CHECK(cache.Statistics().hits == 3);
+
+  // Patterns that do not compile are kept with their error.
+  const auto bad = cache.Get(Patterns{"("}, {});
+  CHECK_FALSE(bad->Ok());
+  CHECK(cache.Get(Patterns{"("}, {}) == bad);
+
+  cache.SetCapacity(0);
+  CHECK(cache.Statistics().entries == 0);
+  CHECK(cache.Get(Patterns{"("}, {}) != bad);
+  CHECK(cache.Statistics().entries == 0);
+}
+
+TEST_CASE("LooksBinary: NUL bytes and bytes that are not UTF-8") {
+  CHECK_FALSE(cppshell::LooksBinary(""));
+  const std::vector<std::string> text = {
+      "plain text\n", "caf\xC3\xA9", "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2",
+      "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF"};
+  const std::vector<std::string> binary = {
+      std::string("a\0b", 3), "caf\xE9 au lait", "\x80", "\xC0\x80",
+      "\xC1\xBF", "\xE0\x80\x80", "\xED\xA0\x80", "\xF0\x80\x80\x80",
+      "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\xE2\x82x"};
+  // Every offset around the 16-byte steps of the vector scan.
+  for (size_t pad = 0; pad < 40; ++pad) {
+    const std::string ascii(pad, 'x');
+    for (const std::string &sample : text) {
+      CAPTURE(pad);
+      CAPTURE(sample);
+      CHECK_FALSE(cppshell::LooksBinary(ascii + sample));
+      CHECK_FALSE(cppshell::LooksBinary(ascii + sample + "\n" + ascii));
+    }
+    // A sequence cut off by the end of the block is not held against it.
+    CHECK_FALSE(cppshell::LooksBinary(ascii + "\xE2\x82"));
+    CHECK_FALSE(cppshell::LooksBinary(ascii + "\xF0\x9F\x98"));
+    for (const std::string &sample : binary) {
+      CAPTURE(pad);
+      CAPTURE(sample);
+      CHECK(cppshell::LooksBinary(ascii + sample));
+      CHECK(cppshell::LooksBinary(ascii + sample + ascii));
+    }
+  }
+}
@@ -0,0 +1,183 @@
+#include "cppshell/builtins.hpp"
+#include "cppshell/wc_command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+#include "cppshell/line_channel.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+TEST_CASE("LineSource: splits a stream into complete lines") {
+  std::istringstream in("one\ntwo\nthree");
+  cppshell::LineSource source(in);
+
+  std::vector<std::string> lines;
+  while (const auto chunk = source.Next()) {
+    for (size_t i = 0; i < chunk->lines.size(); ++i) {
+      lines.emplace_back(chunk->Line(i));
+    }
+  }
+
+  REQUIRE(lines.size() == 3);
+  CHECK(lines[0] == "one\n");
+  CHECK(lines[1] == "two\n");
+  CHECK(lines[2] == "three");
+}
+
+TEST_CASE("BlockReader: blocks end at lines, long lines come in pieces") {
+  std::string input;
+  for (int i = 0; i < 2000; ++i) {
+    input += "line " + std::to_string(i) + '\n';
+  }
+  const std::string longLine(5000, 'x');
+  input += longLine + "\nafter\n" + longLine;
+
+  std::istringstream in(input);
+  cppshell::BlockReader reader(in, 256, 1024);
+  std::string joined;
+  std::string pieces;
+  int longLines = 0;
+  while (true) {
+    const cppshell::BlockReader::Block block = reader.Next();
+    if (block.data == nullptr) {
+      break;
+    }
+    joined += *block.data;
+    if (!block.longLine) {
+      REQUIRE_FALSE(block.data->empty());
+      // Only the last block may end without a '\n'.
+      CHECK((block.data->back() == '\n' || joined.size() == input.size()));
+      CHECK(block.data->size() <= 1024 + 256);
+      continue;
+    }
+    CHECK(block.data->size() <= 1024 + 256);
+    pieces += *block.data;
+    if (block.lineEnds) {
+      ++longLines;
+      CHECK(pieces.starts_with(longLine));
+      CHECK(pieces.size() <= longLine.size() + 1);
+      pieces.clear();
+    }
+  }
+  CHECK(joined == input);
+  CHECK(longLines == 2);
+}
+
+TEST_CASE("LineSink: forwarded lines share the source buffer") {
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+  const cppshell::Environment env;
+  cppshell::CommandStreams streams{in, out, err};
+  cppshell::CommandContext ctx{streams, env};
+  cppshell::BlockingLineChannel channel;
+  ctx.outChannel = &channel;
+
+  auto chunk = std::make_shared<cppshell::LineChunk>();
+  chunk->data = std::make_shared<const std::string>("a\nb\nc\n");
+  chunk->lines = {{0, 2}, {2, 2}, {4, 2}};
+
+  {
+    cppshell::LineSink sink(ctx);
+    sink.Forward(chunk, 0);
+    sink.Forward(chunk, 2);
+    sink.WriteLine("own");
+  }
+  channel.Close();
+
+  const auto first = channel.Pop();
+  REQUIRE(first != nullptr);
+  CHECK(first->data == chunk->data);
+  REQUIRE(first->lines.size() == 2);
+  CHECK(first->Line(1) == "c\n");
+
+  const auto second = channel.Pop();
+  REQUIRE(second != nullptr);
+  CHECK(second->Line(0) == "own\n");
+  CHECK(channel.Pop() == nullptr);
+  CHECK(out.str().empty());
+
+  // A range of lines goes to a stream as they are.
+  ctx.outChannel = nullptr;
+  {
+    cppshell::LineSink sink(ctx);
+    sink.Forward(chunk, 1, 3);
+    sink.Forward(chunk, 0, 0);
+  }
+  CHECK(out.str() == "b\nc\n");
+}
+
+TEST_CASE("LineChannel: closed reader releases a blocked writer") {
+  cppshell::BlockingLineChannel channel(1);
+  auto chunk = std::make_shared<cppshell::LineChunk>();
+  chunk->data = std::make_shared<const std::string>("x\n");
+  chunk->lines = {{0, 2}};
+
+  REQUIRE(channel.Push(chunk));
+  std::thread reader([&] { channel.CloseReader(); });
+  CHECK_FALSE(channel.Push(chunk)); // Would block forever otherwise.
+  reader.join();
+}
+
+TEST_CASE("Builtins exchange lines through channels") {
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+  const cppshell::Environment env;
+  cppshell::CommandStreams streams{in, out, err};
+
+  cppshell::BlockingLineChannel catToGrep;
+  cppshell::BlockingLineChannel grepToWc;
+
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto a = dir / "cppshell_channel_a.txt";
+  const auto b = dir / "cppshell_channel_b.txt";
+  {
+    std::ofstream fa(a, std::ios::binary);
+    fa << "apple pie\nbanana spl";
+    std::ofstream fb(b, std::ios::binary);
+    fb << "it\ncherry apple\r\nplum\n";
+  }
+
+  cppshell::CatCommand cat({a.string(), b.string()});
+  cppshell::GrepCommand grep({"p"});
+  cppshell::WcCommand wc({});
+
+  std::thread catThread([&] {
+    cppshell::CommandContext ctx{streams, env};
+    ctx.outChannel = &catToGrep;
+    CHECK(cat.Execute(ctx).exitCode == 0);
+    catToGrep.Close();
+  });
+  std::thread grepThread([&] {
+    cppshell::CommandContext ctx{streams, env};
+    ctx.inChannel = &catToGrep;
+    ctx.outChannel = &grepToWc;
+    CHECK(grep.Execute(ctx).exitCode == 0);
+    grepToWc.Close();
+    catToGrep.CloseReader();
+  });
+
+  std::thread wcThread([&] {
+    cppshell::CommandContext ctx{streams, env};
+    ctx.inChannel = &grepToWc;
+    CHECK(wc.Execute(ctx).exitCode == 0);
+  });
+
+  catThread.join();
+  grepThread.join();
+  wcThread.join();
+
+  // The line split across the two files is joined and grep strips "\r":
+  // "apple pie", "banana split", "cherry apple", "plum".
+  CHECK(out.str() == "4 7 41\n");
+  CHECK(err.str().empty());
+
+  std::error_code ec;
+  std::filesystem::remove(a, ec);
+  std::filesystem::remove(b, ec);
+}
@@ -0,0 +1,203 @@
+#include "cppshell/optimizer.hpp"
+#include "cppshell/parser.hpp"
+#include "cppshell/shell.hpp"
+
+#include "pipeline_runner.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using cppshell::testing::RunResult;
+
+namespace {
+
+[[nodiscard]] cppshell::Pipeline Optimize(const std::string &line) {
+  const cppshell::ParseResult parsed = cppshell::ParseLine(line);
+  REQUIRE(parsed.Ok());
+  REQUIRE(parsed.pipeline.has_value());
+  return cppshell::OptimizePipeline(*parsed.pipeline);
+}
+
+[[nodiscard]] std::string Plan(const std::string &line) {
+  return cppshell::FormatPipeline(Optimize(line));
+}
+
+/** Runs `script` through a non-interactive shell. */
+[[nodiscard]] RunResult RunShell(const std::string &script, bool optimize) {
+  std::istringstream in(std::string("CPPSHELL_OPTIMIZE=") +
+                        (optimize ? "1" : "0") + "\n" + script);
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Shell shell;
+
+  RunResult r;
+  r.exitCode = shell.Run(in, out, err, false);
+  r.out = out.str();
+  r.err = err.str();
+  return r;
+}
+
+/** Checks that `script` behaves identically with and without the optimizer. */
+void CheckEquivalent(const std::string &script) {
+  CAPTURE(script);
+  const RunResult plain = RunShell(script, false);
+  const RunResult optimized = RunShell(script, true);
+  CHECK(optimized.out == plain.out);
+  CHECK(optimized.err == plain.err);
+  CHECK(optimized.exitCode == plain.exitCode);
+}
+
+/** A small text file removed at the end of the test. */
+class TempFile {
+public:
+  TempFile(const std::string &name, const std::string &data)
+      : path_(std::filesystem::temp_directory_path() / name) {
+    std::ofstream f(path_, std::ios::binary);
+    f << data;
+  }
+
+  ~TempFile() {
+    std::error_code ec;
+    std::filesystem::remove(path_, ec);
+  }
+
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+
+  [[nodiscard]] std::string Path() const { return path_.string(); }
+
+private:
+  std::filesystem::path path_;
+};
+
+} // namespace
+
+TEST_CASE("Optimizer: file argument moves into the consumer") {
+  const TempFile file("cppshell_opt_push.txt", "alpha\nbeta\ngamma\n");
+  const std::string f = file.Path();
+
+  CHECK(Plan("cat " + f + " | grep -i B") == "grep -i B " + f);
+  CHECK(Plan("cat " + f + " | grep -F a.") == "grep -F a. " + f);
+  CHECK(Plan("cat " + f + " | wc") == "wc " + f);
+  CHECK(Plan("cat " + f + " | grep -A 1 a | cat | wc") ==
+        "[grep -A 1 a " + f + " | wc]");
+  CHECK(Plan("cat " + f + " | grep -v -n -m 1 a") ==
+        "grep -v -n -m 1 a " + f);
+  CHECK(Plan("cat " + f + " | grep -B 1 -C 2 m") == "grep -B 1 -C 2 m " + f);
+  CHECK(Plan("cat " + f + " | grep -e a -e b") == "grep -e a -e b " + f);
+  CHECK(Plan("cat " + f + " | grep -f " + f) == "grep -f " + f + " " + f);
+
+  CheckEquivalent("cat " + f + " | grep -i B\n");
+  CheckEquivalent("cat " + f + " | wc\n");
+  CheckEquivalent("cat " + f + " | grep zzz\n");
+  CheckEquivalent("cat " + f + " | grep -A 1 a | cat | wc\n");
+  CheckEquivalent("echo ignored | cat " + f + " | grep a\n");
+  CheckEquivalent("cat " + f + " | grep -v -n -m 1 a\n");
+  CheckEquivalent("cat " + f + " | grep -c a\n");
+  CheckEquivalent("cat " + f + " | grep -e a -e b\n");
+}
+
+TEST_CASE("Optimizer: file argument stays when behaviour could change") {
+  const TempFile file("cppshell_opt_keep.txt", "alpha\nbeta\n");
+  const std::string f = file.Path();
+
+  // Missing file: cat's error message and exit status must be preserved.
+  CHECK(Plan("cat cppshell_opt_missing.txt | wc") ==
+        "cat cppshell_opt_missing.txt | wc");
+  // Several files, grep that already has a file, or a consumer reading
+  // another input are not equivalent to a single file argument.
+  CHECK(Plan("cat " + f + ' ' + f + " | wc") ==
+        "cat " + f + ' ' + f + " | wc");
+  CHECK(Plan("cat " + f + " | grep a " + f) == "cat " + f + " | grep a " + f);
+  CHECK(Plan("cat " + f + " | wc < " + f) == "cat " + f + " | wc < " + f);
+  // Options the optimizer does not know disable the rewrite.
+  CHECK(Plan("cat " + f + " | grep --unknown a") ==
+        "cat " + f + " | grep --unknown a");
+  // -l and -L name their input, which would change to the file.
+  CHECK(Plan("cat " + f + " | grep -l a") == "cat " + f + " | grep -l a");
+  // -f - takes the patterns from the input; -e makes `a` a file.
+  CHECK(Plan("cat " + f + " | grep -f -") == "cat " + f + " | grep -f -");
+  CHECK(Plan("cat " + f + " | grep -e a b") == "cat " + f + " | grep -e a b");
+  CHECK(Plan("cat " + f + " | grep -L a") == "cat " + f + " | grep -L a");
+  // A binary file would be named in "Binary file ... matches".
+  const TempFile blob("cppshell_opt_blob.bin",
+                      std::string("alpha\0\nbeta\n", 12));
+  const std::string b = blob.Path();
+  CHECK(Plan("cat " + b + " | grep a") == "cat " + b + " | grep a");
+  CHECK(Plan("cat " + b + " | grep -c a") == "grep -c a " + b);
+  CHECK(Plan("cat " + b + " | grep -a a") == "grep -a a " + b);
+  CHECK(Plan("cat " + b + " | grep -I a") == "grep -I a " + b);
+
+  CheckEquivalent("cat cppshell_opt_missing.txt | wc\n");
+  CheckEquivalent("cat " + f + ' ' + f + " | wc\n");
+  CheckEquivalent("cat " + b + " | grep a\n");
+  CheckEquivalent("cat " + b + " | grep -c a\n");
+  CheckEquivalent("cat " + b + " | grep -a a\n");
+  CheckEquivalent("cat " + f + " | grep -l a\n");
+}
+
+TEST_CASE("Optimizer: identity cat stages are dropped") {
+  CHECK(Plan("echo a b | cat | cat | grep a") == "echo a b | grep a");
+  CHECK(Plan("cat | grep x") == "grep x");
+  // The last stage determines the exit status and is kept.
+  CHECK(Plan("grep x | cat") == "grep x | cat");
+  // A leading cat that reads the shell's input is kept if the next stage
+  // would not read it all.
+  CHECK(Plan("cat | pwd") == "cat | pwd");
+  CHECK(Plan("cat | exit 3") == "cat | exit 3");
+  CHECK(Plan("cat > out.txt | grep x") == "cat > out.txt | grep x");
+  // grep that may stop early would leave the rest of the input unread.
+  CHECK(Plan("cat | grep -q x") == "cat | grep -q x");
+  CHECK(Plan("cat | grep -m 1 x") == "cat | grep -m 1 x");
+  CHECK(Plan("cat | grep -l x") == "cat | grep -l x");
+  CHECK(Plan("cat | grep -v -c x") == "grep -v -c x");
+
+  CheckEquivalent("echo a b | cat | cat | grep a\n");
+  CheckEquivalent("echo a b | cat | grep zzz\n");
+  // Both plans consume the rest of the script as input.
+  CheckEquivalent("cat | wc\necho after\n");
+  CheckEquivalent("cat | exit 3\necho still running\n");
+  CheckEquivalent("cat | grep -m 1 echo\necho after\n");
+}
+
+TEST_CASE("Optimizer: grep followed by wc is fused") {
+  CHECK(Plan("echo a | grep a | wc") == "echo a | [grep a | wc]");
+  CHECK(Plan("grep a 2> err.txt | wc") == "[grep a 2> err.txt | wc]");
+  CHECK(Plan("grep a > out.txt | wc") == "grep a > out.txt | wc");
+  CHECK(Plan("grep a | wc > out.txt") == "grep a | wc > out.txt");
+  CHECK(Plan("grep a | wc -l") == "grep a | wc -l");
+
+  const TempFile file("cppshell_opt_fuse.txt", "one\ntwo\nthree\n");
+  const std::string f = file.Path();
+  CheckEquivalent("grep o " + f + " | wc\n");
+  CheckEquivalent("echo a | grep a | wc | cat\n");
+  // No match: grep fails but the pipeline status is wc's.
+  CheckEquivalent("grep zzz " + f + " | wc\n");
+  // Errors from grep still reach stderr.
+  CheckEquivalent("grep '(' " + f + " | wc\n");
+  CheckEquivalent("grep o cppshell_opt_missing.txt | wc\n");
+  CheckEquivalent("grep | wc\n");
+}
+
+TEST_CASE("Optimizer: switch and plan dump") {
+  const TempFile file("cppshell_opt_dump.txt", "x\n");
+  const std::string f = file.Path();
+
+  std::istringstream in("CPPSHELL_DUMP_PLAN=1\n"
+                        "cat " +
+                        f +
+                        " | wc\n"
+                        "CPPSHELL_OPTIMIZE=0\n"
+                        "cat " +
+                        f + " | wc\n");
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Shell shell;
+  CHECK(shell.Run(in, out, err, false) == 0);
+  CHECK(out.str() == "1 1 2\n1 1 2\n");
+  CHECK(err.str() == "plan: wc " + f + "\nplan: cat " + f + " | wc\n");
+}
@@ -135,3 +135,58 @@ TEST_CASE("ParseLine: grep complex pipeline on windows") {
 
   CHECK(r.pipeline->commands[2].command == "wc");
 }
+
+TEST_CASE("ParseLine: redirections") {
+  const auto r = cppshell::ParseLine("sort < in.txt -r > out.txt 2> err.txt");
+  REQUIRE(r.Ok());
+  REQUIRE(r.pipeline.has_value());
+  REQUIRE(r.pipeline->commands.size() == 1);
+
+  const auto &cmd = r.pipeline->commands[0];
+  CHECK(cmd.command == "sort");
+  REQUIRE(cmd.args.size() == 1);
+  CHECK(cmd.args[0] == "-r");
+  REQUIRE(cmd.redirections.size() == 3);
+  CHECK(cmd.redirections[0].kind == cppshell::RedirectionKind::Input);
+  CHECK(cmd.redirections[0].target == "in.txt");
+  CHECK(cmd.redirections[1].kind == cppshell::RedirectionKind::Output);
+  CHECK(cmd.redirections[1].target == "out.txt");
+  CHECK(cmd.redirections[2].kind == cppshell::RedirectionKind::Error);
+  CHECK(cmd.redirections[2].target == "err.txt");
+}
+
+TEST_CASE("ParseLine: redirections in pipeline") {
+  const auto r = cppshell::ParseLine("cat < a.txt | grep x >> log.txt");
+  REQUIRE(r.Ok());
+  REQUIRE(r.pipeline.has_value());
+  REQUIRE(r.pipeline->commands.size() == 2);
+
+  const auto &cat = r.pipeline->commands[0];
+  CHECK(cat.args.empty());
+  REQUIRE(cat.redirections.size() == 1);
+  CHECK(cat.redirections[0].kind == cppshell::RedirectionKind::Input);
+
+  const auto &grep = r.pipeline->commands[1];
+  REQUIRE(grep.args.size() == 1);
+  REQUIRE(grep.redirections.size() == 1);
+  CHECK(grep.redirections[0].kind == cppshell::RedirectionKind::Append);
+  CHECK(grep.redirections[0].target == "log.txt");
+}
+
+TEST_CASE("ParseLine: quoted operators are arguments") {
+  const auto r = cppshell::ParseLine("grep '>' \"|\" file.txt");
+  REQUIRE(r.Ok());
+  REQUIRE(r.pipeline.has_value());
+  REQUIRE(r.pipeline->commands.size() == 1);
+  const auto &cmd = r.pipeline->commands[0];
+  REQUIRE(cmd.args.size() == 3);
+  CHECK(cmd.args[0] == ">");
+  CHECK(cmd.args[1] == "|");
+  CHECK(cmd.redirections.empty());
+}
+
+TEST_CASE("ParseLine: redirection without target is an error") {
+  CHECK_FALSE(cppshell::ParseLine("echo hi >").Ok());
+  CHECK_FALSE(cppshell::ParseLine("echo hi > | cat").Ok());
+  CHECK_FALSE(cppshell::ParseLine("cat < > out").Ok());
+}
@@ -0,0 +1,133 @@
+#include "cppshell/environment.hpp"
+#include "cppshell/external_command.hpp"
+#include "cppshell/redirection.hpp"
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef CPPSHELL_TEST_HELPER_PATH
+#error "CPPSHELL_TEST_HELPER_PATH is not defined"
+#endif
+
+namespace {
+
+[[nodiscard]] std::string ReadFile(const std::filesystem::path &path) {
+  std::ifstream f(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+void WriteFile(const std::filesystem::path &path, const std::string &data) {
+  std::ofstream f(path, std::ios::binary);
+  f << data;
+}
+
+} // namespace
+
+TEST_CASE("RedirectedStreams: output truncates and append appends") {
+  const auto tmp =
+      std::filesystem::temp_directory_path() / "cppshell_redirect_out.txt";
+  WriteFile(tmp, "old contents\n");
+
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+
+  {
+    cppshell::RedirectedStreams r(
+        {{cppshell::RedirectionKind::Output, tmp.string()}},
+        cppshell::CommandStreams{in, out, err});
+    REQUIRE(r.Ok());
+    r.Streams().out << "first\n";
+  }
+  CHECK(ReadFile(tmp) == "first\n");
+
+  {
+    cppshell::RedirectedStreams r(
+        {{cppshell::RedirectionKind::Append, tmp.string()}},
+        cppshell::CommandStreams{in, out, err});
+    REQUIRE(r.Ok());
+    r.Streams().out << "second\n";
+  }
+  CHECK(ReadFile(tmp) == "first\nsecond\n");
+  CHECK(out.str().empty());
+
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+}
+
+TEST_CASE("RedirectedStreams: input and untouched streams") {
+  const auto tmp =
+      std::filesystem::temp_directory_path() / "cppshell_redirect_in.txt";
+  WriteFile(tmp, "from file\n");
+
+  std::istringstream in("from stdin\n");
+  std::ostringstream out;
+  std::ostringstream err;
+
+  cppshell::RedirectedStreams r(
+      {{cppshell::RedirectionKind::Input, tmp.string()}},
+      cppshell::CommandStreams{in, out, err});
+  REQUIRE(r.Ok());
+
+  std::string line;
+  std::getline(r.Streams().in, line);
+  CHECK(line == "from file");
+  CHECK(&r.Streams().out == &out);
+  CHECK(&r.Streams().err == &err);
+
+  std::error_code ec;
+  std::filesystem::remove(tmp, ec);
+}
+
+TEST_CASE("RedirectedStreams: missing input file is an error") {
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+
+  cppshell::RedirectedStreams r(
+      {{cppshell::RedirectionKind::Input, "cppshell_no_such_file.txt"}},
+      cppshell::CommandStreams{in, out, err});
+  CHECK_FALSE(r.Ok());
+  CHECK(r.Error().find("cppshell_no_such_file.txt") != std::string::npos);
+}
+
+TEST_CASE("RedirectedStreams: external command writes to the file") {
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto inPath = dir / "cppshell_redirect_ext_in.txt";
+  const auto outPath = dir / "cppshell_redirect_ext_out.txt";
+  WriteFile(inPath, "abc\n123");
+
+  std::istringstream in("");
+  std::ostringstream out;
+  std::ostringstream err;
+  cppshell::Environment env;
+
+  {
+    cppshell::RedirectedStreams r(
+        {{cppshell::RedirectionKind::Input, inPath.string()},
+         {cppshell::RedirectionKind::Output, outPath.string()}},
+        cppshell::CommandStreams{in, out, err});
+    REQUIRE(r.Ok());
+
+    cppshell::CommandStreams streams = r.Streams();
+    streams.out << "prefix\n";
+    cppshell::CommandContext ctx{streams, env};
+    cppshell::ExternalCommand cmd(CPPSHELL_TEST_HELPER_PATH, {"catstdin"},
+                                  env);
+    const auto res = cmd.Execute(ctx);
+    CHECK(res.exitCode == 0);
+  }
+
+  CHECK(ReadFile(outPath) == "prefix\nabc\n123");
+  CHECK(out.str().empty());
+
+  std::error_code ec;
+  std::filesystem::remove(inPath, ec);
+  std::filesystem::remove(outPath, ec);
+}
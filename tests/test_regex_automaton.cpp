@@ -0,0 +1,139 @@
+#include "cppshell/regex_automaton.hpp"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Checks the automaton against std::regex_search on every line. */
+void CheckAgainstStdRegex(const std::string &pattern, bool ignoreCase,
+                          const std::vector<std::string> &lines) {
+  CAPTURE(pattern);
+  CAPTURE(ignoreCase);
+  const auto automaton = cppshell::RegexAutomaton::Compile(pattern, ignoreCase);
+  REQUIRE(automaton != nullptr);
+  auto flags = std::regex_constants::ECMAScript;
+  if (ignoreCase) {
+    flags |= std::regex_constants::icase;
+  }
+  const std::regex re(pattern, flags);
+  auto searcher = automaton->Acquire();
+  for (const std::string &line : lines) {
+    CAPTURE(line);
+    CHECK(searcher->Search(line) == std::regex_search(line, re));
+  }
+  automaton->Release(std::move(searcher));
+}
+
+} // namespace
+
+TEST_CASE("RegexAutomaton: agrees with std::regex on grep patterns") {
+  const std::vector<std::string> lines = {
+      "",
+      "ERROR disk full",
+      "2026-10-19 WARN worker-7 took 950ms",
+      "error: status=503",
+      "a_b c-d",
+      "xyz\tTab\r",
+      "aaaa",
+      "abcabc",
+      "Worker-12 done",
+      "file.cpp main.hpp",
+      "  leading space",
+      "\\path\\to",
+      "[brackets] {braces} (parens)",
+  };
+  const std::vector<std::string> patterns = {
+      "^ERROR",       "full$",          "^$",
+      "e.r",          "[0-9]+ms",       "status=[45]0[0-9]",
+      "(cpp|hpp)$",   "\\bworker\\b",   "\\Bor",
+      "a{2,3}",       "a{4}",           "(abc){2}",
+      "x?y*z+",       "[^a-z ]",        "\\d\\d:\\d",
+      "\\w+-\\w+",    "\\s\\S",         "[\\w.]+\\.hpp",
+      "(?:a|b)c",     "a.*?c",          "\\[\\w+\\]",
+      "[-a]b",        "\\\\path",       "^\\s+",
+      "\\x41",        "[A-Z][a-z]+ ",   "()",
+      "a|",           "(a*)*b",         "\\bb\\b",
+  };
+  for (const std::string &pattern : patterns) {
+    CheckAgainstStdRegex(pattern, false, lines);
+    CheckAgainstStdRegex(pattern, true, lines);
+  }
+}
+
+TEST_CASE("RegexAutomaton: agrees with std::regex on random patterns") {
+  std::mt19937 rng(35);
+  const std::vector<std::string> atoms = {"a",   "b",   ".",    "[ab]",
+                                          "\\b", "^",   "$",    "(a|b)",
+                                          "(ab)", "\\w", "[^a]", "A"};
+  const std::vector<std::string> quantifiers = {"", "", "*", "+", "?",
+                                                "{1,2}"};
+  std::vector<std::string> lines;
+  for (int i = 0; i < 40; ++i) {
+    std::string line(rng() % 8, ' ');
+    for (char &c : line) {
+      c = "abA -"[rng() % 5];
+    }
+    lines.push_back(line);
+  }
+  for (int round = 0; round < 200; ++round) {
+    std::string pattern;
+    for (unsigned n = 1 + rng() % 4; n > 0; --n) {
+      const std::string &atom = atoms[rng() % atoms.size()];
+      pattern += atom;
+      const bool assertion = atom == "\\b" || atom == "^" || atom == "$";
+      if (!assertion) {
+        pattern += quantifiers[rng() % quantifiers.size()];
+      }
+    }
+    CheckAgainstStdRegex(pattern, round % 3 == 0, lines);
+  }
+}
+
+TEST_CASE("RegexAutomaton: leaves unsupported syntax to std::regex") {
+  for (const char *pattern :
+       {"(a)\\1", "a(?=b)", "a(?!b)", "[[:alpha:]]", "\\u0041", "(", "a**",
+        "*a", "a{2,1}", "[b-a]", "\\cM", "a{", "[]"}) {
+    CAPTURE(pattern);
+    CHECK(cppshell::RegexAutomaton::Compile(pattern, false) == nullptr);
+  }
+}
+
+TEST_CASE("RegexAutomaton: adversarial patterns stay linear") {
+  const std::string line = std::string(100000, 'a') + "!";
+  for (const char *pattern :
+       {"(a+)+$", "(a|aa)*b", "(a*)*(a*)*c", "(x+x+)+y"}) {
+    CAPTURE(pattern);
+    const auto automaton = cppshell::RegexAutomaton::Compile(pattern, false);
+    REQUIRE(automaton != nullptr);
+    auto searcher = automaton->Acquire();
+    const auto start = std::chrono::steady_clock::now();
+    CHECK_FALSE(searcher->Search(line));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  }
+}
+
+TEST_CASE("RegexAutomaton: the state cache is bounded") {
+  // (a|b)*a(a|b){12} needs 2^13 DFA states, more than the cache holds.
+  const auto automaton =
+      cppshell::RegexAutomaton::Compile("a[ab]{12}$", false);
+  REQUIRE(automaton != nullptr);
+  std::mt19937 rng(1);
+  std::string line(30000, 'a');
+  for (char &c : line) {
+    c = rng() % 2 == 0 ? 'a' : 'b';
+  }
+  const std::regex re("a[ab]{12}$");
+  auto searcher = automaton->Acquire();
+  for (size_t end = 13; end <= line.size(); end += 997) {
+    const std::string prefix = line.substr(0, end);
+    CHECK(searcher->Search(prefix) == std::regex_search(prefix, re));
+  }
+  CHECK(searcher->Search(line) == std::regex_search(line, re));
+  CHECK(searcher->CacheResets() > 0);
+}
@@ -0,0 +1,245 @@
+#include "cppshell/shm_transport.hpp"
+
+#include <doctest/doctest.h>
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+/** Deterministic data whose every byte depends on its position. */
+[[nodiscard]] std::string Pattern(size_t size) {
+  std::string data(size, '\0');
+  uint32_t x = 12345;
+  for (char &ch : data) {
+    x = x * 1103515245 + 12345;
+    ch = static_cast<char>(x >> 24);
+  }
+  return data;
+}
+
+/** Runs `body` in a child process and returns its exit status. */
+template <typename F> [[nodiscard]] int InChild(F body) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    std::_Exit(body());
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+} // namespace
+
+TEST_CASE("SharedRing: bytes cross a fork intact and wrap around") {
+  const std::unique_ptr<cppshell::SharedRing> ring =
+      cppshell::SharedRing::Create(64 * 1024);
+  REQUIRE(ring != nullptr);
+  CHECK(ring->Capacity() == 64 * 1024);
+
+  // Many times the capacity, in writes of odd sizes.
+  const std::string data = Pattern(3 * 1000 * 1000 + 7);
+  const pid_t producer = fork();
+  if (producer == 0) {
+    {
+      cppshell::RingWriteBuffer buffer(*ring, -1);
+      std::ostream out(&buffer);
+      for (size_t at = 0; at < data.size(); at += 4099) {
+        out.write(data.data() + at,
+                  static_cast<std::streamsize>(
+                      std::min<size_t>(4099, data.size() - at)));
+      }
+      out.put('!');
+    }
+    std::_Exit(0);
+  }
+
+  std::string received;
+  {
+    cppshell::RingReadBuffer buffer(*ring, -1);
+    std::istream in(&buffer);
+    received.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  int status = 0;
+  waitpid(producer, &status, 0);
+  CHECK(WIFEXITED(status));
+  CHECK(received == data + '!');
+}
+
+TEST_CASE("SharedRing: writing after the reader left acts like EPIPE") {
+  const std::unique_ptr<cppshell::SharedRing> ring =
+      cppshell::SharedRing::Create(4096);
+  REQUIRE(ring != nullptr);
+  ring->CloseReader();
+
+  // Default disposition: the writer dies of SIGPIPE, as with a pipe.
+  CHECK(InChild([&] {
+          cppshell::RingWriteBuffer buffer(*ring, -1);
+          std::ostream out(&buffer);
+          out << Pattern(10000) << std::flush;
+          return 0;
+        }) == 128 + SIGPIPE);
+
+  // Ignored: the stream fails instead.
+  CHECK(InChild([&] {
+          std::signal(SIGPIPE, SIG_IGN);
+          cppshell::RingWriteBuffer buffer(*ring, -1);
+          std::ostream out(&buffer);
+          out << Pattern(10000) << std::flush;
+          return out.fail() ? 3 : 0;
+        }) == 3);
+}
+
+TEST_CASE("SharedRing: a reader notices a producer that died") {
+  const std::unique_ptr<cppshell::SharedRing> ring =
+      cppshell::SharedRing::Create(4096);
+  REQUIRE(ring != nullptr);
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+
+  const pid_t producer = fork();
+  if (producer == 0) {
+    close(fds[0]);
+    cppshell::RingWriteBuffer buffer(*ring, fds[1]);
+    std::ostream out(&buffer);
+    out << "partial" << std::flush;
+    // Exits without closing its end of the ring.
+    std::_Exit(0);
+  }
+  close(fds[1]);
+
+  std::string received;
+  {
+    cppshell::RingReadBuffer buffer(*ring, fds[0]);
+    std::istream in(&buffer);
+    received.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  close(fds[0]);
+  waitpid(producer, nullptr, 0);
+  CHECK(received == "partial");
+}
+
+TEST_CASE("VmspliceWriteBuffer: reused buffers never corrupt the stream") {
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  // Several times the pipe capacity, so both buffers are refilled while
+  // the reader may still be behind.
+  const std::string data = Pattern(9 * 1024 * 1024 + 123);
+
+  const pid_t writer = fork();
+  if (writer == 0) {
+    close(fds[0]);
+    {
+      cppshell::VmspliceWriteBuffer buffer(fds[1]);
+      std::ostream out(&buffer);
+      for (size_t at = 0; at < data.size(); at += 10007) {
+        out.write(data.data() + at,
+                  static_cast<std::streamsize>(
+                      std::min<size_t>(10007, data.size() - at)));
+        if (at % (1024 * 1024) == 0) {
+          out.flush();
+        }
+      }
+    }
+    std::_Exit(0);
+  }
+  close(fds[1]);
+
+  std::string received;
+  char block[65536];
+  ssize_t n = 0;
+  for (int reads = 1; (n = read(fds[0], block, sizeof(block))) > 0; ++reads) {
+    received.append(block, static_cast<size_t>(n));
+    // Reading slowly keeps spliced pages in the pipe for longer.
+    if (reads % 8 == 0) {
+      usleep(1000);
+    }
+  }
+  close(fds[0]);
+  waitpid(writer, nullptr, 0);
+  CHECK(received.size() == data.size());
+  CHECK(received == data);
+}
+
+TEST_CASE("VmspliceWriteBuffer: pages a reader keeps are never rewritten") {
+  int fds[2];
+  int kept[2];
+  REQUIRE(pipe(fds) == 0);
+  REQUIRE(pipe(kept) == 0);
+  const std::string data = Pattern(6 * 1024 * 1024 + 5);
+
+  const pid_t writer = fork();
+  if (writer == 0) {
+    close(fds[0]);
+    {
+      cppshell::VmspliceWriteBuffer buffer(fds[1]);
+      std::ostream out(&buffer);
+      out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    std::_Exit(0);
+  }
+  close(fds[1]);
+
+  // Once the first buffer fills the pipe, tee its pages into a second
+  // pipe, which holds on to them while the first is read to the end.
+  usleep(50 * 1000);
+  const int size = fcntl(fds[0], F_GETPIPE_SZ);
+  (void)fcntl(kept[1], F_SETPIPE_SZ, size);
+  const ssize_t teed = tee(fds[0], kept[1], static_cast<size_t>(size), 0);
+  REQUIRE(teed > 0);
+  close(kept[1]);
+
+  std::string received;
+  char block[65536];
+  ssize_t n = 0;
+  while ((n = read(fds[0], block, sizeof(block))) > 0) {
+    received.append(block, static_cast<size_t>(n));
+  }
+  close(fds[0]);
+  waitpid(writer, nullptr, 0);
+  CHECK(received == data);
+
+  std::string again;
+  while ((n = read(kept[0], block, sizeof(block))) > 0) {
+    again.append(block, static_cast<size_t>(n));
+  }
+  close(kept[0]);
+  CHECK(again == data.substr(0, static_cast<size_t>(teed)));
+}
+
+TEST_CASE("VmspliceWriteBuffer: falls back to write for files") {
+  char path[] = "/tmp/cppshell_vmsplice_XXXXXX";
+  const int fd = mkstemp(path);
+  REQUIRE(fd >= 0);
+  const std::string data = Pattern(300 * 1000);
+  {
+    cppshell::VmspliceWriteBuffer buffer(fd);
+    std::ostream out(&buffer);
+    out << data;
+  }
+  REQUIRE(lseek(fd, 0, SEEK_SET) == 0);
+  std::string back(data.size() + 1, '\0');
+  CHECK(read(fd, back.data(), back.size()) ==
+        static_cast<ssize_t>(data.size()));
+  back.resize(data.size());
+  CHECK(back == data);
+  close(fd);
+  unlink(path);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "cppshell/environment.hpp"
+#include "cppshell/thread_pool.hpp"
+
+#include <doctest/doctest.h>
+
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("ThreadPool: runs tasks and returns their results") {
+  cppshell::ThreadPool pool(3);
+  CHECK(pool.Size() == 3);
+
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; ++i) {
+    results.push_back(pool.Submit([i] { return i * i; }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    CHECK(results[i].get() == i * i);
+  }
+}
+
+TEST_CASE("ThreadPool: exceptions reach the caller") {
+  cppshell::ThreadPool pool(1);
+  auto failed =
+      pool.Submit([]() -> int { throw std::runtime_error("task failed"); });
+  CHECK_THROWS_AS(failed.get(), std::runtime_error);
+}
+
+TEST_CASE("WorkerCount: CPPSHELL_THREADS overrides the hardware default") {
+  cppshell::Environment env;
+  env.Set("CPPSHELL_THREADS", "6");
+  CHECK(cppshell::WorkerCount(env) == 6);
+
+  env.Set("CPPSHELL_THREADS", "0");
+  CHECK(cppshell::WorkerCount(env) >= 1);
+  env.Set("CPPSHELL_THREADS", "many");
+  CHECK(cppshell::WorkerCount(env) >= 1);
+}
@@ -97,3 +97,43 @@ TEST_CASE("Tokenize: grep regex patterns") {
   // "foo\"bar" Parser/Tokenizer should strip outer quotes and unescape inner.
   CHECK(r3.tokens[1] == "foo\"bar");
 }
+
+TEST_CASE("Tokenize: redirection operators") {
+  SUBCASE("Separated by spaces") {
+    const auto r = cppshell::Tokenize("cat < in.txt > out.txt 2> err.txt");
+    REQUIRE(r.Ok());
+    REQUIRE(r.tokens.size() == 7);
+    CHECK(r.tokens[1] == "<");
+    CHECK(r.tokens[3] == ">");
+    CHECK(r.tokens[5] == "2>");
+    CHECK(r.tokens[6] == "err.txt");
+  }
+
+  SUBCASE("No spaces and append") {
+    const auto r = cppshell::Tokenize("echo hi>>log.txt");
+    REQUIRE(r.Ok());
+    REQUIRE(r.tokens.size() == 4);
+    CHECK(r.tokens[1] == "hi");
+    CHECK(r.tokens[2] == ">>");
+    CHECK(r.tokens[3] == "log.txt");
+  }
+
+  SUBCASE("Digit inside a word is not a descriptor") {
+    const auto r = cppshell::Tokenize("echo a2>f");
+    REQUIRE(r.Ok());
+    REQUIRE(r.tokens.size() == 4);
+    CHECK(r.tokens[1] == "a2");
+    CHECK(r.tokens[2] == ">");
+  }
+
+  SUBCASE("Quoted operators stay literal") {
+    const auto r = cppshell::Tokenize("echo '>' \"2\">f");
+    REQUIRE(r.Ok());
+    REQUIRE(r.tokens.size() == 5);
+    CHECK(r.tokens[1] == ">");
+    CHECK_FALSE(r.operators[1]);
+    CHECK(r.tokens[2] == "2");
+    CHECK(r.tokens[3] == ">");
+    CHECK(r.operators[3]);
+  }
+}
@@ -0,0 +1,243 @@
+#include "cppshell/trigram_index.hpp"
+
+#include "cppshell/command.hpp"
+#include "cppshell/environment.hpp"
+#include "cppshell/grep_command.hpp"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cppshell;
+
+namespace {
+
+uint32_t Trigram(const char (&text)[4]) {
+  return (uint32_t{static_cast<unsigned char>(text[0])} << 16) |
+         (uint32_t{static_cast<unsigned char>(text[1])} << 8) |
+         static_cast<unsigned char>(text[2]);
+}
+
+std::vector<std::vector<uint32_t>> Query(std::vector<std::string> patterns,
+                                         bool fixed = false) {
+  GrepPatternOptions options;
+  options.fixedStrings = fixed;
+  const TrigramQuery query(patterns, options);
+  return query.All() ? std::vector<std::vector<uint32_t>>{{}}
+                     : query.Alternatives();
+}
+
+/** Writes `text` to `path`, last changed `minutes` ago. */
+void WriteFile(const std::filesystem::path &path, const std::string &text,
+               int minutes = 60) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path, std::ios::binary) << text;
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now() -
+                std::chrono::minutes(minutes));
+}
+
+std::string RunGrep(std::vector<std::string> args) {
+  std::stringstream in;
+  std::stringstream out;
+  std::stringstream err;
+  Environment env;
+  env.Set("CPPSHELL_THREADS", "2");
+  CommandStreams streams{in, out, err};
+  CommandContext ctx{streams, env};
+  GrepCommand cmd(std::move(args));
+  const int code = cmd.Execute(ctx).exitCode;
+  return std::to_string(code) + "\n" + err.str() + out.str();
+}
+
+} // namespace
+
+TEST_CASE("TrigramQuery: trigrams every match holds") {
+  using Alternatives = std::vector<std::vector<uint32_t>>;
+  const Alternatives all = {{}};
+  CHECK(Query({"hello"}) ==
+        Alternatives{{Trigram("ell"), Trigram("hel"), Trigram("llo")}});
+  CHECK(Query({"HeLlo"}) == Query({"hello"}));
+  CHECK(Query({"foo.*bar"}) == Alternatives{{Trigram("bar"), Trigram("foo")}});
+  CHECK(Query({"abc|xyz1"}) ==
+        Alternatives{{Trigram("abc")}, {Trigram("xyz"), Trigram("yz1")}});
+  CHECK(Query({"abc", "xyz"}) ==
+        Alternatives{{Trigram("abc")}, {Trigram("xyz")}});
+  // Optional and repeated characters, groups and classes end a run.
+  CHECK(Query({"colou?r"}) ==
+        Alternatives{{Trigram("col"), Trigram("olo")}});
+  CHECK(Query({"ab+cde"}) == Alternatives{{Trigram("cde")}});
+  CHECK(Query({"abc+d"}) == Alternatives{{Trigram("abc")}});
+  CHECK(Query({"x{2}abc"}) == Alternatives{{Trigram("abc")}});
+  CHECK(Query({"(a|b)cde[xy]fgh"}) ==
+        Alternatives{{Trigram("cde"), Trigram("fgh")}});
+  CHECK(Query({"[|]abc"}) == Alternatives{{Trigram("abc")}});
+  CHECK(Query({"\\.cpp"}) == Alternatives{{Trigram(".cp"), Trigram("cpp")}});
+  CHECK(Query({"a\\dbcd"}) == Alternatives{{Trigram("bcd")}});
+  CHECK(Query({"a.c|x*y"}, true) == Alternatives{{Trigram(".c|"),
+                                                  Trigram("a.c"),
+                                                  Trigram("c|x"),
+                                                  Trigram("x*y"),
+                                                  Trigram("|x*")}});
+  // A branch without three plain characters rules nothing out.
+  CHECK(Query({"ab"}) == all);
+  CHECK(Query({"abc|x"}) == all);
+  // In ECMAScript "[]" is an empty class, so this has two branches.
+  CHECK(Query({"[]|]abc"}) == all);
+  CHECK(Query({"abc", ".*"}) == all);
+  CHECK(Query({""}, true) == all);
+  CHECK(Query({}) == Alternatives{});
+}
+
+TEST_CASE("TrigramIndex: narrows grep to the files that may match") {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_trigram_index";
+  std::filesystem::remove_all(root);
+  WriteFile(root / "a.txt", "alpha\nneedle one\n");
+  WriteFile(root / "src" / "b.cpp", "Needle two\nbeta\n");
+  WriteFile(root / "src" / "c.cpp", "need\nle\ngamma\n");
+  WriteFile(root / "d.txt", "haystack\n");
+  const std::string dir = root.string();
+  const std::string r = dir + "/";
+
+  const IndexBuild built = TrigramIndex::Build(dir, 2);
+  CHECK(built.written);
+  CHECK(built.errors.empty());
+  CHECK(built.files == 4);
+  CHECK(built.read == 4);
+
+  std::string error;
+  const std::unique_ptr<TrigramIndex> index = TrigramIndex::Open(dir, error);
+  REQUIRE(index != nullptr);
+  CHECK(index->Files() == 4);
+  const std::vector<std::string> files = {r + "a.txt", r + "d.txt",
+                                          r + "src/b.cpp", r + "src/c.cpp"};
+  const auto narrow = [&](const std::string &pattern) {
+    return index->Narrow(files, TrigramQuery({pattern}, {}));
+  };
+  // Trigrams do not cross lines; case is folded.
+  CHECK(narrow("needle") ==
+        std::vector<std::string>{r + "a.txt", r + "src/b.cpp"});
+  CHECK(narrow("hay|gamma") ==
+        std::vector<std::string>{r + "d.txt", r + "src/c.cpp"});
+  CHECK(narrow("zebra").empty());
+  CHECK(narrow("ne").size() == 4);
+
+  // The same lines as a full search, for each kind of query.
+  for (const std::vector<std::string> &args :
+       {std::vector<std::string>{"needle"}, {"-i", "NEEDLE"}, {"-n", "e.d"},
+        {"-l", "alpha|beta"}, {"-v", "needle"}, {"-c", "needle"},
+        {"-L", "needle"}, {"-F", "le"}, {"zebra"}}) {
+    std::vector<std::string> indexed = args;
+    indexed.insert(indexed.begin(), {"--sort=path", "--index", dir});
+    std::vector<std::string> full = args;
+    full.insert(full.begin(), {"-r", "--sort=path",
+                               "--exclude=.cppshell-grep-index"});
+    full.push_back(dir);
+    CHECK(RunGrep(indexed) == RunGrep(full));
+  }
+  CHECK(RunGrep({"--sort=path", "--index", dir, "needle"}) ==
+        "0\n" + r + "a.txt:needle one\n");
+
+  CHECK(RunGrep({"--index", dir, "needle", r + "a.txt"}) ==
+        "2\ngrep: --index takes no FILE\n");
+  CHECK(RunGrep({"--index-build", dir, "needle"}) ==
+        "2\ngrep: --index-build takes no pattern or FILE\n");
+  CHECK(RunGrep({"--index-build=" + dir}) == "0\n");
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("TrigramIndex: changed files are searched until indexed again") {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_trigram_update";
+  std::filesystem::remove_all(root);
+  WriteFile(root / "a.txt", "alpha\n");
+  WriteFile(root / "b.txt", "beta\n");
+  WriteFile(root / "c.txt", "gamma\n");
+  const std::string dir = root.string();
+  const std::string r = dir + "/";
+  REQUIRE(TrigramIndex::Build(dir, 1).written);
+
+  // A file that changed or is new is a candidate whatever it holds.
+  WriteFile(root / "b.txt", "beta needle\n", 30);
+  WriteFile(root / "new.txt", "needle new\n");
+  CHECK(RunGrep({"--sort=path", "--index", dir, "needle"}) ==
+        "0\n" + r + "b.txt:beta needle\n" + r + "new.txt:needle new\n");
+  std::string error;
+  std::unique_ptr<TrigramIndex> index = TrigramIndex::Open(dir, error);
+  REQUIRE(index != nullptr);
+  CHECK(index->Narrow({r + "a.txt", r + "b.txt", r + "new.txt"},
+                      TrigramQuery({"zebra"}, {})) ==
+        std::vector<std::string>{r + "b.txt", r + "new.txt"});
+  index.reset();
+
+  // Only those are read again.
+  IndexBuild built = TrigramIndex::Build(dir, 2);
+  CHECK(built.files == 4);
+  CHECK(built.read == 2);
+  index = TrigramIndex::Open(dir, error);
+  REQUIRE(index != nullptr);
+  CHECK(index->Narrow({r + "a.txt", r + "b.txt", r + "new.txt"},
+                      TrigramQuery({"needle"}, {})) ==
+        std::vector<std::string>{r + "b.txt", r + "new.txt"});
+  CHECK(index->Narrow({r + "a.txt", r + "b.txt", r + "new.txt"},
+                      TrigramQuery({"zebra"}, {}))
+            .empty());
+  index.reset();
+  std::filesystem::remove(root / "c.txt");
+  built = TrigramIndex::Build(dir, 1);
+  CHECK(built.files == 3);
+  CHECK(built.read == 0);
+
+  // A file changed just before a build may change again within the same
+  // clock tick, so it is not trusted until a later build.
+  WriteFile(root / "a.txt", "alpha\n", 0);
+  REQUIRE(TrigramIndex::Build(dir, 1).read == 1);
+  index = TrigramIndex::Open(dir, error);
+  REQUIRE(index != nullptr);
+  CHECK(index->Narrow({r + "a.txt"}, TrigramQuery({"zebra"}, {})) ==
+        std::vector<std::string>{r + "a.txt"});
+  index.reset();
+  CHECK(TrigramIndex::Build(dir, 1).read == 1);
+
+  std::filesystem::remove_all(root);
+}
+
+TEST_CASE("TrigramIndex: a missing or damaged index is not used") {
+  const auto root =
+      std::filesystem::temp_directory_path() / "cppshell_trigram_damaged";
+  std::filesystem::remove_all(root);
+  WriteFile(root / "a.txt", "needle\n");
+  const std::string dir = root.string();
+  const std::string path = dir + "/.cppshell-grep-index";
+
+  std::string error;
+  CHECK(TrigramIndex::Open(dir, error) == nullptr);
+  CHECK(error == path + ": No such file or directory");
+  CHECK(RunGrep({"--index", dir, "needle"}) ==
+        "0\ngrep: " + path + ": No such file or directory; searching every " +
+            "file\n" + dir + "/a.txt:needle\n");
+
+  REQUIRE(TrigramIndex::Build(dir, 1).written);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+  CHECK(TrigramIndex::Open(dir, error) == nullptr);
+  CHECK(error == path + ": damaged index");
+  WriteFile(path, "not an index at all", 0);
+  CHECK(TrigramIndex::Open(dir, error) == nullptr);
+  CHECK(error == path + ": not a grep index");
+  CHECK(RunGrep({"--index", dir, "needle"}) ==
+        "0\ngrep: " + path + ": not a grep index; searching every file\n" +
+            dir + "/a.txt:needle\n");
+
+  // Building replaces it.
+  CHECK(TrigramIndex::Build(dir, 1).read == 1);
+  CHECK(TrigramIndex::Open(dir, error) != nullptr);
+
+  std::filesystem::remove_all(root);
+}